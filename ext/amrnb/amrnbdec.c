@@ -82,10 +82,14 @@ gst_amrnb_variant_get_type (void)
 #define GST_AMRNB_VARIANT_TYPE (gst_amrnb_variant_get_type())
 
 #define VARIANT_DEFAULT GST_AMRNB_VARIANT_IF1
+#define FRAMES_PER_BUFFER_DEFAULT 1
+#define FRAMES_PER_BUFFER_MAX 50
+
 enum
 {
   PROP_0,
-  PROP_VARIANT
+  PROP_VARIANT,
+  PROP_FRAMES_PER_BUFFER
 };
 
 static void gst_amrnbdec_set_property (GObject * object, guint prop_id,
@@ -134,6 +138,18 @@ gst_amrnbdec_class_init (GstAmrnbDecClass * klass)
           VARIANT_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstAmrnbDec:frames-per-buffer:
+   *
+   * Number of frames to decode into one output buffer. Input is collected
+   * until that many frames are available, except at the end of the stream.
+   */
+  g_object_class_install_property (object_class, PROP_FRAMES_PER_BUFFER,
+      g_param_spec_uint ("frames-per-buffer", "Frames per buffer",
+          "Number of frames to decode into one output buffer", 1,
+          FRAMES_PER_BUFFER_MAX, FRAMES_PER_BUFFER_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   GST_DEBUG_CATEGORY_INIT (gst_amrnbdec_debug, "amrnbdec", 0,
       "AMR-NB audio decoder");
 }
@@ -141,6 +157,7 @@ gst_amrnbdec_class_init (GstAmrnbDecClass * klass)
 static void
 gst_amrnbdec_init (GstAmrnbDec * amrnbdec)
 {
+  amrnbdec->frames_per_buffer = FRAMES_PER_BUFFER_DEFAULT;
   gst_audio_decoder_set_needs_format (GST_AUDIO_DECODER (amrnbdec), TRUE);
   gst_audio_decoder_set_use_default_pad_acceptcaps (GST_AUDIO_DECODER_CAST
       (amrnbdec), TRUE);
@@ -170,6 +187,13 @@ gst_amrnbdec_stop (GstAudioDecoder * dec)
   GST_DEBUG_OBJECT (dec, "stop");
   Decoder_Interface_exit (amrnbdec->handle);
 
+  if (amrnbdec->pool) {
+    gst_buffer_pool_set_active (amrnbdec->pool, FALSE);
+    gst_object_unref (amrnbdec->pool);
+    amrnbdec->pool = NULL;
+  }
+  amrnbdec->pool_frames = 0;
+
   return TRUE;
 }
 
@@ -183,6 +207,11 @@ gst_amrnbdec_set_property (GObject * object, guint prop_id,
     case PROP_VARIANT:
       self->variant = g_value_get_enum (value);
       break;
+    case PROP_FRAMES_PER_BUFFER:
+      GST_OBJECT_LOCK (self);
+      self->frames_per_buffer = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -200,6 +229,11 @@ gst_amrnbdec_get_property (GObject * object, guint prop_id,
     case PROP_VARIANT:
       g_value_set_enum (value, self->variant);
       break;
+    case PROP_FRAMES_PER_BUFFER:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->frames_per_buffer);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -230,15 +264,40 @@ gst_amrnbdec_set_format (GstAudioDecoder * dec, GstCaps * caps)
   return gst_audio_decoder_set_output_format (dec, &info);
 }
 
+/* size of the frame starting with @head, including the header */
+static gint
+gst_amrnbdec_block_size (GstAmrnbDec * amrnbdec, guint8 head)
+{
+  gint block, mode;
+
+  switch (amrnbdec->variant) {
+    case GST_AMRNB_VARIANT_IF1:
+      mode = (head >> 3) & 0x0F;
+      block = block_size_if1[mode] + 1;
+      break;
+    case GST_AMRNB_VARIANT_IF2:
+      mode = head & 0x0F;
+      block = block_size_if2[mode] + 1;
+      break;
+    default:
+      g_assert_not_reached ();
+      return -1;
+  }
+
+  GST_LOG_OBJECT (amrnbdec, "mode %d, block %d", mode, block);
+
+  return block;
+}
+
 static GstFlowReturn
 gst_amrnbdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
     gint * offset, gint * length)
 {
   GstAmrnbDec *amrnbdec = GST_AMRNBDEC (dec);
   guint8 head[1];
-  guint size;
+  guint size, total, frames, frames_per_buffer;
   gboolean sync, eos;
-  gint block, mode;
+  gint block;
 
   size = gst_adapter_available (adapter);
   if (size < 1)
@@ -246,42 +305,69 @@ gst_amrnbdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
 
   gst_audio_decoder_get_parse_state (dec, &sync, &eos);
 
-  /* need to peek data to get the size */
-  gst_adapter_copy (adapter, head, 0, 1);
+  GST_OBJECT_LOCK (amrnbdec);
+  frames_per_buffer = amrnbdec->frames_per_buffer;
+  GST_OBJECT_UNLOCK (amrnbdec);
 
-  /* get size */
-  switch (amrnbdec->variant) {
-    case GST_AMRNB_VARIANT_IF1:
-      mode = (head[0] >> 3) & 0x0F;
-      block = block_size_if1[mode] + 1;
-      break;
-    case GST_AMRNB_VARIANT_IF2:
-      mode = head[0] & 0x0F;
-      block = block_size_if2[mode] + 1;
+  /* collect up to frames-per-buffer complete frames */
+  total = 0;
+  for (frames = 0; frames < frames_per_buffer; frames++) {
+    if (total >= size)
       break;
-    default:
-      g_assert_not_reached ();
+
+    /* need to peek data to get the size */
+    gst_adapter_copy (adapter, head, total, 1);
+    block = gst_amrnbdec_block_size (amrnbdec, head[0]);
+    if (block < 0)
       return GST_FLOW_ERROR;
+
+    if (total + block > size)
       break;
+    total += block;
   }
 
-  GST_DEBUG_OBJECT (amrnbdec, "mode %d, block %d", mode, block);
+  GST_DEBUG_OBJECT (amrnbdec, "%u frames in %u bytes", frames, total);
 
-  if (block > size)
+  /* wait for more data unless we're draining */
+  if (frames == 0 || (frames < frames_per_buffer && !eos))
     return GST_FLOW_EOS;
 
   *offset = 0;
-  *length = block;
+  *length = total;
 
   return GST_FLOW_OK;
 }
 
+static gboolean
+gst_amrnbdec_setup_pool (GstAmrnbDec * amrnbdec, guint frames)
+{
+  GstStructure *config;
+
+  if (amrnbdec->pool) {
+    gst_buffer_pool_set_active (amrnbdec->pool, FALSE);
+    gst_object_unref (amrnbdec->pool);
+  }
+
+  amrnbdec->pool = gst_buffer_pool_new ();
+  amrnbdec->pool_frames = frames;
+  config = gst_buffer_pool_get_config (amrnbdec->pool);
+  gst_buffer_pool_config_set_params (config, NULL, frames * 160 * 2, 0, 0);
+  if (!gst_buffer_pool_set_config (amrnbdec->pool, config))
+    return FALSE;
+
+  return gst_buffer_pool_set_active (amrnbdec->pool, TRUE);
+}
+
 static GstFlowReturn
 gst_amrnbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
 {
   GstAmrnbDec *amrnbdec;
   GstMapInfo inmap, outmap;
   GstBuffer *out;
+  GstFlowReturn ret;
+  gsize offset;
+  guint frames, num_frames, frames_per_buffer;
+  gint block;
 
   amrnbdec = GST_AMRNBDEC (dec);
 
@@ -291,15 +377,56 @@ gst_amrnbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
 
   gst_buffer_map (buffer, &inmap, GST_MAP_READ);
 
+  /* count the frames the parser collected, the property may have changed
+   * since then */
+  offset = 0;
+  for (num_frames = 0; offset < inmap.size; num_frames++) {
+    block = gst_amrnbdec_block_size (amrnbdec, inmap.data[offset]);
+    if (block < 0 || offset + block > inmap.size)
+      break;
+    offset += block;
+  }
+
+  GST_OBJECT_LOCK (amrnbdec);
+  frames_per_buffer = MAX (amrnbdec->frames_per_buffer, num_frames);
+  GST_OBJECT_UNLOCK (amrnbdec);
+
+  if (amrnbdec->pool_frames != frames_per_buffer &&
+      !gst_amrnbdec_setup_pool (amrnbdec, frames_per_buffer)) {
+    GST_ERROR_OBJECT (amrnbdec, "failed to set up buffer pool");
+    gst_buffer_unmap (buffer, &inmap);
+    return GST_FLOW_ERROR;
+  }
+
   /* get output */
-  out = gst_buffer_new_and_alloc (160 * 2);
-  /* decode */
+  ret = gst_buffer_pool_acquire_buffer (amrnbdec->pool, &out, NULL);
+  if (G_UNLIKELY (ret != GST_FLOW_OK)) {
+    gst_buffer_unmap (buffer, &inmap);
+    return ret;
+  }
+
   gst_buffer_map (out, &outmap, GST_MAP_WRITE);
-  Decoder_Interface_Decode (amrnbdec->handle, inmap.data,
-      (gint16 *) outmap.data, 0);
-  gst_buffer_unmap (out, &outmap);
 
+  /* decode all frames the parser collected */
+  offset = 0;
+  for (frames = 0; frames < num_frames; frames++) {
+    block = gst_amrnbdec_block_size (amrnbdec, inmap.data[offset]);
+
+    Decoder_Interface_Decode (amrnbdec->handle, inmap.data + offset,
+        (gint16 *) outmap.data + frames * 160, 0);
+    offset += block;
+  }
+
+  gst_buffer_unmap (out, &outmap);
   gst_buffer_unmap (buffer, &inmap);
 
+  if (G_UNLIKELY (frames == 0)) {
+    GST_WARNING_OBJECT (amrnbdec, "no complete frame in input");
+    gst_buffer_unref (out);
+    return gst_audio_decoder_finish_frame (dec, NULL, 1);
+  }
+
+  gst_buffer_resize (out, 0, frames * 160 * 2);
+
   return gst_audio_decoder_finish_frame (dec, out, 1);
 }
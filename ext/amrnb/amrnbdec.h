@@ -57,6 +57,13 @@ struct _GstAmrnbDec {
 
   /* output settings */
   gint channels, rate;
+
+  /* decode this many frames per buffer */
+  guint frames_per_buffer;
+
+  /* output buffers and the number of frames they fit */
+  GstBufferPool *pool;
+  guint pool_frames;
 };
 
 struct _GstAmrnbDecClass {
@@ -40,7 +40,7 @@
 
 #include "amrnbenc.h"
 
-static GType
+GType
 gst_amrnbenc_bandmode_get_type (void)
 {
   static GType gst_amrnbenc_bandmode_type = 0;
@@ -63,13 +63,24 @@ gst_amrnbenc_bandmode_get_type (void)
   return gst_amrnbenc_bandmode_type;
 }
 
-#define GST_AMRNBENC_BANDMODE_TYPE (gst_amrnbenc_bandmode_get_type())
-
 #define BANDMODE_DEFAULT MR122
+#define FRAMES_PER_BUFFER_DEFAULT 1
+#define FRAMES_PER_BUFFER_MAX 50
+#define DTX_DEFAULT FALSE
+
+/* max size of an encoded frame */
+#define MAX_FRAME_SIZE 32
+
+/* frame type in the header of an encoded frame */
+#define FRAME_TYPE(header) (((header) >> 3) & 0x0F)
+#define FRAME_TYPE_NO_DATA 15
+
 enum
 {
   PROP_0,
-  PROP_BANDMODE
+  PROP_BANDMODE,
+  PROP_FRAMES_PER_BUFFER,
+  PROP_DTX
 };
 
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -109,6 +120,12 @@ gst_amrnbenc_set_property (GObject * object, guint prop_id,
     case PROP_BANDMODE:
       self->bandmode = g_value_get_enum (value);
       break;
+    case PROP_FRAMES_PER_BUFFER:
+      self->frames_per_buffer = g_value_get_uint (value);
+      break;
+    case PROP_DTX:
+      self->dtx = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -126,6 +143,12 @@ gst_amrnbenc_get_property (GObject * object, guint prop_id,
     case PROP_BANDMODE:
       g_value_set_enum (value, self->bandmode);
       break;
+    case PROP_FRAMES_PER_BUFFER:
+      g_value_set_uint (value, self->frames_per_buffer);
+      break;
+    case PROP_DTX:
+      g_value_set_boolean (value, self->dtx);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -154,6 +177,34 @@ gst_amrnbenc_class_init (GstAmrnbEncClass * klass)
           BANDMODE_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstAmrnbEnc:frames-per-buffer:
+   *
+   * Number of 20 ms frames to encode into one output buffer. Fewer frames
+   * are output when less input is available. Takes effect when the input
+   * format is (re)negotiated.
+   */
+  g_object_class_install_property (object_class, PROP_FRAMES_PER_BUFFER,
+      g_param_spec_uint ("frames-per-buffer", "Frames per buffer",
+          "Number of frames to encode into one output buffer", 1,
+          FRAMES_PER_BUFFER_MAX, FRAMES_PER_BUFFER_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAmrnbEnc:dtx:
+   *
+   * Enable voice activity detection and discontinuous transmission. During
+   * silence the encoder outputs comfort noise (SID) frames and one byte
+   * NO_DATA frames. Buffers holding only NO_DATA frames are flagged as
+   * GAP and the first speech frame after silence is flagged DISCONT, so
+   * that payloaders can skip the former and set the marker bit on the
+   * latter. Takes effect when the encoder is started.
+   */
+  g_object_class_install_property (object_class, PROP_DTX,
+      g_param_spec_boolean ("dtx", "DTX",
+          "Enable discontinuous transmission during silence", DTX_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (element_class, &sink_template);
   gst_element_class_add_static_pad_template (element_class, &src_template);
 
@@ -169,6 +220,8 @@ gst_amrnbenc_class_init (GstAmrnbEncClass * klass)
 static void
 gst_amrnbenc_init (GstAmrnbEnc * amrnbenc)
 {
+  amrnbenc->frames_per_buffer = FRAMES_PER_BUFFER_DEFAULT;
+  amrnbenc->dtx = DTX_DEFAULT;
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_AUDIO_ENCODER_SINK_PAD (amrnbenc));
 }
 
@@ -179,9 +232,11 @@ gst_amrnbenc_start (GstAudioEncoder * enc)
 
   GST_DEBUG_OBJECT (amrnbenc, "start");
 
-  if (!(amrnbenc->handle = Encoder_Interface_init (0)))
+  if (!(amrnbenc->handle = Encoder_Interface_init (amrnbenc->dtx)))
     return FALSE;
 
+  amrnbenc->speech = TRUE;
+
   return TRUE;
 }
 
@@ -194,9 +249,37 @@ gst_amrnbenc_stop (GstAudioEncoder * enc)
 
   Encoder_Interface_exit (amrnbenc->handle);
 
+  if (amrnbenc->pool) {
+    gst_buffer_pool_set_active (amrnbenc->pool, FALSE);
+    gst_object_unref (amrnbenc->pool);
+    amrnbenc->pool = NULL;
+  }
+
   return TRUE;
 }
 
+/* the pool hands out buffers for @frames encoded frames, they are shrunk to
+ * the actual size and grow back when they return to the pool */
+static gboolean
+gst_amrnbenc_setup_pool (GstAmrnbEnc * amrnbenc, guint frames)
+{
+  GstStructure *config;
+
+  if (amrnbenc->pool) {
+    gst_buffer_pool_set_active (amrnbenc->pool, FALSE);
+    gst_object_unref (amrnbenc->pool);
+  }
+
+  amrnbenc->pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (amrnbenc->pool);
+  gst_buffer_pool_config_set_params (config, NULL, frames * MAX_FRAME_SIZE,
+      0, 0);
+  if (!gst_buffer_pool_set_config (amrnbenc->pool, config))
+    return FALSE;
+
+  return gst_buffer_pool_set_active (amrnbenc->pool, TRUE);
+}
+
 static gboolean
 gst_amrnbenc_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
 {
@@ -226,10 +309,16 @@ gst_amrnbenc_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
   gst_audio_encoder_set_output_format (GST_AUDIO_ENCODER (amrnbenc), copy);
   gst_caps_unref (copy);
 
-  /* report needs to base class: hand one frame at a time */
+  /* report needs to base class: hand up to frames-per-buffer frames at a
+   * time */
   gst_audio_encoder_set_frame_samples_min (enc, 160);
   gst_audio_encoder_set_frame_samples_max (enc, 160);
-  gst_audio_encoder_set_frame_max (enc, 1);
+  gst_audio_encoder_set_frame_max (enc, amrnbenc->frames_per_buffer);
+
+  if (!gst_amrnbenc_setup_pool (amrnbenc, amrnbenc->frames_per_buffer)) {
+    GST_ERROR_OBJECT (amrnbenc, "failed to set up buffer pool");
+    return FALSE;
+  }
 
   return TRUE;
 }
@@ -241,7 +330,10 @@ gst_amrnbenc_handle_frame (GstAudioEncoder * enc, GstBuffer * buffer)
   GstFlowReturn ret;
   GstBuffer *out;
   GstMapInfo in_map, out_map;
-  gsize out_size;
+  gsize out_size, frame_size;
+  guint i, n_frames, n_no_data;
+  gboolean discont = FALSE;
+  gint type;
 
   amrnbenc = GST_AMRNBENC (enc);
 
@@ -262,24 +354,61 @@ gst_amrnbenc_handle_frame (GstAudioEncoder * enc, GstBuffer * buffer)
     return gst_audio_encoder_finish_frame (enc, NULL, -1);
   }
 
-  /* get output, max size is 32 */
-  out = gst_buffer_new_and_alloc (32);
+  /* we get at most frames-per-buffer frames, a partial one at the end is
+   * left for the next call */
+  n_frames = MIN (in_map.size / 320, amrnbenc->frames_per_buffer);
+
+  /* get output, max size is 32 per frame */
+  ret = gst_buffer_pool_acquire_buffer (amrnbenc->pool, &out, NULL);
+  if (G_UNLIKELY (ret != GST_FLOW_OK)) {
+    gst_buffer_unmap (buffer, &in_map);
+    return ret;
+  }
   /* AMR encoder actually writes into the source data buffers it gets */
   /* should be able to handle that with what we are given */
 
   gst_buffer_map (out, &out_map, GST_MAP_WRITE);
   /* encode */
-  out_size =
-      Encoder_Interface_Encode (amrnbenc->handle, amrnbenc->bandmode,
-      (short *) in_map.data, out_map.data, 0);
+  out_size = 0;
+  n_no_data = 0;
+  for (i = 0; i < n_frames; i++) {
+    frame_size =
+        Encoder_Interface_Encode (amrnbenc->handle, amrnbenc->bandmode,
+        (short *) in_map.data + i * 160, out_map.data + out_size, 0);
+    if (frame_size == 0)
+      continue;
+
+    /* with DTX, track silence periods by the frame types */
+    type = FRAME_TYPE (out_map.data[out_size]);
+    if (type == FRAME_TYPE_NO_DATA)
+      n_no_data++;
+    if (type < MRDTX) {
+      if (!amrnbenc->speech)
+        discont = TRUE;
+      amrnbenc->speech = TRUE;
+    } else {
+      amrnbenc->speech = FALSE;
+    }
+    out_size += frame_size;
+  }
   gst_buffer_unmap (out, &out_map);
   gst_buffer_resize (out, 0, out_size);
   gst_buffer_unmap (buffer, &in_map);
 
-  GST_LOG_OBJECT (amrnbenc, "output data size %" G_GSIZE_FORMAT, out_size);
+  GST_LOG_OBJECT (amrnbenc, "output data size %" G_GSIZE_FORMAT " for %u "
+      "frames", out_size, n_frames);
 
   if (out_size) {
-    ret = gst_audio_encoder_finish_frame (enc, out, 160);
+    if (n_no_data == n_frames) {
+      GST_LOG_OBJECT (amrnbenc, "no data, marking as gap");
+      GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_GAP);
+      GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_DROPPABLE);
+    }
+    if (discont) {
+      GST_LOG_OBJECT (amrnbenc, "speech starts after silence");
+      GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_DISCONT);
+    }
+    ret = gst_audio_encoder_finish_frame (enc, out, n_frames * 160);
   } else {
     /* should not happen (without dtx or so at least) */
     GST_WARNING_OBJECT (amrnbenc, "no encoded data; discarding input");
@@ -37,6 +37,8 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_AMRNBENC))
 #define GST_IS_AMRNBENC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AMRNBENC))
+#define GST_AMRNBENC_BANDMODE_TYPE \
+  (gst_amrnbenc_bandmode_get_type())
 
 typedef struct _GstAmrnbEnc GstAmrnbEnc;
 typedef struct _GstAmrnbEncClass GstAmrnbEncClass;
@@ -51,8 +53,16 @@ struct _GstAmrnbEnc {
   gint channels, rate;
   gint duration;
 
-  /* property */
+  /* output buffers, one per handle_frame */
+  GstBufferPool *pool;
+
+  /* whether the last encoded frame carried speech */
+  gboolean speech;
+
+  /* properties */
   enum Mode bandmode;
+  guint frames_per_buffer;
+  gboolean dtx;
 };
 
 struct _GstAmrnbEncClass {
@@ -60,6 +70,7 @@ struct _GstAmrnbEncClass {
 };
 
 GType gst_amrnbenc_get_type (void);
+GType gst_amrnbenc_bandmode_get_type (void);
 
 G_END_DECLS
 
@@ -0,0 +1,940 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-amrnbtranscoder
+ * @see_also: #GstAmrnbEnc, #GstAmrnbDec
+ *
+ * AMR narrowband encoder and decoder for many streams at once, based on the
+ * <ulink url="http://sourceforge.net/projects/opencore-amr">opencore codec implementation</ulink>.
+ *
+ * Every requested sink_%u pad gets a src_%u pad with the same number. Raw
+ * audio on the sink pad is encoded to AMR, AMR in the IF1 storage format is
+ * decoded to raw audio. The frames of all channels are processed by a
+ * shared pool of worker threads, which take a batch of channels at a time
+ * and code all complete frames of each into one output buffer. This avoids
+ * one encoder or decoder element with its own streaming thread per call.
+ *
+ * The chain functions only queue the data, so upstream should not push
+ * more than about one second of audio at once per channel.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gst/audio/audio.h>
+
+#include "amrnbenc.h"
+#include "amrnbtranscoder.h"
+
+#define RAW_CAPS "audio/x-raw, format = (string) " GST_AUDIO_NE (S16) ", " \
+    "layout = (string) interleaved, rate = (int) 8000, channels = (int) 1"
+#define AMR_CAPS "audio/AMR, rate = (int) 8000, channels = (int) 1"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (RAW_CAPS "; " AMR_CAPS)
+    );
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS (AMR_CAPS "; " RAW_CAPS)
+    );
+
+GST_DEBUG_CATEGORY_STATIC (gst_amrnbtranscoder_debug);
+#define GST_CAT_DEFAULT gst_amrnbtranscoder_debug
+
+/* samples and raw bytes in a frame */
+#define FRAME_SAMPLES 160
+#define FRAME_BYTES (FRAME_SAMPLES * 2)
+#define FRAME_DURATION (20 * GST_MSECOND)
+/* max size of an encoded frame */
+#define MAX_FRAME_SIZE 32
+/* channels allocated at once */
+#define CHANNELS_PER_SLAB 64
+/* queue up to this many frames per channel before blocking upstream */
+#define MAX_QUEUED_FRAMES 100
+
+#define BANDMODE_DEFAULT MR122
+#define MAX_THREADS_DEFAULT 0
+#define BATCH_SIZE_DEFAULT 32
+#define BATCH_SIZE_MAX 256
+
+enum
+{
+  PROP_0,
+  PROP_BANDMODE,
+  PROP_MAX_THREADS,
+  PROP_BATCH_SIZE
+};
+
+static const gint block_size_if1[16] = { 12, 13, 15, 17, 19, 20, 26, 31, 5,
+  0, 0, 0, 0, 0, 0, 0
+};
+
+static void gst_amrnbtranscoder_finalize (GObject * object);
+static void gst_amrnbtranscoder_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_amrnbtranscoder_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static GstPad *gst_amrnbtranscoder_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_amrnbtranscoder_release_pad (GstElement * element,
+    GstPad * pad);
+static GstStateChangeReturn gst_amrnbtranscoder_change_state (GstElement *
+    element, GstStateChange transition);
+
+static GstFlowReturn gst_amrnbtranscoder_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buffer);
+static gboolean gst_amrnbtranscoder_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_amrnbtranscoder_sink_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static gboolean gst_amrnbtranscoder_src_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static GstIterator *gst_amrnbtranscoder_iterate_internal_links (GstPad * pad,
+    GstObject * parent);
+
+static void gst_amrnbtranscoder_work (gpointer data, gpointer user_data);
+
+#define gst_amrnbtranscoder_parent_class parent_class
+G_DEFINE_TYPE (GstAmrnbTranscoder, gst_amrnbtranscoder, GST_TYPE_ELEMENT);
+
+static void
+gst_amrnbtranscoder_class_init (GstAmrnbTranscoderClass * klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  object_class->finalize = gst_amrnbtranscoder_finalize;
+  object_class->set_property = gst_amrnbtranscoder_set_property;
+  object_class->get_property = gst_amrnbtranscoder_get_property;
+
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_request_new_pad);
+  element_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_release_pad);
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_change_state);
+
+  g_object_class_install_property (object_class, PROP_BANDMODE,
+      g_param_spec_enum ("band-mode", "Band Mode",
+          "Encoding Band Mode (Kbps)", GST_AMRNBENC_BANDMODE_TYPE,
+          BANDMODE_DEFAULT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_MAX_THREADS,
+      g_param_spec_uint ("max-threads", "Max threads",
+          "Number of worker threads (0 = one per CPU), takes effect when "
+          "going to READY", 0, G_MAXINT, MAX_THREADS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size", "Batch size",
+          "Number of channels a worker processes in one go", 1,
+          BATCH_SIZE_MAX, BATCH_SIZE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_static_pad_template (element_class, &sink_template);
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "AMR-NB audio transcoder", "Codec/Encoder/Decoder/Audio",
+      "Adaptive Multi-Rate Narrow-Band encoder and decoder for many streams",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  GST_DEBUG_CATEGORY_INIT (gst_amrnbtranscoder_debug, "amrnbtranscoder", 0,
+      "AMR-NB audio transcoder");
+}
+
+static void
+gst_amrnbtranscoder_init (GstAmrnbTranscoder * self)
+{
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  self->slabs = g_ptr_array_new_with_free_func (g_free);
+  g_queue_init (&self->pending);
+
+  self->bandmode = BANDMODE_DEFAULT;
+  self->max_threads = MAX_THREADS_DEFAULT;
+  self->batch_size = BATCH_SIZE_DEFAULT;
+}
+
+static void
+gst_amrnbtranscoder_finalize (GObject * object)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (object);
+
+  /* GstElement's dispose released the request pads, and with them the
+   * channels, so the slabs are all free again */
+  g_assert (self->channels == NULL);
+
+  g_ptr_array_free (self->slabs, TRUE);
+  g_mutex_clear (&self->lock);
+  g_cond_clear (&self->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_amrnbtranscoder_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (object);
+
+  switch (prop_id) {
+    case PROP_BANDMODE:
+      self->bandmode = g_value_get_enum (value);
+      break;
+    case PROP_MAX_THREADS:
+      self->max_threads = g_value_get_uint (value);
+      break;
+    case PROP_BATCH_SIZE:
+      g_mutex_lock (&self->lock);
+      self->batch_size = g_value_get_uint (value);
+      g_mutex_unlock (&self->lock);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_amrnbtranscoder_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (object);
+
+  switch (prop_id) {
+    case PROP_BANDMODE:
+      g_value_set_enum (value, self->bandmode);
+      break;
+    case PROP_MAX_THREADS:
+      g_value_set_uint (value, self->max_threads);
+      break;
+    case PROP_BATCH_SIZE:
+      g_mutex_lock (&self->lock);
+      g_value_set_uint (value, self->batch_size);
+      g_mutex_unlock (&self->lock);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* called with the lock */
+static GstAmrnbTranscoderChannel *
+gst_amrnbtranscoder_alloc_channel (GstAmrnbTranscoder * self)
+{
+  GstAmrnbTranscoderChannel *channel;
+  guint i;
+
+  if (self->free_channels == NULL) {
+    channel = g_new0 (GstAmrnbTranscoderChannel, CHANNELS_PER_SLAB);
+    g_ptr_array_add (self->slabs, channel);
+    for (i = 0; i < CHANNELS_PER_SLAB; i++) {
+      channel[i].next_free = self->free_channels;
+      self->free_channels = &channel[i];
+    }
+    GST_DEBUG_OBJECT (self, "allocated slab %u", self->slabs->len);
+  }
+
+  channel = self->free_channels;
+  self->free_channels = channel->next_free;
+  memset (channel, 0, sizeof (GstAmrnbTranscoderChannel));
+
+  channel->transcoder = self;
+  g_mutex_init (&channel->lock);
+  channel->adapter = gst_adapter_new ();
+  channel->next_ts = GST_CLOCK_TIME_NONE;
+  channel->flow = GST_FLOW_OK;
+
+  return channel;
+}
+
+/* called with the lock */
+static void
+gst_amrnbtranscoder_free_channel (GstAmrnbTranscoder * self,
+    GstAmrnbTranscoderChannel * channel)
+{
+  g_object_unref (channel->adapter);
+  g_mutex_clear (&channel->lock);
+
+  channel->next_free = self->free_channels;
+  self->free_channels = channel;
+}
+
+/* called with the channel lock */
+static void
+gst_amrnbtranscoder_channel_close (GstAmrnbTranscoderChannel * channel)
+{
+  switch (channel->mode) {
+    case GST_AMRNB_TRANSCODER_ENCODE:
+      Encoder_Interface_exit (channel->handle);
+      break;
+    case GST_AMRNB_TRANSCODER_DECODE:
+      Decoder_Interface_exit (channel->handle);
+      break;
+    default:
+      break;
+  }
+  channel->handle = NULL;
+  channel->mode = GST_AMRNB_TRANSCODER_NONE;
+}
+
+/* called with the channel lock */
+static void
+gst_amrnbtranscoder_channel_reset (GstAmrnbTranscoderChannel * channel)
+{
+  gst_adapter_clear (channel->adapter);
+  channel->next_ts = GST_CLOCK_TIME_NONE;
+  channel->discont = TRUE;
+  channel->flow = GST_FLOW_OK;
+}
+
+/* called with the lock, wait until no worker has the channel */
+static gboolean
+gst_amrnbtranscoder_wait_idle (GstAmrnbTranscoder * self,
+    GstAmrnbTranscoderChannel * channel)
+{
+  while (channel->queued && !channel->flushing)
+    g_cond_wait (&self->cond, &self->lock);
+
+  return !channel->flushing;
+}
+
+/* called with the lock */
+static void
+gst_amrnbtranscoder_schedule (GstAmrnbTranscoder * self,
+    GstAmrnbTranscoderChannel * channel)
+{
+  if (channel) {
+    if (channel->queued) {
+      channel->dirty = TRUE;
+      return;
+    }
+    channel->queued = TRUE;
+    g_queue_push_tail (&self->pending, channel);
+  }
+
+  /* one task per batch of pending channels */
+  while (self->workers &&
+      self->pending.length > self->n_tasks * self->batch_size) {
+    self->n_tasks++;
+    g_thread_pool_push (self->workers, self, NULL);
+  }
+}
+
+/* take all complete frames from the adapter, returns the number of frames
+ * and their size in bytes. Called with the channel lock. */
+static guint
+gst_amrnbtranscoder_take_frames (GstAmrnbTranscoderChannel * channel,
+    GstBuffer ** buffer)
+{
+  gsize avail, size = 0;
+  guint frames = 0;
+  const guint8 *data;
+  gint block;
+
+  avail = gst_adapter_available (channel->adapter);
+
+  switch (channel->mode) {
+    case GST_AMRNB_TRANSCODER_ENCODE:
+      frames = avail / FRAME_BYTES;
+      size = frames * FRAME_BYTES;
+      break;
+    case GST_AMRNB_TRANSCODER_DECODE:
+      if (avail == 0)
+        break;
+      data = gst_adapter_map (channel->adapter, avail);
+      while (size < avail) {
+        block = block_size_if1[(data[size] >> 3) & 0x0F] + 1;
+        if (size + block > avail)
+          break;
+        size += block;
+        frames++;
+      }
+      gst_adapter_unmap (channel->adapter);
+      break;
+    default:
+      break;
+  }
+
+  if (frames)
+    *buffer = gst_adapter_take_buffer (channel->adapter, size);
+
+  return frames;
+}
+
+static GstBuffer *
+gst_amrnbtranscoder_code (GstAmrnbTranscoder * self,
+    GstAmrnbTranscoderChannel * channel, GstBuffer * in, guint frames)
+{
+  GstMapInfo inmap, outmap;
+  GstBuffer *out;
+  gsize in_offset, out_size;
+  guint i;
+
+  gst_buffer_map (in, &inmap, GST_MAP_READ);
+
+  if (channel->mode == GST_AMRNB_TRANSCODER_ENCODE) {
+    out = gst_buffer_new_allocate (NULL, frames * MAX_FRAME_SIZE, NULL);
+    gst_buffer_map (out, &outmap, GST_MAP_WRITE);
+    out_size = 0;
+    for (i = 0; i < frames; i++) {
+      out_size += Encoder_Interface_Encode (channel->handle, self->bandmode,
+          (short *) inmap.data + i * FRAME_SAMPLES, outmap.data + out_size, 0);
+    }
+    gst_buffer_unmap (out, &outmap);
+    gst_buffer_resize (out, 0, out_size);
+  } else {
+    out = gst_buffer_new_allocate (NULL, frames * FRAME_BYTES, NULL);
+    gst_buffer_map (out, &outmap, GST_MAP_WRITE);
+    in_offset = 0;
+    for (i = 0; i < frames; i++) {
+      Decoder_Interface_Decode (channel->handle, inmap.data + in_offset,
+          (gint16 *) outmap.data + i * FRAME_SAMPLES, 0);
+      in_offset += block_size_if1[(inmap.data[in_offset] >> 3) & 0x0F] + 1;
+    }
+    gst_buffer_unmap (out, &outmap);
+  }
+
+  gst_buffer_unmap (in, &inmap);
+
+  return out;
+}
+
+static void
+gst_amrnbtranscoder_process (GstAmrnbTranscoder * self,
+    GstAmrnbTranscoderChannel * channel)
+{
+  GstBuffer *in = NULL, *out;
+  GstFlowReturn ret;
+  GstClockTime timestamp;
+  gboolean discont;
+  gsize size;
+  guint frames;
+
+  g_mutex_lock (&channel->lock);
+  if (channel->flow != GST_FLOW_OK) {
+    gst_adapter_clear (channel->adapter);
+    g_mutex_unlock (&channel->lock);
+    /* nothing will drain it anymore, release a waiting chain function */
+    g_mutex_lock (&self->lock);
+    channel->queued_bytes = 0;
+    g_mutex_unlock (&self->lock);
+    return;
+  }
+
+  frames = gst_amrnbtranscoder_take_frames (channel, &in);
+  if (frames == 0) {
+    g_mutex_unlock (&channel->lock);
+    return;
+  }
+
+  timestamp = channel->next_ts;
+  if (GST_CLOCK_TIME_IS_VALID (timestamp))
+    channel->next_ts += frames * FRAME_DURATION;
+  discont = channel->discont;
+  channel->discont = FALSE;
+  g_mutex_unlock (&channel->lock);
+
+  size = gst_buffer_get_size (in);
+  out = gst_amrnbtranscoder_code (self, channel, in, frames);
+  gst_buffer_unref (in);
+
+  GST_BUFFER_PTS (out) = timestamp;
+  GST_BUFFER_DURATION (out) = frames * FRAME_DURATION;
+  if (discont)
+    GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_DISCONT);
+
+  GST_LOG_OBJECT (self, "channel %u: %u frames, %" G_GSIZE_FORMAT " bytes",
+      channel->id, frames, gst_buffer_get_size (out));
+
+  ret = gst_pad_push (channel->srcpad, out);
+
+  g_mutex_lock (&channel->lock);
+  if (ret != GST_FLOW_OK) {
+    GST_DEBUG_OBJECT (self, "channel %u: %s", channel->id,
+        gst_flow_get_name (ret));
+    channel->flow = ret;
+  }
+  g_mutex_unlock (&channel->lock);
+
+  g_mutex_lock (&self->lock);
+  channel->queued_bytes -= MIN (size, channel->queued_bytes);
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+gst_amrnbtranscoder_work (gpointer data, gpointer user_data)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (data);
+  GstAmrnbTranscoderChannel *batch[BATCH_SIZE_MAX];
+  GstAmrnbTranscoderChannel *channel;
+  guint i, n = 0;
+
+  g_mutex_lock (&self->lock);
+  self->n_tasks--;
+  while (n < self->batch_size && (channel = g_queue_pop_head (&self->pending))) {
+    channel->dirty = FALSE;
+    batch[n++] = channel;
+  }
+  g_mutex_unlock (&self->lock);
+
+  for (i = 0; i < n; i++)
+    gst_amrnbtranscoder_process (self, batch[i]);
+
+  g_mutex_lock (&self->lock);
+  for (i = 0; i < n; i++) {
+    channel = batch[i];
+    if (channel->dirty && !channel->flushing) {
+      /* more data arrived while we were busy */
+      channel->dirty = FALSE;
+      g_queue_push_tail (&self->pending, channel);
+    } else {
+      channel->queued = FALSE;
+    }
+  }
+  gst_amrnbtranscoder_schedule (self, NULL);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
+
+static GstFlowReturn
+gst_amrnbtranscoder_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (parent);
+  GstAmrnbTranscoderChannel *channel = gst_pad_get_element_private (pad);
+  GstFlowReturn ret;
+  gsize size;
+
+  g_mutex_lock (&channel->lock);
+  ret = channel->flow;
+  if (ret != GST_FLOW_OK)
+    goto done;
+  if (channel->mode == GST_AMRNB_TRANSCODER_NONE)
+    goto not_negotiated;
+
+  if (GST_BUFFER_IS_DISCONT (buffer))
+    channel->discont = TRUE;
+  /* take the timestamp when we have no partial frame left */
+  if (GST_BUFFER_PTS_IS_VALID (buffer) &&
+      gst_adapter_available (channel->adapter) == 0)
+    channel->next_ts = GST_BUFFER_PTS (buffer);
+
+  size = gst_buffer_get_size (buffer);
+  gst_adapter_push (channel->adapter, buffer);
+  g_mutex_unlock (&channel->lock);
+
+  g_mutex_lock (&self->lock);
+  channel->queued_bytes += size;
+  gst_amrnbtranscoder_schedule (self, channel);
+  /* don't let upstream run too far ahead of the workers */
+  while (channel->queued_bytes > channel->max_queued_bytes &&
+      !channel->flushing)
+    g_cond_wait (&self->cond, &self->lock);
+  if (channel->flushing)
+    ret = GST_FLOW_FLUSHING;
+  g_mutex_unlock (&self->lock);
+
+  return ret;
+
+done:
+  g_mutex_unlock (&channel->lock);
+  gst_buffer_unref (buffer);
+  return ret;
+
+not_negotiated:
+  g_mutex_unlock (&channel->lock);
+  gst_buffer_unref (buffer);
+  GST_ELEMENT_ERROR (self, CORE, NEGOTIATION, (NULL),
+      ("no caps on %s", GST_PAD_NAME (pad)));
+  return GST_FLOW_NOT_NEGOTIATED;
+}
+
+static gboolean
+gst_amrnbtranscoder_set_caps (GstAmrnbTranscoder * self,
+    GstAmrnbTranscoderChannel * channel, GstCaps * caps)
+{
+  GstStructure *s;
+  GstCaps *outcaps;
+  GstAmrnbTranscoderMode mode;
+  void *handle;
+  gboolean res;
+
+  s = gst_caps_get_structure (caps, 0);
+  if (gst_structure_has_name (s, "audio/AMR")) {
+    mode = GST_AMRNB_TRANSCODER_DECODE;
+    outcaps = gst_caps_from_string (RAW_CAPS);
+    handle = Decoder_Interface_init ();
+  } else {
+    mode = GST_AMRNB_TRANSCODER_ENCODE;
+    outcaps = gst_caps_from_string (AMR_CAPS);
+    handle = Encoder_Interface_init (0);
+  }
+
+  if (handle == NULL) {
+    gst_caps_unref (outcaps);
+    return FALSE;
+  }
+
+  g_mutex_lock (&channel->lock);
+  gst_amrnbtranscoder_channel_close (channel);
+  gst_amrnbtranscoder_channel_reset (channel);
+  channel->mode = mode;
+  channel->handle = handle;
+  g_mutex_unlock (&channel->lock);
+
+  g_mutex_lock (&self->lock);
+  channel->queued_bytes = 0;
+  if (mode == GST_AMRNB_TRANSCODER_ENCODE)
+    channel->max_queued_bytes = MAX_QUEUED_FRAMES * FRAME_BYTES;
+  else
+    channel->max_queued_bytes = MAX_QUEUED_FRAMES * MAX_FRAME_SIZE;
+  g_mutex_unlock (&self->lock);
+
+  GST_DEBUG_OBJECT (self, "channel %u: %s", channel->id,
+      mode == GST_AMRNB_TRANSCODER_ENCODE ? "encoding" : "decoding");
+
+  res = gst_pad_push_event (channel->srcpad, gst_event_new_caps (outcaps));
+  gst_caps_unref (outcaps);
+
+  return res;
+}
+
+static gboolean
+gst_amrnbtranscoder_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (parent);
+  GstAmrnbTranscoderChannel *channel = gst_pad_get_element_private (pad);
+  gboolean res;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (&self->lock);
+      channel->flushing = TRUE;
+      g_cond_broadcast (&self->cond);
+      g_mutex_unlock (&self->lock);
+      res = gst_pad_push_event (channel->srcpad, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      /* workers see the flushing pad when pushing and give up quickly */
+      g_mutex_lock (&self->lock);
+      while (channel->queued)
+        g_cond_wait (&self->cond, &self->lock);
+      channel->flushing = FALSE;
+      channel->queued_bytes = 0;
+      g_mutex_unlock (&self->lock);
+
+      g_mutex_lock (&channel->lock);
+      gst_amrnbtranscoder_channel_reset (channel);
+      g_mutex_unlock (&channel->lock);
+
+      res = gst_pad_push_event (channel->srcpad, event);
+      break;
+    default:
+      if (GST_EVENT_IS_SERIALIZED (event)) {
+        /* keep the order with the queued data */
+        g_mutex_lock (&self->lock);
+        res = gst_amrnbtranscoder_wait_idle (self, channel);
+        g_mutex_unlock (&self->lock);
+        if (!res) {
+          gst_event_unref (event);
+          break;
+        }
+      }
+
+      if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+        GstCaps *caps;
+
+        gst_event_parse_caps (event, &caps);
+        res = gst_amrnbtranscoder_set_caps (self, channel, caps);
+        gst_event_unref (event);
+      } else {
+        if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+          g_mutex_lock (&channel->lock);
+          if (gst_adapter_available (channel->adapter))
+            GST_DEBUG_OBJECT (self, "channel %u: discarding trailing data",
+                channel->id);
+          gst_adapter_clear (channel->adapter);
+          g_mutex_unlock (&channel->lock);
+
+          g_mutex_lock (&self->lock);
+          channel->queued_bytes = 0;
+          g_mutex_unlock (&self->lock);
+        }
+        res = gst_pad_push_event (channel->srcpad, event);
+      }
+      break;
+  }
+
+  return res;
+}
+
+static gboolean
+gst_amrnbtranscoder_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  gboolean res;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+    {
+      GstCaps *filter, *caps;
+
+      /* we take both formats, whatever is downstream */
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *tmp = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = tmp;
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      res = TRUE;
+      break;
+    }
+    default:
+      res = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return res;
+}
+
+static gboolean
+gst_amrnbtranscoder_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstAmrnbTranscoderChannel *channel = gst_pad_get_element_private (pad);
+
+  return gst_pad_push_event (channel->sinkpad, event);
+}
+
+static GstIterator *
+gst_amrnbtranscoder_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  GstAmrnbTranscoderChannel *channel = gst_pad_get_element_private (pad);
+  GstIterator *it;
+  GValue val = G_VALUE_INIT;
+  GstPad *other;
+
+  other = GST_PAD_IS_SINK (pad) ? channel->srcpad : channel->sinkpad;
+
+  g_value_init (&val, GST_TYPE_PAD);
+  g_value_set_object (&val, other);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &val);
+  g_value_unset (&val);
+
+  return it;
+}
+
+static GstPad *
+gst_amrnbtranscoder_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (element);
+  GstAmrnbTranscoderChannel *channel;
+  GstElementClass *klass = GST_ELEMENT_GET_CLASS (element);
+  guint id = 0;
+  GList *walk;
+  gchar *padname;
+
+  g_mutex_lock (&self->lock);
+  if (name && sscanf (name, "sink_%u", &id) == 1) {
+    for (walk = self->channels; walk; walk = g_list_next (walk)) {
+      if (((GstAmrnbTranscoderChannel *) walk->data)->id == id)
+        goto exists;
+    }
+  } else {
+    /* first free number */
+    for (walk = self->channels; walk;) {
+      if (((GstAmrnbTranscoderChannel *) walk->data)->id == id) {
+        id++;
+        walk = self->channels;
+      } else {
+        walk = g_list_next (walk);
+      }
+    }
+  }
+
+  channel = gst_amrnbtranscoder_alloc_channel (self);
+  channel->id = id;
+  self->channels = g_list_prepend (self->channels, channel);
+  g_mutex_unlock (&self->lock);
+
+  padname = g_strdup_printf ("sink_%u", id);
+  channel->sinkpad = gst_pad_new_from_template (templ, padname);
+  g_free (padname);
+  gst_pad_set_element_private (channel->sinkpad, channel);
+  gst_pad_set_chain_function (channel->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_chain));
+  gst_pad_set_event_function (channel->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_sink_event));
+  gst_pad_set_query_function (channel->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_sink_query));
+  gst_pad_set_iterate_internal_links_function (channel->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_iterate_internal_links));
+  GST_PAD_SET_ACCEPT_TEMPLATE (channel->sinkpad);
+
+  padname = g_strdup_printf ("src_%u", id);
+  channel->srcpad =
+      gst_pad_new_from_template (gst_element_class_get_pad_template (klass,
+          "src_%u"), padname);
+  g_free (padname);
+  gst_pad_set_element_private (channel->srcpad, channel);
+  gst_pad_set_event_function (channel->srcpad,
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_src_event));
+  gst_pad_set_iterate_internal_links_function (channel->srcpad,
+      GST_DEBUG_FUNCPTR (gst_amrnbtranscoder_iterate_internal_links));
+  gst_pad_use_fixed_caps (channel->srcpad);
+
+  gst_pad_set_active (channel->srcpad, TRUE);
+  gst_element_add_pad (element, channel->srcpad);
+  gst_pad_set_active (channel->sinkpad, TRUE);
+  gst_element_add_pad (element, channel->sinkpad);
+
+  GST_DEBUG_OBJECT (self, "added channel %u", id);
+
+  return channel->sinkpad;
+
+exists:
+  {
+    g_mutex_unlock (&self->lock);
+    GST_WARNING_OBJECT (self, "pad %s already exists", name);
+    return NULL;
+  }
+}
+
+static void
+gst_amrnbtranscoder_release_pad (GstElement * element, GstPad * pad)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (element);
+  GstAmrnbTranscoderChannel *channel = gst_pad_get_element_private (pad);
+
+  /* unblock and stop the chain function, then wait for the workers to let
+   * go of the channel */
+  g_mutex_lock (&self->lock);
+  channel->flushing = TRUE;
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+
+  gst_pad_set_active (channel->sinkpad, FALSE);
+  gst_pad_set_active (channel->srcpad, FALSE);
+
+  g_mutex_lock (&self->lock);
+  while (channel->queued)
+    g_cond_wait (&self->cond, &self->lock);
+  self->channels = g_list_remove (self->channels, channel);
+  g_mutex_unlock (&self->lock);
+
+  gst_element_remove_pad (element, channel->srcpad);
+  gst_element_remove_pad (element, channel->sinkpad);
+
+  g_mutex_lock (&channel->lock);
+  gst_amrnbtranscoder_channel_close (channel);
+  g_mutex_unlock (&channel->lock);
+
+  GST_DEBUG_OBJECT (self, "released channel %u", channel->id);
+
+  g_mutex_lock (&self->lock);
+  gst_amrnbtranscoder_free_channel (self, channel);
+  g_mutex_unlock (&self->lock);
+}
+
+static GstStateChangeReturn
+gst_amrnbtranscoder_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstAmrnbTranscoder *self = GST_AMRNBTRANSCODER (element);
+  GstStateChangeReturn ret;
+  GList *walk;
+  gint threads;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      threads = self->max_threads ? self->max_threads : g_get_num_processors ();
+      GST_DEBUG_OBJECT (self, "starting %d workers", threads);
+      g_mutex_lock (&self->lock);
+      self->workers = g_thread_pool_new (gst_amrnbtranscoder_work, NULL,
+          threads, FALSE, NULL);
+      g_mutex_unlock (&self->lock);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* wake up chain functions waiting for the workers */
+      g_mutex_lock (&self->lock);
+      for (walk = self->channels; walk; walk = g_list_next (walk))
+        ((GstAmrnbTranscoderChannel *) walk->data)->flushing = TRUE;
+      g_cond_broadcast (&self->cond);
+      g_mutex_unlock (&self->lock);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* the pads are inactive now, the workers drop what is left */
+      g_mutex_lock (&self->lock);
+      for (walk = self->channels; walk; walk = g_list_next (walk)) {
+        GstAmrnbTranscoderChannel *channel = walk->data;
+
+        while (channel->queued)
+          g_cond_wait (&self->cond, &self->lock);
+        channel->queued_bytes = 0;
+        channel->flushing = FALSE;
+
+        g_mutex_lock (&channel->lock);
+        gst_amrnbtranscoder_channel_close (channel);
+        gst_amrnbtranscoder_channel_reset (channel);
+        g_mutex_unlock (&channel->lock);
+      }
+      g_mutex_unlock (&self->lock);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+    {
+      GThreadPool *workers;
+
+      g_mutex_lock (&self->lock);
+      workers = self->workers;
+      self->workers = NULL;
+      g_mutex_unlock (&self->lock);
+      g_thread_pool_free (workers, FALSE, TRUE);
+      break;
+    }
+    default:
+      break;
+  }
+
+  return ret;
+}
@@ -0,0 +1,111 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_AMRNBTRANSCODER_H__
+#define __GST_AMRNBTRANSCODER_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstadapter.h>
+
+#include <opencore-amrnb/interf_dec.h>
+#include <opencore-amrnb/interf_enc.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_AMRNBTRANSCODER \
+  (gst_amrnbtranscoder_get_type())
+#define GST_AMRNBTRANSCODER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_AMRNBTRANSCODER, GstAmrnbTranscoder))
+#define GST_AMRNBTRANSCODER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_AMRNBTRANSCODER, GstAmrnbTranscoderClass))
+#define GST_IS_AMRNBTRANSCODER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_AMRNBTRANSCODER))
+#define GST_IS_AMRNBTRANSCODER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AMRNBTRANSCODER))
+
+typedef struct _GstAmrnbTranscoder GstAmrnbTranscoder;
+typedef struct _GstAmrnbTranscoderClass GstAmrnbTranscoderClass;
+typedef struct _GstAmrnbTranscoderChannel GstAmrnbTranscoderChannel;
+
+typedef enum
+{
+  GST_AMRNB_TRANSCODER_NONE,
+  GST_AMRNB_TRANSCODER_ENCODE,
+  GST_AMRNB_TRANSCODER_DECODE
+} GstAmrnbTranscoderMode;
+
+/* one call, fed on sink_%u and output on src_%u */
+struct _GstAmrnbTranscoderChannel {
+  GstAmrnbTranscoder *transcoder;
+  guint id;
+
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* protected by lock, the codec handle is only used by the one worker
+   * that processes the channel */
+  GMutex lock;
+  GstAmrnbTranscoderMode mode;
+  void *handle;
+  GstAdapter *adapter;
+  GstClockTime next_ts;
+  gboolean discont;
+  GstFlowReturn flow;
+
+  /* protected by the transcoder lock */
+  gboolean queued;
+  gboolean dirty;
+  gboolean flushing;
+  gsize queued_bytes;
+  gsize max_queued_bytes;
+
+  /* next free channel in the slabs */
+  GstAmrnbTranscoderChannel *next_free;
+};
+
+struct _GstAmrnbTranscoder {
+  GstElement element;
+
+  GMutex lock;
+  GCond cond;
+
+  /* channel structures are allocated in slabs and recycled */
+  GPtrArray *slabs;
+  GstAmrnbTranscoderChannel *free_channels;
+  GList *channels;
+
+  /* channels with data to process and the worker tasks for them */
+  GQueue pending;
+  GThreadPool *workers;
+  guint n_tasks;
+
+  /* properties */
+  enum Mode bandmode;
+  guint max_threads;
+  guint batch_size;
+};
+
+struct _GstAmrnbTranscoderClass {
+  GstElementClass parent_class;
+};
+
+GType gst_amrnbtranscoder_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_AMRNBTRANSCODER_H__ */
@@ -66,6 +66,20 @@ static const unsigned char block_size[16] =
   6, 0, 0, 0, 0, 1, 1
 };
 
+#define FRAMES_PER_BUFFER_DEFAULT 1
+#define FRAMES_PER_BUFFER_MAX 50
+
+enum
+{
+  PROP_0,
+  PROP_FRAMES_PER_BUFFER
+};
+
+static void gst_amrwbdec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_amrwbdec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
 static gboolean gst_amrwbdec_start (GstAudioDecoder * dec);
 static gboolean gst_amrwbdec_stop (GstAudioDecoder * dec);
 static gboolean gst_amrwbdec_set_format (GstAudioDecoder * dec, GstCaps * caps);
@@ -80,9 +94,13 @@ G_DEFINE_TYPE (GstAmrwbDec, gst_amrwbdec, GST_TYPE_AUDIO_DECODER);
 static void
 gst_amrwbdec_class_init (GstAmrwbDecClass * klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GstAudioDecoderClass *base_class = GST_AUDIO_DECODER_CLASS (klass);
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
 
+  object_class->set_property = gst_amrwbdec_set_property;
+  object_class->get_property = gst_amrwbdec_get_property;
+
   gst_element_class_add_static_pad_template (element_class, &sink_template);
   gst_element_class_add_static_pad_template (element_class, &src_template);
 
@@ -97,6 +115,18 @@ gst_amrwbdec_class_init (GstAmrwbDecClass * klass)
   base_class->parse = GST_DEBUG_FUNCPTR (gst_amrwbdec_parse);
   base_class->handle_frame = GST_DEBUG_FUNCPTR (gst_amrwbdec_handle_frame);
 
+  /**
+   * GstAmrwbDec:frames-per-buffer:
+   *
+   * Number of frames to decode into one output buffer. Input is collected
+   * until that many frames are available, except at the end of the stream.
+   */
+  g_object_class_install_property (object_class, PROP_FRAMES_PER_BUFFER,
+      g_param_spec_uint ("frames-per-buffer", "Frames per buffer",
+          "Number of frames to decode into one output buffer", 1,
+          FRAMES_PER_BUFFER_MAX, FRAMES_PER_BUFFER_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   GST_DEBUG_CATEGORY_INIT (gst_amrwbdec_debug, "amrwbdec", 0,
       "AMR-WB audio decoder");
 }
@@ -104,6 +134,7 @@ gst_amrwbdec_class_init (GstAmrwbDecClass * klass)
 static void
 gst_amrwbdec_init (GstAmrwbDec * amrwbdec)
 {
+  amrwbdec->frames_per_buffer = FRAMES_PER_BUFFER_DEFAULT;
   gst_audio_decoder_set_needs_format (GST_AUDIO_DECODER (amrwbdec), TRUE);
   gst_audio_decoder_set_use_default_pad_acceptcaps (GST_AUDIO_DECODER_CAST
       (amrwbdec), TRUE);
@@ -133,9 +164,52 @@ gst_amrwbdec_stop (GstAudioDecoder * dec)
   GST_DEBUG_OBJECT (dec, "stop");
   D_IF_exit (amrwbdec->handle);
 
+  if (amrwbdec->pool) {
+    gst_buffer_pool_set_active (amrwbdec->pool, FALSE);
+    gst_object_unref (amrwbdec->pool);
+    amrwbdec->pool = NULL;
+  }
+  amrwbdec->pool_frames = 0;
+
   return TRUE;
 }
 
+static void
+gst_amrwbdec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstAmrwbDec *self = GST_AMRWBDEC (object);
+
+  switch (prop_id) {
+    case PROP_FRAMES_PER_BUFFER:
+      GST_OBJECT_LOCK (self);
+      self->frames_per_buffer = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_amrwbdec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstAmrwbDec *self = GST_AMRWBDEC (object);
+
+  switch (prop_id) {
+    case PROP_FRAMES_PER_BUFFER:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->frames_per_buffer);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static gboolean
 gst_amrwbdec_set_format (GstAudioDecoder * dec, GstCaps * caps)
 {
@@ -167,7 +241,7 @@ gst_amrwbdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
 {
   GstAmrwbDec *amrwbdec = GST_AMRWBDEC (dec);
   guint8 header[1];
-  guint size;
+  guint size, total, frames, frames_per_buffer;
   gboolean sync, eos;
   gint block, mode;
 
@@ -177,6 +251,10 @@ gst_amrwbdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
 
   gst_audio_decoder_get_parse_state (dec, &sync, &eos);
 
+  GST_OBJECT_LOCK (amrwbdec);
+  frames_per_buffer = amrwbdec->frames_per_buffer;
+  GST_OBJECT_UNLOCK (amrwbdec);
+
   /* need to peek data to get the size */
   gst_adapter_copy (adapter, header, 0, 1);
   mode = (header[0] >> 3) & 0x0F;
@@ -184,27 +262,75 @@ gst_amrwbdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
 
   GST_DEBUG_OBJECT (amrwbdec, "mode %d, block %d", mode, block);
 
-  if (block) {
-    if (block > size)
-      return GST_FLOW_EOS;
-    *offset = 0;
-    *length = block;
-  } else {
+  if (!block) {
     /* no frame yet, skip one byte */
     GST_LOG_OBJECT (amrwbdec, "skipping byte");
     *offset = 1;
     return GST_FLOW_EOS;
   }
+  if (block > size)
+    return GST_FLOW_EOS;
+
+  /* collect up to frames-per-buffer complete frames, an invalid header ends
+   * the batch and gets skipped in the next round */
+  total = block;
+  for (frames = 1; frames < frames_per_buffer; frames++) {
+    if (total >= size)
+      break;
+
+    gst_adapter_copy (adapter, header, total, 1);
+    block = block_size[(header[0] >> 3) & 0x0F];
+    if (!block)
+      break;
+    if (total + block > size) {
+      /* wait for more data unless we're draining */
+      if (!eos)
+        return GST_FLOW_EOS;
+      break;
+    }
+    total += block;
+  }
+
+  if (frames < frames_per_buffer && total >= size && !eos)
+    return GST_FLOW_EOS;
+
+  *offset = 0;
+  *length = total;
 
   return GST_FLOW_OK;
 }
 
+static gboolean
+gst_amrwbdec_setup_pool (GstAmrwbDec * amrwbdec, guint frames)
+{
+  GstStructure *config;
+
+  if (amrwbdec->pool) {
+    gst_buffer_pool_set_active (amrwbdec->pool, FALSE);
+    gst_object_unref (amrwbdec->pool);
+  }
+
+  amrwbdec->pool = gst_buffer_pool_new ();
+  amrwbdec->pool_frames = frames;
+  config = gst_buffer_pool_get_config (amrwbdec->pool);
+  gst_buffer_pool_config_set_params (config, NULL,
+      frames * sizeof (gint16) * L_FRAME16k, 0, 0);
+  if (!gst_buffer_pool_set_config (amrwbdec->pool, config))
+    return FALSE;
+
+  return gst_buffer_pool_set_active (amrwbdec->pool, TRUE);
+}
+
 static GstFlowReturn
 gst_amrwbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
 {
   GstAmrwbDec *amrwbdec;
   GstBuffer *out;
   GstMapInfo inmap, outmap;
+  GstFlowReturn ret;
+  gsize offset;
+  guint frames, num_frames, frames_per_buffer;
+  gint block;
 
   amrwbdec = GST_AMRWBDEC (dec);
 
@@ -216,17 +342,57 @@ gst_amrwbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
   /* should be no problem */
   gst_buffer_map (buffer, &inmap, GST_MAP_READ);
 
+  /* count the frames the parser collected, the property may have changed
+   * since then */
+  offset = 0;
+  for (num_frames = 0; offset < inmap.size; num_frames++) {
+    block = block_size[(inmap.data[offset] >> 3) & 0x0F];
+    if (!block || offset + block > inmap.size)
+      break;
+    offset += block;
+  }
+
+  GST_OBJECT_LOCK (amrwbdec);
+  frames_per_buffer = MAX (amrwbdec->frames_per_buffer, num_frames);
+  GST_OBJECT_UNLOCK (amrwbdec);
+
+  if (amrwbdec->pool_frames != frames_per_buffer &&
+      !gst_amrwbdec_setup_pool (amrwbdec, frames_per_buffer)) {
+    GST_ERROR_OBJECT (amrwbdec, "failed to set up buffer pool");
+    gst_buffer_unmap (buffer, &inmap);
+    return GST_FLOW_ERROR;
+  }
+
   /* get output */
-  out = gst_buffer_new_and_alloc (sizeof (gint16) * L_FRAME16k);
+  ret = gst_buffer_pool_acquire_buffer (amrwbdec->pool, &out, NULL);
+  if (G_UNLIKELY (ret != GST_FLOW_OK)) {
+    gst_buffer_unmap (buffer, &inmap);
+    return ret;
+  }
+
   gst_buffer_map (out, &outmap, GST_MAP_WRITE);
 
-  /* decode */
-  D_IF_decode (amrwbdec->handle, (unsigned char *) inmap.data,
-      (short int *) outmap.data, _good_frame);
+  /* decode all frames the parser collected */
+  offset = 0;
+  for (frames = 0; frames < num_frames; frames++) {
+    block = block_size[(inmap.data[offset] >> 3) & 0x0F];
+
+    D_IF_decode (amrwbdec->handle, (unsigned char *) inmap.data + offset,
+        (short int *) outmap.data + frames * L_FRAME16k, _good_frame);
+    offset += block;
+  }
 
   gst_buffer_unmap (out, &outmap);
   gst_buffer_unmap (buffer, &inmap);
 
+  if (G_UNLIKELY (frames == 0)) {
+    GST_WARNING_OBJECT (amrwbdec, "no complete frame in input");
+    gst_buffer_unref (out);
+    return gst_audio_decoder_finish_frame (dec, NULL, 1);
+  }
+
+  gst_buffer_resize (out, 0, frames * sizeof (gint16) * L_FRAME16k);
+
   /* send out */
   return gst_audio_decoder_finish_frame (dec, out, 1);
 }
@@ -55,6 +55,13 @@ struct _GstAmrwbDec {
 
   /* output settings */
   gint channels, rate;
+
+  /* decode this many frames per buffer */
+  guint frames_per_buffer;
+
+  /* output buffers and the number of frames they fit */
+  GstBufferPool *pool;
+  guint pool_frames;
 };
 
 struct _GstAmrwbDecClass {
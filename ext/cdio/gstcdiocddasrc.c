@@ -51,6 +51,12 @@
  * posted on the bus as part of the tag messages.
  * </para>
  * <para>
+ * Audio is read from the drive #GstCdioCddaSrc:sectors-per-read sectors at a
+ * time. When #GstCdioCddaSrc:readahead is set, this happens in a separate
+ * thread that keeps up to that many reads ahead of the sectors that are
+ * pushed, so that the drive is kept busy while downstream processes the data.
+ * </para>
+ * <para>
  * cdiocddasrc supports the GstUriHandler interface, so applications can use
  * playbin with cdda://&lt;track-number&gt; URIs for playback (they will have
  * to connect to playbin's notify::source signal and set the device on the
@@ -87,14 +93,26 @@
 
 #define SAMPLES_PER_SECTOR (CDIO_CD_FRAMESIZE_RAW / sizeof (gint16))
 
-#define DEFAULT_READ_SPEED   -1
+#define DEFAULT_READ_SPEED         -1
+#define DEFAULT_SECTORS_PER_READ   16
+#define MAX_SECTORS_PER_READ       75   /* one second */
+#define DEFAULT_READAHEAD          0
+#define MAX_READAHEAD              64
 
 enum
 {
   PROP_0 = 0,
-  PROP_READ_SPEED
+  PROP_READ_SPEED,
+  PROP_SECTORS_PER_READ,
+  PROP_READAHEAD
 };
 
+typedef struct
+{
+  gint start;
+  gint end;
+} GstCdioCddaTrackRange;
+
 G_DEFINE_TYPE (GstCdioCddaSrc, gst_cdio_cdda_src, GST_TYPE_AUDIO_CD_SRC);
 
 static void gst_cdio_cdda_src_finalize (GObject * obj);
@@ -167,29 +185,200 @@ empty_devices:
 }
 #endif
 
+/* returns how many sectors can be read in one go from @sector on without
+ * leaving its audio track, or 0 if @sector is not in an audio track */
+static gint
+gst_cdio_cdda_src_get_read_len (GstCdioCddaSrc * src, gint sector)
+{
+  guint i;
+
+  for (i = 0; i < src->audio_tracks->len; ++i) {
+    GstCdioCddaTrackRange *range;
+
+    range = &g_array_index (src->audio_tracks, GstCdioCddaTrackRange, i);
+    if (sector >= range->start && sector <= range->end)
+      return MIN (src->chunk_sectors, range->end - sector + 1);
+  }
+
+  return 0;
+}
+
+static void
+gst_cdio_cdda_src_read_chunk (GstCdioCddaSrc * src, GstCdioCddaChunk * chunk,
+    gint sector, gint len)
+{
+  chunk->start = sector;
+  chunk->len = 0;
+  chunk->errnum = 0;
+
+  if (len > 1) {
+    if (cdio_read_audio_sectors (src->cdio, chunk->data, sector, len) == 0) {
+      chunk->len = len;
+      return;
+    }
+    /* some drives can't do reads that big, or one of the sectors is bad */
+    GST_DEBUG_OBJECT (src, "reading %d sectors at %d failed, reading one",
+        len, sector);
+  }
+
+  if (cdio_read_audio_sector (src->cdio, chunk->data, sector) != 0) {
+    chunk->errnum = (errno != 0) ? errno : EIO;
+    return;
+  }
+
+  chunk->len = 1;
+}
+
+static gpointer
+gst_cdio_cdda_src_readahead_thread (gpointer data)
+{
+  GstCdioCddaSrc *src = GST_CDIO_CDDA_SRC (data);
+
+  g_mutex_lock (&src->ra_lock);
+  while (!src->ra_stop) {
+    GstCdioCddaChunk *chunk;
+    gint sector, len;
+    guint cookie;
+
+    if (src->ra_next < 0 || src->ra_count == src->ra_size) {
+      g_cond_wait (&src->ra_cond, &src->ra_lock);
+      continue;
+    }
+
+    sector = src->ra_next;
+    len = gst_cdio_cdda_src_get_read_len (src, sector);
+    if (len == 0) {
+      GST_LOG_OBJECT (src, "sector %d is not in an audio track, idle", sector);
+      src->ra_next = -1;
+      continue;
+    }
+
+    /* the chunk after the filled ones is ours until we add it */
+    chunk = &src->ra_ring[(src->ra_head + src->ra_count) % src->ra_size];
+    cookie = src->ra_cookie;
+    g_mutex_unlock (&src->ra_lock);
+
+    g_mutex_lock (&src->ra_io_lock);
+    gst_cdio_cdda_src_read_chunk (src, chunk, sector, len);
+    g_mutex_unlock (&src->ra_io_lock);
+
+    g_mutex_lock (&src->ra_lock);
+    if (cookie != src->ra_cookie) {
+      GST_LOG_OBJECT (src, "discarding read at sector %d", sector);
+      continue;
+    }
+
+    src->ra_count++;
+    src->ra_next = (chunk->errnum != 0) ? -1 : sector + chunk->len;
+    g_cond_broadcast (&src->ra_cond);
+  }
+  g_mutex_unlock (&src->ra_lock);
+
+  return NULL;
+}
+
+/* waits for the chunk with @sector from the readahead thread, restarting it
+ * at @sector if that is not where it is reading */
+static GstCdioCddaChunk *
+gst_cdio_cdda_src_get_chunk_readahead (GstCdioCddaSrc * src, gint sector)
+{
+  GstCdioCddaChunk *chunk = NULL;
+
+  g_mutex_lock (&src->ra_lock);
+  while (TRUE) {
+    if (src->ra_count > 0) {
+      chunk = &src->ra_ring[src->ra_head];
+
+      if (chunk->errnum != 0 && chunk->start == sector)
+        break;
+      if (sector >= chunk->start && sector < chunk->start + chunk->len)
+        break;
+
+      if (sector > chunk->start) {
+        /* done with this one, the next chunk might have it */
+        src->ra_head = (src->ra_head + 1) % src->ra_size;
+        src->ra_count--;
+        g_cond_broadcast (&src->ra_cond);
+        continue;
+      }
+    } else if (src->ra_next == sector) {
+      g_cond_wait (&src->ra_cond, &src->ra_lock);
+      continue;
+    }
+
+    GST_DEBUG_OBJECT (src, "restarting readahead at sector %d", sector);
+    src->ra_count = 0;
+    src->ra_next = sector;
+    src->ra_cookie++;
+    g_cond_broadcast (&src->ra_cond);
+  }
+  g_mutex_unlock (&src->ra_lock);
+
+  return chunk;
+}
+
+static GstCdioCddaChunk *
+gst_cdio_cdda_src_get_chunk (GstCdioCddaSrc * src, gint sector)
+{
+  gint len;
+
+  len = gst_cdio_cdda_src_get_read_len (src, sector);
+  if (src->ra_thread != NULL && len > 0)
+    return gst_cdio_cdda_src_get_chunk_readahead (src, sector);
+
+  g_mutex_lock (&src->ra_io_lock);
+  gst_cdio_cdda_src_read_chunk (src, &src->chunk, sector, MAX (len, 1));
+  g_mutex_unlock (&src->ra_io_lock);
+
+  return &src->chunk;
+}
+
+/* swaps the bytes of two samples at a time, which compilers turn into
+ * vector instructions */
+static void
+gst_cdio_cdda_src_copy_swapped (guint8 * dest, const guint8 * src, gsize size)
+{
+  const guint32 *s = (const guint32 *) src;
+  guint32 *d = (guint32 *) dest;
+  gsize i;
+
+  for (i = 0; i < size / 4; ++i)
+    d[i] = ((s[i] & 0x00ff00ff) << 8) | ((s[i] >> 8) & 0x00ff00ff);
+}
+
 static GstBuffer *
 gst_cdio_cdda_src_read_sector (GstAudioCdSrc * audiocdsrc, gint sector)
 {
   GstCdioCddaSrc *src;
-  guint8 *data;
+  GstCdioCddaChunk *chunk;
+  GstBuffer *buf = NULL;
+  GstMapInfo map;
+  const guint8 *data;
 
   src = GST_CDIO_CDDA_SRC (audiocdsrc);
 
-  data = g_malloc (CDIO_CD_FRAMESIZE_RAW);
+  chunk = src->cur;
+  if (chunk == NULL || sector < chunk->start ||
+      sector >= chunk->start + chunk->len) {
+    chunk = src->cur = gst_cdio_cdda_src_get_chunk (src, sector);
+    if (chunk->errnum != 0)
+      goto read_failed;
+  }
 
-  /* can't use pad_alloc because we can't return the GstFlowReturn (FIXME 0.11) */
-  if (cdio_read_audio_sector (src->cdio, data, sector) != 0)
-    goto read_failed;
+  data = chunk->data + (sector - chunk->start) * CDIO_CD_FRAMESIZE_RAW;
 
-  if (src->swap_le_be) {
-    gint16 *pcm_data = (gint16 *) data;
-    gint i;
+  /* can't use pad_alloc because we can't return the GstFlowReturn (FIXME 0.11) */
+  if (gst_buffer_pool_acquire_buffer (src->pool, &buf, NULL) != GST_FLOW_OK)
+    goto no_buffer;
 
-    for (i = 0; i < SAMPLES_PER_SECTOR; ++i)
-      pcm_data[i] = GUINT16_SWAP_LE_BE (pcm_data[i]);
-  }
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  if (src->swap_le_be)
+    gst_cdio_cdda_src_copy_swapped (map.data, data, CDIO_CD_FRAMESIZE_RAW);
+  else
+    memcpy (map.data, data, CDIO_CD_FRAMESIZE_RAW);
+  gst_buffer_unmap (buf, &map);
 
-  return gst_buffer_new_wrapped (data, CDIO_CD_FRAMESIZE_RAW);
+  return buf;
 
   /* ERRORS */
 read_failed:
@@ -198,12 +387,95 @@ read_failed:
     GST_ELEMENT_ERROR (src, RESOURCE, READ,
         (_("Could not read from CD.")),
         ("cdio_read_audio_sector at %d failed: %s", sector,
-            g_strerror (errno)));
-    g_free (data);
+            g_strerror (chunk->errnum)));
+    return NULL;
+  }
+no_buffer:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+        ("Failed to allocate buffer"));
     return NULL;
   }
 }
 
+static gboolean
+gst_cdio_cdda_src_start_reading (GstCdioCddaSrc * src)
+{
+  GstStructure *config;
+  guint i;
+
+  GST_OBJECT_LOCK (src);
+  src->chunk_sectors = src->sectors_per_read;
+  src->ra_size = src->readahead;
+  GST_OBJECT_UNLOCK (src);
+
+  src->pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (src->pool);
+  gst_buffer_pool_config_set_params (config, NULL, CDIO_CD_FRAMESIZE_RAW, 0,
+      0);
+  if (!gst_buffer_pool_set_config (src->pool, config) ||
+      !gst_buffer_pool_set_active (src->pool, TRUE))
+    return FALSE;
+
+  src->chunk.data = g_malloc (src->chunk_sectors * CDIO_CD_FRAMESIZE_RAW);
+  src->chunk.start = -1;
+  src->chunk.len = 0;
+  src->cur = NULL;
+
+  if (src->ra_size > 0) {
+    GST_DEBUG_OBJECT (src, "reading %u x %d sectors ahead", src->ra_size,
+        src->chunk_sectors);
+
+    src->ra_ring = g_new0 (GstCdioCddaChunk, src->ra_size);
+    for (i = 0; i < src->ra_size; ++i) {
+      src->ra_ring[i].data =
+          g_malloc (src->chunk_sectors * CDIO_CD_FRAMESIZE_RAW);
+      src->ra_ring[i].start = -1;
+    }
+    src->ra_head = 0;
+    src->ra_count = 0;
+    src->ra_next = -1;
+    src->ra_stop = FALSE;
+    src->ra_thread = g_thread_new ("cdiocddasrc-readahead",
+        gst_cdio_cdda_src_readahead_thread, src);
+  }
+
+  return TRUE;
+}
+
+static void
+gst_cdio_cdda_src_stop_reading (GstCdioCddaSrc * src)
+{
+  guint i;
+
+  if (src->ra_thread) {
+    g_mutex_lock (&src->ra_lock);
+    src->ra_stop = TRUE;
+    g_cond_broadcast (&src->ra_cond);
+    g_mutex_unlock (&src->ra_lock);
+
+    g_thread_join (src->ra_thread);
+    src->ra_thread = NULL;
+  }
+
+  if (src->ra_ring) {
+    for (i = 0; i < src->ra_size; ++i)
+      g_free (src->ra_ring[i].data);
+    g_free (src->ra_ring);
+    src->ra_ring = NULL;
+  }
+
+  g_free (src->chunk.data);
+  src->chunk.data = NULL;
+  src->cur = NULL;
+
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+  }
+}
+
 static gboolean
 gst_cdio_cdda_src_do_detect_drive_endianness (GstCdioCddaSrc * src, gint from,
     gint to)
@@ -346,6 +618,9 @@ gst_cdio_cdda_src_open (GstAudioCdSrc * audiocdsrc, const gchar * device)
   if (src->read_speed != -1)
     cdio_set_speed (src->cdio, src->read_speed);
 
+  src->audio_tracks = g_array_new (FALSE, FALSE,
+      sizeof (GstCdioCddaTrackRange));
+
 #if LIBCDIO_VERSION_NUM > 83 || LIBCDIO_VERSION_NUM < 76
   cdtext = cdio_get_cdtext (src->cdio);
 
@@ -376,8 +651,11 @@ gst_cdio_cdda_src_open (GstAudioCdSrc * audiocdsrc, const gchar * device)
     track.end = track.start + len_sectors - 1;  /* -1? */
 
     if (track.is_audio) {
+      GstCdioCddaTrackRange range = { track.start, track.end };
+
       first_audio_sector = MIN (first_audio_sector, track.start);
       last_audio_sector = MAX (last_audio_sector, track.end);
+      g_array_append_val (src->audio_tracks, range);
     }
 #if LIBCDIO_VERSION_NUM > 83 || LIBCDIO_VERSION_NUM < 76
     if (NULL != cdtext)
@@ -397,6 +675,9 @@ gst_cdio_cdda_src_open (GstAudioCdSrc * audiocdsrc, const gchar * device)
   gst_cdio_cdda_src_detect_drive_endianness (src, first_audio_sector,
       last_audio_sector);
 
+  if (!gst_cdio_cdda_src_start_reading (src))
+    goto pool_failed;
+
   return TRUE;
 
   /* ERRORS */
@@ -416,6 +697,13 @@ not_audio:
     src->cdio = NULL;
     return FALSE;
   }
+pool_failed:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, SETTINGS, (NULL),
+        ("Failed to set up buffer pool"));
+    gst_cdio_cdda_src_close (audiocdsrc);
+    return FALSE;
+  }
 }
 
 static void
@@ -423,6 +711,13 @@ gst_cdio_cdda_src_close (GstAudioCdSrc * audiocdsrc)
 {
   GstCdioCddaSrc *src = GST_CDIO_CDDA_SRC (audiocdsrc);
 
+  gst_cdio_cdda_src_stop_reading (src);
+
+  if (src->audio_tracks) {
+    g_array_free (src->audio_tracks, TRUE);
+    src->audio_tracks = NULL;
+  }
+
   if (src->cdio) {
     cdio_destroy (src->cdio);
     src->cdio = NULL;
@@ -433,7 +728,13 @@ static void
 gst_cdio_cdda_src_init (GstCdioCddaSrc * src)
 {
   src->read_speed = DEFAULT_READ_SPEED; /* don't need atomic access here */
+  src->sectors_per_read = DEFAULT_SECTORS_PER_READ;
+  src->readahead = DEFAULT_READAHEAD;
   src->cdio = NULL;
+
+  g_mutex_init (&src->ra_lock);
+  g_cond_init (&src->ra_cond);
+  g_mutex_init (&src->ra_io_lock);
 }
 
 static void
@@ -446,6 +747,10 @@ gst_cdio_cdda_src_finalize (GObject * obj)
     src->cdio = NULL;
   }
 
+  g_mutex_clear (&src->ra_lock);
+  g_cond_clear (&src->ra_cond);
+  g_mutex_clear (&src->ra_io_lock);
+
   G_OBJECT_CLASS (gst_cdio_cdda_src_parent_class)->finalize (obj);
 }
 
@@ -473,6 +778,21 @@ gst_cdio_cdda_src_class_init (GstCdioCddaSrcClass * klass)
           "Read from device at the specified speed (-1 = default)", -1, 100,
           DEFAULT_READ_SPEED, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_SECTORS_PER_READ, g_param_spec_uint ("sectors-per-read",
+          "Sectors per read",
+          "Number of sectors to read from the device at once (takes effect "
+          "when the device is opened)", 1, MAX_SECTORS_PER_READ,
+          DEFAULT_SECTORS_PER_READ,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_READAHEAD,
+      g_param_spec_uint ("readahead", "Readahead",
+          "Number of reads to do ahead in a separate thread, 0 to read only "
+          "when needed (takes effect when the device is opened)", 0,
+          MAX_READAHEAD, DEFAULT_READAHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (element_class,
       "CD audio source (CDDA)", "Source/File",
       "Read audio from CD using libcdio",
@@ -493,6 +813,16 @@ gst_cdio_cdda_src_set_property (GObject * object, guint prop_id,
       g_atomic_int_set (&src->read_speed, speed);
       break;
     }
+    case PROP_SECTORS_PER_READ:
+      GST_OBJECT_LOCK (src);
+      src->sectors_per_read = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_READAHEAD:
+      GST_OBJECT_LOCK (src);
+      src->readahead = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -513,6 +843,16 @@ gst_cdio_cdda_src_get_property (GObject * object, guint prop_id,
       g_value_set_int (value, speed);
       break;
     }
+    case PROP_SECTORS_PER_READ:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint (value, src->sectors_per_read);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_READAHEAD:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint (value, src->readahead);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -31,16 +31,50 @@
 
 typedef struct _GstCdioCddaSrc GstCdioCddaSrc;
 typedef struct _GstCdioCddaSrcClass GstCdioCddaSrcClass;
+typedef struct _GstCdioCddaChunk GstCdioCddaChunk;
+
+/* raw sectors read from the drive in one go */
+struct _GstCdioCddaChunk
+{
+  guint8        *data;
+  gint           start;         /* first sector, -1 if empty */
+  gint           len;           /* number of sectors */
+  gint           errnum;        /* errno if reading at start failed */
+};
 
 struct _GstCdioCddaSrc
 {
   GstAudioCdSrc  audiocdsrc;
 
   gint           read_speed;    /* ATOMIC */
+  guint          sectors_per_read;
+  guint          readahead;
 
   gboolean       swap_le_be;    /* Drive produces samples in other endianness */
 
   CdIo          *cdio;          /* NULL if not open */
+
+  gint           chunk_sectors; /* sectors_per_read when opened */
+  GArray        *audio_tracks;  /* first and last sector of audio tracks */
+  GstBufferPool *pool;          /* for the sectors we push */
+
+  GstCdioCddaChunk  chunk;      /* last read without readahead */
+  GstCdioCddaChunk *cur;        /* chunk the last sector came from */
+
+  /* background reading into a ring of readahead chunks, protected by
+   * ra_lock. The chunk at ra_head is in use until the next chunk is
+   * needed */
+  GThread       *ra_thread;
+  GMutex         ra_lock;
+  GCond          ra_cond;
+  GMutex         ra_io_lock;    /* held while reading from the drive */
+  GstCdioCddaChunk *ra_ring;
+  guint          ra_size;
+  guint          ra_head;
+  guint          ra_count;      /* filled chunks from ra_head */
+  gint           ra_next;       /* sector to read next, -1 when idle */
+  guint          ra_cookie;     /* changes when reading restarts elsewhere */
+  gboolean       ra_stop;
 };
 
 struct _GstCdioCddaSrcClass
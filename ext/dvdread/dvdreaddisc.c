@@ -0,0 +1,281 @@
+/* GStreamer DVD title source
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#include "dvdreaddisc.h"
+
+/* shared discs by location, also protects the refcount of all discs */
+static GMutex shared_lock;
+static GHashTable *shared_discs;
+
+static void
+gst_dvd_read_title_free (GstDvdReadTitle * info)
+{
+  g_free (info->chapter_starts);
+  if (info->index)
+    gst_dvd_read_index_free (info->index);
+  g_free (info);
+}
+
+static void
+gst_dvd_read_disc_free (GstDvdReadDisc * disc)
+{
+  gint i;
+
+  if (disc->toc)
+    gst_toc_unref (disc->toc);
+
+  for (i = 0; i < disc->num_titles; i++) {
+    if (disc->titles[i])
+      gst_dvd_read_title_free (disc->titles[i]);
+  }
+  g_free (disc->titles);
+
+  for (i = 0; i <= disc->num_vts; i++) {
+    if (disc->vts_files[i])
+      ifoClose (disc->vts_files[i]);
+  }
+  g_free (disc->vts_files);
+
+  ifoClose (disc->vmg_file);
+  DVDClose (disc->dvd);
+
+  g_mutex_clear (&disc->lock);
+  g_free (disc->location);
+  g_free (disc);
+}
+
+/* opens the disc info for @location. Without @shared, the IFOs are read
+ * with @dvd, which the disc takes over and closes when it is released. */
+GstDvdReadDisc *
+gst_dvd_read_disc_open (const gchar * location, dvd_reader_t * dvd,
+    gboolean shared)
+{
+  GstDvdReadDisc *disc = NULL;
+  ifo_handle_t *vmg_file;
+
+  if (shared) {
+    g_mutex_lock (&shared_lock);
+    if (shared_discs != NULL) {
+      disc = g_hash_table_lookup (shared_discs, location);
+      if (disc != NULL) {
+        disc->refcount++;
+        goto done;
+      }
+    }
+    if ((dvd = DVDOpen (location)) == NULL)
+      goto done;
+  }
+
+  if ((vmg_file = ifoOpen (dvd, 0)) == NULL) {
+    if (shared)
+      DVDClose (dvd);
+    goto done;
+  }
+
+  disc = g_new0 (GstDvdReadDisc, 1);
+  disc->refcount = 1;
+  disc->location = g_strdup (location);
+  disc->shared = shared;
+  g_mutex_init (&disc->lock);
+  disc->dvd = dvd;
+  disc->vmg_file = vmg_file;
+  disc->num_vts = vmg_file->vmgi_mat->vmg_nr_of_title_sets;
+  disc->vts_files = g_new0 (ifo_handle_t *, disc->num_vts + 1);
+  disc->num_titles = vmg_file->tt_srpt->nr_of_srpts;
+  disc->titles = g_new0 (GstDvdReadTitle *, disc->num_titles);
+
+  if (shared) {
+    if (shared_discs == NULL)
+      shared_discs = g_hash_table_new (g_str_hash, g_str_equal);
+    g_hash_table_insert (shared_discs, disc->location, disc);
+  }
+
+done:
+  if (shared)
+    g_mutex_unlock (&shared_lock);
+
+  return disc;
+}
+
+GstDvdReadDisc *
+gst_dvd_read_disc_ref (GstDvdReadDisc * disc)
+{
+  g_mutex_lock (&shared_lock);
+  disc->refcount++;
+  g_mutex_unlock (&shared_lock);
+
+  return disc;
+}
+
+void
+gst_dvd_read_disc_unref (GstDvdReadDisc * disc)
+{
+  gboolean last;
+
+  g_mutex_lock (&shared_lock);
+  last = (--disc->refcount == 0);
+  if (last && disc->shared)
+    g_hash_table_remove (shared_discs, disc->location);
+  g_mutex_unlock (&shared_lock);
+
+  if (last)
+    gst_dvd_read_disc_free (disc);
+}
+
+/* returns the IFO of the title set, it stays valid as long as the disc */
+ifo_handle_t *
+gst_dvd_read_disc_get_vts (GstDvdReadDisc * disc, gint title_set_nr)
+{
+  ifo_handle_t *vts_file;
+
+  if (title_set_nr < 1 || title_set_nr > disc->num_vts)
+    return NULL;
+
+  g_mutex_lock (&disc->lock);
+  vts_file = disc->vts_files[title_set_nr];
+  if (vts_file == NULL) {
+    vts_file = disc->vts_files[title_set_nr] =
+        ifoOpen (disc->dvd, title_set_nr);
+  }
+  g_mutex_unlock (&disc->lock);
+
+  return vts_file;
+}
+
+GstDvdReadTitle *
+gst_dvd_read_disc_get_title (GstDvdReadDisc * disc, gint title)
+{
+  GstDvdReadTitle *info;
+
+  if (title < 0 || title >= disc->num_titles)
+    return NULL;
+
+  g_mutex_lock (&disc->lock);
+  info = disc->titles[title];
+  g_mutex_unlock (&disc->lock);
+
+  return info;
+}
+
+/* takes ownership of @info, returns the info that is in the disc now, which
+ * is a different one when another element was faster */
+GstDvdReadTitle *
+gst_dvd_read_disc_add_title (GstDvdReadDisc * disc, gint title,
+    GstDvdReadTitle * info)
+{
+  g_return_val_if_fail (title >= 0 && title < disc->num_titles, NULL);
+
+  g_mutex_lock (&disc->lock);
+  if (disc->titles[title] == NULL) {
+    disc->titles[title] = info;
+    /* rebuilt with the times of this title when asked for next */
+    if (disc->toc) {
+      gst_toc_unref (disc->toc);
+      disc->toc = NULL;
+    }
+  } else {
+    gst_dvd_read_title_free (info);
+    info = disc->titles[title];
+  }
+  g_mutex_unlock (&disc->lock);
+
+  return info;
+}
+
+/* one edition per title with its chapters, from the title table of the
+ * VMG. Only titles that were opened have their times, title sets are not
+ * loaded for this. */
+static GstToc *
+gst_dvd_read_disc_build_toc (GstDvdReadDisc * disc)
+{
+  const tt_srpt_t *tt_srpt = disc->vmg_file->tt_srpt;
+  GstToc *toc;
+  gint title, c;
+
+  toc = gst_toc_new (GST_TOC_SCOPE_GLOBAL);
+
+  for (title = 0; title < disc->num_titles; title++) {
+    const title_info_t *tt = &tt_srpt->title[title];
+    GstDvdReadTitle *info = disc->titles[title];
+    ifo_handle_t *vts_file = NULL;
+    GstTocEntry *edition;
+    gchar *id;
+
+    if (tt->nr_of_ptts == 0)
+      continue;
+
+    /* skip interactive titles, we can't play them anyway; we only know
+     * for the title sets that are loaded already */
+    if (tt->title_set_nr >= 1 && tt->title_set_nr <= disc->num_vts)
+      vts_file = disc->vts_files[tt->title_set_nr];
+    if (vts_file != NULL &&
+        vts_file->vts_ptt_srpt->title[tt->vts_ttn - 1].ptt[0].pgn == 0)
+      continue;
+
+    id = g_strdup_printf ("title%02d", title + 1);
+    edition = gst_toc_entry_new (GST_TOC_ENTRY_TYPE_EDITION, id);
+    g_free (id);
+    if (info != NULL)
+      gst_toc_entry_set_start_stop_times (edition, 0, info->duration);
+
+    for (c = 0; c < tt->nr_of_ptts; c++) {
+      GstTocEntry *chapter;
+
+      id = g_strdup_printf ("title%02d-chapter%02d", title + 1, c + 1);
+      chapter = gst_toc_entry_new (GST_TOC_ENTRY_TYPE_CHAPTER, id);
+      g_free (id);
+
+      if (info != NULL && c < info->num_chapters) {
+        GstClockTime stop;
+
+        stop = (c + 1 < info->num_chapters) ? info->chapter_starts[c + 1] :
+            info->duration;
+        gst_toc_entry_set_start_stop_times (chapter, info->chapter_starts[c],
+            stop);
+      }
+      gst_toc_entry_append_sub_entry (edition, chapter);
+    }
+
+    gst_toc_append_entry (toc, edition);
+  }
+
+  return toc;
+}
+
+/* returns a ref to the TOC of the disc */
+GstToc *
+gst_dvd_read_disc_get_toc (GstDvdReadDisc * disc)
+{
+  GstToc *toc;
+
+  g_mutex_lock (&disc->lock);
+  if (disc->toc == NULL)
+    disc->toc = gst_dvd_read_disc_build_toc (disc);
+  toc = gst_toc_ref (disc->toc);
+  g_mutex_unlock (&disc->lock);
+
+  return toc;
+}
@@ -0,0 +1,83 @@
+/* GStreamer DVD title source
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_DVD_READ_DISC_H__
+#define __GST_DVD_READ_DISC_H__
+
+#include <gst/gst.h>
+
+#include <dvdread/dvd_reader.h>
+#include <dvdread/ifo_types.h>
+#include <dvdread/ifo_read.h>
+
+#include "dvdreadindex.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstDvdReadDisc GstDvdReadDisc;
+typedef struct _GstDvdReadTitle GstDvdReadTitle;
+
+/* what we computed about a title, never changes once added to the disc */
+struct _GstDvdReadTitle {
+  gint             num_chapters;
+  GstClockTime    *chapter_starts;
+  GstClockTime     duration;
+  GstDvdReadIndex *index;
+};
+
+/* parsed IFO data of a disc. Shared discs are looked up by location and
+ * have their own reader, otherwise the disc takes over the reader of the
+ * element. */
+struct _GstDvdReadDisc {
+  gint             refcount;
+  gchar           *location;
+  gboolean         shared;
+
+  GMutex           lock;
+  dvd_reader_t    *dvd;
+  ifo_handle_t    *vmg_file;
+  ifo_handle_t   **vts_files;     /* by title set number, loaded on demand */
+  gint             num_vts;
+  GstDvdReadTitle **titles;       /* by title number, added on demand      */
+  gint             num_titles;
+  GstToc          *toc;           /* built on demand                       */
+};
+
+GstDvdReadDisc  * gst_dvd_read_disc_open      (const gchar * location,
+                                               dvd_reader_t * dvd,
+                                               gboolean shared);
+
+GstDvdReadDisc  * gst_dvd_read_disc_ref       (GstDvdReadDisc * disc);
+
+void              gst_dvd_read_disc_unref     (GstDvdReadDisc * disc);
+
+ifo_handle_t    * gst_dvd_read_disc_get_vts   (GstDvdReadDisc * disc,
+                                               gint title_set_nr);
+
+GstDvdReadTitle * gst_dvd_read_disc_get_title (GstDvdReadDisc * disc,
+                                               gint title);
+
+GstDvdReadTitle * gst_dvd_read_disc_add_title (GstDvdReadDisc * disc,
+                                               gint title,
+                                               GstDvdReadTitle * info);
+
+GstToc          * gst_dvd_read_disc_get_toc   (GstDvdReadDisc * disc);
+
+G_END_DECLS
+
+#endif /* __GST_DVD_READ_DISC_H__ */
@@ -0,0 +1,268 @@
+/* GStreamer DVD title source
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#include "dvdreadindex.h"
+
+static gint
+compare_sector (gconstpointer a, gconstpointer b)
+{
+  const GstDvdReadIndexEntry *ea = a, *eb = b;
+
+  if (ea->sector != eb->sector)
+    return ea->sector < eb->sector ? -1 : 1;
+  if (ea->time != eb->time)
+    return ea->time < eb->time ? -1 : 1;
+  return 0;
+}
+
+static gint
+compare_time (gconstpointer a, gconstpointer b)
+{
+  const GstDvdReadIndexEntry *ea = a, *eb = b;
+
+  if (ea->time != eb->time)
+    return ea->time < eb->time ? -1 : 1;
+  if (ea->sector != eb->sector)
+    return ea->sector < eb->sector ? -1 : 1;
+  return 0;
+}
+
+static GstDvdReadIndex *
+gst_dvd_read_index_new (gboolean interpolated, guint size)
+{
+  GstDvdReadIndex *index;
+
+  index = g_new0 (GstDvdReadIndex, 1);
+  index->by_sector = g_array_sized_new (FALSE, FALSE,
+      sizeof (GstDvdReadIndexEntry), size);
+  index->interpolated = interpolated;
+
+  return index;
+}
+
+static void
+gst_dvd_read_index_sort (GstDvdReadIndex * index)
+{
+  index->by_time = g_array_sized_new (FALSE, FALSE,
+      sizeof (GstDvdReadIndexEntry), index->by_sector->len);
+  g_array_append_vals (index->by_time, index->by_sector->data,
+      index->by_sector->len);
+
+  g_array_sort (index->by_sector, compare_sector);
+  g_array_sort (index->by_time, compare_time);
+}
+
+/* entry j of a time map points to the VOBU at time unit * (j + 1) */
+GstDvdReadIndex *
+gst_dvd_read_index_new_from_tmap (const vts_tmap_t * tmap)
+{
+  GstDvdReadIndex *index;
+  GstDvdReadIndexEntry entry = { 0, };
+  gint j;
+
+  index = gst_dvd_read_index_new (FALSE, tmap->nr_of_entries);
+
+  for (j = 0; j < tmap->nr_of_entries; ++j) {
+    entry.sector = tmap->map_ent[j] & 0x7fffffff;
+    entry.time = (guint64) tmap->tmu * (j + 1) * GST_SECOND;
+    g_array_append_val (index->by_sector, entry);
+  }
+
+  gst_dvd_read_index_sort (index);
+
+  return index;
+}
+
+/* one entry per cell; the cells of an angle block all start at the same
+ * time, which only advances after the last cell of the block */
+GstDvdReadIndex *
+gst_dvd_read_index_new_from_pgc (const pgc_t * pgc)
+{
+  GstDvdReadIndex *index;
+  GstDvdReadIndexEntry entry = { 0, };
+  GstClockTime time = 0;
+  gint64 duration;
+  gint i;
+
+  index = gst_dvd_read_index_new (TRUE, pgc->nr_of_cells);
+
+  for (i = 0; i < pgc->nr_of_cells; ++i) {
+    const cell_playback_t *cell = &pgc->cell_playback[i];
+
+    duration = gst_dvd_read_convert_timecode (&cell->playback_time);
+    if (duration < 0)
+      duration = 0;
+
+    entry.sector = cell->first_sector;
+    entry.last_sector = cell->last_sector;
+    entry.time = time;
+    entry.duration = duration;
+    g_array_append_val (index->by_sector, entry);
+
+    if (cell->block_type != BLOCK_TYPE_ANGLE_BLOCK ||
+        cell->block_mode == BLOCK_MODE_LAST_CELL)
+      time += duration;
+  }
+
+  gst_dvd_read_index_sort (index);
+
+  return index;
+}
+
+void
+gst_dvd_read_index_free (GstDvdReadIndex * index)
+{
+  g_array_free (index->by_sector, TRUE);
+  g_array_free (index->by_time, TRUE);
+  g_free (index);
+}
+
+/* returns the time of the entry at exactly @sector, NONE if there is none */
+GstClockTime
+gst_dvd_read_index_get_time (GstDvdReadIndex * index, guint sector)
+{
+  GstDvdReadIndexEntry *entries;
+  guint lo, hi, mid;
+
+  entries = (GstDvdReadIndexEntry *) index->by_sector->data;
+
+  /* find the first entry at or after the sector */
+  lo = 0;
+  hi = index->by_sector->len;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (entries[mid].sector < sector)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo < index->by_sector->len && entries[lo].sector == sector)
+    return entries[lo].time;
+
+  if (sector == 0)
+    return (GstClockTime) 0;
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+/* looks for @sector in every time map of the title set, for VOBUs that the
+ * index of the title doesn't cover; returns NONE if none has it */
+GstClockTime
+gst_dvd_read_index_scan_tmapt (const vts_tmapt_t * tmapt, guint sector)
+{
+  gint i, j;
+
+  if (tmapt == NULL)
+    return GST_CLOCK_TIME_NONE;
+
+  for (i = 0; i < tmapt->nr_of_tmaps; ++i) {
+    for (j = 0; j < tmapt->tmap[i].nr_of_entries; ++j) {
+      if ((tmapt->tmap[i].map_ent[j] & 0x7fffffff) == sector)
+        return (guint64) tmapt->tmap[i].tmu * (j + 1) * GST_SECOND;
+    }
+  }
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+/* returns the sector of the entry at (or before) the given time, or -1 when
+ * the time is after the last entry. Within cells, the sector is interpolated
+ * from the playback time. */
+gint
+gst_dvd_read_index_get_sector (GstDvdReadIndex * index, GstClockTime ts)
+{
+  GstDvdReadIndexEntry *entries, *entry, *first, *last;
+  guint lo, hi, mid, len;
+
+  entries = (GstDvdReadIndexEntry *) index->by_time->data;
+  len = index->by_time->len;
+
+  if (len == 0)
+    return (ts == 0) ? 0 : -1;
+
+  /* find the first entry after the time */
+  lo = 0;
+  hi = len;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (entries[mid].time <= ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (!index->interpolated) {
+    if (entries[len - 1].time < ts)
+      return (ts == 0) ? 0 : -1;
+    /* before the first entry we start at the first one */
+    entry = &entries[lo > 0 ? lo - 1 : 0];
+    return entry->sector;
+  }
+
+  if (lo == 0)
+    return -1;
+
+  /* the cells of an angle block share the start time, take the first one
+   * that covers the time */
+  last = &entries[lo - 1];
+  first = last;
+  while (first > entries && (first - 1)->time == last->time)
+    first--;
+
+  for (entry = first; entry <= last; entry++) {
+    if (ts - entry->time < entry->duration)
+      return entry->sector + gst_util_uint64_scale (ts - entry->time,
+          entry->last_sector - entry->sector + 1, entry->duration);
+  }
+
+  /* after the end of the last cell */
+  if (lo == len)
+    return (ts == 0) ? (gint) first->sector : -1;
+
+  return entries[lo].sector;
+}
+
+gint64
+gst_dvd_read_convert_timecode (const dvd_time_t * time)
+{
+  gint64 ret_time;
+  const gint64 one_hour = 3600 * GST_SECOND;
+  const gint64 one_min = 60 * GST_SECOND;
+
+  g_return_val_if_fail ((time->hour >> 4) < 0xa
+      && (time->hour & 0xf) < 0xa, -1);
+  g_return_val_if_fail ((time->minute >> 4) < 0x7
+      && (time->minute & 0xf) < 0xa, -1);
+  g_return_val_if_fail ((time->second >> 4) < 0x7
+      && (time->second & 0xf) < 0xa, -1);
+
+  ret_time = ((time->hour >> 4) * 10 + (time->hour & 0xf)) * one_hour;
+  ret_time += ((time->minute >> 4) * 10 + (time->minute & 0xf)) * one_min;
+  ret_time += ((time->second >> 4) * 10 + (time->second & 0xf)) * GST_SECOND;
+
+  return ret_time;
+}
@@ -0,0 +1,65 @@
+/* GStreamer DVD title source
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_DVD_READ_INDEX_H__
+#define __GST_DVD_READ_INDEX_H__
+
+#include <gst/gst.h>
+
+#include <dvdread/ifo_types.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstDvdReadIndex GstDvdReadIndex;
+typedef struct _GstDvdReadIndexEntry GstDvdReadIndexEntry;
+
+struct _GstDvdReadIndexEntry {
+  guint32          sector;
+  guint32          last_sector;   /* only for cell entries */
+  GstClockTime     time;
+  GstClockTime     duration;      /* only for cell entries */
+};
+
+/* sector <=> time mapping of one title, built from the title's time map
+ * or, when there is none, from the cell playback times of its PGC */
+struct _GstDvdReadIndex {
+  GArray          *by_sector;     /* GstDvdReadIndexEntry, sorted by sector */
+  GArray          *by_time;       /* the same entries, sorted by time       */
+  gboolean         interpolated;  /* entries are cells                      */
+};
+
+GstDvdReadIndex * gst_dvd_read_index_new_from_tmap (const vts_tmap_t * tmap);
+
+GstDvdReadIndex * gst_dvd_read_index_new_from_pgc  (const pgc_t * pgc);
+
+void              gst_dvd_read_index_free          (GstDvdReadIndex * index);
+
+GstClockTime      gst_dvd_read_index_get_time      (GstDvdReadIndex * index,
+                                                    guint sector);
+
+gint              gst_dvd_read_index_get_sector    (GstDvdReadIndex * index,
+                                                    GstClockTime ts);
+
+GstClockTime      gst_dvd_read_index_scan_tmapt    (const vts_tmapt_t * tmapt,
+                                                    guint sector);
+
+gint64            gst_dvd_read_convert_timecode    (const dvd_time_t * time);
+
+G_END_DECLS
+
+#endif /* __GST_DVD_READ_INDEX_H__ */
@@ -47,9 +47,17 @@ enum
   ARG_DEVICE,
   ARG_TITLE,
   ARG_CHAPTER,
-  ARG_ANGLE
+  ARG_ANGLE,
+  ARG_READAHEAD,
+  ARG_SHARED_CACHE
 };
 
+#define DEFAULT_READAHEAD FALSE
+#define DEFAULT_SHARED_CACHE FALSE
+
+/* a VOBU is at most 1024 sectors including the NAV pack */
+#define MAX_VOBU_SECTORS 1024
+
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
@@ -81,7 +89,6 @@ static GstEvent *gst_dvd_read_src_make_clut_change_event (GstDvdReadSrc * src,
     const guint * clut);
 static gboolean gst_dvd_read_src_get_size (GstDvdReadSrc * src, gint64 * size);
 static gboolean gst_dvd_read_src_do_seek (GstBaseSrc * src, GstSegment * s);
-static gint64 gst_dvd_read_src_convert_timecode (dvd_time_t * time);
 static gint gst_dvd_read_src_get_next_cell (GstDvdReadSrc * src,
     pgc_t * pgc, gint cell);
 static GstClockTime gst_dvd_read_src_get_time_for_sector (GstDvdReadSrc * src,
@@ -89,6 +96,10 @@ static GstClockTime gst_dvd_read_src_get_time_for_sector (GstDvdReadSrc * src,
 static gint gst_dvd_read_src_get_sector_from_time (GstDvdReadSrc * src,
     GstClockTime ts);
 
+static void gst_dvd_read_src_readahead_func (gpointer data,
+    gpointer user_data);
+static void gst_dvd_read_src_readahead_flush (GstDvdReadSrc * src);
+
 static void gst_dvd_read_src_uri_handler_init (gpointer g_iface,
     gpointer iface_data);
 
@@ -103,6 +114,8 @@ gst_dvd_read_src_finalize (GObject * object)
   GstDvdReadSrc *src = GST_DVD_READ_SRC (object);
 
   g_free (src->location);
+  g_mutex_clear (&src->readahead_lock);
+  g_cond_clear (&src->readahead_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -127,6 +140,11 @@ gst_dvd_read_src_init (GstDvdReadSrc * src)
   src->title_lang_event_pending = NULL;
   src->pending_clut_event = NULL;
 
+  src->readahead = DEFAULT_READAHEAD;
+  src->shared_cache = DEFAULT_SHARED_CACHE;
+  g_mutex_init (&src->readahead_lock);
+  g_cond_init (&src->readahead_cond);
+
   gst_pad_use_fixed_caps (GST_BASE_SRC_PAD (src));
   gst_pad_set_caps (GST_BASE_SRC_PAD (src),
       gst_static_pad_template_get_caps (&srctemplate));
@@ -163,6 +181,16 @@ gst_dvd_read_src_class_init (GstDvdReadSrcClass * klass)
   g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_ANGLE,
       g_param_spec_int ("angle", "angle", "angle",
           1, 999, 1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_READAHEAD,
+      g_param_spec_boolean ("readahead", "Readahead",
+          "Read the next VOBU in a separate thread while the current one "
+          "is pushed (takes effect when the device is opened)",
+          DEFAULT_READAHEAD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_SHARED_CACHE,
+      g_param_spec_boolean ("shared-cache", "Shared cache",
+          "Share the parsed disc structure with other elements opening the "
+          "same device (takes effect when the device is opened)",
+          DEFAULT_SHARED_CACHE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_static_pad_template (gstelement_class, &srctemplate);
 
@@ -191,6 +219,10 @@ static gboolean
 gst_dvd_read_src_start (GstBaseSrc * basesrc)
 {
   GstDvdReadSrc *src = GST_DVD_READ_SRC (basesrc);
+  GstDvdReadDisc *disc;
+  GstStructure *config;
+  GstCaps *caps;
+  gboolean shared;
 
   g_return_val_if_fail (src->location != NULL, FALSE);
 
@@ -202,10 +234,21 @@ gst_dvd_read_src_start (GstBaseSrc * basesrc)
   /* Load the video manager to find out the information about the titles */
   GST_DEBUG_OBJECT (src, "Loading VMG info");
 
-  if (!(src->vmg_file = ifoOpen (src->dvd, 0)))
+  GST_OBJECT_LOCK (src);
+  shared = src->shared_cache;
+  GST_OBJECT_UNLOCK (src);
+
+  disc = gst_dvd_read_disc_open (src->location, src->dvd, shared);
+  if (disc == NULL)
     goto ifo_open_failed;
 
+  GST_OBJECT_LOCK (src);
+  src->disc = disc;
+  GST_OBJECT_UNLOCK (src);
+
+  src->vmg_file = src->disc->vmg_file;
   src->tt_srpt = src->vmg_file->tt_srpt;
+  src->title_set_nr = -1;
 
   src->title = src->uri_title - 1;
   src->chapter = src->uri_chapter - 1;
@@ -222,9 +265,38 @@ gst_dvd_read_src_start (GstBaseSrc * basesrc)
 
   src->first_seek = TRUE;
 
+  /* all titles and chapters of the disc, sent before the first buffer */
+  src->toc_sent = FALSE;
+
+  /* VOBUs are read straight into buffers of the maximum VOBU size */
+  src->pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (src->pool);
+  caps = gst_static_pad_template_get_caps (&srctemplate);
+  gst_buffer_pool_config_set_params (config, caps,
+      MAX_VOBU_SECTORS * DVD_VIDEO_LB_LEN, 0, 0);
+  gst_caps_unref (caps);
+  if (!gst_buffer_pool_set_config (src->pool, config) ||
+      !gst_buffer_pool_set_active (src->pool, TRUE))
+    goto pool_failed;
+
+  GST_OBJECT_LOCK (src);
+  if (src->readahead) {
+    src->readahead_pool = g_thread_pool_new (gst_dvd_read_src_readahead_func,
+        NULL, 1, TRUE, NULL);
+  }
+  GST_OBJECT_UNLOCK (src);
+
   return TRUE;
 
   /* ERRORS */
+pool_failed:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, SETTINGS, (NULL),
+        ("Failed to set up buffer pool"));
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+    return FALSE;
+  }
 open_failed:
   {
     GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
@@ -258,19 +330,39 @@ static gboolean
 gst_dvd_read_src_stop (GstBaseSrc * basesrc)
 {
   GstDvdReadSrc *src = GST_DVD_READ_SRC (basesrc);
+  GstDvdReadDisc *disc;
 
-  if (src->vts_file) {
-    ifoClose (src->vts_file);
-    src->vts_file = NULL;
+  if (src->readahead_pool) {
+    gst_dvd_read_src_readahead_flush (src);
+    g_thread_pool_free (src->readahead_pool, FALSE, TRUE);
+    src->readahead_pool = NULL;
   }
-  if (src->vmg_file) {
-    ifoClose (src->vmg_file);
-    src->vmg_file = NULL;
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
   }
+
+  src->vts_file = NULL;
+  src->vmg_file = NULL;
   if (src->dvd_title) {
     DVDCloseFile (src->dvd_title);
     src->dvd_title = NULL;
   }
+  /* queries may still hold a ref to the disc */
+  GST_OBJECT_LOCK (src);
+  disc = src->disc;
+  src->disc = NULL;
+  src->chapter_starts = NULL;
+  src->index = NULL;
+  GST_OBJECT_UNLOCK (src);
+
+  if (disc) {
+    /* a disc that is not shared reads through our reader and closes it */
+    if (!disc->shared)
+      src->dvd = NULL;
+    gst_dvd_read_disc_unref (disc);
+  }
   if (src->dvd) {
     DVDClose (src->dvd);
     src->dvd = NULL;
@@ -290,10 +382,6 @@ gst_dvd_read_src_stop (GstBaseSrc * basesrc)
     gst_event_unref (src->pending_clut_event);
     src->pending_clut_event = NULL;
   }
-  if (src->chapter_starts) {
-    g_free (src->chapter_starts);
-    src->chapter_starts = NULL;
-  }
 
   GST_LOG_OBJECT (src, "closed DVD");
 
@@ -301,17 +389,15 @@ gst_dvd_read_src_stop (GstBaseSrc * basesrc)
 }
 
 static void
-cur_title_get_chapter_pgc (GstDvdReadSrc * src, gint chapter, gint * p_pgn,
-    gint * p_pgc_id, pgc_t ** p_pgc)
+title_get_chapter_pgc (ifo_handle_t * vts_file, gint ttn, gint chapter,
+    gint * p_pgn, gint * p_pgc_id, pgc_t ** p_pgc)
 {
   pgc_t *pgc;
   gint pgn, pgc_id;
 
-  g_assert (chapter >= 0 && chapter < src->num_chapters);
-
-  pgc_id = src->vts_ptt_srpt->title[src->ttn - 1].ptt[chapter].pgcn;
-  pgn = src->vts_ptt_srpt->title[src->ttn - 1].ptt[chapter].pgn;
-  pgc = src->vts_file->vts_pgcit->pgci_srp[pgc_id - 1].pgc;
+  pgc_id = vts_file->vts_ptt_srpt->title[ttn - 1].ptt[chapter].pgcn;
+  pgn = vts_file->vts_ptt_srpt->title[ttn - 1].ptt[chapter].pgn;
+  pgc = vts_file->vts_pgcit->pgci_srp[pgc_id - 1].pgc;
 
   *p_pgn = pgn;
   *p_pgc_id = pgc_id;
@@ -319,29 +405,47 @@ cur_title_get_chapter_pgc (GstDvdReadSrc * src, gint chapter, gint * p_pgn,
 }
 
 static void
-cur_title_get_chapter_bounds (GstDvdReadSrc * src, gint chapter,
-    gint * p_first_cell, gint * p_last_cell)
+title_get_chapter_bounds (ifo_handle_t * vts_file, gint ttn,
+    gint num_chapters, gint chapter, gint * p_first_cell, gint * p_last_cell)
 {
   pgc_t *pgc;
   gint pgn, pgc_id, pgn_next_ch;
 
-  g_assert (chapter >= 0 && chapter < src->num_chapters);
+  g_assert (chapter >= 0 && chapter < num_chapters);
 
-  cur_title_get_chapter_pgc (src, chapter, &pgn, &pgc_id, &pgc);
+  title_get_chapter_pgc (vts_file, ttn, chapter, &pgn, &pgc_id, &pgc);
 
   *p_first_cell = pgc->program_map[pgn - 1] - 1;
 
   /* last cell is used as a 'up to boundary', not 'up to and including',
    * i.e. it is the first cell not included in the chapter range */
-  if (chapter == (src->num_chapters - 1)) {
+  if (chapter == (num_chapters - 1)) {
     *p_last_cell = pgc->nr_of_cells;
   } else {
-    pgn_next_ch = src->vts_ptt_srpt->title[src->ttn - 1].ptt[chapter + 1].pgn;
+    pgn_next_ch = vts_file->vts_ptt_srpt->title[ttn - 1].ptt[chapter + 1].pgn;
     *p_last_cell = pgc->program_map[pgn_next_ch - 1] - 1;
   }
+}
+
+static void
+cur_title_get_chapter_pgc (GstDvdReadSrc * src, gint chapter, gint * p_pgn,
+    gint * p_pgc_id, pgc_t ** p_pgc)
+{
+  g_assert (chapter >= 0 && chapter < src->num_chapters);
+
+  title_get_chapter_pgc (src->vts_file, src->ttn, chapter, p_pgn, p_pgc_id,
+      p_pgc);
+}
+
+static void
+cur_title_get_chapter_bounds (GstDvdReadSrc * src, gint chapter,
+    gint * p_first_cell, gint * p_last_cell)
+{
+  title_get_chapter_bounds (src->vts_file, src->ttn, src->num_chapters,
+      chapter, p_first_cell, p_last_cell);
 
-  GST_DEBUG_OBJECT (src, "Chapter %d bounds: %d %d (within %d cells)",
-      chapter, *p_first_cell, *p_last_cell, pgc->nr_of_cells);
+  GST_DEBUG_OBJECT (src, "Chapter %d bounds: %d %d", chapter, *p_first_cell,
+      *p_last_cell);
 }
 
 static gboolean
@@ -396,48 +500,109 @@ gst_dvd_read_src_goto_chapter (GstDvdReadSrc * src, gint chapter)
   return TRUE;
 }
 
-static void
-gst_dvd_read_src_get_chapter_starts (GstDvdReadSrc * src)
+/* computes chapter starts and index of a title, unless this or another
+ * element already did that for the disc */
+static GstDvdReadTitle *
+gst_dvd_read_src_get_title_info (GstDvdReadSrc * src, gint title,
+    ifo_handle_t * vts_file, gint ttn, gint num_chapters)
 {
+  GstDvdReadTitle *info;
+  vts_tmapt_t *vts_tmapt;
   GstClockTime uptohere;
-  guint c;
+  pgc_t *pgc0 = NULL;
+  gint pgn0, pgc0_id;
+  gint c;
+
+  info = gst_dvd_read_disc_get_title (src->disc, title);
+  if (info != NULL)
+    return info;
 
-  g_free (src->chapter_starts);
-  src->chapter_starts = g_new (GstClockTime, src->num_chapters);
+  info = g_new0 (GstDvdReadTitle, 1);
+  info->num_chapters = num_chapters;
+  info->chapter_starts = g_new (GstClockTime, num_chapters);
 
   uptohere = (GstClockTime) 0;
-  for (c = 0; c < src->num_chapters; ++c) {
+  for (c = 0; c < num_chapters; ++c) {
     GstClockTime chapter_duration = 0;
     gint cell_start, cell_end, cell;
     gint pgn, pgc_id;
     pgc_t *pgc;
 
-    cur_title_get_chapter_pgc (src, c, &pgn, &pgc_id, &pgc);
-    cur_title_get_chapter_bounds (src, c, &cell_start, &cell_end);
+    title_get_chapter_pgc (vts_file, ttn, c, &pgn, &pgc_id, &pgc);
+    title_get_chapter_bounds (vts_file, ttn, num_chapters, c, &cell_start,
+        &cell_end);
 
     cell = cell_start;
     while (cell < cell_end) {
       dvd_time_t *cell_duration;
 
       cell_duration = &pgc->cell_playback[cell].playback_time;
-      chapter_duration += gst_dvd_read_src_convert_timecode (cell_duration);
+      chapter_duration += gst_dvd_read_convert_timecode (cell_duration);
       cell = gst_dvd_read_src_get_next_cell (src, pgc, cell);
     }
 
-    src->chapter_starts[c] = uptohere;
+    info->chapter_starts[c] = uptohere;
 
     GST_INFO_OBJECT (src, "[%02u] Chapter %02u starts at %" GST_TIME_FORMAT
-        ", dur = %" GST_TIME_FORMAT ", cells %d-%d", src->title + 1, c + 1,
+        ", dur = %" GST_TIME_FORMAT ", cells %d-%d", title + 1, c + 1,
         GST_TIME_ARGS (uptohere), GST_TIME_ARGS (chapter_duration),
         cell_start, cell_end);
 
     uptohere += chapter_duration;
   }
+  info->duration = uptohere;
+
+  if (num_chapters > 0)
+    title_get_chapter_pgc (vts_file, ttn, 0, &pgn0, &pgc0_id, &pgc0);
+
+  /* dump seek tables */
+  vts_tmapt = vts_file->vts_tmapt;
+  if (vts_tmapt) {
+    gint i, j;
+
+    GST_LOG_OBJECT (src, "nr_of_tmaps = %d", vts_tmapt->nr_of_tmaps);
+    for (i = 0; i < vts_tmapt->nr_of_tmaps; ++i) {
+      GST_LOG_OBJECT (src, "======= Table %d ===================", i);
+      GST_LOG_OBJECT (src, "Offset relative to VTS_TMAPTI: %d",
+          vts_tmapt->tmap_offset[i]);
+      GST_LOG_OBJECT (src, "Time unit (seconds)          : %d",
+          vts_tmapt->tmap[i].tmu);
+      GST_LOG_OBJECT (src, "Number of entries            : %d",
+          vts_tmapt->tmap[i].nr_of_entries);
+      for (j = 0; j < vts_tmapt->tmap[i].nr_of_entries; j++) {
+        guint64 time;
+
+        time = (guint64) vts_tmapt->tmap[i].tmu * (j + 1) * GST_SECOND;
+        GST_LOG_OBJECT (src, "Time: %" GST_TIME_FORMAT " VOBU "
+            "Sector: 0x%08x %s", GST_TIME_ARGS (time),
+            vts_tmapt->tmap[i].map_ent[j] & 0x7fffffff,
+            (vts_tmapt->tmap[i].map_ent[j] >> 31) ? "discontinuity" : "");
+      }
+    }
+  }
+
+  if (vts_tmapt && vts_tmapt->nr_of_tmaps >= ttn &&
+      vts_tmapt->tmap[ttn - 1].nr_of_entries > 0) {
+    info->index = gst_dvd_read_index_new_from_tmap (&vts_tmapt->tmap[ttn - 1]);
+  } else if (pgc0 != NULL) {
+    GST_WARNING_OBJECT (src, "no time map for the title - interpolating seek "
+        "positions from cell times");
+    info->index = gst_dvd_read_index_new_from_pgc (pgc0);
+  } else {
+    GST_WARNING_OBJECT (src, "no vts_tmapt - seeking will suck");
+  }
+  if (info->index) {
+    GST_DEBUG_OBJECT (src, "index has %u entries",
+        info->index->by_sector->len);
+  }
+
+  return gst_dvd_read_disc_add_title (src->disc, title, info);
 }
 
 static gboolean
 gst_dvd_read_src_goto_title (GstDvdReadSrc * src, gint title, gint angle)
 {
+  GstDvdReadTitle *info;
   GstStructure *s;
   gchar lang_code[3] = { '\0', '\0', '\0' }, *t;
   pgc_t *pgc0;
@@ -465,9 +630,12 @@ gst_dvd_read_src_goto_title (GstDvdReadSrc * src, gint title, gint angle)
     angle = CLAMP (angle, 0, src->num_angles - 1);
   }
 
-  /* load the VTS information for the title set our title is in */
+  /* a pending read might still use the old title set */
+  gst_dvd_read_src_readahead_flush (src);
+
+  /* get the VTS information for the title set our title is in */
   title_set_nr = src->tt_srpt->title[title].title_set_nr;
-  src->vts_file = ifoOpen (src->dvd, title_set_nr);
+  src->vts_file = gst_dvd_read_disc_get_vts (src->disc, title_set_nr);
   if (src->vts_file == NULL)
     goto ifo_open_failed;
 
@@ -480,10 +648,17 @@ gst_dvd_read_src_goto_title (GstDvdReadSrc * src, gint title, gint angle)
     goto commands_only_pgc;
   }
 
-  /* we've got enough info, time to open the title set data */
-  src->dvd_title = DVDOpenFile (src->dvd, title_set_nr, DVD_READ_TITLE_VOBS);
-  if (src->dvd_title == NULL)
-    goto title_open_failed;
+  /* we've got enough info, time to open the title set data unless we
+   * already have it open */
+  if (src->dvd_title == NULL || src->title_set_nr != title_set_nr) {
+    if (src->dvd_title)
+      DVDCloseFile (src->dvd_title);
+    src->title_set_nr = title_set_nr;
+    src->dvd_title =
+        DVDOpenFile (src->dvd, title_set_nr, DVD_READ_TITLE_VOBS);
+    if (src->dvd_title == NULL)
+      goto title_open_failed;
+  }
 
   GST_INFO_OBJECT (src, "Opened title %d, angle %d", title + 1, angle);
   src->title = title;
@@ -577,35 +752,17 @@ gst_dvd_read_src_goto_title (GstDvdReadSrc * src, gint title, gint angle)
   src->title_lang_event_pending =
       gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM, s);
 
-  /* dump seek tables */
   src->vts_tmapt = src->vts_file->vts_tmapt;
-  if (src->vts_tmapt) {
-    gint i, j;
 
-    GST_LOG_OBJECT (src, "nr_of_tmaps = %d", src->vts_tmapt->nr_of_tmaps);
-    for (i = 0; i < src->vts_tmapt->nr_of_tmaps; ++i) {
-      GST_LOG_OBJECT (src, "======= Table %d ===================", i);
-      GST_LOG_OBJECT (src, "Offset relative to VTS_TMAPTI: %d",
-          src->vts_tmapt->tmap_offset[i]);
-      GST_LOG_OBJECT (src, "Time unit (seconds)          : %d",
-          src->vts_tmapt->tmap[i].tmu);
-      GST_LOG_OBJECT (src, "Number of entries            : %d",
-          src->vts_tmapt->tmap[i].nr_of_entries);
-      for (j = 0; j < src->vts_tmapt->tmap[i].nr_of_entries; j++) {
-        guint64 time;
-
-        time = (guint64) src->vts_tmapt->tmap[i].tmu * (j + 1) * GST_SECOND;
-        GST_LOG_OBJECT (src, "Time: %" GST_TIME_FORMAT " VOBU "
-            "Sector: 0x%08x %s", GST_TIME_ARGS (time),
-            src->vts_tmapt->tmap[i].map_ent[j] & 0x7fffffff,
-            (src->vts_tmapt->tmap[i].map_ent[j] >> 31) ? "discontinuity" : "");
-      }
-    }
-  } else {
-    GST_WARNING_OBJECT (src, "no vts_tmapt - seeking will suck");
-  }
+  info = gst_dvd_read_src_get_title_info (src, title, src->vts_file, src->ttn,
+      src->num_chapters);
+  GST_OBJECT_LOCK (src);
+  src->chapter_starts = info->chapter_starts;
+  src->index = info->index;
+  GST_OBJECT_UNLOCK (src);
 
-  gst_dvd_read_src_get_chapter_starts (src);
+  /* the TOC has the times of this title now */
+  src->toc_sent = FALSE;
 
   return TRUE;
 
@@ -687,65 +844,196 @@ gst_dvd_read_src_is_nav_pack (const guint8 * data, gint lbn, dsi_t * dsi_pack)
   return TRUE;
 }
 
-/* find time for sector from index, returns NONE if there is no exact match */
+/* find time for sector from index, or from the other time maps of the title
+ * set, returns NONE if there is no exact match */
 static GstClockTime
 gst_dvd_read_src_get_time_for_sector (GstDvdReadSrc * src, guint sector)
 {
-  gint i, j;
+  GstClockTime time = GST_CLOCK_TIME_NONE;
 
-  if (src->vts_tmapt == NULL || src->vts_tmapt->nr_of_tmaps == 0)
-    return GST_CLOCK_TIME_NONE;
+  if (src->index != NULL)
+    time = gst_dvd_read_index_get_time (src->index, sector);
 
-  for (i = 0; i < src->vts_tmapt->nr_of_tmaps; ++i) {
-    for (j = 0; j < src->vts_tmapt->tmap[i].nr_of_entries; ++j) {
-      if ((src->vts_tmapt->tmap[i].map_ent[j] & 0x7fffffff) == sector)
-        return (guint64) src->vts_tmapt->tmap[i].tmu * (j + 1) * GST_SECOND;
-    }
-  }
+  if (!GST_CLOCK_TIME_IS_VALID (time) && src->vts_file != NULL)
+    time = gst_dvd_read_index_scan_tmapt (src->vts_file->vts_tmapt, sector);
 
-  if (sector == 0)
-    return (GstClockTime) 0;
+  if (!GST_CLOCK_TIME_IS_VALID (time) && sector == 0)
+    time = 0;
 
-  return GST_CLOCK_TIME_NONE;
+  return time;
 }
 
 /* returns the sector in the index at (or before) the given time, or -1 */
 static gint
 gst_dvd_read_src_get_sector_from_time (GstDvdReadSrc * src, GstClockTime ts)
 {
-  gint sector, j;
+  if (src->index == NULL)
+    return (ts == 0) ? 0 : -1;
 
-  if (src->vts_tmapt == NULL || src->vts_tmapt->nr_of_tmaps < src->ttn)
-    return -1;
+  return gst_dvd_read_index_get_sector (src->index, ts);
+}
 
-  sector = src->vts_tmapt->tmap[src->ttn - 1].map_ent[0] & 0x7fffffff;
+typedef enum
+{
+  GST_DVD_READ_OK = 0,
+  GST_DVD_READ_ERROR = -1,
+  GST_DVD_READ_EOS = -2,
+  GST_DVD_READ_AGAIN = -3
+} GstDvdReadReturn;
 
-  for (j = 0; j < src->vts_tmapt->tmap[src->ttn - 1].nr_of_entries; ++j) {
-    GstClockTime entry_time;
+/* reads the VOBU starting with the NAV pack at (or after) *pack into a
+ * buffer from the pool and parses the DSI from the NAV pack in place.
+ * *pack is updated to the sector of the NAV pack. */
+static GstDvdReadReturn
+gst_dvd_read_src_read_vobu (GstDvdReadSrc * src, dvd_file_t * file,
+    gint * pack, GstBuffer ** p_buf, dsi_t * dsi_pack)
+{
+  GstBuffer *buf = NULL;
+  GstMapInfo map;
+  guint size;
+  gint len;
+  gint retries;
 
-    entry_time =
-        (guint64) src->vts_tmapt->tmap[src->ttn - 1].tmu * (j + 1) * GST_SECOND;
-    if (entry_time <= ts) {
-      sector = src->vts_tmapt->tmap[src->ttn - 1].map_ent[j] & 0x7fffffff;
-    }
-    if (entry_time >= ts) {
-      return sector;
+  if (gst_buffer_pool_acquire_buffer (src->pool, &buf, NULL) != GST_FLOW_OK)
+    goto no_buffer;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+
+  /* read NAV packet */
+  retries = 0;
+nav_retry:
+  retries++;
+
+  len = DVDReadBlocks (file, *pack, 1, map.data);
+  if (len != 1)
+    goto read_error;
+
+  if (!gst_dvd_read_src_is_nav_pack (map.data, *pack, dsi_pack)) {
+    GST_LOG_OBJECT (src, "Skipping nav packet @ pack %d", *pack);
+    (*pack)++;
+
+    if (retries < 2000) {
+      goto nav_retry;
+    } else {
+      GST_LOG_OBJECT (src, "No nav packet @ pack %d after 2000 blocks", *pack);
+      goto read_error;
     }
   }
 
-  if (ts == 0)
-    return 0;
+  size = dsi_pack->dsi_gi.vobu_ea + 1;
+
+  g_assert (size < MAX_VOBU_SECTORS);
+
+  GST_LOG_OBJECT (src, "Going to read %u sectors @ pack %d", size, *pack);
+
+  /* the NAV pack is already in place, read the rest of the VOBU after it */
+  if (size > 1) {
+    len = DVDReadBlocks (file, *pack + 1, size - 1,
+        map.data + DVD_VIDEO_LB_LEN);
+    if (len != size - 1)
+      goto block_read_error;
+  }
+
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_resize (buf, 0, size * DVD_VIDEO_LB_LEN);
+
+  *p_buf = buf;
+
+  return GST_DVD_READ_OK;
 
-  return -1;
+  /* ERRORS */
+no_buffer:
+  {
+    GST_ERROR_OBJECT (src, "Could not get a buffer from the pool");
+    return GST_DVD_READ_ERROR;
+  }
+read_error:
+  {
+    GST_ERROR_OBJECT (src, "Read failed for block %d", *pack);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+    return GST_DVD_READ_ERROR;
+  }
+block_read_error:
+  {
+    GST_ERROR_OBJECT (src, "Read failed for %d blocks at %d", size, *pack);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+    return GST_DVD_READ_ERROR;
+  }
 }
 
-typedef enum
+static void
+gst_dvd_read_src_readahead_func (gpointer data, gpointer user_data)
 {
-  GST_DVD_READ_OK = 0,
-  GST_DVD_READ_ERROR = -1,
-  GST_DVD_READ_EOS = -2,
-  GST_DVD_READ_AGAIN = -3
-} GstDvdReadReturn;
+  GstDvdReadSrc *src = GST_DVD_READ_SRC (data);
+  GstBuffer *buf = NULL;
+  dsi_t dsi_pack;
+  gint pack, res;
+
+  /* the streaming thread doesn't touch the file until we're done */
+  g_mutex_lock (&src->readahead_lock);
+  pack = src->readahead_pack;
+  g_mutex_unlock (&src->readahead_lock);
+
+  res = gst_dvd_read_src_read_vobu (src, src->dvd_title, &pack, &buf,
+      &dsi_pack);
+
+  g_mutex_lock (&src->readahead_lock);
+  src->readahead_nav = pack;
+  src->readahead_result = res;
+  src->readahead_buf = buf;
+  src->readahead_dsi = dsi_pack;
+  src->readahead_busy = FALSE;
+  g_cond_broadcast (&src->readahead_cond);
+  g_mutex_unlock (&src->readahead_lock);
+}
+
+static void
+gst_dvd_read_src_readahead_start (GstDvdReadSrc * src, gint pack)
+{
+  GST_LOG_OBJECT (src, "reading ahead @ pack %d", pack);
+
+  g_mutex_lock (&src->readahead_lock);
+  src->readahead_busy = TRUE;
+  src->readahead_pack = pack;
+  g_mutex_unlock (&src->readahead_lock);
+
+  g_thread_pool_push (src->readahead_pool, src, NULL);
+}
+
+/* waits for a pending read and takes its result when it was started at
+ * @pack, otherwise it is dropped */
+static gboolean
+gst_dvd_read_src_readahead_take (GstDvdReadSrc * src, gint pack,
+    GstBuffer ** p_buf, dsi_t * dsi_pack, gint * nav)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&src->readahead_lock);
+  while (src->readahead_busy)
+    g_cond_wait (&src->readahead_cond, &src->readahead_lock);
+
+  if (src->readahead_result == GST_DVD_READ_OK && src->readahead_buf &&
+      src->readahead_pack == pack && pack >= 0) {
+    *p_buf = src->readahead_buf;
+    *dsi_pack = src->readahead_dsi;
+    *nav = src->readahead_nav;
+    ret = TRUE;
+  } else if (src->readahead_buf) {
+    gst_buffer_unref (src->readahead_buf);
+  }
+  src->readahead_buf = NULL;
+  g_mutex_unlock (&src->readahead_lock);
+
+  return ret;
+}
+
+static void
+gst_dvd_read_src_readahead_flush (GstDvdReadSrc * src)
+{
+  gst_dvd_read_src_readahead_take (src, -1, NULL, NULL, NULL);
+}
 
 static GstDvdReadReturn
 gst_dvd_read_src_read (GstDvdReadSrc * src, gint angle, gint new_seek,
@@ -753,13 +1041,10 @@ gst_dvd_read_src_read (GstDvdReadSrc * src, gint angle, gint new_seek,
 {
   GstBuffer *buf;
   GstSegment *seg;
-  guint8 oneblock[DVD_VIDEO_LB_LEN];
   dsi_t dsi_pack;
   guint next_vobu, cur_output_size;
-  gint len;
-  gint retries;
+  GstDvdReadReturn res;
   gint64 next_time;
-  GstMapInfo map;
 
   seg = &(GST_BASE_SRC (src)->segment);
 
@@ -819,26 +1104,13 @@ again:
     return GST_DVD_READ_AGAIN;
   }
 
-  /* read NAV packet */
-  retries = 0;
-nav_retry:
-  retries++;
-
-  len = DVDReadBlocks (src->dvd_title, src->cur_pack, 1, oneblock);
-  if (len != 1)
-    goto read_error;
-
-  if (!gst_dvd_read_src_is_nav_pack (oneblock, src->cur_pack, &dsi_pack)) {
-    GST_LOG_OBJECT (src, "Skipping nav packet @ pack %d", src->cur_pack);
-    src->cur_pack++;
-
-    if (retries < 2000) {
-      goto nav_retry;
-    } else {
-      GST_LOG_OBJECT (src, "No nav packet @ pack %d after 2000 blocks",
-          src->cur_pack);
-      goto read_error;
-    }
+  /* the VOBU might have been read already */
+  if (!gst_dvd_read_src_readahead_take (src, src->cur_pack, &buf, &dsi_pack,
+          &src->cur_pack)) {
+    res = gst_dvd_read_src_read_vobu (src, src->dvd_title, &src->cur_pack,
+        &buf, &dsi_pack);
+    if (res != GST_DVD_READ_OK)
+      return res;
   }
 
   /* determine where we go next. These values are the ones we
@@ -859,25 +1131,11 @@ nav_retry:
     next_vobu = src->cur_pgc->cell_playback[src->cur_cell].last_sector + 1;
   }
 
-  g_assert (cur_output_size < 1024);
-
-  /* create the buffer (TODO: use buffer pool?) */
-  buf =
-      gst_buffer_new_allocate (NULL, cur_output_size * DVD_VIDEO_LB_LEN, NULL);
-
-  GST_LOG_OBJECT (src, "Going to read %u sectors @ pack %d", cur_output_size,
-      src->cur_pack);
+  /* fetch the next VOBU while this one is pushed */
+  if (src->readahead_pool &&
+      next_vobu < src->cur_pgc->cell_playback[src->cur_cell].last_sector)
+    gst_dvd_read_src_readahead_start (src, next_vobu);
 
-  gst_buffer_map (buf, &map, GST_MAP_WRITE);
-  /* read in and output cursize packs */
-  len =
-      DVDReadBlocks (src->dvd_title, src->cur_pack, cur_output_size, map.data);
-
-  if (len != cur_output_size)
-    goto block_read_error;
-
-  gst_buffer_unmap (buf, &map);
-  gst_buffer_resize (buf, 0, cur_output_size * DVD_VIDEO_LB_LEN);
   /* GST_BUFFER_OFFSET (buf) = priv->cur_pack * DVD_VIDEO_LB_LEN; */
   GST_BUFFER_TIMESTAMP (buf) =
       gst_dvd_read_src_get_time_for_sector (src, src->cur_pack);
@@ -893,6 +1151,8 @@ nav_retry:
       GST_CLOCK_TIME_IS_VALID (seg->stop) &&
       next_time > seg->stop + 5 * GST_SECOND) {
     GST_DEBUG_OBJECT (src, "end of TIME segment");
+    gst_buffer_unref (buf);
+    *p_buf = NULL;
     goto eos;
   }
 
@@ -904,19 +1164,6 @@ eos:
     GST_INFO_OBJECT (src, "Reached end-of-segment/stream - EOS");
     return GST_DVD_READ_EOS;
   }
-read_error:
-  {
-    GST_ERROR_OBJECT (src, "Read failed for block %d", src->cur_pack);
-    return GST_DVD_READ_ERROR;
-  }
-block_read_error:
-  {
-    GST_ERROR_OBJECT (src, "Read failed for %d blocks at %d",
-        cur_output_size, src->cur_pack);
-    gst_buffer_unmap (buf, &map);
-    gst_buffer_unref (buf);
-    return GST_DVD_READ_ERROR;
-  }
 }
 
 /* we don't cache the result on purpose */
@@ -968,6 +1215,15 @@ gst_dvd_read_src_create (GstPushSrc * pushsrc, GstBuffer ** p_buf)
     src->change_cell = TRUE;
   }
 
+  if (!src->toc_sent) {
+    GstToc *toc;
+
+    toc = gst_dvd_read_disc_get_toc (src->disc);
+    gst_pad_push_event (srcpad, gst_event_new_toc (toc, FALSE));
+    gst_toc_unref (toc);
+    src->toc_sent = TRUE;
+  }
+
   if (src->title_lang_event_pending) {
     gst_pad_push_event (srcpad, src->title_lang_event_pending);
     src->title_lang_event_pending = NULL;
@@ -1057,6 +1313,12 @@ gst_dvd_read_src_set_property (GObject * object, guint prop_id,
         src->angle = src->uri_angle - 1;
       }
       break;
+    case ARG_READAHEAD:
+      src->readahead = g_value_get_boolean (value);
+      break;
+    case ARG_SHARED_CACHE:
+      src->shared_cache = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1086,6 +1348,12 @@ gst_dvd_read_src_get_property (GObject * object, guint prop_id, GValue * value,
     case ARG_ANGLE:
       g_value_set_int (value, src->uri_angle);
       break;
+    case ARG_READAHEAD:
+      g_value_set_boolean (value, src->readahead);
+      break;
+    case ARG_SHARED_CACHE:
+      g_value_set_boolean (value, src->shared_cache);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1367,27 +1635,6 @@ gst_dvd_read_src_make_clut_change_event (GstDvdReadSrc * src,
   return gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM_STICKY, structure);
 }
 
-static gint64
-gst_dvd_read_src_convert_timecode (dvd_time_t * time)
-{
-  gint64 ret_time;
-  const gint64 one_hour = 3600 * GST_SECOND;
-  const gint64 one_min = 60 * GST_SECOND;
-
-  g_return_val_if_fail ((time->hour >> 4) < 0xa
-      && (time->hour & 0xf) < 0xa, -1);
-  g_return_val_if_fail ((time->minute >> 4) < 0x7
-      && (time->minute & 0xf) < 0xa, -1);
-  g_return_val_if_fail ((time->second >> 4) < 0x7
-      && (time->second & 0xf) < 0xa, -1);
-
-  ret_time = ((time->hour >> 4) * 10 + (time->hour & 0xf)) * one_hour;
-  ret_time += ((time->minute >> 4) * 10 + (time->minute & 0xf)) * one_min;
-  ret_time += ((time->second >> 4) * 10 + (time->second & 0xf)) * GST_SECOND;
-
-  return ret_time;
-}
-
 static gboolean
 gst_dvd_read_src_do_duration_query (GstDvdReadSrc * src, GstQuery * query)
 {
@@ -1400,7 +1647,7 @@ gst_dvd_read_src_do_duration_query (GstDvdReadSrc * src, GstQuery * query)
     case GST_FORMAT_TIME:{
       if (src->cur_pgc == NULL)
         return FALSE;
-      val = gst_dvd_read_src_convert_timecode (&src->cur_pgc->playback_time);
+      val = gst_dvd_read_convert_timecode (&src->cur_pgc->playback_time);
       if (val < 0)
         return FALSE;
       break;
@@ -1608,6 +1855,32 @@ gst_dvd_read_src_src_query (GstBaseSrc * basesrc, GstQuery * query)
       }
       GST_OBJECT_UNLOCK (src);
       break;
+    case GST_QUERY_TOC:{
+      GstDvdReadDisc *disc = NULL;
+      GstToc *toc = NULL;
+
+      /* stop () releases the disc, keep it alive while we use it */
+      GST_OBJECT_LOCK (src);
+      if (GST_OBJECT_FLAG_IS_SET (src, GST_BASE_SRC_FLAG_STARTED) &&
+          src->disc != NULL)
+        disc = gst_dvd_read_disc_ref (src->disc);
+      GST_OBJECT_UNLOCK (src);
+
+      if (disc != NULL) {
+        toc = gst_dvd_read_disc_get_toc (disc);
+        gst_dvd_read_disc_unref (disc);
+      }
+
+      if (toc != NULL) {
+        gst_query_set_toc (query, toc, NULL);
+        gst_toc_unref (toc);
+        res = TRUE;
+      } else {
+        GST_DEBUG_OBJECT (src, "query failed: no TOC");
+        res = FALSE;
+      }
+      break;
+    }
     default:
       res = GST_BASE_SRC_CLASS (parent_class)->query (basesrc, query);
       break;
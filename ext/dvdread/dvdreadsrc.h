@@ -31,6 +31,8 @@
 #include <dvdread/nav_read.h>
 #include <dvdread/nav_print.h>
 
+#include "dvdreaddisc.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_DVD_READ_SRC            (gst_dvd_read_src_get_type())
@@ -66,19 +68,27 @@ struct _GstDvdReadSrc {
   gint             cur_pack;
   gint             next_cell;
   dvd_reader_t    *dvd;
-  ifo_handle_t    *vmg_file;
+  ifo_handle_t    *vmg_file;       /* owned by the disc                     */
+
+  /* parsed IFO data, titles and TOC, possibly shared with other elements */
+  GstDvdReadDisc  *disc;
+  gboolean         shared_cache;
+  gboolean         toc_sent;
 
   /* title stuff */
   gint             ttn;
   tt_srpt_t       *tt_srpt;
-  ifo_handle_t    *vts_file;
+  ifo_handle_t    *vts_file;       /* owned by the disc                     */
   vts_ptt_srpt_t  *vts_ptt_srpt;
   vts_tmapt_t     *vts_tmapt;
   dvd_file_t      *dvd_title;
+  gint             title_set_nr;   /* title set dvd_title was opened for    */
   gint             num_chapters;
   gint             num_angles;
 
-  GstClockTime    *chapter_starts;  /* start time of chapters within title   */
+  GstClockTime    *chapter_starts;  /* start time of chapters within title,  */
+  GstDvdReadIndex *index;           /* sector <=> time mapping of the title; */
+                                    /* both owned by the disc                */
 
   /* which program chain to watch (based on title and chapter number) */
   pgc_t           *cur_pgc;
@@ -88,6 +98,21 @@ struct _GstDvdReadSrc {
   gboolean         need_newsegment;
   GstEvent        *title_lang_event_pending;
   GstEvent        *pending_clut_event;
+
+  /* buffers large enough for a whole VOBU */
+  GstBufferPool   *pool;
+
+  /* asynchronous read of the next VOBU, protected by readahead_lock */
+  gboolean         readahead;
+  GThreadPool     *readahead_pool;
+  GMutex           readahead_lock;
+  GCond            readahead_cond;
+  gboolean         readahead_busy;
+  gint             readahead_pack;    /* sector the read was started at   */
+  gint             readahead_nav;     /* sector the NAV pack was found at */
+  gint             readahead_result;
+  GstBuffer       *readahead_buf;
+  dsi_t            readahead_dsi;
 };
 
 struct _GstDvdReadSrcClass {
@@ -28,13 +28,18 @@
  * This plugin will first load the complete program into memory before starting
  * the emulator and producing output.
  *
- * Seeking is not (and cannot be) implemented.
+ * Seeking is implemented by running the emulator without output from the
+ * start of the tune, or from the current position when seeking forward, up
+ * to the requested time.
  *
  * <refsect2>
  * <title>Example pipelines</title>
  * |[
  * gst-launch-1.0 -v filesrc location=Hawkeye.sid ! siddec ! audioconvert ! audioresample ! autoaudiosink
  * ]| Decode a sid file and play it back.
+ * |[
+ * gst-launch-1.0 filesrc location=Hawkeye.sid ! siddec tune=2 song-length=180000000000 ! wavenc ! filesink location=Hawkeye-2.wav
+ * ]| Render the first 3 minutes of the second subtune as fast as possible.
  * </refsect2>
  */
 
@@ -54,6 +59,11 @@
 #define DEFAULT_MOS8580		FALSE
 #define DEFAULT_FORCE_SPEED	FALSE
 #define DEFAULT_BLOCKSIZE	4096
+#define DEFAULT_SONG_LENGTH	GST_CLOCK_TIME_NONE
+#define DEFAULT_DEFAULT_SONG_LENGTH	(5 * 60 * GST_SECOND)
+
+/* size of the scratch buffer that skipped audio is rendered into */
+#define SKIP_BUFFER_SIZE	(64 * 1024)
 
 enum
 {
@@ -66,7 +76,9 @@ enum
   PROP_MOS8580,
   PROP_FORCE_SPEED,
   PROP_BLOCKSIZE,
-  PROP_METADATA
+  PROP_METADATA,
+  PROP_SONG_LENGTH,
+  PROP_DEFAULT_SONG_LENGTH
 };
 
 static GstStaticPadTemplate sink_templ = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -125,6 +137,10 @@ gst_sid_memory_get_type (void)
 }
 
 static void gst_siddec_finalize (GObject * object);
+static GstStateChangeReturn gst_siddec_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean siddec_setup_pool (GstSidDec * siddec);
+static void siddec_release_pool (GstSidDec * siddec);
 
 static GstFlowReturn gst_siddec_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
@@ -159,6 +175,8 @@ gst_siddec_class_init (GstSidDecClass * klass)
   gobject_class->set_property = gst_siddec_set_property;
   gobject_class->get_property = gst_siddec_get_property;
 
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_siddec_change_state);
+
   g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_TUNE,
       g_param_spec_int ("tune", "tune", "tune",
           0, 100, DEFAULT_TUNE,
@@ -193,6 +211,29 @@ gst_siddec_class_init (GstSidDecClass * klass)
   g_object_class_install_property (gobject_class, PROP_METADATA,
       g_param_spec_boxed ("metadata", "Metadata", "Metadata", GST_TYPE_CAPS,
           (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  /**
+   * GstSidDec:song-length:
+   *
+   * Length of the tune. Tunes don't end by themselves, so the tune ends
+   * after this time and the length is reported as the duration. When not
+   * set, #GstSidDec:default-song-length is used.
+   */
+  g_object_class_install_property (gobject_class, PROP_SONG_LENGTH,
+      g_param_spec_uint64 ("song-length", "Song length",
+          "Length of the tune in nanoseconds (-1 = use default-song-length)",
+          0, G_MAXUINT64, DEFAULT_SONG_LENGTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  /**
+   * GstSidDec:default-song-length:
+   *
+   * Length assumed for tunes when #GstSidDec:song-length is not set. SID
+   * files don't store their length, so this is only an estimate.
+   */
+  g_object_class_install_property (gobject_class, PROP_DEFAULT_SONG_LENGTH,
+      g_param_spec_uint64 ("default-song-length", "Default song length",
+          "Length of tunes without a song-length in nanoseconds "
+          "(-1 = play forever)", 0, G_MAXUINT64, DEFAULT_DEFAULT_SONG_LENGTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   gst_element_class_set_static_metadata (gstelement_class, "Sid decoder",
       "Codec/Decoder/Audio", "Use libsidplay to decode SID audio tunes",
@@ -238,6 +279,9 @@ gst_siddec_init (GstSidDec * siddec)
   siddec->tune_number = 0;
   siddec->total_bytes = 0;
   siddec->blocksize = DEFAULT_BLOCKSIZE;
+  siddec->song_length = DEFAULT_SONG_LENGTH;
+  siddec->default_song_length = DEFAULT_DEFAULT_SONG_LENGTH;
+  gst_segment_init (&siddec->segment, GST_FORMAT_UNDEFINED);
 
   siddec->have_group_id = FALSE;
   siddec->group_id = G_MAXUINT;
@@ -251,12 +295,36 @@ gst_siddec_finalize (GObject * object)
   g_free (siddec->config);
   g_free (siddec->tune_buffer);
 
+  siddec_release_pool (siddec);
+
   delete (siddec->tune);
   delete (siddec->engine);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static GstStateChangeReturn
+gst_siddec_change_state (GstElement * element, GstStateChange transition)
+{
+  GstSidDec *siddec = GST_SIDDEC (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* the pads are flushing now, make sure the task is gone before the
+       * pool it acquires from */
+      gst_pad_stop_task (siddec->srcpad);
+      siddec_release_pool (siddec);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
 static void
 update_tags (GstSidDec * siddec)
 {
@@ -394,16 +462,43 @@ play_loop (GstPad * pad)
   GstSidDec *siddec;
   GstBuffer *out;
   GstMapInfo outmap;
+  gsize size;
   gint64 value, offset, time = 0;
+  GstClockTime stop;
   GstFormat format;
 
   siddec = GST_SIDDEC (gst_pad_get_parent (pad));
 
-  out = gst_buffer_new_and_alloc (siddec->blocksize);
+  /* check for the end of the configured segment or the song */
+  stop = siddec->segment.stop;
+  if (!GST_CLOCK_TIME_IS_VALID (stop))
+    stop = siddec->segment.duration;
+  format = GST_FORMAT_TIME;
+  if (GST_CLOCK_TIME_IS_VALID (stop) &&
+      gst_siddec_src_convert (siddec->srcpad,
+          GST_FORMAT_BYTES, siddec->total_bytes, &format, &time) &&
+      (guint64) time >= stop) {
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  /* blocksize may have changed since the pool was set up */
+  if (G_UNLIKELY (siddec->blocksize != siddec->pool_blocksize) &&
+      !siddec_setup_pool (siddec)) {
+    GST_ELEMENT_ERROR (siddec, RESOURCE, SETTINGS,
+        ("Could not set up buffer pool"), ("Could not set up buffer pool"));
+    ret = GST_FLOW_ERROR;
+    goto pause;
+  }
 
+  ret = gst_buffer_pool_acquire_buffer (siddec->pool, &out, NULL);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  /* always go by the size of the buffer we got, never the property */
   gst_buffer_map (out, &outmap, GST_MAP_WRITE);
-  sidEmuFillBuffer (*siddec->engine, *siddec->tune,
-      outmap.data, siddec->blocksize);
+  size = outmap.size;
+  sidEmuFillBuffer (*siddec->engine, *siddec->tune, outmap.data, size);
   gst_buffer_unmap (out, &outmap);
 
   /* get offset in samples */
@@ -419,7 +514,7 @@ play_loop (GstPad * pad)
     GST_BUFFER_TIMESTAMP (out) = time;
 
   /* update position and get new timestamp to calculate duration */
-  siddec->total_bytes += siddec->blocksize;
+  siddec->total_bytes += size;
 
   /* get offset in samples */
   format = GST_FORMAT_DEFAULT;
@@ -432,6 +527,12 @@ play_loop (GstPad * pad)
         GST_FORMAT_BYTES, siddec->total_bytes, &format, &value))
     GST_BUFFER_DURATION (out) = value - time;
 
+  siddec->segment.position = time;
+  if (siddec->discont) {
+    GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_DISCONT);
+    siddec->discont = FALSE;
+  }
+
   if ((ret = gst_pad_push (siddec->srcpad, out)) != GST_FLOW_OK)
     goto pause;
 
@@ -444,8 +545,15 @@ done:
 pause:
   {
     if (ret == GST_FLOW_EOS) {
-      /* perform EOS logic, FIXME, segment seek? */
-      gst_pad_push_event (pad, gst_event_new_eos ());
+      if (siddec->segment.flags & GST_SEGMENT_FLAG_SEGMENT) {
+        gst_element_post_message (GST_ELEMENT (siddec),
+            gst_message_new_segment_done (GST_OBJECT (siddec),
+                GST_FORMAT_TIME, stop));
+        gst_pad_push_event (pad,
+            gst_event_new_segment_done (GST_FORMAT_TIME, stop));
+      } else {
+        gst_pad_push_event (pad, gst_event_new_eos ());
+      }
     } else if (ret < GST_FLOW_EOS || ret == GST_FLOW_NOT_LINKED) {
       /* for fatal errors we post an error message */
       GST_ELEMENT_FLOW_ERROR (siddec, ret);
@@ -458,11 +566,54 @@ pause:
   }
 }
 
+static void
+siddec_release_pool (GstSidDec * siddec)
+{
+  if (siddec->pool) {
+    gst_buffer_pool_set_active (siddec->pool, FALSE);
+    gst_object_unref (siddec->pool);
+    siddec->pool = NULL;
+  }
+  siddec->pool_blocksize = 0;
+}
+
+/* output buffers are recycled through a pool of blocksize buffers */
+static gboolean
+siddec_setup_pool (GstSidDec * siddec)
+{
+  GstStructure *config;
+  GstCaps *caps;
+
+  siddec_release_pool (siddec);
+
+  siddec->pool = gst_buffer_pool_new ();
+  siddec->pool_blocksize = siddec->blocksize;
+  caps = gst_pad_get_current_caps (siddec->srcpad);
+  config = gst_buffer_pool_get_config (siddec->pool);
+  gst_buffer_pool_config_set_params (config, caps, siddec->pool_blocksize, 0,
+      0);
+  if (caps)
+    gst_caps_unref (caps);
+
+  if (!gst_buffer_pool_set_config (siddec->pool, config))
+    return FALSE;
+
+  return gst_buffer_pool_set_active (siddec->pool, TRUE);
+}
+
+/* the configured length of the tune, or the estimate */
+static GstClockTime
+gst_siddec_get_song_length (GstSidDec * siddec)
+{
+  if (GST_CLOCK_TIME_IS_VALID (siddec->song_length))
+    return siddec->song_length;
+  return siddec->default_song_length;
+}
+
 static gboolean
 start_play_tune (GstSidDec * siddec)
 {
   gboolean res;
-  GstSegment segment;
 
   if (!siddec->tune->load (siddec->tune_buffer, siddec->tune_len))
     goto could_not_load;
@@ -472,13 +623,19 @@ start_play_tune (GstSidDec * siddec)
   if (!siddec_negotiate (siddec))
     goto could_not_negotiate;
 
+  if (!siddec_setup_pool (siddec))
+    goto no_pool;
+
   if (!sidEmuInitializeSong (*siddec->engine, *siddec->tune,
           siddec->tune_number))
     goto could_not_init;
 
-  gst_segment_init (&segment, GST_FORMAT_TIME);
-  gst_pad_push_event (siddec->srcpad, gst_event_new_segment (&segment));
+  gst_segment_init (&siddec->segment, GST_FORMAT_TIME);
+  siddec->segment.duration = gst_siddec_get_song_length (siddec);
+  gst_pad_push_event (siddec->srcpad,
+      gst_event_new_segment (&siddec->segment));
   siddec->total_bytes = 0;
+  siddec->discont = TRUE;
   siddec->have_group_id = FALSE;
   siddec->group_id = G_MAXUINT;
 
@@ -499,6 +656,12 @@ could_not_negotiate:
         ("Could not negotiate format"), ("Could not negotiate format"));
     return FALSE;
   }
+no_pool:
+  {
+    GST_ELEMENT_ERROR (siddec, RESOURCE, SETTINGS,
+        ("Could not set up buffer pool"), ("Could not set up buffer pool"));
+    return FALSE;
+  }
 could_not_init:
   {
     GST_ELEMENT_ERROR (siddec, LIBRARY, INIT,
@@ -638,12 +801,165 @@ gst_siddec_src_convert (GstPad * pad, GstFormat src_format, gint64 src_value,
   return res;
 }
 
+/* run the emulator without output until @target bytes were produced. The
+ * emulator state can't be saved, so going backwards restarts the song. Must
+ * be called with the stream lock. */
+static gboolean
+gst_siddec_skip_to (GstSidDec * siddec, guint64 target)
+{
+  guint8 *scratch;
+  guint64 len;
+
+  if (target < siddec->total_bytes) {
+    GST_DEBUG_OBJECT (siddec, "restarting song");
+    if (!sidEmuInitializeSong (*siddec->engine, *siddec->tune,
+            siddec->tune_number))
+      return FALSE;
+    siddec->total_bytes = 0;
+  }
+
+  GST_DEBUG_OBJECT (siddec, "skipping %" G_GUINT64_FORMAT " bytes",
+      target - siddec->total_bytes);
+
+  scratch = (guint8 *) g_malloc (SKIP_BUFFER_SIZE);
+  while (siddec->total_bytes < target) {
+    len = MIN (target - siddec->total_bytes, SKIP_BUFFER_SIZE);
+    sidEmuFillBuffer (*siddec->engine, *siddec->tune, scratch, len);
+    siddec->total_bytes += len;
+  }
+  g_free (scratch);
+
+  return TRUE;
+}
+
+static gboolean
+gst_siddec_handle_seek (GstSidDec * siddec, GstEvent * event)
+{
+  GstFormat format;
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  gdouble rate;
+  gint64 start, stop, sample;
+  gboolean flush, res;
+  guint64 target;
+
+  /* we can only seek once the tune is playing */
+  if (siddec->segment.format != GST_FORMAT_TIME)
+    goto not_playing;
+
+  gst_event_parse_seek (event, &rate, &format, &flags,
+      &start_type, &start, &stop_type, &stop);
+
+  if (rate <= 0.0)
+    goto cannot_do_backwards_playback;
+
+  /* convert to TIME, our segment format */
+  if (format != GST_FORMAT_TIME) {
+    GstFormat time_format = GST_FORMAT_TIME;
+
+    if (start_type != GST_SEEK_TYPE_NONE && start != -1 &&
+        !gst_siddec_src_convert (siddec->srcpad, format, start,
+            &time_format, &start))
+      goto convert_failed;
+    time_format = GST_FORMAT_TIME;
+    if (stop_type != GST_SEEK_TYPE_NONE && stop != -1 &&
+        !gst_siddec_src_convert (siddec->srcpad, format, stop,
+            &time_format, &stop))
+      goto convert_failed;
+  }
+
+  flush = ((flags & GST_SEEK_FLAG_FLUSH) != 0);
+
+  GST_DEBUG_OBJECT (siddec, "flush=%d, rate=%g", flush, rate);
+
+  /* unlock streaming thread and make streaming stop */
+  if (flush)
+    gst_pad_push_event (siddec->srcpad, gst_event_new_flush_start ());
+  else
+    gst_pad_pause_task (siddec->srcpad);
+
+  GST_PAD_STREAM_LOCK (siddec->srcpad);
+
+  gst_segment_do_seek (&siddec->segment, rate, GST_FORMAT_TIME, flags,
+      start_type, start, stop_type, stop, NULL);
+
+  GST_DEBUG_OBJECT (siddec, "segment: %" GST_SEGMENT_FORMAT,
+      &siddec->segment);
+
+  /* start at a sample boundary */
+  format = GST_FORMAT_DEFAULT;
+  res = gst_siddec_src_convert (siddec->srcpad, GST_FORMAT_TIME,
+      siddec->segment.start, &format, &sample);
+  format = GST_FORMAT_BYTES;
+  res = res && gst_siddec_src_convert (siddec->srcpad, GST_FORMAT_DEFAULT,
+      sample, &format, (gint64 *) & target);
+  res = res && gst_siddec_skip_to (siddec, target);
+
+  if (flush)
+    gst_pad_push_event (siddec->srcpad, gst_event_new_flush_stop (TRUE));
+
+  if (res) {
+    format = GST_FORMAT_TIME;
+    gst_siddec_src_convert (siddec->srcpad, GST_FORMAT_BYTES,
+        siddec->total_bytes, &format, &start);
+    siddec->segment.start = siddec->segment.time = start;
+    siddec->segment.position = start;
+    siddec->discont = TRUE;
+
+    /* notify start of new segment */
+    if (siddec->segment.flags & GST_SEGMENT_FLAG_SEGMENT) {
+      gst_element_post_message (GST_ELEMENT (siddec),
+          gst_message_new_segment_start (GST_OBJECT (siddec),
+              GST_FORMAT_TIME, siddec->segment.position));
+    }
+    gst_pad_push_event (siddec->srcpad,
+        gst_event_new_segment (&siddec->segment));
+
+    /* restart our task since it might have been stopped when we did the
+     * flush */
+    gst_pad_start_task (siddec->srcpad,
+        (GstTaskFunction) play_loop, siddec->srcpad, NULL);
+  } else {
+    GST_ELEMENT_ERROR (siddec, LIBRARY, INIT,
+        ("Could not initialize song"), ("Could not restart song for seek"));
+  }
+
+  /* streaming can continue now */
+  GST_PAD_STREAM_UNLOCK (siddec->srcpad);
+
+  return res;
+
+  /* ERRORS */
+not_playing:
+  {
+    GST_DEBUG_OBJECT (siddec, "seek failed: tune is not playing yet");
+    return FALSE;
+  }
+cannot_do_backwards_playback:
+  {
+    GST_DEBUG_OBJECT (siddec, "can only seek with positive rate, not %lf",
+        rate);
+    return FALSE;
+  }
+convert_failed:
+  {
+    GST_DEBUG_OBJECT (siddec, "seek failed: could not convert to time");
+    return FALSE;
+  }
+}
+
 static gboolean
 gst_siddec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
+  GstSidDec *siddec;
   gboolean res = FALSE;
 
+  siddec = GST_SIDDEC (parent);
+
   switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEEK:
+      res = gst_siddec_handle_seek (siddec, event);
+      break;
     default:
       break;
   }
@@ -676,6 +992,40 @@ gst_siddec_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
       }
       break;
     }
+    case GST_QUERY_DURATION:
+    {
+      GstFormat format;
+      GstClockTime length;
+      gint64 duration;
+
+      gst_query_parse_duration (query, &format, NULL);
+
+      /* unknown only when playing forever */
+      length = gst_siddec_get_song_length (siddec);
+      res = GST_CLOCK_TIME_IS_VALID (length) && siddec->config->frequency != 0;
+      res = res && gst_siddec_src_convert (pad,
+          GST_FORMAT_TIME, length, &format, &duration);
+      if (res) {
+        gst_query_set_duration (query, format, duration);
+      }
+      break;
+    }
+    case GST_QUERY_SEEKING:
+    {
+      GstFormat format;
+      GstClockTime length;
+      gint64 duration = -1;
+      GstFormat time_format = GST_FORMAT_TIME;
+
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      length = gst_siddec_get_song_length (siddec);
+      if (GST_CLOCK_TIME_IS_VALID (length))
+        gst_siddec_src_convert (pad, time_format, length, &format, &duration);
+      gst_query_set_seeking (query, format,
+          format == GST_FORMAT_TIME || format == GST_FORMAT_DEFAULT ||
+          format == GST_FORMAT_BYTES, 0, duration);
+      break;
+    }
     default:
       res = gst_pad_query_default (pad, parent, query);
       break;
@@ -712,6 +1062,12 @@ gst_siddec_set_property (GObject * object, guint prop_id, const GValue * value,
     case PROP_BLOCKSIZE:
       siddec->blocksize = g_value_get_uint (value);
       break;
+    case PROP_SONG_LENGTH:
+      siddec->song_length = g_value_get_uint64 (value);
+      break;
+    case PROP_DEFAULT_SONG_LENGTH:
+      siddec->default_song_length = g_value_get_uint64 (value);
+      break;
     case PROP_FORCE_SPEED:
       siddec->config->forceSongSpeed = g_value_get_boolean (value);
       break;
@@ -722,6 +1078,33 @@ gst_siddec_set_property (GObject * object, guint prop_id, const GValue * value,
   siddec->engine->setConfig (*siddec->config);
 }
 
+/* describes the loaded tune, so that applications can find out about the
+ * subtunes and render each of them */
+static GstCaps *
+siddec_get_metadata (GstSidDec * siddec)
+{
+  sidTuneInfo info;
+  GstCaps *caps;
+
+  if (siddec->tune_len == 0 || !siddec->tune->getInfo (info) ||
+      info.songs == 0)
+    return NULL;
+
+  caps = gst_caps_new_simple ("audio/x-sid",
+      "songs", G_TYPE_INT, (gint) info.songs,
+      "start-song", G_TYPE_INT, (gint) info.startSong, NULL);
+  if (info.nameString)
+    gst_caps_set_simple (caps, "title", G_TYPE_STRING, info.nameString, NULL);
+  if (info.authorString)
+    gst_caps_set_simple (caps, "artist", G_TYPE_STRING, info.authorString,
+        NULL);
+  if (info.copyrightString)
+    gst_caps_set_simple (caps, "copyright", G_TYPE_STRING,
+        info.copyrightString, NULL);
+
+  return caps;
+}
+
 static void
 gst_siddec_get_property (GObject * object, guint prop_id, GValue * value,
     GParamSpec * pspec)
@@ -754,7 +1137,13 @@ gst_siddec_get_property (GObject * object, guint prop_id, GValue * value,
       g_value_set_uint (value, siddec->blocksize);
       break;
     case PROP_METADATA:
-      g_value_set_boxed (value, NULL);
+      g_value_take_boxed (value, siddec_get_metadata (siddec));
+      break;
+    case PROP_SONG_LENGTH:
+      g_value_set_uint64 (value, siddec->song_length);
+      break;
+    case PROP_DEFAULT_SONG_LENGTH:
+      g_value_set_uint64 (value, siddec->default_song_length);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
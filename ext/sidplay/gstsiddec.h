@@ -56,12 +56,18 @@ struct _GstSidDec {
   gint           tune_len;
   gint           tune_number;
   guint64        total_bytes;
+  GstSegment     segment;
+  gboolean       discont;
 
   emuEngine     *engine;
   sidTune       *tune;
   emuConfig     *config;
 
   guint         blocksize;
+  GstClockTime  song_length;
+  GstClockTime  default_song_length;
+  GstBufferPool *pool;
+  guint         pool_blocksize;  /* size of the buffers in the pool */
 };
 
 struct _GstSidDecClass {
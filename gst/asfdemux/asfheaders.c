@@ -76,6 +76,18 @@ const ASFGuidHash asf_ext_stream_guids[] = {
       }
 };
 
+const ASFGuidHash asf_mutex_guids[] = {
+  {ASF_MUTEX_LANGUAGE, "ASF_MUTEX_LANGUAGE",
+        {0xD6E22A00, 0x11D135DA, 0xA0003490, 0xBE4903C9}
+      },
+  {ASF_MUTEX_BITRATE, "ASF_MUTEX_BITRATE",
+        {0xD6E22A01, 0x11D135DA, 0xA0003490, 0xBE4903C9}
+      },
+  {ASF_MUTEX_UNDEFINED, "ASF_MUTEX_UNDEFINED",
+        {0, 0, 0, 0}
+      }
+};
+
 const ASFGuidHash asf_object_guids[] = {
   {ASF_OBJ_STREAM, "ASF_OBJ_STREAM",
         {0xB7DC0791, 0x11CFA9B7, 0xC000E68E, 0x6553200C}
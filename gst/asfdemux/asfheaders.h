@@ -84,6 +84,12 @@ typedef enum {
   ASF_EXT_STREAM_AUDIO
 } AsfExtStreamType;
 
+typedef enum {
+  ASF_MUTEX_UNDEFINED = 0,
+  ASF_MUTEX_LANGUAGE,
+  ASF_MUTEX_BITRATE
+} AsfMutexType;
+
 typedef enum {
   ASF_CORRECTION_UNDEFINED = 0,
   ASF_CORRECTION_ON,
@@ -106,6 +112,8 @@ extern const ASFGuidHash asf_stream_guids[];
 
 extern const ASFGuidHash asf_ext_stream_guids[];
 
+extern const ASFGuidHash asf_mutex_guids[];
+
 extern const ASFGuidHash asf_object_guids[];
 
 /* GUID utilities */
@@ -0,0 +1,420 @@
+/* GStreamer ASF/WMV/WMA demuxer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Output queues let the streaming thread parse ahead while every source
+ * pad pushes downstream from a task of its own, so that a slow branch does
+ * not hold up the others. Like in multiqueue, each queue is bounded in time
+ * and bytes, which are hard limits, and in buffers, which is not: a queue
+ * full on buffers only takes one more buffer whenever another selected
+ * stream has run dry, so that branches do not wait for each other (e.g.
+ * sinks prerolling on streams interleaved further apart than the buffer
+ * limit). Streams interleaved further apart than the time and byte limits
+ * need bigger limits. All queues of a demuxer share its output lock. */
+
+#include "asfoutput.h"
+
+/* initial buffer limit of a queue, raised while other streams starve */
+#define OUTPUT_MIN_BUFFERS 5
+
+struct _AsfOutputQueue
+{
+  GstASFDemux  *demux;
+  GstPad       *pad;
+
+  GQueue        items;        /* buffers and serialized events            */
+  GCond         item_added;   /* the task waits on this for items         */
+  gboolean      busy;         /* the task is pushing an item downstream   */
+  guint         num_buffers;
+  guint64       bytes;
+  GstClockTime  in_ts;        /* timestamp of the last buffer queued      */
+  GstClockTime  out_ts;       /* timestamp of the oldest buffer queued    */
+
+  /* result of the last push downstream; FLUSHING while flushing or the pad
+   * is inactive, the task is paused whenever this is not OK */
+  GstFlowReturn srcresult;
+
+  GstClockTime  max_time;     /* 0 = unlimited */
+  guint         max_bytes;    /* 0 = unlimited */
+  guint         max_buffers;  /* grows while other streams starve       */
+};
+
+#define OUTPUT_LOCK(q)   (g_mutex_lock (&(q)->demux->output_lock))
+#define OUTPUT_UNLOCK(q) (g_mutex_unlock (&(q)->demux->output_lock))
+
+/* the streaming thread waits on the demuxer's output_space for a queue to
+ * drain; all queues share it, so broadcast */
+#define OUTPUT_WAIT_SPACE(q) \
+  (g_cond_wait (&(q)->demux->output_space, &(q)->demux->output_lock))
+#define OUTPUT_SIGNAL_SPACE(q) (g_cond_broadcast (&(q)->demux->output_space))
+
+static void asf_output_queue_loop (AsfOutputQueue * queue);
+
+/* call with the output lock */
+static void
+asf_output_queue_clear (AsfOutputQueue * queue)
+{
+  GstMiniObject *item;
+
+  while ((item = g_queue_pop_head (&queue->items)))
+    gst_mini_object_unref (item);
+  queue->num_buffers = 0;
+  queue->bytes = 0;
+  queue->in_ts = GST_CLOCK_TIME_NONE;
+  queue->out_ts = GST_CLOCK_TIME_NONE;
+}
+
+/* call with the output lock */
+static GstClockTime
+asf_output_queue_time_level (AsfOutputQueue * queue)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (queue->in_ts)
+      || !GST_CLOCK_TIME_IS_VALID (queue->out_ts))
+    return 0;
+
+  /* timestamps go down between GOPs in reverse playback */
+  if (queue->in_ts >= queue->out_ts)
+    return queue->in_ts - queue->out_ts;
+  return queue->out_ts - queue->in_ts;
+}
+
+/* call with the output lock; the time and byte limits are never raised */
+static gboolean
+asf_output_queue_is_over_limits (AsfOutputQueue * queue)
+{
+  if (queue->num_buffers == 0)
+    return FALSE;
+  if (queue->max_bytes > 0 && queue->bytes >= queue->max_bytes)
+    return TRUE;
+  if (queue->max_time > 0
+      && asf_output_queue_time_level (queue) >= queue->max_time)
+    return TRUE;
+  return FALSE;
+}
+
+/* call with the output lock */
+static gboolean
+asf_output_queue_is_full (AsfOutputQueue * queue)
+{
+  return queue->num_buffers >= queue->max_buffers
+      || asf_output_queue_is_over_limits (queue);
+}
+
+/* call with the output lock, from the streaming thread */
+static gboolean
+asf_output_queue_others_starving (AsfOutputQueue * queue)
+{
+  GstASFDemux *demux = queue->demux;
+  guint i;
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+    AsfOutputQueue *other;
+
+    if (!stream->active || !stream->selected)
+      continue;
+
+    other = gst_asf_demux_output_get (stream->pad);
+    if (other && other != queue && other->srcresult == GST_FLOW_OK
+        && other->num_buffers == 0 && !other->busy)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* call with the output lock */
+static void
+asf_output_queue_start (AsfOutputQueue * queue)
+{
+  GST_DEBUG_OBJECT (queue->pad, "starting output task");
+  queue->srcresult = GST_FLOW_OK;
+  gst_pad_start_task (queue->pad, (GstTaskFunction) asf_output_queue_loop,
+      queue, NULL);
+}
+
+static void
+asf_output_queue_flush (AsfOutputQueue * queue)
+{
+  OUTPUT_LOCK (queue);
+  GST_DEBUG_OBJECT (queue->pad, "flushing output queue");
+  queue->srcresult = GST_FLOW_FLUSHING;
+  asf_output_queue_clear (queue);
+  /* unblocks the task and the streaming thread */
+  g_cond_signal (&queue->item_added);
+  OUTPUT_SIGNAL_SPACE (queue);
+  OUTPUT_UNLOCK (queue);
+}
+
+static gboolean
+asf_output_queue_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  AsfOutputQueue *queue = gst_asf_demux_output_get (pad);
+  gboolean res;
+
+  if (mode != GST_PAD_MODE_PUSH)
+    return FALSE;
+
+  if (active) {
+    OUTPUT_LOCK (queue);
+    asf_output_queue_clear (queue);
+    asf_output_queue_start (queue);
+    OUTPUT_UNLOCK (queue);
+    res = TRUE;
+  } else {
+    asf_output_queue_flush (queue);
+    /* NOTE this will hardlock if called from the output task */
+    res = gst_pad_stop_task (pad);
+  }
+  return res;
+}
+
+static void
+asf_output_queue_loop (AsfOutputQueue * queue)
+{
+  GstMiniObject *item;
+  GstFlowReturn ret;
+  GQueue events = G_QUEUE_INIT;
+
+  OUTPUT_LOCK (queue);
+  while (queue->srcresult == GST_FLOW_OK && g_queue_is_empty (&queue->items))
+    g_cond_wait (&queue->item_added, &queue->demux->output_lock);
+  if (queue->srcresult != GST_FLOW_OK)
+    goto paused;
+
+  item = g_queue_pop_head (&queue->items);
+  if (GST_IS_BUFFER (item)) {
+    GstClockTime ts = GST_BUFFER_DTS_OR_PTS (item);
+
+    queue->bytes -= gst_buffer_get_size (GST_BUFFER_CAST (item));
+    if (--queue->num_buffers == 0) {
+      queue->in_ts = GST_CLOCK_TIME_NONE;
+      queue->out_ts = GST_CLOCK_TIME_NONE;
+    } else if (GST_CLOCK_TIME_IS_VALID (ts)) {
+      queue->out_ts = ts;
+    }
+  }
+  queue->busy = TRUE;
+  OUTPUT_UNLOCK (queue);
+
+  if (GST_IS_BUFFER (item)) {
+    ret = gst_pad_push (queue->pad, GST_BUFFER_CAST (item));
+  } else {
+    gst_pad_push_event (queue->pad, GST_EVENT_CAST (item));
+    ret = GST_FLOW_OK;
+  }
+
+  OUTPUT_LOCK (queue);
+  queue->busy = FALSE;
+  OUTPUT_SIGNAL_SPACE (queue);
+  if (G_UNLIKELY (ret != GST_FLOW_OK))
+    goto pause;
+  OUTPUT_UNLOCK (queue);
+  return;
+
+paused:
+  {
+    GST_DEBUG_OBJECT (queue->pad, "pausing output task, %s",
+        gst_flow_get_name (queue->srcresult));
+    gst_pad_pause_task (queue->pad);
+    OUTPUT_UNLOCK (queue);
+    return;
+  }
+pause:
+  {
+    GST_DEBUG_OBJECT (queue->pad, "pausing output task, reason %s",
+        gst_flow_get_name (ret));
+
+    /* a flush that came in meanwhile wins; otherwise the result is returned
+     * for the next buffer, which the demuxer combines like a direct push.
+     * Queued buffers are dropped, but sticky events still go to the pad */
+    if (queue->srcresult == GST_FLOW_OK)
+      queue->srcresult = ret;
+    while ((item = g_queue_pop_head (&queue->items))) {
+      if (GST_IS_EVENT (item))
+        g_queue_push_tail (&events, item);
+      else
+        gst_mini_object_unref (item);
+    }
+    asf_output_queue_clear (queue);
+    OUTPUT_SIGNAL_SPACE (queue);
+    gst_pad_pause_task (queue->pad);
+    OUTPUT_UNLOCK (queue);
+
+    while ((item = g_queue_pop_head (&events)))
+      gst_pad_push_event (queue->pad, GST_EVENT_CAST (item));
+    return;
+  }
+}
+
+AsfOutputQueue *
+gst_asf_demux_output_new (GstASFDemux * demux, GstPad * pad,
+    GstClockTime max_time, guint max_bytes)
+{
+  AsfOutputQueue *queue;
+
+  queue = g_new0 (AsfOutputQueue, 1);
+  queue->demux = demux;
+  queue->pad = pad;
+  g_queue_init (&queue->items);
+  g_cond_init (&queue->item_added);
+  queue->in_ts = GST_CLOCK_TIME_NONE;
+  queue->out_ts = GST_CLOCK_TIME_NONE;
+  queue->srcresult = GST_FLOW_FLUSHING;
+  queue->max_time = max_time;
+  queue->max_bytes = max_bytes;
+  queue->max_buffers = OUTPUT_MIN_BUFFERS;
+
+  gst_pad_set_element_private (pad, queue);
+  gst_pad_set_activatemode_function (pad, asf_output_queue_activate_mode);
+
+  GST_DEBUG_OBJECT (pad, "output queue of at most %" GST_TIME_FORMAT
+      " and %u bytes", GST_TIME_ARGS (max_time), max_bytes);
+
+  return queue;
+}
+
+/* deactivates the pad, which stops the task */
+void
+gst_asf_demux_output_free (AsfOutputQueue * queue)
+{
+  gst_pad_set_active (queue->pad, FALSE);
+  gst_pad_set_activatemode_function (queue->pad, NULL);
+  gst_pad_set_element_private (queue->pad, NULL);
+
+  asf_output_queue_clear (queue);
+  g_cond_clear (&queue->item_added);
+  g_free (queue);
+}
+
+/* takes ownership of @buf; blocks while the queue is full */
+GstFlowReturn
+gst_asf_demux_output_push (AsfOutputQueue * queue, GstBuffer * buf)
+{
+  GstClockTime ts;
+  GstFlowReturn ret;
+
+  OUTPUT_LOCK (queue);
+  /* the stream stops getting buffers when unlinked, the first one after it
+   * got linked again restarts the task */
+  if (G_UNLIKELY (queue->srcresult == GST_FLOW_NOT_LINKED
+          && gst_pad_is_linked (queue->pad)))
+    asf_output_queue_start (queue);
+
+  while (queue->srcresult == GST_FLOW_OK && asf_output_queue_is_full (queue)) {
+    if (!asf_output_queue_is_over_limits (queue)
+        && asf_output_queue_others_starving (queue)) {
+      queue->max_buffers++;
+      GST_DEBUG_OBJECT (queue->pad, "another stream is starving, raising "
+          "buffer limit to %u", queue->max_buffers);
+      continue;
+    }
+    GST_LOG_OBJECT (queue->pad, "output queue full, %u buffers, %"
+        G_GUINT64_FORMAT " bytes, %" GST_TIME_FORMAT, queue->num_buffers,
+        queue->bytes, GST_TIME_ARGS (asf_output_queue_time_level (queue)));
+    OUTPUT_WAIT_SPACE (queue);
+  }
+
+  ret = queue->srcresult;
+  if (G_UNLIKELY (ret != GST_FLOW_OK))
+    goto out_flow;
+
+  ts = GST_BUFFER_DTS_OR_PTS (buf);
+  if (GST_CLOCK_TIME_IS_VALID (ts)) {
+    if (!GST_CLOCK_TIME_IS_VALID (queue->out_ts))
+      queue->out_ts = ts;
+    queue->in_ts = ts;
+  }
+  queue->bytes += gst_buffer_get_size (buf);
+  queue->num_buffers++;
+  g_queue_push_tail (&queue->items, buf);
+  g_cond_signal (&queue->item_added);
+  OUTPUT_UNLOCK (queue);
+
+  return GST_FLOW_OK;
+
+out_flow:
+  {
+    OUTPUT_UNLOCK (queue);
+    GST_LOG_OBJECT (queue->pad, "dropping buffer, %s",
+        gst_flow_get_name (ret));
+    gst_buffer_unref (buf);
+    return ret;
+  }
+}
+
+/* takes ownership of @event; flushes and non-serialized events are pushed
+ * right away */
+gboolean
+gst_asf_demux_output_push_event (AsfOutputQueue * queue, GstEvent * event)
+{
+  gboolean res;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      asf_output_queue_flush (queue);
+      res = gst_pad_push_event (queue->pad, event);
+      gst_pad_pause_task (queue->pad);
+      return res;
+    case GST_EVENT_FLUSH_STOP:
+      res = gst_pad_push_event (queue->pad, event);
+      OUTPUT_LOCK (queue);
+      if (gst_pad_is_active (queue->pad)) {
+        asf_output_queue_clear (queue);
+        asf_output_queue_start (queue);
+      }
+      OUTPUT_UNLOCK (queue);
+      return res;
+    default:
+      break;
+  }
+
+  if (!GST_EVENT_IS_SERIALIZED (event))
+    return gst_pad_push_event (queue->pad, event);
+
+  OUTPUT_LOCK (queue);
+  /* a new segment after EOS, e.g. for a reselected stream */
+  if (G_UNLIKELY (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT
+          && queue->srcresult == GST_FLOW_EOS))
+    asf_output_queue_start (queue);
+  if (G_UNLIKELY (queue->srcresult == GST_FLOW_NOT_LINKED
+          && gst_pad_is_linked (queue->pad)))
+    asf_output_queue_start (queue);
+
+  if (G_UNLIKELY (queue->srcresult != GST_FLOW_OK)) {
+    OUTPUT_UNLOCK (queue);
+    /* the task is paused, so this cannot overtake anything */
+    return gst_pad_push_event (queue->pad, event);
+  }
+
+  g_queue_push_tail (&queue->items, event);
+  g_cond_signal (&queue->item_added);
+  OUTPUT_UNLOCK (queue);
+
+  return TRUE;
+}
+
+/* waits for everything queued so far to be pushed downstream */
+void
+gst_asf_demux_output_drain (AsfOutputQueue * queue)
+{
+  OUTPUT_LOCK (queue);
+  while (queue->srcresult == GST_FLOW_OK
+      && (!g_queue_is_empty (&queue->items) || queue->busy))
+    OUTPUT_WAIT_SPACE (queue);
+  OUTPUT_UNLOCK (queue);
+}
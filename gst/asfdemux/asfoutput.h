@@ -0,0 +1,46 @@
+/* GStreamer ASF/WMV/WMA demuxer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __ASF_OUTPUT_H__
+#define __ASF_OUTPUT_H__
+
+#include <gst/gst.h>
+
+#include "gstasfdemux.h"
+
+G_BEGIN_DECLS
+
+/* output queue of a source pad, pushed from a task of its own; the queue
+ * is the element private data of the pad, so it follows the pad around */
+AsfOutputQueue * gst_asf_demux_output_new (GstASFDemux * demux, GstPad * pad,
+                                           GstClockTime max_time, guint max_bytes);
+
+void             gst_asf_demux_output_free (AsfOutputQueue * queue);
+
+GstFlowReturn    gst_asf_demux_output_push (AsfOutputQueue * queue, GstBuffer * buf);
+
+gboolean         gst_asf_demux_output_push_event (AsfOutputQueue * queue, GstEvent * event);
+
+void             gst_asf_demux_output_drain (AsfOutputQueue * queue);
+
+#define gst_asf_demux_output_get(pad) \
+    ((AsfOutputQueue *) gst_pad_get_element_private (pad))
+
+G_END_DECLS
+
+#endif /* __ASF_OUTPUT_H__ */
@@ -112,7 +112,7 @@ asf_payload_find_previous_fragment (GstASFDemux * demux, AsfPayload * payload,
 {
   AsfPayload *ret = NULL;
 
-  if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+  if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux)) {
 
     /* Search in queued payloads list */
     ret = asf_payload_search_payloads_queue (payload, stream->payloads);
@@ -167,6 +167,15 @@ asf_payload_find_previous_fragment (GstASFDemux * demux, AsfPayload * payload,
   return ret;
 }
 
+/* payloads queued before the streams are activated count towards the
+ * max-preroll-bytes limit */
+static inline void
+asf_payload_unqueue_preroll_bytes (GstASFDemux * demux, AsfPayload * payload)
+{
+  if (G_UNLIKELY (!demux->activated_streams))
+    demux->preroll_bytes -= MIN (demux->preroll_bytes, payload->mo_size);
+}
+
 /* TODO: if we have another payload already queued for this stream and that
  * payload doesn't have a duration, maybe we can calculate a duration for it
  * (if the previous timestamp is smaller etc. etc.) */
@@ -201,6 +210,7 @@ gst_asf_payload_queue_for_stream_forward (GstASFDemux * demux,
     GST_DEBUG_OBJECT (demux, "Dropping incomplete fragmented media object "
         "queued for stream %u", stream->id);
 
+    asf_payload_unqueue_preroll_bytes (demux, prev);
     gst_buffer_replace (&prev->buf, NULL);
     g_array_remove_index (stream->payloads, idx_last);
 
@@ -225,6 +235,7 @@ gst_asf_payload_queue_for_stream_forward (GstASFDemux * demux,
 
       idx_last = stream->payloads->len - 1;
       last = &g_array_index (stream->payloads, AsfPayload, idx_last);
+      asf_payload_unqueue_preroll_bytes (demux, last);
       gst_buffer_replace (&last->buf, NULL);
       g_array_remove_index (stream->payloads, idx_last);
     }
@@ -233,6 +244,9 @@ gst_asf_payload_queue_for_stream_forward (GstASFDemux * demux,
     GST_BUFFER_FLAG_SET (payload->buf, GST_BUFFER_FLAG_DISCONT);
   }
 
+  if (G_UNLIKELY (!demux->activated_streams))
+    demux->preroll_bytes += payload->mo_size;
+
   g_array_append_vals (stream->payloads, payload, 1);
 }
 
@@ -266,7 +280,7 @@ gst_asf_payload_queue_for_stream (GstASFDemux * demux, AsfPayload * payload,
   GST_DEBUG_OBJECT (demux, "Got payload for stream %d ts:%" GST_TIME_FORMAT,
       stream->id, GST_TIME_ARGS (payload->ts));
 
-  if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+  if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux)) {
     gst_asf_payload_queue_for_stream_reverse (demux, payload, stream);
   } else {
     gst_asf_payload_queue_for_stream_forward (demux, payload, stream);
@@ -438,6 +452,25 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
     return TRUE;
   }
 
+  if (G_UNLIKELY (stream->not_linked) && gst_pad_is_linked (stream->pad)) {
+    GST_DEBUG_OBJECT (stream->pad, "linked again, resuming payloads");
+    stream->not_linked = FALSE;
+    stream->discont = TRUE;
+  }
+
+  /* nobody consumes this stream, or only video keyframes are wanted in key
+   * unit trick mode, step over the data without creating a buffer for it */
+  if (G_UNLIKELY (!stream->selected || stream->not_linked
+          || (demux->trickmode_key_units && (!stream->is_video
+                  || !payload.keyframe)))) {
+    GST_LOG_OBJECT (demux, "skipping %u bytes payload for stream %u",
+        payload_len, stream_num);
+    demux->payload_bytes_skipped += payload_len;
+    *p_data += payload_len;
+    *p_size -= payload_len;
+    return TRUE;
+  }
+
   if (!stream->is_video)
     stream->kf_pos = 0;
 
@@ -480,7 +513,7 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
           payload_len);
       payload.buf_filled = payload_len;
       gst_asf_payload_queue_for_stream (demux, &payload, stream);
-    } else if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+    } else if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux)) {
       /* Handle fragmented payloads for reverse playback */
       AsfPayload *prev;
       const guint8 *payload_data = *p_data;
@@ -708,7 +741,7 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
   GST_LOG_OBJECT (demux, "duration         : %" GST_TIME_FORMAT,
       GST_TIME_ARGS (packet.duration));
 
-  if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)
+  if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux)
       && demux->seek_to_cur_pos == TRUE) {
     /* For reverse playback, initially parse packets forward until we reach packet with 'seek' timestamp */
     if (packet.send_time - demux->preroll > demux->segment.stop) {
@@ -773,7 +806,7 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
       }
     }
 
-    if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+    if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux)) {
       /* In reverse playback, we parsed the packet (with multiple payloads) and stored the payloads in temporary queue.
          Now, add them to the stream's payload queue */
       for (i = 0; i < demux->num_streams; i++) {
@@ -46,6 +46,7 @@
 #include "gstasfdemux.h"
 #include "asfheaders.h"
 #include "asfpacket.h"
+#include "asfoutput.h"
 
 static GstStaticPadTemplate gst_asf_demux_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
@@ -77,8 +78,43 @@ GST_STATIC_PAD_TEMPLATE ("video_%u",
   (flow == ASF_FLOW_NEED_MORE_DATA) ?  \
   "need-more-data" : gst_flow_get_name (flow)
 
+#define DEFAULT_READ_BLOCK_SIZE 0
+#define DEFAULT_MAX_BITRATE 0
+#define DEFAULT_OUTPUT_QUEUES FALSE
+#define DEFAULT_MAX_QUEUE_TIME (1 * GST_SECOND)
+#define DEFAULT_MAX_QUEUE_BYTES (2 * 1024 * 1024)
+#define DEFAULT_MAX_PREROLL_TIME (5 * GST_SECOND)
+#define DEFAULT_MAX_PREROLL_BYTES (16 * 1024 * 1024)
+#define DEFAULT_PROBE FALSE
+#define DEFAULT_PARSE_IMAGES TRUE
+
+/* how long downstream QoS has to wait before lowering or raising the
+ * bitrate of a rendition group again, in microseconds */
+#define QOS_DOWN_INTERVAL (1 * G_USEC_PER_SEC)
+#define QOS_UP_INTERVAL (10 * G_USEC_PER_SEC)
+
+enum
+{
+  PROP_0,
+  PROP_READ_BLOCK_SIZE,
+  PROP_MAX_BITRATE,
+  PROP_OUTPUT_QUEUES,
+  PROP_MAX_QUEUE_TIME,
+  PROP_MAX_QUEUE_BYTES,
+  PROP_MAX_PREROLL_TIME,
+  PROP_MAX_PREROLL_BYTES,
+  PROP_PROBE,
+  PROP_PARSE_IMAGES
+};
+
 GST_DEBUG_CATEGORY (asfdemux_dbg);
+GST_DEBUG_CATEGORY_STATIC (CAT_PERFORMANCE);
 
+static void gst_asf_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_asf_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_asf_demux_finalize (GObject * object);
 static GstStateChangeReturn gst_asf_demux_change_state (GstElement * element,
     GstStateChange transition);
 static gboolean gst_asf_demux_element_send_event (GstElement * element,
@@ -113,6 +149,22 @@ static GstStructure *gst_asf_demux_get_metadata_for_stream (GstASFDemux * d,
     guint stream_num);
 static GstFlowReturn gst_asf_demux_push_complete_payloads (GstASFDemux * demux,
     gboolean force);
+static void gst_asf_demux_post_collection (GstASFDemux * demux);
+static gboolean gst_asf_demux_post_probe (GstASFDemux * demux);
+static void gst_asf_demux_load_pictures (GstASFDemux * demux);
+static gboolean gst_asf_demux_handle_select_streams (GstASFDemux * demux,
+    GstEvent * event);
+static void gst_asf_demux_apply_stream_selection (GstASFDemux * demux);
+static void gst_asf_demux_restart_stream (GstASFDemux * demux,
+    AsfStream * stream);
+static void gst_asf_demux_flush_stream_payloads (AsfStream * stream);
+static void gst_asf_demux_update_renditions (GstASFDemux * demux);
+static void gst_asf_demux_cancel_rendition_switch (GstASFDemux * demux,
+    AsfRenditionGroup * group);
+static void gst_asf_demux_switch_rendition (GstASFDemux * demux,
+    AsfRenditionGroup * group, GstClockTime keyframe_ts);
+static void gst_asf_demux_handle_qos (GstASFDemux * demux, GstPad * pad,
+    GstEvent * event);
 
 #define gst_asf_demux_parent_class parent_class
 G_DEFINE_TYPE (GstASFDemux, gst_asf_demux, GST_TYPE_ELEMENT);
@@ -120,10 +172,78 @@ G_DEFINE_TYPE (GstASFDemux, gst_asf_demux, GST_TYPE_ELEMENT);
 static void
 gst_asf_demux_class_init (GstASFDemuxClass * klass)
 {
+  GObjectClass *gobject_class;
   GstElementClass *gstelement_class;
 
+  gobject_class = (GObjectClass *) klass;
   gstelement_class = (GstElementClass *) klass;
 
+  gobject_class->set_property = gst_asf_demux_set_property;
+  gobject_class->get_property = gst_asf_demux_get_property;
+  gobject_class->finalize = gst_asf_demux_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_READ_BLOCK_SIZE,
+      g_param_spec_uint ("read-block-size", "Read block size",
+          "In pull mode, read packets in blocks of about this many bytes "
+          "instead of one at a time (0 = one packet at a time)",
+          0, G_MAXINT, DEFAULT_READ_BLOCK_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_BITRATE,
+      g_param_spec_uint ("max-bitrate", "Max bitrate",
+          "Output the highest bitrate rendition of multi-bitrate content "
+          "that does not exceed this many bits per second (0 = no limit)",
+          0, G_MAXUINT, DEFAULT_MAX_BITRATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_OUTPUT_QUEUES,
+      g_param_spec_boolean ("output-queues", "Output queues",
+          "Queue the output of each source pad and push it from a thread of "
+          "its own, so that parsing runs ahead of slow downstream branches "
+          "(applies to pads created afterwards)",
+          DEFAULT_OUTPUT_QUEUES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_TIME,
+      g_param_spec_uint64 ("max-queue-time", "Max queue time",
+          "Max amount of data in each output queue, in ns (0 = no limit)",
+          0, G_MAXUINT64, DEFAULT_MAX_QUEUE_TIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_BYTES,
+      g_param_spec_uint ("max-queue-bytes", "Max queue bytes",
+          "Max amount of data in each output queue, in bytes (0 = no limit)",
+          0, G_MAXUINT, DEFAULT_MAX_QUEUE_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PREROLL_TIME,
+      g_param_spec_uint64 ("max-preroll-time", "Max preroll time",
+          "Activate the streams once this much data in ns is queued, even "
+          "if some have none yet, which then start with a gap; never less "
+          "than the preroll of the file (0 = no limit)",
+          0, G_MAXUINT64, DEFAULT_MAX_PREROLL_TIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PREROLL_BYTES,
+      g_param_spec_uint ("max-preroll-bytes", "Max preroll bytes",
+          "Activate the streams once this many bytes are queued, even if "
+          "some have none yet, which then start with a gap (0 = no limit)",
+          0, G_MAXUINT, DEFAULT_MAX_PREROLL_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PROBE,
+      g_param_spec_boolean ("probe", "Probe",
+          "Only parse the header: post the stream collection, the tags and "
+          "a probe-done element message, then stop without exposing pads "
+          "or reading the data section",
+          DEFAULT_PROBE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PARSE_IMAGES,
+      g_param_spec_boolean ("parse-images", "Parse images",
+          "Turn embedded pictures into image tags while parsing the header; "
+          "if disabled they are only recorded, and turned into tags once "
+          "this is enabled again",
+          DEFAULT_PARSE_IMAGES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (gstelement_class, "ASF Demuxer",
       "Codec/Demuxer",
       "Demultiplexes ASF Streams", "Owen Fraser-Green <owen@discobabe.net>");
@@ -139,6 +259,40 @@ gst_asf_demux_class_init (GstASFDemuxClass * klass)
       GST_DEBUG_FUNCPTR (gst_asf_demux_change_state);
   gstelement_class->send_event =
       GST_DEBUG_FUNCPTR (gst_asf_demux_element_send_event);
+
+  GST_DEBUG_CATEGORY_GET (CAT_PERFORMANCE, "GST_PERFORMANCE");
+}
+
+/* the output of a pad goes through its output queue, if it has one */
+static GstFlowReturn
+gst_asf_demux_push_buffer (AsfStream * stream, GstBuffer * buf)
+{
+  AsfOutputQueue *output = gst_asf_demux_output_get (stream->pad);
+
+  if (output)
+    return gst_asf_demux_output_push (output, buf);
+  return gst_pad_push (stream->pad, buf);
+}
+
+static gboolean
+gst_asf_demux_push_event (AsfStream * stream, GstEvent * event)
+{
+  AsfOutputQueue *output = gst_asf_demux_output_get (stream->pad);
+
+  if (output)
+    return gst_asf_demux_output_push_event (output, event);
+  return gst_pad_push_event (stream->pad, event);
+}
+
+static void
+gst_asf_demux_set_stream_caps (AsfStream * stream)
+{
+  AsfOutputQueue *output = gst_asf_demux_output_get (stream->pad);
+
+  if (output)
+    gst_asf_demux_output_push_event (output, gst_event_new_caps (stream->caps));
+  else
+    gst_pad_set_caps (stream->pad, stream->caps);
 }
 
 static void
@@ -153,7 +307,12 @@ gst_asf_demux_free_stream (GstASFDemux * demux, AsfStream * stream)
     gst_buffer_unref (stream->streamheader);
     stream->streamheader = NULL;
   }
+  gst_object_replace ((GstObject **) & stream->gst_stream, NULL);
   if (stream->pad) {
+    AsfOutputQueue *output = gst_asf_demux_output_get (stream->pad);
+
+    if (output)
+      gst_asf_demux_output_free (output);
     if (stream->active) {
       gst_element_remove_pad (GST_ELEMENT_CAST (demux), stream->pad);
       gst_flow_combiner_remove_pad (demux->flowcombiner, stream->pad);
@@ -196,6 +355,46 @@ gst_asf_demux_free_stream (GstASFDemux * demux, AsfStream * stream)
   }
 }
 
+static void
+gst_asf_demux_log_packet_stats (GstASFDemux * demux)
+{
+  if (demux->payload_bytes_skipped == 0)
+    return;
+
+  GST_CAT_INFO_OBJECT (CAT_PERFORMANCE, demux, "skipped %" G_GUINT64_FORMAT
+      " payload bytes of deselected or unlinked streams",
+      demux->payload_bytes_skipped);
+}
+
+static void
+gst_asf_demux_log_trickmode_stats (GstASFDemux * demux)
+{
+  if (demux->trick_keyframes == 0)
+    return;
+
+  GST_CAT_INFO_OBJECT (CAT_PERFORMANCE, demux, "%s read %" G_GUINT64_FORMAT
+      " packets for %" G_GUINT64_FORMAT " index entries, spanning %"
+      G_GINT64_FORMAT " packets", demux->reverse_gop ? "reverse playback" :
+      "key unit trick mode", demux->trick_packets, demux->trick_keyframes,
+      ABS (demux->packet - demux->trick_start_packet));
+  demux->trick_keyframes = 0;
+  demux->trick_packets = 0;
+}
+
+static void
+gst_asf_demux_clear_pictures (GstASFDemux * demux)
+{
+  guint i;
+
+  for (i = 0; i < demux->pictures->len; i++) {
+    AsfPicture *picture = &g_array_index (demux->pictures, AsfPicture, i);
+
+    if (picture->data)
+      gst_buffer_unref (picture->data);
+  }
+  g_array_set_size (demux->pictures, 0);
+}
+
 static void
 gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
 {
@@ -208,10 +407,23 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
     g_object_unref (demux->adapter);
     demux->adapter = NULL;
   }
+  if (!chain_reset) {
+    gst_asf_demux_log_packet_stats (demux);
+    demux->payload_bytes_skipped = 0;
+  }
   if (demux->taglist) {
     gst_tag_list_unref (demux->taglist);
     demux->taglist = NULL;
   }
+  if (demux->sent_taglist) {
+    gst_tag_list_unref (demux->sent_taglist);
+    demux->sent_taglist = NULL;
+  }
+  if (demux->pictures) {
+    gst_asf_demux_clear_pictures (demux);
+    g_array_free (demux->pictures, TRUE);
+    demux->pictures = NULL;
+  }
   if (demux->metadata) {
     gst_caps_unref (demux->metadata);
     demux->metadata = NULL;
@@ -224,6 +436,17 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
     g_slist_free (demux->mut_ex_streams);
     demux->mut_ex_streams = NULL;
   }
+  gst_object_replace ((GstObject **) & demux->collection, NULL);
+  GST_OBJECT_LOCK (demux);
+  g_list_free_full (demux->pending_selection, g_free);
+  demux->pending_selection = NULL;
+  demux->selection_pending = FALSE;
+  if (demux->renditions) {
+    g_array_free (demux->renditions, TRUE);
+    demux->renditions = NULL;
+  }
+  demux->renditions_changed = FALSE;
+  GST_OBJECT_UNLOCK (demux);
 
   demux->state = GST_ASF_DEMUX_STATE_HEADER;
   g_free (demux->objpath);
@@ -266,6 +489,8 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
   }
   demux->num_streams = 0;
   demux->activated_streams = FALSE;
+  demux->preroll_bytes = 0;
+  demux->probed = FALSE;
   demux->first_ts = GST_CLOCK_TIME_NONE;
   demux->segment_ts = GST_CLOCK_TIME_NONE;
   demux->in_gap = 0;
@@ -280,6 +505,11 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
   demux->sidx_entries = NULL;
 
   demux->speed_packets = 1;
+  gst_buffer_replace (&demux->block, NULL);
+
+  gst_asf_demux_log_trickmode_stats (demux);
+  demux->trickmode_key_units = FALSE;
+  demux->reverse_gop = FALSE;
 
   demux->asf_3D_mode = GST_ASF_3D_NONE;
 
@@ -319,10 +549,152 @@ gst_asf_demux_init (GstASFDemux * demux)
       GST_DEBUG_FUNCPTR (gst_asf_demux_activate_mode));
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 
+  demux->read_block_size = DEFAULT_READ_BLOCK_SIZE;
+  demux->output_queues = DEFAULT_OUTPUT_QUEUES;
+  demux->max_queue_time = DEFAULT_MAX_QUEUE_TIME;
+  demux->max_queue_bytes = DEFAULT_MAX_QUEUE_BYTES;
+  demux->max_preroll_time = DEFAULT_MAX_PREROLL_TIME;
+  demux->max_preroll_bytes = DEFAULT_MAX_PREROLL_BYTES;
+  demux->probe = DEFAULT_PROBE;
+  demux->parse_images = DEFAULT_PARSE_IMAGES;
+  g_mutex_init (&demux->output_lock);
+  g_cond_init (&demux->output_space);
+
   /* set initial state */
   gst_asf_demux_reset (demux, FALSE);
 }
 
+static void
+gst_asf_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstASFDemux *demux = GST_ASF_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_READ_BLOCK_SIZE:
+      GST_OBJECT_LOCK (demux);
+      demux->read_block_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_BITRATE:
+      GST_OBJECT_LOCK (demux);
+      demux->max_bitrate = g_value_get_uint (value);
+      demux->renditions_changed = TRUE;
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_OUTPUT_QUEUES:
+      GST_OBJECT_LOCK (demux);
+      demux->output_queues = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_QUEUE_TIME:
+      GST_OBJECT_LOCK (demux);
+      demux->max_queue_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_QUEUE_BYTES:
+      GST_OBJECT_LOCK (demux);
+      demux->max_queue_bytes = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_PREROLL_TIME:
+      GST_OBJECT_LOCK (demux);
+      demux->max_preroll_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_PREROLL_BYTES:
+      GST_OBJECT_LOCK (demux);
+      demux->max_preroll_bytes = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_PROBE:
+      GST_OBJECT_LOCK (demux);
+      demux->probe = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_PARSE_IMAGES:
+      GST_OBJECT_LOCK (demux);
+      demux->parse_images = g_value_get_boolean (value);
+      /* the streaming thread loads what was recorded so far */
+      if (demux->parse_images)
+        demux->pictures_requested = TRUE;
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_asf_demux_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstASFDemux *demux = GST_ASF_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_READ_BLOCK_SIZE:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->read_block_size);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_BITRATE:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->max_bitrate);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_OUTPUT_QUEUES:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_boolean (value, demux->output_queues);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_QUEUE_TIME:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint64 (value, demux->max_queue_time);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_QUEUE_BYTES:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->max_queue_bytes);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_PREROLL_TIME:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint64 (value, demux->max_preroll_time);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_PREROLL_BYTES:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->max_preroll_bytes);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_PROBE:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_boolean (value, demux->probe);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_PARSE_IMAGES:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_boolean (value, demux->parse_images);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_asf_demux_finalize (GObject * object)
+{
+  GstASFDemux *demux = GST_ASF_DEMUX (object);
+
+  g_mutex_clear (&demux->output_lock);
+  g_cond_clear (&demux->output_space);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static gboolean
 gst_asf_demux_activate (GstPad * sinkpad, GstObject * parent)
 {
@@ -441,6 +813,12 @@ gst_asf_demux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
     case GST_EVENT_EOS:{
       GstFlowReturn flow;
 
+      /* nothing was exposed, so there is nobody to forward EOS to */
+      if (demux->probed) {
+        gst_event_unref (event);
+        break;
+      }
+
       if (demux->state == GST_ASF_DEMUX_STATE_HEADER) {
         GST_ELEMENT_ERROR (demux, STREAM, DEMUX,
             (_("This stream contains no data.")),
@@ -460,6 +838,8 @@ gst_asf_demux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
         break;
       }
 
+      gst_asf_demux_log_packet_stats (demux);
+
       GST_OBJECT_LOCK (demux);
       gst_adapter_clear (demux->adapter);
       GST_OBJECT_UNLOCK (demux);
@@ -562,6 +942,7 @@ gst_asf_demux_reset_stream_state_after_discont (GstASFDemux * demux)
   GST_DEBUG_OBJECT (demux, "reset stream state");
 
   gst_flow_combiner_reset (demux->flowcombiner);
+  demux->preroll_bytes = 0;
   for (n = 0; n < demux->num_streams; n++) {
     demux->stream[n].discont = TRUE;
     demux->stream[n].first_buffer = TRUE;
@@ -639,6 +1020,52 @@ gst_asf_demux_handle_seek_push (GstASFDemux * demux, GstEvent * event)
   return res;
 }
 
+/* with a simple index and video, reverse playback goes GOP by GOP; the
+ * first GOP read is the one of the first index entry at or after the stop
+ * position, so the GOP after it is set up as the last one read */
+static void
+gst_asf_demux_setup_reverse_gop (GstASFDemux * demux)
+{
+  GstClockTime stop;
+  guint idx, next, n = demux->sidx_num_entries;
+
+  if (n == 0 || demux->sidx_interval == 0 || demux->num_video_streams == 0)
+    return;
+
+  stop = demux->segment.stop;
+  if (!GST_CLOCK_TIME_IS_VALID (stop))
+    stop = demux->segment.duration;
+
+  idx = n - 1;
+  if (GST_CLOCK_TIME_IS_VALID (stop))
+    idx = MIN (gst_util_uint64_scale_ceil (stop + demux->preroll, 1,
+            demux->sidx_interval), idx);
+
+  for (next = idx + 1; next < n; ++next) {
+    if (demux->sidx_entries[next].packet != demux->sidx_entries[idx].packet)
+      break;
+  }
+
+  if (next < n) {
+    demux->rev_idx = next;
+    demux->rev_kf_packet = demux->sidx_entries[next].packet;
+    demux->rev_end_packet = demux->rev_kf_packet +
+        MAX (demux->sidx_entries[next].count, 1);
+  } else {
+    demux->rev_idx = n - 1;
+    demux->rev_kf_packet = demux->num_packets;
+    demux->rev_end_packet = demux->num_packets;
+  }
+  demux->rev_upper_ts = GST_CLOCK_TIME_NONE;
+  demux->trick_start_packet = demux->rev_end_packet;
+  demux->trick_keyframes = 0;
+  demux->trick_packets = 0;
+  demux->reverse_gop = TRUE;
+
+  GST_DEBUG_OBJECT (demux, "reverse playback by GOP, from before packet %"
+      G_GINT64_FORMAT, demux->rev_kf_packet);
+}
+
 static gboolean
 gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
 {
@@ -654,7 +1081,7 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
   gint64 cur, stop;
   gint64 seek_time;
   guint packet, speed_count = 1;
-  gboolean eos;
+  gboolean eos, trickmode;
   guint32 seqnum;
   GstEvent *fevent;
   gint i;
@@ -716,6 +1143,15 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
     return gst_asf_demux_handle_seek_push (demux, event);
   }
 
+  /* forward key unit trick mode jumps from keyframe to keyframe along the
+   * simple index, without one it falls back to reading all packets */
+  trickmode = (flags & GST_SEEK_FLAG_TRICKMODE_KEY_UNITS) && rate > 0.0
+      && demux->num_video_streams > 0 && demux->sidx_num_entries > 0;
+  if (trickmode) {
+    demux->keyunit_sync = TRUE;
+    demux->accurate = FALSE;
+  }
+
   /* unlock the streaming thread */
   if (G_LIKELY (flush)) {
     fevent = gst_event_new_flush_start ();
@@ -765,6 +1201,8 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
       goto skip;
     }
 
+    trickmode = FALSE;
+
     /* First try to query our source to see if it can convert for us. This is
        the case when our source is an mms stream, notice that in this case
        gstmms will do a time based seek to get the byte offset, this is not a
@@ -810,9 +1248,21 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
 
   GST_OBJECT_LOCK (demux);
   demux->segment = segment;
+  gst_asf_demux_log_trickmode_stats (demux);
+  demux->trickmode_key_units = trickmode;
+  if (trickmode) {
+    /* audio is skipped altogether */
+    demux->segment.flags |= GST_SEGMENT_FLAG_TRICKMODE_NO_AUDIO;
+    demux->trick_idx = 0;
+    demux->trick_start_packet = packet;
+    demux->trick_end_packet = packet + MAX (speed_count, 1);
+    demux->trick_keyframes = 1;
+  }
+  demux->reverse_gop = FALSE;
   if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
     demux->packet = (gint64) gst_util_uint64_scale (demux->num_packets,
         stop, demux->play_time);
+    gst_asf_demux_setup_reverse_gop (demux);
   } else {
     demux->packet = packet;
   }
@@ -821,6 +1271,7 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
   demux->segment_seqnum = seqnum;
   demux->speed_packets =
       GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) ? 1 : speed_count;
+  gst_buffer_replace (&demux->block, NULL);
   gst_asf_demux_reset_stream_state_after_discont (demux);
   GST_OBJECT_UNLOCK (demux);
 
@@ -850,9 +1301,18 @@ gst_asf_demux_handle_src_event (GstPad * pad, GstObject * parent,
       ret = gst_asf_demux_handle_seek_event (demux, event);
       gst_event_unref (event);
       break;
+    case GST_EVENT_SELECT_STREAMS:
+      GST_LOG_OBJECT (pad, "select-streams event");
+      ret = gst_asf_demux_handle_select_streams (demux, event);
+      gst_event_unref (event);
+      break;
     case GST_EVENT_QOS:
+      gst_asf_demux_handle_qos (demux, pad, event);
+      gst_event_unref (event);
+      ret = FALSE;
+      break;
     case GST_EVENT_NAVIGATION:
-      /* just drop these two silently */
+      /* just drop these silently */
       gst_event_unref (event);
       ret = FALSE;
       break;
@@ -932,8 +1392,12 @@ gst_asf_demux_release_old_pads (GstASFDemux * demux)
   GST_DEBUG_OBJECT (demux, "Releasing old pads");
 
   while (demux->old_num_streams > 0) {
-    gst_pad_push_event (demux->old_stream[demux->old_num_streams - 1].pad,
-        gst_event_new_eos ());
+    AsfStream *stream = &demux->old_stream[demux->old_num_streams - 1];
+    AsfOutputQueue *output = gst_asf_demux_output_get (stream->pad);
+
+    gst_asf_demux_push_event (stream, gst_event_new_eos ());
+    if (output)
+      gst_asf_demux_output_drain (output);
     gst_asf_demux_free_stream (demux,
         &demux->old_stream[demux->old_num_streams - 1]);
     --demux->old_num_streams;
@@ -1051,6 +1515,66 @@ gst_asf_demux_pull_data (GstASFDemux * demux, guint64 offset, guint size,
   return TRUE;
 }
 
+/* pulls the packets to parse next at @offset, which is a sub-buffer of the
+ * current block when reading in blocks */
+static gboolean
+gst_asf_demux_pull_packets (GstASFDemux * demux, guint64 offset,
+    GstBuffer ** p_buf, GstFlowReturn * p_flow)
+{
+  guint block_size;
+  gsize size;
+
+  GST_OBJECT_LOCK (demux);
+  block_size = demux->read_block_size;
+  GST_OBJECT_UNLOCK (demux);
+
+  /* key unit trick mode reads just the packets of each keyframe */
+  if (block_size == 0 || demux->speed_packets != 1
+      || demux->trickmode_key_units
+      || GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+    return gst_asf_demux_pull_data (demux, offset,
+        demux->packet_size * demux->speed_packets, p_buf, p_flow);
+  }
+
+  if (demux->block != NULL) {
+    size = gst_buffer_get_size (demux->block);
+    if (offset >= demux->block_offset
+        && offset + demux->packet_size <= demux->block_offset + size)
+      goto done;
+    gst_buffer_replace (&demux->block, NULL);
+  }
+
+  /* whole packets only, and not beyond the data object if we know where
+   * it ends */
+  block_size = MAX (block_size / demux->packet_size, 1) * demux->packet_size;
+  if (demux->num_packets > 0) {
+    guint64 end = demux->data_offset + demux->num_packets * demux->packet_size;
+
+    if (offset < end)
+      block_size = MIN (block_size, end - offset);
+  }
+
+  if (!gst_asf_demux_pull_data (demux, offset, block_size, &demux->block,
+          p_flow)) {
+    /* might just be less than a block left */
+    if (block_size > demux->packet_size && *p_flow == GST_FLOW_EOS) {
+      return gst_asf_demux_pull_data (demux, offset, demux->packet_size,
+          p_buf, p_flow);
+    }
+    return FALSE;
+  }
+
+  GST_LOG_OBJECT (demux, "pulled block of %u packets",
+      block_size / demux->packet_size);
+  demux->block_offset = offset;
+
+done:
+  *p_buf = gst_buffer_copy_region (demux->block, GST_BUFFER_COPY_MEMORY,
+      offset - demux->block_offset, demux->packet_size);
+
+  return TRUE;
+}
+
 static GstFlowReturn
 gst_asf_demux_pull_indices (GstASFDemux * demux)
 {
@@ -1174,6 +1698,8 @@ gst_asf_demux_parse_data_object_start (GstASFDemux * demux, guint8 * data)
   /* process pending stream objects and create pads for those */
   gst_asf_demux_process_queued_extended_stream_objects (demux);
 
+  gst_asf_demux_post_collection (demux);
+
   GST_INFO_OBJECT (demux, "Stream has %" G_GUINT64_FORMAT " packets, "
       "data_offset=%" G_GINT64_FORMAT ", data_size=%" G_GINT64_FORMAT
       ", index_offset=%" G_GUINT64_FORMAT, demux->num_packets,
@@ -1223,7 +1749,9 @@ gst_asf_demux_pull_headers (GstASFDemux * demux, GstFlowReturn * pflow)
   gst_buffer_map (buf, &map, GST_MAP_READ);
   g_assert (map.size >= size);
   bufdata = (guint8 *) map.data;
+  demux->header_data = bufdata;
   flow = gst_asf_demux_process_object (demux, &bufdata, &size);
+  demux->header_data = NULL;
   gst_buffer_unmap (buf, &map);
   gst_buffer_replace (&buf, NULL);
 
@@ -1285,8 +1813,81 @@ parse_failed:
   }
 }
 
+/* time spanned by the payloads queued for the selected streams */
+static GstClockTime
+gst_asf_demux_queued_duration (GstASFDemux * demux)
+{
+  GstClockTime first_ts = GST_CLOCK_TIME_NONE, last_ts = GST_CLOCK_TIME_NONE;
+  guint i;
+  gint j;
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+    AsfPayload *payload;
+
+    if (!stream->selected)
+      continue;
+
+    for (j = 0; j < stream->payloads->len; ++j) {
+      payload = &g_array_index (stream->payloads, AsfPayload, j);
+      if (GST_CLOCK_TIME_IS_VALID (payload->ts)) {
+        if (!GST_CLOCK_TIME_IS_VALID (first_ts) || payload->ts < first_ts)
+          first_ts = payload->ts;
+        break;
+      }
+    }
+    for (j = stream->payloads->len - 1; j >= 0; --j) {
+      payload = &g_array_index (stream->payloads, AsfPayload, j);
+      if (GST_CLOCK_TIME_IS_VALID (payload->ts)) {
+        if (!GST_CLOCK_TIME_IS_VALID (last_ts) || payload->ts > last_ts)
+          last_ts = payload->ts;
+        break;
+      }
+    }
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (first_ts) || last_ts <= first_ts)
+    return 0;
+  return last_ts - first_ts;
+}
+
+/* streams that are sparse or have no data at all would otherwise make us
+ * queue everything else until they show up or the file ends */
+static gboolean
+gst_asf_demux_preroll_limit_reached (GstASFDemux * demux,
+    GstClockTime preroll_time)
+{
+  GstClockTime max_time, queued;
+  guint max_bytes;
+
+  GST_OBJECT_LOCK (demux);
+  max_time = demux->max_preroll_time;
+  max_bytes = demux->max_preroll_bytes;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (max_bytes > 0 && demux->preroll_bytes >= max_bytes) {
+    GST_INFO_OBJECT (demux, "%" G_GUINT64_FORMAT " bytes queued, not waiting "
+        "for the other streams any longer", demux->preroll_bytes);
+    return TRUE;
+  }
+
+  if (max_time == 0)
+    return FALSE;
+
+  queued = gst_asf_demux_queued_duration (demux);
+  if (queued >= MAX (max_time, preroll_time)) {
+    GST_INFO_OBJECT (demux, "%" GST_TIME_FORMAT " queued, not waiting for the "
+        "other streams any longer", GST_TIME_ARGS (queued));
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* @limit_reached is set if we stop waiting because of the preroll limits
+ * rather than because every stream has data */
 static gboolean
-all_streams_prerolled (GstASFDemux * demux)
+all_streams_prerolled (GstASFDemux * demux, gboolean * limit_reached)
 {
   GstClockTime preroll_time;
   guint i, num_no_data = 0;
@@ -1295,6 +1896,11 @@ all_streams_prerolled (GstASFDemux * demux)
   /* Allow at least 500ms of preroll_time  */
   preroll_time = MAX (demux->preroll, 500 * GST_MSECOND);
 
+  if (gst_asf_demux_preroll_limit_reached (demux, preroll_time)) {
+    *limit_reached = TRUE;
+    return TRUE;
+  }
+
   /* returns TRUE as long as there isn't a stream which (a) has data queued
    * and (b) the timestamp of last piece of data queued is < demux->preroll
    * AND there is at least one other stream with data queued */
@@ -1305,6 +1911,9 @@ all_streams_prerolled (GstASFDemux * demux)
 
     stream = &demux->stream[i];
 
+    if (!stream->selected)
+      continue;
+
     all_types |= stream->type;
 
     if (G_UNLIKELY (stream->payloads->len == 0)) {
@@ -1540,11 +2149,12 @@ static gboolean
 gst_asf_demux_check_activate_streams (GstASFDemux * demux, gboolean force)
 {
   guint i, actual_streams = 0;
+  gboolean limit_reached = FALSE;
 
   if (demux->activated_streams)
     return TRUE;
 
-  if (!all_streams_prerolled (demux) && !force) {
+  if (!all_streams_prerolled (demux, &limit_reached) && !force) {
     GST_DEBUG_OBJECT (demux, "not all streams with data beyond preroll yet");
     return FALSE;
   }
@@ -1569,6 +2179,13 @@ gst_asf_demux_check_activate_streams (GstASFDemux * demux, gboolean force)
       GST_LOG_OBJECT (stream->pad, "is prerolled - activate!");
       gst_asf_demux_activate_stream (demux, stream);
       actual_streams += 1;
+    } else if (limit_reached && stream->selected && !stream->inspect_payload) {
+      /* its data may still come, so expose it now and let downstream know
+       * not to wait for it until then */
+      GST_INFO_OBJECT (stream->pad, "no data yet, activating with a gap");
+      gst_asf_demux_activate_stream (demux, stream);
+      stream->preroll_gap = TRUE;
+      actual_streams += 1;
     } else {
       GST_LOG_OBJECT (stream->pad, "no data, ignoring stream");
     }
@@ -1582,6 +2199,12 @@ gst_asf_demux_check_activate_streams (GstASFDemux * demux, gboolean force)
 
   gst_asf_demux_release_old_pads (demux);
 
+  GST_CAT_INFO_OBJECT (CAT_PERFORMANCE, demux, "activated %u of %u streams "
+      "with %" G_GUINT64_FORMAT " bytes spanning %" GST_TIME_FORMAT " queued",
+      actual_streams, demux->num_streams, demux->preroll_bytes,
+      GST_TIME_ARGS (gst_asf_demux_queued_duration (demux)));
+  demux->preroll_bytes = 0;
+
   demux->activated_streams = TRUE;
   GST_LOG_OBJECT (demux, "signalling no more pads");
   gst_element_no_more_pads (GST_ELEMENT (demux));
@@ -1613,7 +2236,7 @@ gst_asf_demux_find_stream_with_complete_payload (GstASFDemux * demux)
       AsfPayload *payload = NULL;
       gint last_idx;
 
-      if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+      if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux)) {
         /* Reverse playback */
 
         if (stream->is_video) {
@@ -1696,6 +2319,52 @@ gst_asf_demux_find_stream_with_complete_payload (GstASFDemux * demux)
   return best_stream;
 }
 
+/* audio is skipped in key unit trick mode, so keep its pads moving along
+ * with the video keyframes or downstream would wait for it */
+static void
+gst_asf_demux_push_trick_gaps (GstASFDemux * demux, GstClockTime timestamp)
+{
+  guint i;
+
+  if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+    return;
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+
+    if (stream->active && !stream->is_video)
+      gst_asf_demux_push_event (stream,
+          gst_event_new_gap (timestamp, GST_CLOCK_TIME_NONE));
+  }
+}
+
+/* streams activated without data once the preroll limits tripped start
+ * with a gap from the first payload we push on the others */
+static void
+gst_asf_demux_push_preroll_gaps (GstASFDemux * demux, GstClockTime timestamp)
+{
+  guint i;
+
+  if (GST_CLOCK_TIME_IS_VALID (timestamp))
+    timestamp += demux->in_gap;
+  else
+    timestamp = demux->segment.position;
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+
+    if (G_LIKELY (!stream->preroll_gap))
+      continue;
+
+    GST_DEBUG_OBJECT (stream->pad, "no data at preroll, gap from %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (timestamp));
+    if (stream->active)
+      gst_asf_demux_push_event (stream,
+          gst_event_new_gap (timestamp, GST_CLOCK_TIME_NONE));
+    stream->preroll_gap = FALSE;
+  }
+}
+
 static GstFlowReturn
 gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
 {
@@ -1718,17 +2387,38 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
             && !GST_CLOCK_TIME_IS_VALID (demux->segment_ts)))
       return GST_FLOW_OK;
 
-    if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) && stream->is_video
+    if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux) && stream->is_video
         && stream->payloads->len) {
       payload = &g_array_index (stream->payloads, AsfPayload, stream->kf_pos);
     } else {
       payload = &g_array_index (stream->payloads, AsfPayload, 0);
     }
 
-    /* do we need to send a newsegment event */
-    if ((G_UNLIKELY (demux->need_newsegment))) {
-      GstEvent *segment_event;
-
+    /* a rendition we are switching to only takes over from a keyframe */
+    if (G_UNLIKELY (stream->rendition >= 0 && !stream->active
+            && !GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment))) {
+      AsfRenditionGroup *group = &g_array_index (demux->renditions,
+          AsfRenditionGroup, stream->rendition);
+
+      if (group->pending == stream) {
+        if (!payload->keyframe) {
+          GST_LOG_OBJECT (demux, "dropping non-keyframe of stream %u before "
+              "switching to it", stream->id);
+          gst_buffer_replace (&payload->buf, NULL);
+          g_array_remove_index (stream->payloads, 0);
+          continue;
+        }
+        gst_asf_demux_switch_rendition (demux, group, payload->ts);
+      }
+    }
+
+    if (G_UNLIKELY (stream->restart))
+      gst_asf_demux_restart_stream (demux, stream);
+
+    /* do we need to send a newsegment event */
+    if ((G_UNLIKELY (demux->need_newsegment))) {
+      GstEvent *segment_event;
+
       /* safe default if insufficient upstream info */
       if (!GST_CLOCK_TIME_IS_VALID (demux->in_gap))
         demux->in_gap = 0;
@@ -1769,18 +2459,24 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
 
       GST_DEBUG_OBJECT (demux, "global tags: %" GST_PTR_FORMAT, demux->taglist);
       gst_asf_demux_send_event_unlocked (demux,
-          gst_event_new_tag (demux->taglist));
+          gst_event_new_tag (gst_tag_list_ref (demux->taglist)));
+      /* kept so that pictures loaded later can be added to them */
+      if (demux->sent_taglist)
+        gst_tag_list_unref (demux->sent_taglist);
+      demux->sent_taglist = demux->taglist;
       demux->taglist = NULL;
 
       demux->need_newsegment = FALSE;
       demux->segment_seqnum = 0;
       demux->segment_running = TRUE;
+
+      gst_asf_demux_push_preroll_gaps (demux, payload->ts);
     }
 
     /* Do we have tags pending for this stream? */
     if (G_UNLIKELY (stream->pending_tags)) {
       GST_LOG_OBJECT (stream->pad, "%" GST_PTR_FORMAT, stream->pending_tags);
-      gst_pad_push_event (stream->pad,
+      gst_asf_demux_push_event (stream,
           gst_event_new_tag (stream->pending_tags));
       stream->pending_tags = NULL;
     }
@@ -1814,7 +2510,7 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
       stream->caps = gst_caps_make_writable (stream->caps);
       gst_caps_set_simple (stream->caps, "pixel-aspect-ratio",
           GST_TYPE_FRACTION, stream->par_x, stream->par_y, NULL);
-      gst_pad_set_caps (stream->pad, stream->caps);
+      gst_asf_demux_set_stream_caps (stream);
     }
 
     if (G_UNLIKELY (stream->interlaced != payload->interlaced)) {
@@ -1824,7 +2520,7 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
       stream->caps = gst_caps_make_writable (stream->caps);
       gst_caps_set_simple (stream->caps, "interlace-mode", G_TYPE_BOOLEAN,
           (stream->interlaced ? "mixed" : "progressive"), NULL);
-      gst_pad_set_caps (stream->pad, stream->caps);
+      gst_asf_demux_set_stream_caps (stream);
     }
 
     /* (sort of) interpolate timestamps using upstream "frame of reference",
@@ -1871,11 +2567,11 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
     GST_LOG_OBJECT (stream->pad, "pushing buffer, %" GST_PTR_FORMAT,
         payload->buf);
 
-    if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) && stream->is_video) {
+    if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux) && stream->is_video) {
       if (stream->reverse_kf_ready == TRUE && stream->kf_pos == 0) {
         GST_BUFFER_FLAG_SET (payload->buf, GST_BUFFER_FLAG_DISCONT);
       }
-    } else if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+    } else if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux)) {
       GST_BUFFER_FLAG_SET (payload->buf, GST_BUFFER_FLAG_DISCONT);
     }
 
@@ -1885,7 +2581,8 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
         if (stream->streamheader != NULL) {
           GST_DEBUG_OBJECT (stream->pad,
               "Pushing streamheader before first buffer");
-          gst_pad_push (stream->pad, gst_buffer_ref (stream->streamheader));
+          gst_asf_demux_push_buffer (stream,
+              gst_buffer_ref (stream->streamheader));
         }
         stream->first_buffer = FALSE;
       }
@@ -1897,7 +2594,12 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
           demux->segment.position += timestamp;
       }
 
-      ret = gst_pad_push (stream->pad, payload->buf);
+      ret = gst_asf_demux_push_buffer (stream, payload->buf);
+      /* stop creating buffers for this stream until it gets linked */
+      if (G_UNLIKELY (ret == GST_FLOW_NOT_LINKED))
+        stream->not_linked = TRUE;
+      if (G_UNLIKELY (demux->trickmode_key_units) && stream->is_video)
+        gst_asf_demux_push_trick_gaps (demux, timestamp);
       ret =
           gst_flow_combiner_update_pad_flow (demux->flowcombiner, stream->pad,
           ret);
@@ -1906,7 +2608,7 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
       ret = GST_FLOW_OK;
     }
     payload->buf = NULL;
-    if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) && stream->is_video
+    if (GST_ASF_DEMUX_STEPS_BACKWARDS (demux) && stream->is_video
         && stream->reverse_kf_ready) {
       g_array_remove_index (stream->payloads, stream->kf_pos);
       stream->kf_pos--;
@@ -1981,6 +2683,186 @@ gst_asf_demux_check_chained_asf (GstASFDemux * demux)
   return header;
 }
 
+static void
+gst_asf_demux_remove_payloads (AsfStream * stream, guint first, guint last)
+{
+  guint i;
+
+  for (i = first; i < last; i++)
+    gst_buffer_replace (&g_array_index (stream->payloads, AsfPayload, i).buf,
+        NULL);
+  if (last > first)
+    g_array_remove_range (stream->payloads, first, last - first);
+}
+
+/* keeps what belongs to the GOP just parsed: video from its first keyframe
+ * up to the keyframe the GOP read before it started with, the other streams
+ * within the same span of time; returns the start of the GOP, or
+ * GST_CLOCK_TIME_NONE if it has no keyframe */
+static GstClockTime
+gst_asf_demux_trim_reverse_gop (GstASFDemux * demux)
+{
+  GstClockTime lower = GST_CLOCK_TIME_NONE;
+  GstClockTime upper = demux->rev_upper_ts;
+  GstClockTime stop = demux->segment.stop;
+  guint i, j;
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+    AsfPayload *payload;
+
+    if (!stream->is_video)
+      continue;
+
+    for (j = 0; j < stream->payloads->len; j++) {
+      payload = &g_array_index (stream->payloads, AsfPayload, j);
+      if (payload->keyframe && GST_CLOCK_TIME_IS_VALID (payload->ts))
+        break;
+    }
+    gst_asf_demux_remove_payloads (stream, 0, j);
+    if (stream->payloads->len == 0)
+      continue;
+
+    payload = &g_array_index (stream->payloads, AsfPayload, 0);
+    if (!GST_CLOCK_TIME_IS_VALID (lower) || payload->ts < lower)
+      lower = payload->ts;
+
+    for (j = 1; j < stream->payloads->len; j++) {
+      payload = &g_array_index (stream->payloads, AsfPayload, j);
+      if (payload->keyframe && GST_CLOCK_TIME_IS_VALID (upper)
+          && GST_CLOCK_TIME_IS_VALID (payload->ts) && payload->ts >= upper)
+        break;
+    }
+    gst_asf_demux_remove_payloads (stream, j, stream->payloads->len);
+  }
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+
+    if (!GST_CLOCK_TIME_IS_VALID (lower)) {
+      gst_asf_demux_flush_stream_payloads (stream);
+      continue;
+    }
+
+    for (j = 0; j < stream->payloads->len;) {
+      AsfPayload *payload = &g_array_index (stream->payloads, AsfPayload, j);
+      GstClockTime ts = payload->ts;
+
+      if (GST_CLOCK_TIME_IS_VALID (ts) && ((GST_CLOCK_TIME_IS_VALID (stop)
+                  && ts > stop) || (!stream->is_video && (ts < lower
+                      || (GST_CLOCK_TIME_IS_VALID (upper) && ts >= upper)))))
+        gst_asf_demux_remove_payloads (stream, j, j + 1);
+      else
+        j++;
+    }
+  }
+
+  return lower;
+}
+
+/* reverse playback: reads the GOP before the last one read in a single pull,
+ * parses it forwards and pushes it with DISCONT on the first buffer of each
+ * stream, as reverse decoders expect */
+static GstFlowReturn
+gst_asf_demux_pull_reverse_gop (GstASFDemux * demux)
+{
+  GstFlowReturn flow = GST_FLOW_OK;
+  GstClockTime lower;
+  GstBuffer *buf;
+  gint64 start, end;
+  guint idx, n, num;
+
+  idx = demux->rev_idx;
+  while (idx > 0 && demux->sidx_entries[idx].packet >= demux->rev_kf_packet)
+    --idx;
+  if (demux->sidx_entries[idx].packet >= demux->rev_kf_packet)
+    return GST_FLOW_EOS;
+
+  start = demux->sidx_entries[idx].packet;
+  end = MIN (demux->rev_end_packet, (gint64) demux->num_packets);
+  if (G_UNLIKELY (end <= start))
+    return GST_FLOW_EOS;
+
+  GST_DEBUG_OBJECT (demux, "reading GOP of index entry %u, packets %"
+      G_GINT64_FORMAT " to %" G_GINT64_FORMAT, idx, start, end);
+
+  if (!gst_asf_demux_pull_data (demux,
+          demux->data_offset + start * demux->packet_size,
+          (end - start) * demux->packet_size, &buf, &flow))
+    return flow;
+
+  num = gst_buffer_get_size (buf) / demux->packet_size;
+  for (n = 0; n < num; n++) {
+    GstBuffer *sub;
+
+    sub = gst_buffer_copy_region (buf, GST_BUFFER_COPY_ALL,
+        n * demux->packet_size, demux->packet_size);
+    if (G_UNLIKELY (gst_asf_demux_parse_packet (demux, sub) !=
+            GST_ASF_DEMUX_PARSE_PACKET_ERROR_NONE))
+      GST_INFO_OBJECT (demux, "Ignoring recoverable parse error");
+    gst_buffer_unref (sub);
+  }
+  gst_buffer_unref (buf);
+
+  demux->packet = start;
+  demux->trick_keyframes++;
+  demux->trick_packets += num;
+
+  lower = gst_asf_demux_trim_reverse_gop (demux);
+  if (GST_CLOCK_TIME_IS_VALID (lower)) {
+    for (n = 0; n < demux->num_streams; n++)
+      demux->stream[n].discont = TRUE;
+    flow = gst_asf_demux_push_complete_payloads (demux, FALSE);
+  }
+  for (n = 0; n < demux->num_streams; n++)
+    gst_asf_demux_flush_stream_payloads (&demux->stream[n]);
+
+  demux->rev_idx = idx;
+  demux->rev_kf_packet = start;
+  demux->rev_end_packet = start + MAX (demux->sidx_entries[idx].count, 1);
+
+  if (GST_CLOCK_TIME_IS_VALID (lower)) {
+    GST_LOG_OBJECT (demux, "pushed GOP from %" GST_TIME_FORMAT " to %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (lower),
+        GST_TIME_ARGS (demux->rev_upper_ts));
+    demux->rev_upper_ts = lower;
+    demux->segment.position = lower;
+    if (flow == GST_FLOW_OK && lower <= demux->segment.start)
+      flow = GST_FLOW_EOS;
+  }
+
+  return flow;
+}
+
+/* key unit trick mode: moves on to the packets of the next keyframe in the
+ * simple index, returns FALSE after the last one */
+static gboolean
+gst_asf_demux_next_trick_entry (GstASFDemux * demux)
+{
+  AsfSimpleIndexEntry *entry;
+  guint idx;
+
+  for (idx = demux->trick_idx; idx < demux->sidx_num_entries; ++idx) {
+    if (demux->sidx_entries[idx].packet >= demux->trick_end_packet)
+      break;
+  }
+  if (idx >= demux->sidx_num_entries)
+    return FALSE;
+
+  entry = &demux->sidx_entries[idx];
+  GST_LOG_OBJECT (demux, "next keyframe at %" GST_TIME_FORMAT ": %u packets "
+      "from packet %u", GST_TIME_ARGS (idx * demux->sidx_interval),
+      entry->count, entry->packet);
+
+  demux->trick_idx = idx;
+  demux->packet = entry->packet;
+  demux->speed_packets = MAX (entry->count, 1);
+  demux->trick_end_packet = demux->packet + demux->speed_packets;
+  demux->trick_keyframes++;
+
+  return TRUE;
+}
+
 static void
 gst_asf_demux_loop (GstASFDemux * demux)
 {
@@ -1993,6 +2875,11 @@ gst_asf_demux_loop (GstASFDemux * demux)
       goto pause;
     }
 
+    if (gst_asf_demux_post_probe (demux)) {
+      gst_pad_pause_task (demux->sinkpad);
+      return;
+    }
+
     flow = gst_asf_demux_pull_indices (demux);
     if (flow != GST_FLOW_OK)
       goto pause;
@@ -2000,17 +2887,38 @@ gst_asf_demux_loop (GstASFDemux * demux)
 
   g_assert (demux->state == GST_ASF_DEMUX_STATE_DATA);
 
+  if (G_UNLIKELY (demux->selection_pending))
+    gst_asf_demux_apply_stream_selection (demux);
+  if (G_UNLIKELY (demux->pictures_requested))
+    gst_asf_demux_load_pictures (demux);
+  if (G_UNLIKELY (demux->renditions_changed))
+    gst_asf_demux_update_renditions (demux);
+
+  if (G_UNLIKELY (demux->reverse_gop)) {
+    flow = gst_asf_demux_pull_reverse_gop (demux);
+    if (flow == GST_FLOW_EOS)
+      goto eos;
+    if (flow != GST_FLOW_OK)
+      goto pause;
+    return;
+  }
+
   if (G_UNLIKELY (demux->num_packets != 0
           && demux->packet >= demux->num_packets))
     goto eos;
 
+  if (G_UNLIKELY (demux->trickmode_key_units
+          && demux->packet >= demux->trick_end_packet)) {
+    if (!gst_asf_demux_next_trick_entry (demux))
+      goto eos;
+  }
+
   GST_LOG_OBJECT (demux, "packet %u/%u", (guint) demux->packet + 1,
       (guint) demux->num_packets);
 
   off = demux->data_offset + (demux->packet * demux->packet_size);
 
-  if (G_UNLIKELY (!gst_asf_demux_pull_data (demux, off,
-              demux->packet_size * demux->speed_packets, &buf, &flow))) {
+  if (G_UNLIKELY (!gst_asf_demux_pull_packets (demux, off, &buf, &flow))) {
     GST_DEBUG_OBJECT (demux, "got flow %s", gst_flow_get_name (flow));
     if (flow == GST_FLOW_EOS) {
       goto eos;
@@ -2022,6 +2930,9 @@ gst_asf_demux_loop (GstASFDemux * demux)
     }
   }
 
+  if (G_UNLIKELY (demux->trickmode_key_units))
+    demux->trick_packets += demux->speed_packets;
+
   if (G_LIKELY (demux->speed_packets == 1)) {
     GstAsfDemuxParsePacketError err;
     err = gst_asf_demux_parse_packet (demux, buf);
@@ -2138,6 +3049,8 @@ eos:
     if (!demux->activated_streams)
       flow = gst_asf_demux_push_complete_payloads (demux, TRUE);
 
+    gst_asf_demux_log_trickmode_stats (demux);
+
     /* we want to push an eos or post a segment-done in any case */
     if (demux->segment.flags & GST_SEEK_FLAG_SEGMENT) {
       gint64 stop;
@@ -2249,6 +3162,11 @@ gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
       GST_TIME_FORMAT, gst_buffer_get_size (buf), GST_BUFFER_OFFSET (buf),
       GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
 
+  if (G_UNLIKELY (demux->probed)) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_EOS;
+  }
+
   if (G_UNLIKELY (GST_BUFFER_IS_DISCONT (buf))) {
     GST_DEBUG_OBJECT (demux, "received DISCONT");
     gst_asf_demux_mark_discont (demux);
@@ -2287,6 +3205,11 @@ gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
       ret = gst_asf_demux_chain_headers (demux);
       if (demux->state != GST_ASF_DEMUX_STATE_DATA)
         break;
+      if (gst_asf_demux_post_probe (demux)) {
+        gst_adapter_clear (demux->adapter);
+        ret = GST_FLOW_EOS;
+        break;
+      }
       /* otherwise fall through */
     }
     case GST_ASF_DEMUX_STATE_DATA:
@@ -2295,6 +3218,13 @@ gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 
       data_size = demux->packet_size;
 
+      if (G_UNLIKELY (demux->selection_pending))
+        gst_asf_demux_apply_stream_selection (demux);
+      if (G_UNLIKELY (demux->pictures_requested))
+        gst_asf_demux_load_pictures (demux);
+      if (G_UNLIKELY (demux->renditions_changed))
+        gst_asf_demux_update_renditions (demux);
+
       while (gst_adapter_available (demux->adapter) >= data_size) {
         GstBuffer *buf;
         GstAsfDemuxParsePacketError err;
@@ -2597,6 +3527,12 @@ gst_asf_demux_setup_pad (GstASFDemux * demux, GstPad * src_pad,
   gst_pad_set_query_function (src_pad,
       GST_DEBUG_FUNCPTR (gst_asf_demux_handle_src_query));
 
+  GST_OBJECT_LOCK (demux);
+  if (demux->output_queues)
+    gst_asf_demux_output_new (demux, src_pad, demux->max_queue_time,
+        demux->max_queue_bytes);
+  GST_OBJECT_UNLOCK (demux);
+
   stream = &demux->stream[demux->num_streams];
   stream->caps = caps;
   stream->pad = src_pad;
@@ -2606,6 +3542,8 @@ gst_asf_demux_setup_pad (GstASFDemux * demux, GstPad * src_pad,
   stream->pending_tags = tags;
   stream->discont = TRUE;
   stream->first_buffer = TRUE;
+  stream->selected = TRUE;
+  stream->rendition = -1;
   stream->streamheader = streamheader;
   if (stream->streamheader) {
     stream->streamheader = gst_buffer_make_writable (streamheader);
@@ -2939,46 +3877,558 @@ gst_asf_demux_add_video_stream (GstASFDemux * demux,
       streamheader, tags);
 }
 
+static void
+gst_asf_demux_push_stream_start (GstASFDemux * demux, AsfStream * stream)
+{
+  GstEvent *event;
+
+  event = gst_pad_get_sticky_event (demux->sinkpad, GST_EVENT_STREAM_START, 0);
+  if (event) {
+    if (gst_event_parse_group_id (event, &demux->group_id))
+      demux->have_group_id = TRUE;
+    else
+      demux->have_group_id = FALSE;
+    gst_event_unref (event);
+  } else if (!demux->have_group_id) {
+    demux->have_group_id = TRUE;
+    demux->group_id = gst_util_group_id_next ();
+  }
+
+  event = gst_event_new_stream_start (gst_stream_get_stream_id
+      (stream->gst_stream));
+  if (demux->have_group_id)
+    gst_event_set_group_id (event, demux->group_id);
+  gst_event_set_stream (event, stream->gst_stream);
+
+  gst_asf_demux_push_event (stream, event);
+  gst_asf_demux_push_event (stream,
+      gst_event_new_stream_collection (demux->collection));
+}
+
 static void
 gst_asf_demux_activate_stream (GstASFDemux * demux, AsfStream * stream)
 {
   if (!stream->active) {
-    GstEvent *event;
-    gchar *stream_id;
-
     GST_INFO_OBJECT (demux, "Activating stream %2u, pad %s, caps %"
         GST_PTR_FORMAT, stream->id, GST_PAD_NAME (stream->pad), stream->caps);
     gst_pad_set_active (stream->pad, TRUE);
 
+    gst_asf_demux_push_stream_start (demux, stream);
+    gst_asf_demux_set_stream_caps (stream);
+
+    gst_element_add_pad (GST_ELEMENT_CAST (demux), stream->pad);
+    gst_flow_combiner_add_pad (demux->flowcombiner, stream->pad);
+    stream->active = TRUE;
+  }
+}
+
+/* a stream reselected after the initial activation either already received
+ * EOS on its pad or never got a pad, so it needs to be (re)started before
+ * any data goes out */
+static void
+gst_asf_demux_restart_stream (GstASFDemux * demux, AsfStream * stream)
+{
+  GST_INFO_OBJECT (demux, "restarting reselected stream %u", stream->id);
+
+  if (stream->active) {
+    gst_asf_demux_push_stream_start (demux, stream);
+    gst_asf_demux_set_stream_caps (stream);
+  } else {
+    gst_asf_demux_activate_stream (demux, stream);
+  }
+  gst_asf_demux_push_event (stream, gst_event_new_segment (&demux->segment));
+  stream->restart = FALSE;
+}
+
+static void
+gst_asf_demux_flush_stream_payloads (AsfStream * stream)
+{
+  while (stream->payloads->len > 0) {
+    AsfPayload *payload;
+    guint last;
+
+    last = stream->payloads->len - 1;
+    payload = &g_array_index (stream->payloads, AsfPayload, last);
+    gst_buffer_replace (&payload->buf, NULL);
+    g_array_remove_index (stream->payloads, last);
+  }
+}
+
+/* call with the object lock */
+static guint32
+gst_asf_demux_rendition_limit (GstASFDemux * demux, AsfRenditionGroup * group)
+{
+  guint32 limit = demux->max_bitrate;
+
+  if (group->qos_limit != 0 && (limit == 0 || group->qos_limit < limit))
+    limit = group->qos_limit;
+
+  return limit;
+}
+
+/* highest bitrate rendition within @limit, or the lowest if none fits */
+static AsfStream *
+gst_asf_demux_pick_rendition (GstASFDemux * demux, AsfRenditionGroup * group,
+    guint32 limit)
+{
+  AsfStream *best = NULL, *lowest = NULL;
+  guint i;
+
+  for (i = 0; i < group->num_ids; i++) {
+    AsfStream *stream = gst_asf_demux_get_stream (demux, group->ids[i]);
+
+    if (stream == NULL)
+      continue;
+    if (lowest == NULL || stream->bitrate < lowest->bitrate)
+      lowest = stream;
+    if ((limit == 0 || stream->bitrate <= limit)
+        && (best == NULL || stream->bitrate > best->bitrate))
+      best = stream;
+  }
+
+  return best ? best : lowest;
+}
+
+/* resolves the bitrate exclusion groups now that all streams are known and
+ * deselects all but one rendition of each */
+static void
+gst_asf_demux_setup_renditions (GstASFDemux * demux)
+{
+  guint i, j;
+
+  if (demux->renditions == NULL)
+    return;
+
+  for (i = 0; i < demux->renditions->len; i++) {
+    AsfRenditionGroup *group =
+        &g_array_index (demux->renditions, AsfRenditionGroup, i);
+    guint num_streams = 0;
+
+    for (j = 0; j < group->num_ids; j++) {
+      AsfStream *stream = gst_asf_demux_get_stream (demux, group->ids[j]);
+
+      if (stream == NULL)
+        continue;
+      if (stream->bitrate == 0)
+        stream->bitrate = stream->ext_props.data_bitrate;
+      ++num_streams;
+    }
+
+    /* dual stream 3D uses exclusion groups for the two views */
+    if (num_streams < 2 || demux->asf_3D_mode == GST_ASF_3D_DUAL_STREAM) {
+      group->num_ids = 0;
+      continue;
+    }
+
+    GST_OBJECT_LOCK (demux);
+    group->current = gst_asf_demux_pick_rendition (demux, group,
+        gst_asf_demux_rendition_limit (demux, group));
+    GST_OBJECT_UNLOCK (demux);
+
+    for (j = 0; j < group->num_ids; j++) {
+      AsfStream *stream = gst_asf_demux_get_stream (demux, group->ids[j]);
+
+      if (stream == NULL)
+        continue;
+      stream->rendition = i;
+      stream->selected = (stream == group->current);
+      GST_INFO_OBJECT (demux, "rendition group %u: stream %u, %u bps%s", i,
+          stream->id, stream->bitrate, stream->selected ? ", selected" : "");
+    }
+  }
+}
+
+static void
+gst_asf_demux_post_collection (GstASFDemux * demux)
+{
+  guint i;
+
+  gst_asf_demux_setup_renditions (demux);
+
+  gst_object_replace ((GstObject **) & demux->collection, NULL);
+  demux->collection = gst_stream_collection_new (NULL);
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+    gchar *stream_id;
+
     stream_id =
         gst_pad_create_stream_id_printf (stream->pad, GST_ELEMENT_CAST (demux),
         "%03u", stream->id);
+    gst_object_replace ((GstObject **) & stream->gst_stream, NULL);
+    stream->gst_stream = gst_stream_new (stream_id, stream->caps,
+        stream->is_video ? GST_STREAM_TYPE_VIDEO : GST_STREAM_TYPE_AUDIO,
+        stream->selected ? GST_STREAM_FLAG_NONE : GST_STREAM_FLAG_UNSELECT);
+    if (stream->pending_tags)
+      gst_stream_set_tags (stream->gst_stream, stream->pending_tags);
+    g_free (stream_id);
 
-    event =
-        gst_pad_get_sticky_event (demux->sinkpad, GST_EVENT_STREAM_START, 0);
-    if (event) {
-      if (gst_event_parse_group_id (event, &demux->group_id))
-        demux->have_group_id = TRUE;
-      else
-        demux->have_group_id = FALSE;
-      gst_event_unref (event);
-    } else if (!demux->have_group_id) {
-      demux->have_group_id = TRUE;
-      demux->group_id = gst_util_group_id_next ();
+    gst_stream_collection_add_stream (demux->collection,
+        gst_object_ref (stream->gst_stream));
+  }
+
+  GST_DEBUG_OBJECT (demux, "posting collection with %u streams",
+      demux->num_streams);
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_stream_collection (GST_OBJECT_CAST (demux),
+          demux->collection));
+}
+
+/* in probe mode, post what the header told us once it is parsed; the
+ * collection itself went out when the data object was found. Returns TRUE
+ * if the caller should stop there. */
+static gboolean
+gst_asf_demux_post_probe (GstASFDemux * demux)
+{
+  GstTagList *tags;
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  gboolean probe;
+
+  GST_OBJECT_LOCK (demux);
+  probe = demux->probe;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (!probe)
+    return FALSE;
+
+  if (demux->play_time > 0)
+    duration = demux->play_time;
+
+  tags = demux->taglist ? gst_tag_list_copy (demux->taglist) :
+      gst_tag_list_new_empty ();
+  gst_tag_list_set_scope (tags, GST_TAG_SCOPE_GLOBAL);
+  gst_tag_list_add (tags, GST_TAG_MERGE_KEEP, GST_TAG_CONTAINER_FORMAT, "ASF",
+      NULL);
+  if (GST_CLOCK_TIME_IS_VALID (duration))
+    gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE, GST_TAG_DURATION, duration,
+        NULL);
+
+  GST_DEBUG_OBJECT (demux, "probe done, %u streams, duration %"
+      GST_TIME_FORMAT, demux->num_streams, GST_TIME_ARGS (duration));
+
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_tag (GST_OBJECT_CAST (demux), tags));
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_element (GST_OBJECT_CAST (demux),
+          gst_structure_new ("probe-done",
+              "duration", G_TYPE_UINT64, duration,
+              "seekable", G_TYPE_BOOLEAN, demux->seekable,
+              "num-streams", G_TYPE_UINT, demux->num_streams, NULL)));
+
+  demux->probed = TRUE;
+  return TRUE;
+}
+
+static void
+gst_asf_demux_post_streams_selected (GstASFDemux * demux, guint32 seqnum)
+{
+  GstMessage *msg;
+  guint i;
+
+  msg = gst_message_new_streams_selected (GST_OBJECT_CAST (demux),
+      demux->collection);
+  if (seqnum)
+    gst_message_set_seqnum (msg, seqnum);
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+
+    /* a rendition waiting for its keyframe is not output yet */
+    if (stream->rendition >= 0 && stream != g_array_index (demux->renditions,
+            AsfRenditionGroup, stream->rendition).current)
+      continue;
+    if (stream->selected)
+      gst_message_streams_selected_add (msg, stream->gst_stream);
+  }
+
+  gst_element_post_message (GST_ELEMENT_CAST (demux), msg);
+}
+
+static gboolean
+gst_asf_demux_handle_select_streams (GstASFDemux * demux, GstEvent * event)
+{
+  GList *streams = NULL;
+
+  if (demux->collection == NULL)
+    return FALSE;
+
+  gst_event_parse_select_streams (event, &streams);
+
+  GST_OBJECT_LOCK (demux);
+  g_list_free_full (demux->pending_selection, g_free);
+  demux->pending_selection = streams;
+  demux->selection_seqnum = gst_event_get_seqnum (event);
+  demux->selection_pending = TRUE;
+  GST_OBJECT_UNLOCK (demux);
+
+  return TRUE;
+}
+
+static gboolean
+gst_asf_demux_selection_contains (GList * selection, AsfStream * stream)
+{
+  return g_list_find_custom (selection,
+      gst_stream_get_stream_id (stream->gst_stream),
+      (GCompareFunc) g_strcmp0) != NULL;
+}
+
+/* called from the streaming thread before parsing packets, so that payloads
+ * of deselected streams are skipped from then on */
+static void
+gst_asf_demux_apply_stream_selection (GstASFDemux * demux)
+{
+  GList *selection;
+  guint32 seqnum;
+  guint i, j;
+
+  GST_OBJECT_LOCK (demux);
+  selection = demux->pending_selection;
+  seqnum = demux->selection_seqnum;
+  demux->pending_selection = NULL;
+  demux->selection_pending = FALSE;
+  GST_OBJECT_UNLOCK (demux);
+
+  /* selecting any rendition of a group selects the group; selecting one
+   * other than the current one pins the group to it, selecting the current
+   * one leaves the choice to the adaptive logic */
+  for (i = 0; demux->renditions && i < demux->renditions->len; i++) {
+    AsfRenditionGroup *group =
+        &g_array_index (demux->renditions, AsfRenditionGroup, i);
+    AsfStream *forced = NULL;
+
+    if (group->num_ids == 0)
+      continue;
+
+    for (j = 0; j < group->num_ids; j++) {
+      AsfStream *stream = gst_asf_demux_get_stream (demux, group->ids[j]);
+
+      if (stream && stream != group->current
+          && gst_asf_demux_selection_contains (selection, stream))
+        forced = stream;
+    }
+    if (forced != group->forced) {
+      group->forced = forced;
+      demux->renditions_changed = TRUE;
     }
+  }
 
-    event = gst_event_new_stream_start (stream_id);
-    if (demux->have_group_id)
-      gst_event_set_group_id (event, demux->group_id);
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+    gboolean selected;
 
-    gst_pad_push_event (stream->pad, event);
-    g_free (stream_id);
-    gst_pad_set_caps (stream->pad, stream->caps);
+    if (stream->rendition >= 0) {
+      AsfRenditionGroup *group = &g_array_index (demux->renditions,
+          AsfRenditionGroup, stream->rendition);
 
-    gst_element_add_pad (GST_ELEMENT_CAST (demux), stream->pad);
-    gst_flow_combiner_add_pad (demux->flowcombiner, stream->pad);
-    stream->active = TRUE;
+      if (stream != group->current)
+        continue;
+
+      selected = FALSE;
+      for (j = 0; j < group->num_ids && !selected; j++) {
+        AsfStream *other = gst_asf_demux_get_stream (demux, group->ids[j]);
+
+        selected = other && gst_asf_demux_selection_contains (selection, other);
+      }
+    } else {
+      selected = gst_asf_demux_selection_contains (selection, stream);
+    }
+
+    if (selected == stream->selected)
+      continue;
+
+    GST_INFO_OBJECT (demux, "stream %u %s", stream->id,
+        selected ? "selected" : "deselected");
+    stream->selected = selected;
+
+    if (selected) {
+      stream->discont = TRUE;
+      stream->first_buffer = TRUE;
+      stream->restart = stream->active || demux->activated_streams;
+      continue;
+    }
+
+    gst_asf_demux_flush_stream_payloads (stream);
+    stream->restart = FALSE;
+    if (stream->active)
+      gst_asf_demux_push_event (stream, gst_event_new_eos ());
+    if (stream->rendition >= 0) {
+      AsfRenditionGroup *group = &g_array_index (demux->renditions,
+          AsfRenditionGroup, stream->rendition);
+
+      if (group->pending)
+        gst_asf_demux_cancel_rendition_switch (demux, group);
+    }
+  }
+
+  g_list_free_full (selection, g_free);
+  gst_asf_demux_post_streams_selected (demux, seqnum);
+}
+
+static void
+gst_asf_demux_cancel_rendition_switch (GstASFDemux * demux,
+    AsfRenditionGroup * group)
+{
+  GST_DEBUG_OBJECT (demux, "cancelling switch to stream %u",
+      group->pending->id);
+  group->pending->selected = FALSE;
+  gst_asf_demux_flush_stream_payloads (group->pending);
+  group->pending = NULL;
+}
+
+/* picks the rendition each group should output after a change of the
+ * bitrate limits or the selection; the switch itself happens on the next
+ * keyframe of the new rendition */
+static void
+gst_asf_demux_update_renditions (GstASFDemux * demux)
+{
+  guint i;
+
+  GST_OBJECT_LOCK (demux);
+  demux->renditions_changed = FALSE;
+
+  for (i = 0; demux->renditions && i < demux->renditions->len; i++) {
+    AsfRenditionGroup *group =
+        &g_array_index (demux->renditions, AsfRenditionGroup, i);
+    AsfStream *target;
+
+    /* deselected groups keep their current rendition for when they come
+     * back */
+    if (group->num_ids == 0 || !group->current->selected)
+      continue;
+
+    if (group->forced)
+      target = group->forced;
+    else
+      target = gst_asf_demux_pick_rendition (demux, group,
+          gst_asf_demux_rendition_limit (demux, group));
+
+    if (target == group->pending)
+      continue;
+    if (group->pending)
+      gst_asf_demux_cancel_rendition_switch (demux, group);
+    if (target == group->current)
+      continue;
+
+    GST_INFO_OBJECT (demux, "switching from stream %u (%u bps) to %u (%u bps)",
+        group->current->id, group->current->bitrate, target->id,
+        target->bitrate);
+
+    if (!demux->activated_streams) {
+      /* nothing went out yet, no need to wait for a keyframe */
+      group->current->selected = FALSE;
+      gst_asf_demux_flush_stream_payloads (group->current);
+      target->selected = TRUE;
+      group->current = target;
+      continue;
+    }
+
+    target->selected = TRUE;
+    target->discont = TRUE;
+    group->pending = target;
+    group->switch_requested = g_get_monotonic_time ();
+    group->switch_position = demux->segment.position;
   }
+  GST_OBJECT_UNLOCK (demux);
+}
+
+/* the pending rendition has a keyframe up next: it takes over the pad of
+ * the current one, which then gets deselected */
+static void
+gst_asf_demux_switch_rendition (GstASFDemux * demux, AsfRenditionGroup * group,
+    GstClockTime keyframe_ts)
+{
+  AsfStream *old = group->current;
+  AsfStream *new = group->pending;
+  GstPad *pad;
+
+  GST_OBJECT_LOCK (demux);
+  pad = old->pad;
+  old->pad = new->pad;
+  new->pad = pad;
+  new->active = old->active;
+  old->active = FALSE;
+  group->current = new;
+  group->pending = NULL;
+  GST_OBJECT_UNLOCK (demux);
+
+  old->selected = FALSE;
+  gst_asf_demux_flush_stream_payloads (old);
+
+  new->not_linked = old->not_linked;
+  old->not_linked = FALSE;
+  new->first_buffer = TRUE;
+  new->discont = TRUE;
+  new->restart = TRUE;
+
+  GST_CAT_INFO_OBJECT (CAT_PERFORMANCE, demux, "switched from stream %u "
+      "(%u bps) to %u (%u bps) after %" G_GINT64_FORMAT " ms, keyframe at %"
+      GST_TIME_FORMAT " (%" GST_STIME_FORMAT " after the decision)", old->id,
+      old->bitrate, new->id, new->bitrate,
+      (g_get_monotonic_time () - group->switch_requested) / 1000,
+      GST_TIME_ARGS (keyframe_ts),
+      GST_STIME_ARGS (GST_CLOCK_DIFF (group->switch_position, keyframe_ts)));
+
+  gst_asf_demux_post_streams_selected (demux, 0);
+}
+
+/* lowers the bitrate of a rendition group while downstream is late and
+ * slowly raises it again once downstream has caught up */
+static void
+gst_asf_demux_handle_qos (GstASFDemux * demux, GstPad * pad, GstEvent * event)
+{
+  AsfRenditionGroup *group = NULL;
+  AsfStream *current;
+  GstClockTimeDiff diff;
+  gdouble proportion;
+  guint32 limit = 0;
+  gint64 now;
+  guint i;
+
+  gst_event_parse_qos (event, NULL, &proportion, &diff, NULL);
+  now = g_get_monotonic_time ();
+
+  GST_OBJECT_LOCK (demux);
+  for (i = 0; i < demux->num_streams; i++) {
+    AsfStream *stream = &demux->stream[i];
+
+    if (stream->pad == pad && stream->rendition >= 0) {
+      group = &g_array_index (demux->renditions, AsfRenditionGroup,
+          stream->rendition);
+      break;
+    }
+  }
+  if (group == NULL || group->num_ids == 0 || group->forced)
+    goto done;
+
+  current = group->current;
+
+  if (diff > 0 && proportion > 1.0) {
+    if (now - group->qos_changed < QOS_DOWN_INTERVAL || current->bitrate <= 1)
+      goto done;
+    limit = current->bitrate - 1;
+  } else if (diff < 0 && proportion < 0.75 && group->qos_limit != 0) {
+    if (now - group->qos_changed < QOS_UP_INTERVAL)
+      goto done;
+    /* next rendition up, no limit past the highest */
+    for (i = 0; i < group->num_ids; i++) {
+      AsfStream *stream = gst_asf_demux_get_stream (demux, group->ids[i]);
+
+      if (stream && stream->bitrate > current->bitrate
+          && (limit == 0 || stream->bitrate < limit))
+        limit = stream->bitrate;
+    }
+  } else {
+    goto done;
+  }
+
+  GST_DEBUG_OBJECT (pad, "QoS proportion %g, diff %" GST_STIME_FORMAT
+      ", rendition limit now %u bps", proportion, GST_STIME_ARGS (diff), limit);
+  group->qos_limit = limit;
+  group->qos_changed = now;
+  demux->renditions_changed = TRUE;
+
+done:
+  GST_OBJECT_UNLOCK (demux);
 }
 
 static AsfStream *
@@ -3266,6 +4716,98 @@ not_enough_data:
   }
 }
 
+/* skips a WM/Picture descriptor value, only remembering where it is: in
+ * pull mode we can read it again later, when streaming we have to keep
+ * the bytes, but still save the typefinding and the sample */
+static gboolean
+gst_asf_demux_record_picture (GstASFDemux * demux, guint8 ** p_data,
+    guint64 * p_size)
+{
+  AsfPicture picture = { 0, };
+  guint16 len;
+
+  if (*p_size < 2)
+    return FALSE;
+
+  len = gst_asf_demux_get_uint16 (p_data, p_size);
+  if (*p_size < len)
+    return FALSE;
+
+  picture.size = len;
+  if (demux->header_data != NULL)
+    picture.offset = demux->base_offset + (*p_data - demux->header_data);
+  else
+    picture.data = gst_buffer_new_wrapped (g_memdup (*p_data, len), len);
+
+  GST_DEBUG_OBJECT (demux, "recorded picture of %u bytes at offset %"
+      G_GUINT64_FORMAT, picture.size, picture.offset);
+
+  if (demux->pictures == NULL)
+    demux->pictures = g_array_new (FALSE, TRUE, sizeof (AsfPicture));
+  g_array_append_val (demux->pictures, picture);
+
+  gst_asf_demux_skip_bytes (len, p_data, p_size);
+  return TRUE;
+}
+
+/* turns the recorded pictures into image tags, once parse-images got
+ * enabled; they go out with the other global tags, or update them if
+ * those were already sent */
+static void
+gst_asf_demux_load_pictures (GstASFDemux * demux)
+{
+  GstTagList *tags, *merged;
+  guint i;
+
+  GST_OBJECT_LOCK (demux);
+  demux->pictures_requested = FALSE;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (demux->pictures == NULL || demux->pictures->len == 0)
+    return;
+
+  tags = gst_tag_list_new_empty ();
+  for (i = 0; i < demux->pictures->len; i++) {
+    AsfPicture *picture = &g_array_index (demux->pictures, AsfPicture, i);
+    GstBuffer *buf = NULL;
+    GstMapInfo map;
+
+    if (picture->data != NULL)
+      buf = gst_buffer_ref (picture->data);
+    else if (!gst_asf_demux_pull_data (demux, picture->offset, picture->size,
+            &buf, NULL))
+      continue;
+
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    asf_demux_parse_picture_tag (tags, map.data, map.size);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+  gst_asf_demux_clear_pictures (demux);
+
+  GST_DEBUG_OBJECT (demux, "loaded pictures: %" GST_PTR_FORMAT, tags);
+
+  if (demux->sent_taglist == NULL) {
+    gst_asf_demux_add_global_tags (demux, tags);
+    return;
+  }
+
+  if (gst_tag_list_is_empty (tags)) {
+    gst_tag_list_unref (tags);
+    return;
+  }
+
+  merged = gst_tag_list_merge (demux->sent_taglist, tags,
+      GST_TAG_MERGE_APPEND);
+  gst_tag_list_set_scope (merged, GST_TAG_SCOPE_GLOBAL);
+  gst_tag_list_unref (tags);
+  gst_tag_list_unref (demux->sent_taglist);
+  demux->sent_taglist = merged;
+
+  gst_asf_demux_send_event_unlocked (demux,
+      gst_event_new_tag (gst_tag_list_ref (merged)));
+}
+
 /* Extended Content Description Object */
 static GstFlowReturn
 gst_asf_demux_process_ext_content_desc (GstASFDemux * demux, guint8 * data,
@@ -3311,8 +4853,14 @@ gst_asf_demux_process_ext_content_desc (GstASFDemux * demux, guint8 * data,
     "OverUnderLT", GST_ASF_3D_TOP_AND_BOTTOM_HALF_LR}, {
     "DualStream", GST_ASF_3D_DUAL_STREAM}
   };
+  gboolean parse_images;
+
   GST_INFO_OBJECT (demux, "object is an extended content description");
 
+  GST_OBJECT_LOCK (demux);
+  parse_images = demux->parse_images;
+  GST_OBJECT_UNLOCK (demux);
+
   taglist = gst_tag_list_new_empty ();
 
   /* Content Descriptor Count */
@@ -3343,15 +4891,26 @@ gst_asf_demux_process_ext_content_desc (GstASFDemux * demux, guint8 * data,
     /* Descriptor Value Data Type */
     datatype = gst_asf_demux_get_uint16 (&data, &size);
 
+    name_utf8 =
+        g_convert (name, name_len, "UTF-8", "UTF-16LE", &in, &out, NULL);
+
+    /* leave pictures alone until someone wants them, not even copying */
+    if (!parse_images && datatype == ASF_DEMUX_DATA_TYPE_BYTE_ARRAY &&
+        name_utf8 != NULL && strcmp (name_utf8, "WM/Picture") == 0) {
+      g_free (name);
+      g_free (name_utf8);
+      if (!gst_asf_demux_record_picture (demux, &data, &size))
+        goto not_enough_data;
+      continue;
+    }
+
     /* Descriptor Value (not really a string, but same thing reading-wise) */
     if (!gst_asf_demux_get_string (&value, &value_len, &data, &size)) {
       g_free (name);
+      g_free (name_utf8);
       goto not_enough_data;
     }
 
-    name_utf8 =
-        g_convert (name, name_len, "UTF-8", "UTF-16LE", &in, &out, NULL);
-
     if (name_utf8 != NULL) {
       GST_DEBUG ("Found tag/metadata %s", name_utf8);
 
@@ -3650,6 +5209,8 @@ gst_asf_demux_process_header (GstASFDemux * demux, guint8 * data, guint64 size)
   GstFlowReturn ret = GST_FLOW_OK;
   guint32 i, num_objects;
   guint8 unknown G_GNUC_UNUSED;
+  guint64 header_size = size;
+  gint64 start;
 
   /* Get the rest of the header's header */
   if (size < (4 + 1 + 1))
@@ -3661,6 +5222,7 @@ gst_asf_demux_process_header (GstASFDemux * demux, guint8 * data, guint64 size)
 
   GST_INFO_OBJECT (demux, "object is a header with %u parts", num_objects);
   demux->saw_file_header = FALSE;
+  start = g_get_monotonic_time ();
   /* Loop through the header's objects, processing those */
   for (i = 0; i < num_objects; ++i) {
     GST_INFO_OBJECT (demux, "reading header part %u", i);
@@ -3670,6 +5232,10 @@ gst_asf_demux_process_header (GstASFDemux * demux, guint8 * data, guint64 size)
       break;
     }
   }
+  GST_CAT_INFO_OBJECT (CAT_PERFORMANCE, demux, "parsed %" G_GUINT64_FORMAT
+      " bytes of header in %" G_GINT64_FORMAT " us, %u pictures deferred",
+      header_size, g_get_monotonic_time () - start,
+      demux->pictures ? demux->pictures->len : 0);
   if (!demux->saw_file_header) {
     GST_ELEMENT_ERROR (demux, STREAM, DEMUX, (NULL),
         ("Header does not have mandatory FILE section"));
@@ -3882,6 +5448,7 @@ gst_asf_demux_process_bitrate_props_object (GstASFDemux * demux, guint8 * data,
       GST_DEBUG_OBJECT (demux, "bitrate of stream %u = %u", stream_id, bitrate);
       stream = gst_asf_demux_get_stream (demux, stream_id);
       if (stream) {
+        stream->bitrate = bitrate;
         if (stream->pending_tags == NULL)
           stream->pending_tags = gst_tag_list_new_empty ();
         gst_tag_list_add (stream->pending_tags, GST_TAG_MERGE_REPLACE,
@@ -4048,6 +5615,8 @@ static GstFlowReturn
 gst_asf_demux_process_advanced_mutual_exclusion (GstASFDemux * demux,
     guint8 * data, guint64 size)
 {
+  AsfRenditionGroup group = { {0,}, 0, };
+  AsfMutexType mutex_type;
   ASFGuid guid;
   guint16 num, i;
 
@@ -4055,6 +5624,7 @@ gst_asf_demux_process_advanced_mutual_exclusion (GstASFDemux * demux,
     goto not_enough_data;
 
   gst_asf_demux_get_guid (&guid, &data, &size);
+  mutex_type = gst_asf_demux_identify_guid (asf_mutex_guids, &guid);
   num = gst_asf_demux_get_uint16 (&data, &size);
 
   if (num < 2) {
@@ -4073,8 +5643,17 @@ gst_asf_demux_process_advanced_mutual_exclusion (GstASFDemux * demux,
 
     demux->mut_ex_streams =
         g_slist_append (demux->mut_ex_streams, GINT_TO_POINTER (mes));
+
+    if (group.num_ids < G_N_ELEMENTS (group.ids))
+      group.ids[group.num_ids++] = mes;
   }
 
+  /* the streams are resolved once all of them are known */
+  if (mutex_type == ASF_MUTEX_BITRATE) {
+    if (demux->renditions == NULL)
+      demux->renditions = g_array_new (FALSE, TRUE, sizeof (AsfRenditionGroup));
+    g_array_append_val (demux->renditions, group);
+  }
 
   return GST_FLOW_OK;
 
@@ -4624,7 +6203,7 @@ gst_asf_demux_send_event_unlocked (GstASFDemux * demux, GstEvent * event)
 
   for (i = 0; i < demux->num_streams; ++i) {
     gst_event_ref (event);
-    ret &= gst_pad_push_event (demux->stream[i].pad, event);
+    ret &= gst_asf_demux_push_event (&demux->stream[i], event);
   }
   gst_event_unref (event);
   return ret;
@@ -46,12 +46,21 @@ GST_DEBUG_CATEGORY_EXTERN (asfdemux_dbg);
 typedef struct _GstASFDemux GstASFDemux;
 typedef struct _GstASFDemuxClass GstASFDemuxClass;
 typedef enum _GstASF3DMode GstASF3DMode;
+typedef struct _AsfOutputQueue AsfOutputQueue;
 
 typedef struct {
   guint32	packet;
   guint16	count;
 } AsfSimpleIndexEntry;
 
+/* WM/Picture value left unparsed, see the parse-images property */
+typedef struct {
+  guint64     offset;     /* of the value in the file, when pulling         */
+  guint32     size;
+  GstBuffer  *data;       /* the value itself when streaming, as we can't
+                           * read it again                                  */
+} AsfPicture;
+
 typedef struct {
   AsfPayloadExtensionID   id : 16;  /* extension ID; the :16 makes sure the
                                      * struct gets packed into 4 bytes       */
@@ -106,6 +115,18 @@ typedef struct
   GstPad     *pad;
   guint16     id;
 
+  /* stream selection; payloads of deselected or unlinked streams are
+   * skipped without creating buffers */
+  GstStream  *gst_stream;
+  gboolean    selected;
+  gboolean    not_linked;   /* last push returned NOT_LINKED */
+  gboolean    restart;      /* reselected after EOS, resend sticky events */
+
+  /* index into GstASFDemux::renditions if this is one of several bitrate
+   * renditions of the same content, -1 otherwise */
+  gint        rendition;
+  guint32     bitrate;
+
   /* video-only */
   gboolean    is_video;
   gboolean    fps_known;
@@ -118,6 +139,7 @@ typedef struct
 
   gboolean    discont;
   gboolean    first_buffer;
+  gboolean    preroll_gap;  /* activated without data, push a gap first */
 
   /* Descrambler settings */
   guint8               span;
@@ -152,11 +174,33 @@ typedef enum {
 
 #define GST_ASF_DEMUX_IS_REVERSE_PLAYBACK(seg) (seg.rate < 0.0? TRUE:FALSE)
 
+/* reverse playback that parses packet by packet backwards, rather than
+ * reading whole GOPs forwards */
+#define GST_ASF_DEMUX_STEPS_BACKWARDS(demux) \
+  (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK ((demux)->segment) && !(demux)->reverse_gop)
+
 #define GST_ASF_DEMUX_NUM_VIDEO_PADS   16
 #define GST_ASF_DEMUX_NUM_AUDIO_PADS   32
 #define GST_ASF_DEMUX_NUM_STREAMS      32
 #define GST_ASF_DEMUX_NUM_STREAM_IDS  127
 
+/* bitrate mutual exclusion group: only one rendition at a time is output,
+ * on the pad of the current one; switches happen at keyframes */
+typedef struct
+{
+  guint8        ids[GST_ASF_DEMUX_NUM_STREAMS];
+  guint         num_ids;
+
+  AsfStream    *current;         /* rendition being output                  */
+  AsfStream    *pending;         /* waiting for its keyframe to switch, or NULL */
+  AsfStream    *forced;          /* picked with SELECT_STREAMS, or NULL     */
+
+  guint32       qos_limit;       /* bitrate limit from downstream QoS, or 0 */
+  gint64        qos_changed;     /* monotonic time of the last QoS limit    */
+  gint64        switch_requested; /* monotonic time pending was picked      */
+  GstClockTime  switch_position; /* segment position when pending was picked */
+} AsfRenditionGroup;
+
 struct _GstASFDemux {
   GstElement 	     element;
 
@@ -167,6 +211,13 @@ struct _GstASFDemux {
 
   GstAdapter        *adapter;
   GstTagList        *taglist;
+  GstTagList        *sent_taglist;  /* global tags last pushed downstream */
+
+  /* pictures are only typefound and turned into samples when asked for */
+  gboolean           parse_images;       /* under object lock */
+  gboolean           pictures_requested; /* set under object lock */
+  GArray            *pictures;           /* AsfPicture */
+  const guint8      *header_data;        /* header being parsed, pull mode */
   GstASFDemuxState   state;
 
   /* byte offset where the asf starts, which might not be zero on chained
@@ -180,6 +231,29 @@ struct _GstASFDemux {
   gint64             packet;       /* current packet                           */
   guint              speed_packets; /* Known number of packets to get in one go*/
 
+  /* key unit trick mode: only the packets of each index entry are read and
+   * only video keyframes are parsed out of them */
+  gboolean           trickmode_key_units;
+  guint              trick_idx;          /* simple index entry being read   */
+  gint64             trick_end_packet;   /* first packet after the entry    */
+  gint64             trick_start_packet; /* packet the trick mode began at  */
+  guint64            trick_keyframes;    /* index entries visited           */
+  guint64            trick_packets;      /* packets read for them           */
+
+  /* GOP-at-a-time reverse playback: the packets from one keyframe in the
+   * simple index to the next are read and parsed forwards in one go, and
+   * the GOPs are pushed in reverse order */
+  gboolean           reverse_gop;
+  guint              rev_idx;            /* index entry of the last GOP read */
+  gint64             rev_kf_packet;      /* first packet of the last GOP read */
+  gint64             rev_end_packet;     /* end of the next GOP to read      */
+  GstClockTime       rev_upper_ts;       /* start of the last GOP pushed     */
+
+  /* pull mode: packets are parsed from blocks of read_block_size bytes */
+  guint              read_block_size;
+  GstBuffer         *block;        /* packets at block_offset, or NULL       */
+  guint64            block_offset;
+
   gchar              **languages;
   guint                num_languages;
 
@@ -194,8 +268,33 @@ struct _GstASFDemux {
   guint32              num_streams;
   AsfStream            stream[GST_ASF_DEMUX_NUM_STREAMS];
   gboolean             activated_streams;
+  guint64              preroll_bytes;    /* queued before activation (approx.) */
+  GstClockTime         max_preroll_time; /* under object lock */
+  guint                max_preroll_bytes; /* under object lock */
+
+  /* header-only probing: stop once the header is parsed */
+  gboolean             probe;            /* under object lock */
+  gboolean             probed;
   GstFlowCombiner     *flowcombiner;
 
+  GstStreamCollection *collection;
+  GList               *pending_selection; /* stream ids, under object lock */
+  gboolean             selection_pending;
+  guint32              selection_seqnum;
+  guint64              payload_bytes_skipped;
+
+  GArray              *renditions;       /* AsfRenditionGroup */
+  guint32              max_bitrate;      /* under object lock */
+  gboolean             renditions_changed;
+
+  /* per-pad output queues pushed from tasks of their own (asfoutput.c),
+   * created for new pads when output_queues is set (under object lock) */
+  gboolean             output_queues;
+  GstClockTime         max_queue_time;
+  guint                max_queue_bytes;
+  GMutex               output_lock;      /* protects all output queues */
+  GCond                output_space;     /* an output queue got drained */
+
   /* for chained asf handling, we need to hold the old asf streams until
    * we detect the new ones */
   AsfStream            old_stream[GST_ASF_DEMUX_NUM_STREAMS];
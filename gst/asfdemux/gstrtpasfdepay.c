@@ -101,7 +101,17 @@ gst_rtp_asf_depay_class_init (GstRtpAsfDepayClass * klass)
 static void
 gst_rtp_asf_depay_init (GstRtpAsfDepay * depay)
 {
-  depay->adapter = gst_adapter_new ();
+}
+
+static void
+gst_rtp_asf_depay_clear_fragments (GstRtpAsfDepay * depay)
+{
+  if (depay->frag) {
+    gst_buffer_unmap (depay->frag, &depay->frag_map);
+    gst_buffer_unref (depay->frag);
+    depay->frag = NULL;
+  }
+  depay->frag_len = 0;
 }
 
 static void
@@ -111,7 +121,9 @@ gst_rtp_asf_depay_finalize (GObject * object)
 
   depay = GST_RTP_ASF_DEPAY (object);
 
-  g_object_unref (depay->adapter);
+  gst_rtp_asf_depay_clear_fragments (depay);
+  if (depay->padding)
+    gst_memory_unref (depay->padding);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -128,9 +140,11 @@ gst_rtp_asf_depay_setcaps (GstRTPBaseDepayload * depayload, GstCaps * caps)
   const gchar *config_str, *ps_string;
   GstBuffer *buf;
   GstCaps *src_caps;
+  GstMemory *padding;
+  GstMapInfo map;
   guint8 *headers;
   gsize headers_len;
-  gint clock_rate;
+  gint clock_rate, packet_size;
 
   depay = GST_RTP_ASF_DEPAY (depayload);
 
@@ -149,18 +163,19 @@ gst_rtp_asf_depay_setcaps (GstRTPBaseDepayload * depayload, GstCaps * caps)
   if (ps_string == NULL || *ps_string == '\0')
     goto no_packetsize;
 
+  packet_size = atoi (ps_string);
+
   if (depay->packet_size) {
     /* header sent again following seek;
      * discard to avoid confusing upstream */
-    if (depay->packet_size == atoi (ps_string)) {
+    if (depay->packet_size == (guint) packet_size) {
       goto duplicate_header;
     } else {
       /* since we should fiddle with downstream state to handle this */
       goto refuse_renegotiation;
     }
-  } else
-    depay->packet_size = atoi (ps_string);
-  if (depay->packet_size <= 16)
+  }
+  if (packet_size <= 16)
     goto invalid_packetsize;
 
   headers = (guint8 *) g_base64_decode (config_str, &headers_len);
@@ -169,6 +184,19 @@ gst_rtp_asf_depay_setcaps (GstRTPBaseDepayload * depayload, GstCaps * caps)
       || memcmp (headers, asf_marker, 16) != 0)
     goto invalid_headers;
 
+  /* short packets are padded from this, without copying their data; only
+   * set along with packet_size, which take_packet relies on */
+  padding = gst_allocator_alloc (NULL, packet_size, NULL);
+  gst_memory_map (padding, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+  gst_memory_unmap (padding, &map);
+  GST_MINI_OBJECT_FLAG_SET (padding, GST_MEMORY_FLAG_READONLY);
+
+  if (depay->padding)
+    gst_memory_unref (depay->padding);
+  depay->padding = padding;
+  depay->packet_size = packet_size;
+
   src_caps = gst_caps_new_empty_simple ("video/x-ms-asf");
   gst_pad_set_caps (depayload->srcpad, src_caps);
   gst_caps_unref (src_caps);
@@ -195,7 +223,7 @@ no_packetsize:
   }
 invalid_packetsize:
   {
-    GST_WARNING_OBJECT (depay, "packet size %u invalid", depay->packet_size);
+    GST_WARNING_OBJECT (depay, "packet size %d invalid", packet_size);
     return FALSE;
   }
 invalid_headers:
@@ -239,40 +267,21 @@ field_size (guint8 field)
   }
 }
 
-/* Set the padding field to te correct value as the spec
- * says it should be se to 0 in the rtp packets
- */
-static GstBuffer *
-gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
+/* Find the padding length field, which the spec says is set to 0 in the
+ * rtp packets, in the header of the ASF packet. Returns FALSE if there is
+ * no such field or the packet doesn't follow the spec */
+static gboolean
+gst_rtp_asf_depay_find_padding (GstRtpAsfDepay * depayload,
+    const guint8 * data, guint len, guint * p_offset, guint * p_size)
 {
-  GstBuffer *result;
-  GstMapInfo map;
-  guint8 *data;
-  gint offset = 0;
+  guint offset = 0;
   guint8 aux;
   guint8 seq_type;
   guint8 pad_type;
   guint8 pkt_type;
-  gsize plen, padding;
-
-  plen = gst_buffer_get_size (buf);
-  if (plen == depayload->packet_size)
-    return buf;
-
-  padding = depayload->packet_size - plen;
 
-  GST_LOG_OBJECT (depayload,
-      "padding buffer size %" G_GSIZE_FORMAT " to packet size %d", plen,
-      depayload->packet_size);
-
-  result = gst_buffer_new_and_alloc (depayload->packet_size);
-
-  gst_buffer_map (result, &map, GST_MAP_READ);
-  data = map.data;
-  memset (data + plen, 0, padding);
-
-  gst_buffer_extract (buf, 0, data, plen);
-  gst_buffer_unref (buf);
+  if (len < 1)
+    return FALSE;
 
   aux = data[offset++];
   if (aux & 0x80) {
@@ -281,12 +290,13 @@ gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
       GST_WARNING_OBJECT (depayload, "Error correction length type should be "
           "set to 0");
       /* this packet doesn't follow the spec */
-      gst_buffer_unmap (result, &map);
-      return result;
+      return FALSE;
     }
     err_len = aux & 0x0F;
     offset += err_len;
 
+    if (offset >= len)
+      return FALSE;
     aux = data[offset++];
   }
   seq_type = (aux >> 1) & 0x3;
@@ -297,31 +307,108 @@ gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
   offset += field_size (pkt_type);      /* skip packet length */
   offset += field_size (seq_type);      /* skip sequence field */
 
-  /* write padding */
-  switch (pad_type) {
+  *p_offset = offset;
+  *p_size = field_size (pad_type);
+
+  return (*p_size > 0 && offset + *p_size <= len);
+}
+
+static void
+gst_rtp_asf_depay_write_padding (guint8 * data, guint size, guint padding)
+{
+  switch (size) {
       /* DWORD */
-    case 3:
-      GST_WRITE_UINT32_LE (&(data[offset]), padding);
+    case 4:
+      GST_WRITE_UINT32_LE (data, padding);
       break;
 
       /* WORD */
     case 2:
-      GST_WRITE_UINT16_LE (&(data[offset]), padding);
+      GST_WRITE_UINT16_LE (data, padding);
       break;
 
       /* BYTE */
     case 1:
-      data[offset] = (guint8) padding;
+      *data = (guint8) padding;
       break;
 
-      /* non-existent */
-    case 0:
     default:
       break;
   }
-  gst_buffer_unmap (result, &map);
+}
+
+/* Make a packet of packet_size from a complete packet in the rtp payload.
+ * The payload is not copied, only the header when the padding needs to be
+ * written into it, and the padding is shared zeros */
+static GstBuffer *
+gst_rtp_asf_depay_take_packet (GstRtpAsfDepay * depay, GstRTPBuffer * rtp,
+    guint offset, const guint8 * data, guint len)
+{
+  GstBuffer *outbuf;
+  GstMemory *mem;
+  GstMapInfo map;
+  guint pad_offset, pad_size, hdr_len = 0;
+  guint padding;
+
+  if (len >= depay->packet_size)
+    return gst_rtp_buffer_get_payload_subbuffer (rtp, offset, len);
+
+  padding = depay->packet_size - len;
+
+  GST_LOG_OBJECT (depay, "padding packet size %u to packet size %u", len,
+      depay->packet_size);
+
+  outbuf = gst_buffer_new ();
+
+  if (gst_rtp_asf_depay_find_padding (depay, data, len, &pad_offset,
+          &pad_size)) {
+    hdr_len = pad_offset + pad_size;
+    mem = gst_allocator_alloc (NULL, hdr_len, NULL);
+    gst_memory_map (mem, &map, GST_MAP_WRITE);
+    memcpy (map.data, data, hdr_len);
+    gst_rtp_asf_depay_write_padding (map.data + pad_offset, pad_size, padding);
+    gst_memory_unmap (mem, &map);
+    gst_buffer_append_memory (outbuf, mem);
+  }
+
+  if (len > hdr_len) {
+    outbuf = gst_buffer_append (outbuf,
+        gst_rtp_buffer_get_payload_subbuffer (rtp, offset + hdr_len,
+            len - hdr_len));
+  }
+
+  gst_buffer_append_memory (outbuf,
+      gst_memory_share (depay->padding, 0, padding));
+
+  return outbuf;
+}
+
+/* Fragments are collected in a buffer of packet_size, which only needs
+ * the padding filled in when the last one arrived */
+static GstBuffer *
+gst_rtp_asf_depay_finish_fragments (GstRtpAsfDepay * depay)
+{
+  GstBuffer *outbuf;
+  guint8 *data;
+  guint pad_offset, pad_size;
+  guint padding;
+
+  data = depay->frag_map.data;
+  padding = depay->packet_size - depay->frag_len;
+
+  if (padding > 0) {
+    memset (data + depay->frag_len, 0, padding);
+    if (gst_rtp_asf_depay_find_padding (depay, data, depay->frag_len,
+            &pad_offset, &pad_size))
+      gst_rtp_asf_depay_write_padding (data + pad_offset, pad_size, padding);
+  }
+
+  gst_buffer_unmap (depay->frag, &depay->frag_map);
+  outbuf = depay->frag;
+  depay->frag = NULL;
+  depay->frag_len = 0;
 
-  return result;
+  return outbuf;
 }
 
 /* Docs: 'RTSP Protocol PDF' document from http://sdp.ppona.com/ (page 8) */
@@ -331,7 +418,8 @@ gst_rtp_asf_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
 {
   GstRtpAsfDepay *depay;
   const guint8 *payload;
-  GstBuffer *outbuf;
+  GstBuffer *outbuf, *first = NULL;
+  GstBufferList *list = NULL;
   gboolean S, L, R, D, I;
   guint payload_len, hdr_len, offset;
   guint len_offs;
@@ -343,7 +431,7 @@ gst_rtp_asf_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
   /* flush remaining data on discont */
   if (GST_BUFFER_IS_DISCONT (buf)) {
     GST_LOG_OBJECT (depay, "got DISCONT");
-    gst_adapter_clear (depay->adapter);
+    gst_rtp_asf_depay_clear_fragments (depay);
     depay->discont = TRUE;
   }
 
@@ -438,43 +526,54 @@ gst_rtp_asf_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
         packet_len, payload_len, depay->packet_size);
 
     if (!L) {
-      guint available;
-      GstBuffer *sub;
-
       /* Fragmented packet handling */
       outbuf = NULL;
 
-      if (len_offs == (available = gst_adapter_available (depay->adapter))) {
+      if (len_offs == 0 && depay->frag_len > 0) {
+        GST_WARNING_OBJECT (depay, "new packet before the last one was "
+            "complete, discarding %u bytes", depay->frag_len);
+        gst_rtp_asf_depay_clear_fragments (depay);
+      }
+      if (len_offs == 0 && depay->frag == NULL) {
+        /* first fragment, all of them go into one buffer */
+        depay->frag = gst_buffer_new_allocate (NULL, depay->packet_size, NULL);
+        gst_buffer_map (depay->frag, &depay->frag_map, GST_MAP_WRITE);
+        depay->frag_len = 0;
+      }
+
+      if (depay->frag && len_offs == depay->frag_len) {
         /* fragment aligns with what we have, add it */
-        GST_LOG_OBJECT (depay, "collecting fragment");
-        sub =
-            gst_rtp_buffer_get_payload_subbuffer (&rtpbuf, offset, packet_len);
-        gst_adapter_push (depay->adapter, sub);
-        /* RTP marker bit M is set if this is last fragment */
-        if (gst_rtp_buffer_get_marker (&rtpbuf)) {
-          GST_LOG_OBJECT (depay, "last fragment, assembling packet");
-          outbuf =
-              gst_adapter_take_buffer (depay->adapter, available + packet_len);
+        if (depay->frag_len + packet_len > depay->packet_size) {
+          GST_WARNING_OBJECT (depay, "fragments exceed packet size %u",
+              depay->packet_size);
+          gst_rtp_asf_depay_clear_fragments (depay);
+        } else {
+          GST_LOG_OBJECT (depay, "collecting fragment");
+          memcpy (depay->frag_map.data + depay->frag_len, payload, packet_len);
+          depay->frag_len += packet_len;
+          /* RTP marker bit M is set if this is last fragment */
+          if (gst_rtp_buffer_get_marker (&rtpbuf)) {
+            GST_LOG_OBJECT (depay, "last fragment, assembling packet");
+            outbuf = gst_rtp_asf_depay_finish_fragments (depay);
+          }
         }
       } else {
-        if (available) {
+        if (depay->frag) {
           GST_WARNING_OBJECT (depay, "Offset doesn't match previous data?!");
           GST_DEBUG_OBJECT (depay, "clearing for re-sync");
-          gst_adapter_clear (depay->adapter);
+          gst_rtp_asf_depay_clear_fragments (depay);
         } else
           GST_DEBUG_OBJECT (depay, "waiting for start of packet");
       }
     } else {
       GST_LOG_OBJECT (depay, "collecting packet");
-      outbuf =
-          gst_rtp_buffer_get_payload_subbuffer (&rtpbuf, offset, packet_len);
+      outbuf = gst_rtp_asf_depay_take_packet (depay, &rtpbuf, offset, payload,
+          packet_len);
     }
 
-    /* If we haven't completed a full ASF packet, return */
+    /* If we haven't completed a full ASF packet, we're done */
     if (!outbuf)
-      return NULL;
-
-    outbuf = gst_rtp_asf_depay_update_padding (depay, outbuf);
+      break;
 
     if (!S)
       GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
@@ -487,28 +586,43 @@ gst_rtp_asf_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
 
     GST_BUFFER_TIMESTAMP (outbuf) = timestamp;
 
-    gst_rtp_base_depayload_push (depayload, outbuf);
-
     /* only apply the timestamp to the first buffer of this packet */
     timestamp = -1;
 
+    /* several packets in one RTP packet are pushed together */
+    if (first == NULL && list == NULL) {
+      first = outbuf;
+    } else {
+      if (list == NULL) {
+        list = gst_buffer_list_new ();
+        gst_buffer_list_add (list, first);
+        first = NULL;
+      }
+      gst_buffer_list_add (list, outbuf);
+    }
+
     /* skip packet data */
     payload += packet_len;
     offset += packet_len;
     payload_len -= packet_len;
   } while (payload_len > 0);
 
+done:
   gst_rtp_buffer_unmap (&rtpbuf);
 
+  if (list)
+    gst_rtp_base_depayload_push_list (depayload, list);
+  else if (first)
+    gst_rtp_base_depayload_push (depayload, first);
+
   return NULL;
 
 /* ERRORS */
 too_small:
   {
-    gst_rtp_buffer_unmap (&rtpbuf);
     GST_WARNING_OBJECT (depayload, "Payload too small, expected at least 4 "
         "bytes for header, but got only %d bytes", payload_len);
-    return NULL;
+    goto done;
   }
 }
 
@@ -522,7 +636,7 @@ gst_rtp_asf_depay_change_state (GstElement * element, GstStateChange trans)
 
   switch (trans) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
-      gst_adapter_clear (depay->adapter);
+      gst_rtp_asf_depay_clear_fragments (depay);
       depay->discont = TRUE;
       break;
     default:
@@ -533,7 +647,13 @@ gst_rtp_asf_depay_change_state (GstElement * element, GstStateChange trans)
 
   switch (trans) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
-      gst_adapter_clear (depay->adapter);
+      gst_rtp_asf_depay_clear_fragments (depay);
+      /* the next stream may have another packet size */
+      depay->packet_size = 0;
+      if (depay->padding) {
+        gst_memory_unref (depay->padding);
+        depay->padding = NULL;
+      }
       break;
     default:
       break;
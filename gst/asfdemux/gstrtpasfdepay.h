@@ -22,7 +22,6 @@
 #define __GST_RTP_ASF_DEPAY_H__
 
 #include <gst/gst.h>
-#include <gst/base/gstadapter.h>
 
 #include <gst/rtp/gstrtpbasedepayload.h>
 
@@ -48,7 +47,14 @@ struct _GstRtpAsfDepay
 
   guint packet_size;
 
-  GstAdapter *adapter;
+  /* packet being assembled from fragments, mapped while we have it */
+  GstBuffer  *frag;
+  GstMapInfo  frag_map;
+  guint       frag_len;
+
+  /* packet_size zeros to pad short packets with */
+  GstMemory  *padding;
+
   gboolean    discont;
 };
 
@@ -86,44 +86,62 @@ gst_asm_operator_eval (GstASMOp optype, gfloat left, gfloat right)
   return result;
 }
 
-static gfloat
-gst_asm_node_evaluate (GstASMNode * node, GHashTable * vars)
+static guint
+gst_asm_vars_lookup (GPtrArray * vars, const gchar * varname)
 {
-  gfloat result = 0.0;
+  guint i;
+
+  for (i = 0; i < vars->len; i++) {
+    if (strcmp (g_ptr_array_index (vars, i), varname) == 0)
+      return i;
+  }
+  g_ptr_array_add (vars, g_strdup (varname));
+
+  return i;
+}
+
+/* append node in postfix order, depth is the number of values already
+ * on the evaluation stack */
+static void
+gst_asm_node_compile (GstASMNode * node, GArray * instrs, GPtrArray * vars,
+    guint depth, guint * max_depth)
+{
+  GstASMInstr instr;
+
+  *max_depth = MAX (*max_depth, depth + 1);
 
-  if (node == NULL)
-    return 0.0;
+  if (node == NULL) {
+    instr.type = GST_ASM_INSTR_CONSTANT;
+    instr.data.value = 0.0;
+    g_array_append_val (instrs, instr);
+    return;
+  }
 
   switch (node->type) {
     case GST_ASM_NODE_VARIABLE:
-    {
-      gchar *val;
-
-      val = g_hash_table_lookup (vars, node->data.varname);
-      if (val)
-        result = (gfloat) atof (val);
+      instr.type = GST_ASM_INSTR_VARIABLE;
+      instr.data.varidx = gst_asm_vars_lookup (vars, node->data.varname);
       break;
-    }
     case GST_ASM_NODE_INTEGER:
-      result = (gfloat) node->data.intval;
+      instr.type = GST_ASM_INSTR_CONSTANT;
+      instr.data.value = (gfloat) node->data.intval;
       break;
     case GST_ASM_NODE_FLOAT:
-      result = node->data.floatval;
+      instr.type = GST_ASM_INSTR_CONSTANT;
+      instr.data.value = node->data.floatval;
       break;
     case GST_ASM_NODE_OPERATOR:
-    {
-      gfloat left, right;
-
-      left = gst_asm_node_evaluate (node->left, vars);
-      right = gst_asm_node_evaluate (node->right, vars);
-
-      result = gst_asm_operator_eval (node->data.optype, left, right);
+      gst_asm_node_compile (node->left, instrs, vars, depth, max_depth);
+      gst_asm_node_compile (node->right, instrs, vars, depth + 1, max_depth);
+      instr.type = GST_ASM_INSTR_OPERATOR;
+      instr.data.optype = node->data.optype;
       break;
-    }
     default:
+      instr.type = GST_ASM_INSTR_CONSTANT;
+      instr.data.value = 0.0;
       break;
   }
-  return result;
+  g_array_append_val (instrs, instr);
 }
 
 #define IS_SPACE(p) (((p) == ' ') || ((p) == '\n') || \
@@ -421,6 +439,8 @@ gst_asm_rule_new (void)
 
   rule = g_new (GstASMRule, 1);
   rule->root = NULL;
+  rule->instrs = NULL;
+  rule->n_instrs = 0;
   rule->props = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
   return rule;
@@ -432,6 +452,7 @@ gst_asm_rule_free (GstASMRule * rule)
   g_hash_table_destroy (rule->props);
   if (rule->root)
     gst_asm_node_free (rule->root);
+  g_free (rule->instrs);
   g_free (rule);
 }
 
@@ -578,17 +599,48 @@ gst_asm_scan_parse_rule (GstASMScan * scan)
   return rule;
 }
 
-static gboolean
-gst_asm_rule_evaluate (GstASMRule * rule, GHashTable * vars)
+static void
+gst_asm_rule_compile (GstASMRule * rule, GPtrArray * vars, guint * max_depth)
 {
-  gboolean res;
+  GArray *instrs;
 
-  if (rule->root) {
-    res = (gboolean) gst_asm_node_evaluate (rule->root, vars);
-  } else
-    res = TRUE;
+  if (rule->root == NULL)
+    return;
+
+  instrs = g_array_new (FALSE, FALSE, sizeof (GstASMInstr));
+  gst_asm_node_compile (rule->root, instrs, vars, 0, max_depth);
+
+  rule->n_instrs = instrs->len;
+  rule->instrs = (GstASMInstr *) g_array_free (instrs, FALSE);
+}
 
-  return res;
+static gboolean
+gst_asm_rule_evaluate (GstASMRule * rule, const gfloat * values,
+    gfloat * stack)
+{
+  guint i, sp = 0;
+
+  if (rule->n_instrs == 0)
+    return TRUE;
+
+  for (i = 0; i < rule->n_instrs; i++) {
+    const GstASMInstr *instr = &rule->instrs[i];
+
+    switch (instr->type) {
+      case GST_ASM_INSTR_VARIABLE:
+        stack[sp++] = values[instr->data.varidx];
+        break;
+      case GST_ASM_INSTR_CONSTANT:
+        stack[sp++] = instr->data.value;
+        break;
+      case GST_ASM_INSTR_OPERATOR:
+        sp--;
+        stack[sp - 1] = gst_asm_operator_eval (instr->data.optype,
+            stack[sp - 1], stack[sp]);
+        break;
+    }
+  }
+  return (gboolean) stack[0];
 }
 
 GstASMRuleBook *
@@ -598,6 +650,7 @@ gst_asm_rule_book_new (const gchar * rulebook)
   GstASMRule *rule = NULL;
   GstASMScan *scan;
   GstASMToken token;
+  GPtrArray *vars;
 
   book = g_new0 (GstASMRuleBook, 1);
   book->rulebook = rulebook;
@@ -605,9 +658,12 @@ gst_asm_rule_book_new (const gchar * rulebook)
   scan = gst_asm_scan_new (book->rulebook);
   gst_asm_scan_next_token (scan);
 
+  vars = g_ptr_array_new ();
+
   do {
     rule = gst_asm_scan_parse_rule (scan);
     if (rule) {
+      gst_asm_rule_compile (rule, vars, &book->max_depth);
       book->rules = g_list_append (book->rules, rule);
       book->n_rules++;
     }
@@ -616,6 +672,10 @@ gst_asm_rule_book_new (const gchar * rulebook)
 
   gst_asm_scan_free (scan);
 
+  book->n_vars = vars->len;
+  g_ptr_array_add (vars, NULL);
+  book->vars = (gchar **) g_ptr_array_free (vars, FALSE);
+
   return book;
 }
 
@@ -630,34 +690,94 @@ gst_asm_rule_book_free (GstASMRuleBook * book)
     gst_asm_rule_free (rule);
   }
   g_list_free (book->rules);
+  g_strfreev (book->vars);
   g_free (book);
 }
 
+/* Returns the position of @varname in the value vector passed to
+ * gst_asm_rule_book_match_values(), or -1 when no rule uses it. */
 gint
-gst_asm_rule_book_match (GstASMRuleBook * book, GHashTable * vars,
+gst_asm_rule_book_get_var_index (GstASMRuleBook * book, const gchar * varname)
+{
+  guint i;
+
+  for (i = 0; i < book->n_vars; i++) {
+    if (strcmp (book->vars[i], varname) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/* @values holds book->n_vars entries, see gst_asm_rule_book_get_var_index().
+ * At most MAX_RULEMATCHES matches are stored in @rulematches. */
+gint
+gst_asm_rule_book_match_values (GstASMRuleBook * book, const gfloat * values,
     gint * rulematches)
 {
   GList *walk;
   gint i, n = 0;
+  gfloat stack_static[64], *stack;
+
+  if (book->max_depth > G_N_ELEMENTS (stack_static))
+    stack = g_new (gfloat, book->max_depth);
+  else
+    stack = stack_static;
 
-  for (walk = book->rules, i = 0; walk; walk = g_list_next (walk), i++) {
+  for (walk = book->rules, i = 0; walk && n < MAX_RULEMATCHES;
+      walk = g_list_next (walk), i++) {
     GstASMRule *rule = (GstASMRule *) walk->data;
 
-    if (gst_asm_rule_evaluate (rule, vars)) {
+    if (gst_asm_rule_evaluate (rule, values, stack)) {
       rulematches[n++] = i;
     }
   }
+
+  if (stack != stack_static)
+    g_free (stack);
+
+  return n;
+}
+
+gint
+gst_asm_rule_book_match (GstASMRuleBook * book, GHashTable * vars,
+    gint * rulematches)
+{
+  gfloat values_static[16] = { 0, }, *values;
+  guint i;
+  gint n;
+
+  if (book->n_vars > G_N_ELEMENTS (values_static))
+    values = g_new (gfloat, book->n_vars);
+  else
+    values = values_static;
+
+  for (i = 0; i < book->n_vars; i++) {
+    gchar *val;
+
+    val = g_hash_table_lookup (vars, book->vars[i]);
+    values[i] = val ? (gfloat) atof (val) : 0.0;
+  }
+
+  n = gst_asm_rule_book_match_values (book, values, rulematches);
+
+  if (values != values_static)
+    g_free (values);
+
   return n;
 }
 
 #ifdef TEST
+#define BENCH_ITERATIONS 1000000
+
 gint
 main (gint argc, gchar * argv[])
 {
   GstASMRuleBook *book;
   gint rulematch[MAX_RULEMATCHES];
   GHashTable *vars;
-  gint i, n;
+  gint i, n, idx;
+  gfloat *values;
+  gint64 start, hash_time, values_time;
 
   static const gchar rules1[] =
       "#($Bandwidth < 67959),TimestampDelivery=T,DropByN=T,"
@@ -705,6 +825,29 @@ main (gint argc, gchar * argv[])
     g_print ("rule %d matched\n", rulematch[i]);
   }
 
+  /* benchmark the string table against the value vector */
+  book = gst_asm_rule_book_new (rules3);
+  values = g_new0 (gfloat, book->n_vars);
+  idx = gst_asm_rule_book_get_var_index (book, "Bandwidth");
+  values[idx] = 300000;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_ITERATIONS; i++)
+    gst_asm_rule_book_match (book, vars, rulematch);
+  hash_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_ITERATIONS; i++)
+    gst_asm_rule_book_match_values (book, values, rulematch);
+  values_time = g_get_monotonic_time () - start;
+
+  g_print ("%d matches: %" G_GINT64_FORMAT " us with variable table, %"
+      G_GINT64_FORMAT " us with value vector\n", BENCH_ITERATIONS, hash_time,
+      values_time);
+
+  g_free (values);
+  gst_asm_rule_book_free (book);
+
   g_hash_table_destroy (vars);
 
   return 0;
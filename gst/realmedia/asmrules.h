@@ -78,6 +78,23 @@ typedef enum {
   GST_ASM_OP_OR           = GST_ASM_TOKEN_OR
 } GstASMOp;
 
+/* rule conditions compiled to postfix */
+typedef enum {
+  GST_ASM_INSTR_VARIABLE,
+  GST_ASM_INSTR_CONSTANT,
+  GST_ASM_INSTR_OPERATOR
+} GstASMInstrType;
+
+typedef struct {
+  GstASMInstrType type;
+
+  union {
+    guint    varidx;
+    gfloat   value;
+    GstASMOp optype;
+  } data;
+} GstASMInstr;
+
 struct _GstASMNode {
   GstASMNodeType  type;
 
@@ -93,8 +110,12 @@ struct _GstASMNode {
 };
 
 struct _GstASMRule {
-  GstASMNode *root;
-  GHashTable *props;
+  GstASMNode  *root;
+  GHashTable  *props;
+
+  /* root as postfix program, empty when the rule has no condition */
+  GstASMInstr *instrs;
+  guint        n_instrs;
 };
 
 struct _GstASMRuleBook {
@@ -102,6 +123,11 @@ struct _GstASMRuleBook {
 
   guint        n_rules;
   GList       *rules;
+
+  /* variables referenced by the rules, indexes into the value vector */
+  guint        n_vars;
+  gchar      **vars;
+  guint        max_depth;
 };
 
 G_END_DECLS
@@ -112,4 +138,10 @@ void              gst_asm_rule_book_free    (GstASMRuleBook *book);
 gint              gst_asm_rule_book_match   (GstASMRuleBook *book, GHashTable *vars, 
 		                             gint *rulematches);
 
+gint              gst_asm_rule_book_get_var_index (GstASMRuleBook *book,
+                                             const gchar *varname);
+gint              gst_asm_rule_book_match_values  (GstASMRuleBook *book,
+                                             const gfloat *values,
+                                             gint *rulematches);
+
 #endif /* __GST_ASM_RULES_H__ */
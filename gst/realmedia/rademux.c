@@ -59,6 +59,14 @@ static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
 GST_DEBUG_CATEGORY_STATIC (real_audio_demux_debug);
 #define GST_CAT_DEFAULT real_audio_demux_debug
 
+#define DEFAULT_READAHEAD_BYTES 0
+
+enum
+{
+  PROP_0,
+  PROP_READAHEAD_BYTES
+};
+
 #define gst_real_audio_demux_parent_class parent_class
 G_DEFINE_TYPE (GstRealAudioDemux, gst_real_audio_demux, GST_TYPE_ELEMENT);
 
@@ -73,6 +81,10 @@ static gboolean gst_real_audio_demux_src_event (GstPad * pad,
 static gboolean gst_real_audio_demux_src_query (GstPad * pad,
     GstObject * parent, GstQuery * query);
 static void gst_real_audio_demux_loop (GstRealAudioDemux * demux);
+static void gst_real_audio_demux_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_real_audio_demux_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec);
 static gboolean gst_real_audio_demux_sink_activate (GstPad * sinkpad,
     GstObject * parent);
 static gboolean gst_real_audio_demux_sink_activate_mode (GstPad * sinkpad,
@@ -84,6 +96,7 @@ gst_real_audio_demux_finalize (GObject * obj)
   GstRealAudioDemux *demux = GST_REAL_AUDIO_DEMUX (obj);
 
   g_object_unref (demux->adapter);
+  gst_rm_utils_readahead_clear (&demux->readahead);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -95,6 +108,15 @@ gst_real_audio_demux_class_init (GstRealAudioDemuxClass * klass)
   GstElementClass *gstelement_class = (GstElementClass *) klass;
 
   gobject_class->finalize = gst_real_audio_demux_finalize;
+  gobject_class->set_property = gst_real_audio_demux_set_property;
+  gobject_class->get_property = gst_real_audio_demux_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_READAHEAD_BYTES,
+      g_param_spec_uint ("readahead-bytes", "Readahead bytes",
+          "Size of the blocks pulled from upstream in pull mode, headers "
+          "and packets are parsed out of these (0 = pull each one "
+          "separately)", 0, G_MAXINT, DEFAULT_READAHEAD_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_static_pad_template (gstelement_class, &sink_template);
   gst_element_class_add_static_pad_template (gstelement_class, &src_template);
@@ -111,6 +133,42 @@ gst_real_audio_demux_class_init (GstRealAudioDemuxClass * klass)
       0, "Demuxer for RealAudio streams");
 }
 
+static void
+gst_real_audio_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRealAudioDemux *demux = GST_REAL_AUDIO_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_READAHEAD_BYTES:
+      GST_OBJECT_LOCK (demux);
+      demux->readahead_bytes = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_real_audio_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRealAudioDemux *demux = GST_REAL_AUDIO_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_READAHEAD_BYTES:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->readahead_bytes);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_real_audio_demux_reset (GstRealAudioDemux * demux)
 {
@@ -149,6 +207,13 @@ gst_real_audio_demux_reset (GstRealAudioDemux * demux)
 
   demux->offset = 0;
 
+  GST_DEBUG_OBJECT (demux, "readahead served %" G_GUINT64_FORMAT " reads "
+      "with %" G_GUINT64_FORMAT " upstream pulls", demux->readahead.n_reads,
+      demux->readahead.n_pulls);
+  gst_rm_utils_readahead_clear (&demux->readahead);
+  demux->readahead.n_reads = 0;
+  demux->readahead.n_pulls = 0;
+
   demux->have_group_id = FALSE;
   demux->group_id = G_MAXUINT;
 
@@ -172,6 +237,7 @@ gst_real_audio_demux_init (GstRealAudioDemux * demux)
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 
   demux->adapter = gst_adapter_new ();
+  demux->readahead_bytes = DEFAULT_READAHEAD_BYTES;
   gst_real_audio_demux_reset (demux);
 }
 
@@ -228,6 +294,7 @@ gst_real_audio_demux_sink_activate_mode (GstPad * sinkpad, GstObject * parent,
       } else {
         demux->seekable = FALSE;
         res = gst_pad_stop_task (sinkpad);
+        gst_rm_utils_readahead_clear (&demux->readahead);
       }
       break;
     default:
@@ -627,7 +694,7 @@ gst_real_audio_demux_loop (GstRealAudioDemux * demux)
 {
   GstFlowReturn ret;
   GstBuffer *buf;
-  guint bytes_needed;
+  guint bytes_needed, readahead_bytes;
 
   /* check how much data we need */
   switch (demux->state) {
@@ -658,8 +725,13 @@ gst_real_audio_demux_loop (GstRealAudioDemux * demux)
   if (demux->upstream_size > 0 && demux->offset >= demux->upstream_size)
     goto eos;
 
+  GST_OBJECT_LOCK (demux);
+  readahead_bytes = demux->readahead_bytes;
+  GST_OBJECT_UNLOCK (demux);
+
   buf = NULL;
-  ret = gst_pad_pull_range (demux->sinkpad, demux->offset, bytes_needed, &buf);
+  ret = gst_rm_utils_readahead_pull (&demux->readahead, demux->sinkpad,
+      readahead_bytes, demux->offset, bytes_needed, &buf);
 
   if (ret != GST_FLOW_OK)
     goto pull_range_error;
@@ -828,6 +900,7 @@ gst_real_audio_demux_handle_seek (GstRealAudioDemux * demux, GstEvent * event)
 
   demux->offset = seek_pos;
   demux->need_newsegment = TRUE;
+  gst_rm_utils_readahead_clear (&demux->readahead);
 
   /* notify start of new segment */
   if (demux->segment.flags & GST_SEEK_FLAG_SEGMENT) {
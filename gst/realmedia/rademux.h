@@ -23,6 +23,8 @@
 #include <gst/gst.h>
 #include <gst/base/gstadapter.h>
 
+#include "rmutils.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_REAL_AUDIO_DEMUX \
@@ -85,6 +87,9 @@ struct _GstRealAudioDemux {
   guint64                  offset;          /* current read byte offset for
                                              * pull_range-based mode */
 
+  guint                    readahead_bytes; /* pull mode block size */
+  GstRmUtilsReadahead      readahead;
+
   /* playback start/stop positions */
   GstSegment               segment;
 
@@ -54,6 +54,7 @@
 #include "gstrdtbuffer.h"
 #include "rdtmanager.h"
 #include "rdtjitterbuffer.h"
+#include "rtspreal.h"
 
 #include <gst/glib-compat-private.h>
 
@@ -81,11 +82,20 @@ enum
 };
 
 #define DEFAULT_LATENCY_MS      200
+#define DEFAULT_STATS_INTERVAL  0
+
+/* how often the receive rate is reported to rtspreal */
+#define RATE_INTERVAL           G_USEC_PER_SEC
+
+/* data packet seqnums wrap here, higher values are other packet types */
+#define RDT_SEQNUM_WRAP         GST_RDT_TYPE_ASMACTION
 
 enum
 {
   PROP_0,
-  PROP_LATENCY
+  PROP_LATENCY,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 static GstStaticPadTemplate gst_rdt_manager_recv_rtp_sink_template =
@@ -216,6 +226,25 @@ struct _GstRDTManagerSession
   /* some accounting */
   guint64 num_late;
   guint64 num_duplicates;
+
+  /* receive rate measurement for the rtspreal extension */
+  gchar *rtspreal_id;
+  guint64 rate_bytes;
+  gint64 rate_start;
+
+  /* receive statistics, protected by the jbuf lock */
+  gboolean have_seqnum;
+  guint16 base_seqnum;
+  guint16 max_seqnum;
+  guint32 seqnum_cycles;
+  guint64 num_received;
+  guint64 bytes_received;
+  guint64 num_reordered;
+  guint max_reorder_depth;
+  gint64 transit;
+  guint32 jitter;
+  guint bitrate;
+  gint64 last_stats_post;
 };
 
 /* find a session with the given id */
@@ -243,9 +272,13 @@ create_session (GstRDTManager * rdtmanager, gint id)
   sess->id = id;
   sess->dec = rdtmanager;
   sess->jbuf = rdt_jitter_buffer_new ();
+  sess->transit = -1;
   g_mutex_init (&sess->jbuf_lock);
   g_cond_init (&sess->jbuf_cond);
+
+  GST_OBJECT_LOCK (rdtmanager);
   rdtmanager->sessions = g_slist_prepend (rdtmanager->sessions, sess);
+  GST_OBJECT_UNLOCK (rdtmanager);
 
   return sess;
 }
@@ -329,6 +362,7 @@ static void
 free_session (GstRDTManagerSession * session)
 {
   g_object_unref (session->jbuf);
+  g_free (session->rtspreal_id);
   g_cond_clear (&session->jbuf_cond);
   g_mutex_clear (&session->jbuf_lock);
   g_free (session);
@@ -426,6 +460,40 @@ gst_rdt_manager_class_init (GstRDTManagerClass * g_class)
           "Amount of ms to buffer", 0, G_MAXUINT, DEFAULT_LATENCY_MS,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRDTManager:stats:
+   *
+   * Receive statistics of all sessions. The "session-stats" field holds
+   * an array with one application/x-rdt-session-stats structure per
+   * session, with the fields:
+   *
+   *   "session"           G_TYPE_UINT    the session id
+   *   "packets-received"  G_TYPE_UINT64  data packets, without duplicates
+   *   "bytes-received"    G_TYPE_UINT64  data packet bytes
+   *   "packets-lost"      G_TYPE_INT64   expected minus received packets
+   *   "num-duplicates"    G_TYPE_UINT64  duplicate packets dropped
+   *   "num-reordered"     G_TYPE_UINT64  packets older than the highest seqnum
+   *   "max-reorder-depth" G_TYPE_UINT    largest seqnum distance of those
+   *   "jitter"            G_TYPE_UINT    interarrival jitter, in clock-rate units
+   *   "bitrate"           G_TYPE_UINT    receive rate in bits per second
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Receive statistics of the sessions", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRDTManager:stats-interval:
+   *
+   * Post an element message with the application/x-rdt-session-stats of a
+   * session every this many ms while it receives data, 0 to disable.
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Statistics interval",
+          "Interval in ms between session statistics messages (0 = disabled)",
+          0, G_MAXUINT, DEFAULT_STATS_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstRDTManager::request-pt-map:
    * @rdtmanager: the object which received the signal
@@ -540,6 +608,7 @@ gst_rdt_manager_init (GstRDTManager * rdtmanager)
 {
   rdtmanager->provided_clock = gst_system_clock_obtain ();
   rdtmanager->latency = DEFAULT_LATENCY_MS;
+  rdtmanager->stats_interval = DEFAULT_STATS_INTERVAL;
   GST_OBJECT_FLAG_SET (rdtmanager, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
 }
 
@@ -645,12 +714,161 @@ gst_rdt_manager_src_activate_mode (GstPad * pad, GstObject * parent,
   return result;
 }
 
+/* distance from data packet seqnum @s1 to @s2 */
+static gint
+gst_rdt_manager_seqnum_gap (guint16 s1, guint16 s2)
+{
+  gint gap;
+
+  gap = (gint) s2 - (gint) s1;
+  if (gap > (RDT_SEQNUM_WRAP / 2))
+    gap -= RDT_SEQNUM_WRAP;
+  else if (gap < -(RDT_SEQNUM_WRAP / 2))
+    gap += RDT_SEQNUM_WRAP;
+
+  return gap;
+}
+
+/* called with the jbuf lock for every packet that was not a duplicate */
+static void
+gst_rdt_manager_update_stats (GstRDTManagerSession * session,
+    GstClockTime timestamp, guint16 seqnum, guint32 rdt_timestamp,
+    guint length)
+{
+  gint gap;
+
+  session->num_received++;
+  session->bytes_received += length;
+
+  if (!session->have_seqnum) {
+    session->base_seqnum = seqnum;
+    session->max_seqnum = seqnum;
+    session->seqnum_cycles = 0;
+    session->have_seqnum = TRUE;
+  } else {
+    gap = gst_rdt_manager_seqnum_gap (session->max_seqnum, seqnum);
+    if (gap > 0) {
+      /* new highest seqnum, count wraparounds */
+      if (seqnum < session->max_seqnum)
+        session->seqnum_cycles += RDT_SEQNUM_WRAP;
+      session->max_seqnum = seqnum;
+    } else if (gap < 0) {
+      session->num_reordered++;
+      session->max_reorder_depth = MAX (session->max_reorder_depth, -gap);
+    }
+  }
+
+  /* interarrival jitter as in RFC 3550, kept scaled by 16 */
+  if (GST_CLOCK_TIME_IS_VALID (timestamp) && session->clock_rate > 0) {
+    gint64 arrival, transit, d;
+
+    arrival = gst_util_uint64_scale_int (timestamp, session->clock_rate,
+        GST_SECOND);
+    transit = arrival - rdt_timestamp;
+
+    if (session->transit != -1) {
+      d = ABS (transit - session->transit);
+      session->jitter += d - ((session->jitter + 8) >> 4);
+    }
+    session->transit = transit;
+  }
+}
+
+/* called with the jbuf lock */
+static GstStructure *
+gst_rdt_manager_session_get_stats (GstRDTManagerSession * session)
+{
+  guint64 expected = 0;
+  gint64 lost = 0;
+
+  if (session->have_seqnum) {
+    expected = session->seqnum_cycles + session->max_seqnum -
+        session->base_seqnum + 1;
+    lost = expected - session->num_received;
+  }
+
+  return gst_structure_new ("application/x-rdt-session-stats",
+      "session", G_TYPE_UINT, (guint) session->id,
+      "packets-received", G_TYPE_UINT64, session->num_received,
+      "bytes-received", G_TYPE_UINT64, session->bytes_received,
+      "packets-lost", G_TYPE_INT64, lost,
+      "num-duplicates", G_TYPE_UINT64, session->num_duplicates,
+      "num-reordered", G_TYPE_UINT64, session->num_reordered,
+      "max-reorder-depth", G_TYPE_UINT, session->max_reorder_depth,
+      "jitter", G_TYPE_UINT, session->jitter >> 4,
+      "bitrate", G_TYPE_UINT, session->bitrate, NULL);
+}
+
+static GstStructure *
+gst_rdt_manager_get_stats (GstRDTManager * rdtmanager)
+{
+  GstStructure *stats;
+  GValue sessions = G_VALUE_INIT;
+  GSList *list, *walk;
+
+  g_value_init (&sessions, GST_TYPE_ARRAY);
+
+  /* sessions live as long as the element, copy the list so that we don't
+   * take the jbuf locks with the object lock held */
+  GST_OBJECT_LOCK (rdtmanager);
+  list = g_slist_copy (rdtmanager->sessions);
+  GST_OBJECT_UNLOCK (rdtmanager);
+
+  for (walk = list; walk; walk = g_slist_next (walk)) {
+    GstRDTManagerSession *session = (GstRDTManagerSession *) walk->data;
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, GST_TYPE_STRUCTURE);
+    JBUF_LOCK (session);
+    g_value_take_boxed (&value, gst_rdt_manager_session_get_stats (session));
+    JBUF_UNLOCK (session);
+    gst_value_array_append_and_take_value (&sessions, &value);
+  }
+  g_slist_free (list);
+
+  stats = gst_structure_new_empty ("application/x-rdt-manager-stats");
+  gst_structure_take_value (stats, "session-stats", &sessions);
+
+  return stats;
+}
+
+static void
+gst_rdt_manager_post_stats (GstRDTManager * rdtmanager,
+    GstRDTManagerSession * session)
+{
+  GstStructure *stats;
+  guint interval;
+  gint64 now;
+
+  GST_OBJECT_LOCK (rdtmanager);
+  interval = rdtmanager->stats_interval;
+  GST_OBJECT_UNLOCK (rdtmanager);
+
+  if (interval == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+  if (session->last_stats_post != 0 &&
+      now - session->last_stats_post < (gint64) interval * 1000)
+    return;
+  session->last_stats_post = now;
+
+  JBUF_LOCK (session);
+  stats = gst_rdt_manager_session_get_stats (session);
+  JBUF_UNLOCK (session);
+
+  gst_element_post_message (GST_ELEMENT_CAST (rdtmanager),
+      gst_message_new_element (GST_OBJECT_CAST (rdtmanager), stats));
+}
+
 static GstFlowReturn
 gst_rdt_manager_handle_data_packet (GstRDTManagerSession * session,
     GstClockTime timestamp, GstRDTPacket * packet)
 {
   GstRDTManager *rdtmanager;
   guint16 seqnum;
+  guint32 rdt_timestamp;
+  guint length;
   gboolean tail;
   GstFlowReturn res;
   GstBuffer *buffer;
@@ -659,7 +877,9 @@ gst_rdt_manager_handle_data_packet (GstRDTManagerSession * session,
 
   res = GST_FLOW_OK;
 
-  seqnum = 0;
+  seqnum = gst_rdt_packet_data_get_seq (packet);
+  rdt_timestamp = gst_rdt_packet_data_get_timestamp (packet);
+  length = gst_rdt_packet_get_length (packet);
   GST_DEBUG_OBJECT (rdtmanager,
       "Received packet #%d at time %" GST_TIME_FORMAT, seqnum,
       GST_TIME_ARGS (timestamp));
@@ -668,15 +888,22 @@ gst_rdt_manager_handle_data_packet (GstRDTManagerSession * session,
 
   JBUF_LOCK_CHECK (session, out_flushing);
 
-  /* insert the packet into the queue now, FIXME, use seqnum */
+  /* insert the packet into the queue now, sorted on seqnum */
   if (!rdt_jitter_buffer_insert (session->jbuf, buffer, timestamp,
           session->clock_rate, &tail))
     goto duplicate;
 
+  gst_rdt_manager_update_stats (session, timestamp, seqnum, rdt_timestamp,
+      length);
+
   /* signal addition of new buffer when the _loop is waiting. */
   if (session->waiting)
     JBUF_SIGNAL (session);
 
+  /* an older packet became the tail, the _loop has to wait for that one */
+  if (tail && session->clock_id)
+    gst_clock_id_unschedule (session->clock_id);
+
 finished:
   JBUF_UNLOCK (session);
 
@@ -741,6 +968,11 @@ gst_rdt_manager_parse_caps (GstRDTManager * rdtmanager,
 
   GST_DEBUG_OBJECT (rdtmanager, "got seqnum-base %d", session->next_seqnum);
 
+  /* set by rtspreal when it wants to hear about our receive rate */
+  g_free (session->rtspreal_id);
+  session->rtspreal_id =
+      g_strdup (gst_structure_get_string (caps_struct, "rtspreal-id"));
+
   return TRUE;
 
   /* ERRORS */
@@ -779,6 +1011,39 @@ gst_rdt_manager_event_rdt (GstPad * pad, GstObject * parent, GstEvent * event)
   return res;
 }
 
+/* measure the receive rate and pass it to rtspreal, which uses it to
+ * select the rules the server streams */
+static void
+gst_rdt_manager_update_rate (GstRDTManager * rdtmanager,
+    GstRDTManagerSession * session, gsize size)
+{
+  gint64 now, elapsed;
+  guint bitrate;
+
+  now = g_get_monotonic_time ();
+  if (session->rate_start == 0) {
+    session->rate_start = now;
+    session->rate_bytes = 0;
+  }
+  session->rate_bytes += size;
+
+  elapsed = now - session->rate_start;
+  if (elapsed < RATE_INTERVAL)
+    return;
+
+  bitrate = gst_util_uint64_scale (session->rate_bytes * 8, G_USEC_PER_SEC,
+      elapsed);
+  session->rate_start = now;
+  session->rate_bytes = 0;
+  session->bitrate = bitrate;
+
+  GST_DEBUG_OBJECT (rdtmanager, "session %d receiving %u bps", session->id,
+      bitrate);
+
+  if (session->rtspreal_id)
+    gst_rtsp_real_report_bitrate (session->rtspreal_id, session->id, bitrate);
+}
+
 static GstFlowReturn
 gst_rdt_manager_chain_rdt (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 {
@@ -814,6 +1079,9 @@ gst_rdt_manager_chain_rdt (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     session->discont = TRUE;
   }
 
+  gst_rdt_manager_update_rate (rdtmanager, session,
+      gst_buffer_get_size (buffer));
+
   res = GST_FLOW_OK;
 
   /* take the timestamp of the buffer. This is the time when the packet was
@@ -850,6 +1118,8 @@ gst_rdt_manager_chain_rdt (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
   gst_buffer_unref (buffer);
 
+  gst_rdt_manager_post_stats (rdtmanager, session);
+
   return res;
 }
 
@@ -861,6 +1131,11 @@ gst_rdt_manager_loop (GstPad * pad)
   GstRDTManagerSession *session;
   GstBuffer *buffer;
   GstFlowReturn result;
+  GstRDTPacket packet;
+  GstClockTime timestamp;
+  GstEvent *lost = NULL;
+  guint16 seqnum;
+  gint gap;
 
   rdtmanager = GST_RDT_MANAGER (GST_PAD_PARENT (pad));
 
@@ -868,6 +1143,7 @@ gst_rdt_manager_loop (GstPad * pad)
 
   JBUF_LOCK_CHECK (session, flushing);
   GST_DEBUG_OBJECT (rdtmanager, "Peeking item");
+again:
   while (TRUE) {
     /* always wait if we are blocked */
     if (!session->blocked) {
@@ -884,10 +1160,82 @@ gst_rdt_manager_loop (GstPad * pad)
     session->waiting = FALSE;
   }
 
+  /* hold the oldest packet until its running time plus the latency so that
+   * missing and reordered packets get a chance to arrive before it */
+  buffer = rdt_jitter_buffer_peek (session->jbuf);
+  timestamp = GST_BUFFER_TIMESTAMP (buffer);
+  if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+    GstClock *clock;
+    GstClockTime deadline = GST_CLOCK_TIME_NONE;
+    GstClockID id;
+    GstClockReturn ret;
+
+    GST_OBJECT_LOCK (rdtmanager);
+    clock = GST_ELEMENT_CLOCK (rdtmanager);
+    if (clock) {
+      gst_object_ref (clock);
+      deadline = GST_ELEMENT_CAST (rdtmanager)->base_time + timestamp +
+          rdtmanager->latency * GST_MSECOND;
+    }
+    GST_OBJECT_UNLOCK (rdtmanager);
+
+    if (clock) {
+      GST_DEBUG_OBJECT (rdtmanager, "waiting until %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (deadline));
+
+      id = session->clock_id = gst_clock_new_single_shot_id (clock, deadline);
+      JBUF_UNLOCK (session);
+      ret = gst_clock_id_wait (id, NULL);
+      JBUF_LOCK (session);
+      gst_clock_id_unref (id);
+      session->clock_id = NULL;
+      gst_object_unref (clock);
+
+      if (session->srcresult != GST_FLOW_OK)
+        goto flushing;
+      /* an older packet was inserted, start over with that one */
+      if (ret == GST_CLOCK_UNSCHEDULED)
+        goto again;
+    }
+  }
+
   buffer = rdt_jitter_buffer_pop (session->jbuf);
+  timestamp = GST_BUFFER_TIMESTAMP (buffer);
 
   GST_DEBUG_OBJECT (rdtmanager, "Got item %p", buffer);
 
+  gst_rdt_buffer_get_first_packet (buffer, &packet);
+  seqnum = gst_rdt_packet_data_get_seq (&packet);
+
+  /* the seqnum-base of the caps is not trusted, we only look for gaps
+   * after the first packet we pushed */
+  if (session->last_popped_seqnum != -1) {
+    gap = gst_rdt_manager_seqnum_gap (session->next_seqnum, seqnum);
+    if (gap < 0)
+      goto late;
+    if (gap > 0) {
+      GstClockTime duration = GST_CLOCK_TIME_NONE;
+
+      GST_DEBUG_OBJECT (rdtmanager, "%d packets lost before #%d", gap, seqnum);
+
+      if (GST_CLOCK_TIME_IS_VALID (timestamp) &&
+          GST_CLOCK_TIME_IS_VALID (session->last_out_time) &&
+          timestamp > session->last_out_time)
+        duration = timestamp - session->last_out_time;
+
+      lost = gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM,
+          gst_structure_new ("GstRDTPacketLost",
+              "seqnum", G_TYPE_UINT, (guint) session->next_seqnum,
+              "count", G_TYPE_UINT, (guint) gap,
+              "timestamp", G_TYPE_UINT64, session->last_out_time,
+              "duration", G_TYPE_UINT64, duration, NULL));
+    }
+  }
+  session->last_popped_seqnum = seqnum;
+  session->next_seqnum = (seqnum + 1) % RDT_SEQNUM_WRAP;
+  if (GST_CLOCK_TIME_IS_VALID (timestamp))
+    session->last_out_time = timestamp;
+
   if (session->discont) {
     GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
     session->discont = FALSE;
@@ -895,6 +1243,9 @@ gst_rdt_manager_loop (GstPad * pad)
 
   JBUF_UNLOCK (session);
 
+  if (lost)
+    gst_pad_push_event (session->recv_rtp_src, lost);
+
   result = gst_pad_push (session->recv_rtp_src, buffer);
   if (result != GST_FLOW_OK)
     goto pause;
@@ -902,6 +1253,15 @@ gst_rdt_manager_loop (GstPad * pad)
   return;
 
   /* ERRORS */
+late:
+  {
+    /* we already pushed a newer packet and declared this one lost */
+    GST_DEBUG_OBJECT (rdtmanager, "dropping late packet #%d", seqnum);
+    session->num_late++;
+    JBUF_UNLOCK (session);
+    gst_buffer_unref (buffer);
+    return;
+  }
 flushing:
   {
     GST_DEBUG_OBJECT (rdtmanager, "we are flushing");
@@ -1105,6 +1465,11 @@ gst_rdt_manager_set_property (GObject * object, guint prop_id,
     case PROP_LATENCY:
       src->latency = g_value_get_uint (value);
       break;
+    case PROP_STATS_INTERVAL:
+      GST_OBJECT_LOCK (src);
+      src->stats_interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1123,6 +1488,14 @@ gst_rdt_manager_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_LATENCY:
       g_value_set_uint (value, src->latency);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_rdt_manager_get_stats (src));
+      break;
+    case PROP_STATS_INTERVAL:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint (value, src->stats_interval);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
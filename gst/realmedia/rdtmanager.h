@@ -61,6 +61,7 @@ struct _GstRDTManager {
   GstElement  element;
 
   guint       latency;
+  guint       stats_interval;
   GSList     *sessions;
   GstClock   *provided_clock;
 };
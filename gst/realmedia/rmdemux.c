@@ -42,6 +42,16 @@
 
 #define MAX_FRAGS 256
 
+#define DEFAULT_READAHEAD_BYTES 0
+#define DEFAULT_PROBE FALSE
+
+enum
+{
+  PROP_0,
+  PROP_READAHEAD_BYTES,
+  PROP_PROBE
+};
+
 static const guint8 sipr_subpk_size[4] = { 29, 19, 37, 20 };
 
 typedef struct _GstRMDemuxIndex GstRMDemuxIndex;
@@ -131,6 +141,10 @@ static void gst_rmdemux_class_init (GstRMDemuxClass * klass);
 static void gst_rmdemux_base_init (GstRMDemuxClass * klass);
 static void gst_rmdemux_init (GstRMDemux * rmdemux);
 static void gst_rmdemux_finalize (GObject * object);
+static void gst_rmdemux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_rmdemux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static GstStateChangeReturn gst_rmdemux_change_state (GstElement * element,
     GstStateChange transition);
 static GstFlowReturn gst_rmdemux_chain (GstPad * pad, GstObject * parent,
@@ -164,6 +178,7 @@ static void gst_rmdemux_parse_cont (GstRMDemux * rmdemux, const guint8 * data,
     int length);
 static GstFlowReturn gst_rmdemux_parse_packet (GstRMDemux * rmdemux,
     GstBuffer * in, guint16 version);
+static gboolean gst_rmdemux_post_probe (GstRMDemux * rmdemux);
 static void gst_rmdemux_parse_indx_data (GstRMDemux * rmdemux,
     const guint8 * data, int length);
 static void gst_rmdemux_stream_clear_cached_subpackets (GstRMDemux * rmdemux,
@@ -226,6 +241,82 @@ gst_rmdemux_class_init (GstRMDemuxClass * klass)
       0, "Demuxer for Realmedia streams");
 
   gobject_class->finalize = gst_rmdemux_finalize;
+  gobject_class->set_property = gst_rmdemux_set_property;
+  gobject_class->get_property = gst_rmdemux_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_READAHEAD_BYTES,
+      g_param_spec_uint ("readahead-bytes", "Readahead bytes",
+          "Size of the blocks pulled from upstream in pull mode, headers "
+          "and packets are parsed out of these (0 = pull each one "
+          "separately)", 0, G_MAXINT, DEFAULT_READAHEAD_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PROBE,
+      g_param_spec_boolean ("probe", "Probe",
+          "Only parse the headers: post the stream collection, the tags and "
+          "a probe-done element message, then stop without exposing pads "
+          "or reading the data section",
+          DEFAULT_PROBE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_rmdemux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRMDemux *rmdemux = GST_RMDEMUX (object);
+
+  switch (prop_id) {
+    case PROP_READAHEAD_BYTES:
+      GST_OBJECT_LOCK (rmdemux);
+      rmdemux->readahead_bytes = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (rmdemux);
+      break;
+    case PROP_PROBE:
+      GST_OBJECT_LOCK (rmdemux);
+      rmdemux->probe = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (rmdemux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_rmdemux_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstRMDemux *rmdemux = GST_RMDEMUX (object);
+
+  switch (prop_id) {
+    case PROP_READAHEAD_BYTES:
+      GST_OBJECT_LOCK (rmdemux);
+      g_value_set_uint (value, rmdemux->readahead_bytes);
+      GST_OBJECT_UNLOCK (rmdemux);
+      break;
+    case PROP_PROBE:
+      GST_OBJECT_LOCK (rmdemux);
+      g_value_set_boolean (value, rmdemux->probe);
+      GST_OBJECT_UNLOCK (rmdemux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static GstFlowReturn
+gst_rmdemux_pull_range (GstRMDemux * rmdemux, guint offset, guint size,
+    GstBuffer ** buffer)
+{
+  guint block_size;
+
+  GST_OBJECT_LOCK (rmdemux);
+  block_size = rmdemux->readahead_bytes;
+  GST_OBJECT_UNLOCK (rmdemux);
+
+  return gst_rm_utils_readahead_pull (&rmdemux->readahead, rmdemux->sinkpad,
+      block_size, offset, size, buffer);
 }
 
 static void
@@ -241,6 +332,7 @@ gst_rmdemux_finalize (GObject * object)
     gst_flow_combiner_free (rmdemux->flowcombiner);
     rmdemux->flowcombiner = NULL;
   }
+  gst_rm_utils_readahead_clear (&rmdemux->readahead);
 
   GST_CALL_PARENT (G_OBJECT_CLASS, finalize, (object));
 }
@@ -268,6 +360,8 @@ gst_rmdemux_init (GstRMDemux * rmdemux)
   rmdemux->have_group_id = FALSE;
   rmdemux->group_id = G_MAXUINT;
   rmdemux->flowcombiner = gst_flow_combiner_new ();
+  rmdemux->readahead_bytes = DEFAULT_READAHEAD_BYTES;
+  rmdemux->probe = DEFAULT_PROBE;
 
   gst_rm_utils_run_tests ();
 }
@@ -352,7 +446,7 @@ gst_rmdemux_validate_offset (GstRMDemux * rmdemux)
   GstMapInfo map;
 
   buffer = NULL;
-  flowret = gst_pad_pull_range (rmdemux->sinkpad, rmdemux->offset, 4, &buffer);
+  flowret = gst_rmdemux_pull_range (rmdemux, rmdemux->offset, 4, &buffer);
 
   if (flowret != GST_FLOW_OK) {
     GST_DEBUG_OBJECT (rmdemux, "Failed to pull data at offset %d",
@@ -541,6 +635,9 @@ gst_rmdemux_perform_seek (GstRMDemux * rmdemux, GstEvent * event)
 
   GST_LOG_OBJECT (rmdemux, "Pushed FLUSH_STOP event");
 
+  /* cached data is unlikely to be near the new position */
+  gst_rm_utils_readahead_clear (&rmdemux->readahead);
+
   /* For each stream, find the first index offset equal to or before our seek 
    * target. Of these, find the smallest offset. That's where we seek to.
    *
@@ -704,7 +801,11 @@ gst_rmdemux_reset (GstRMDemux * rmdemux)
     GstRMDemuxStream *stream = cur->data;
 
     gst_flow_combiner_remove_pad (rmdemux->flowcombiner, stream->pad);
-    gst_element_remove_pad (GST_ELEMENT (rmdemux), stream->pad);
+    /* probed streams and streams without caps never got exposed */
+    if (GST_PAD_PARENT (stream->pad) == GST_OBJECT_CAST (rmdemux))
+      gst_element_remove_pad (GST_ELEMENT (rmdemux), stream->pad);
+    else
+      gst_object_unref (stream->pad);
     gst_rmdemux_free_stream (rmdemux, stream);
   }
   g_slist_free (rmdemux->streams);
@@ -717,10 +818,20 @@ gst_rmdemux_reset (GstRMDemux * rmdemux)
     rmdemux->pending_tags = NULL;
   }
 
+  gst_object_replace ((GstObject **) & rmdemux->probe_collection, NULL);
+  rmdemux->probed = FALSE;
+
   gst_adapter_clear (rmdemux->adapter);
   rmdemux->state = RMDEMUX_STATE_HEADER;
   rmdemux->have_pads = FALSE;
 
+  GST_DEBUG_OBJECT (rmdemux, "readahead served %" G_GUINT64_FORMAT
+      " reads with %" G_GUINT64_FORMAT " upstream pulls",
+      rmdemux->readahead.n_reads, rmdemux->readahead.n_pulls);
+  gst_rm_utils_readahead_clear (&rmdemux->readahead);
+  rmdemux->readahead.n_reads = 0;
+  rmdemux->readahead.n_pulls = 0;
+
   gst_segment_init (&rmdemux->segment, GST_FORMAT_UNDEFINED);
   rmdemux->first_ts = GST_CLOCK_TIME_NONE;
   rmdemux->base_ts = GST_CLOCK_TIME_NONE;
@@ -831,6 +942,7 @@ gst_rmdemux_sink_activate_mode (GstPad * sinkpad, GstObject * parent,
             sinkpad, NULL);
       } else {
         res = gst_pad_stop_task (sinkpad);
+        gst_rm_utils_readahead_clear (&demux->readahead);
       }
       break;
     default:
@@ -876,7 +988,7 @@ gst_rmdemux_loop (GstPad * pad)
   }
 
   buffer = NULL;
-  ret = gst_pad_pull_range (pad, rmdemux->offset, size, &buffer);
+  ret = gst_rmdemux_pull_range (rmdemux, rmdemux->offset, size, &buffer);
   if (ret != GST_FLOW_OK) {
     if (rmdemux->offset == rmdemux->index_offset) {
       /* The index isn't available so forget about it */
@@ -911,6 +1023,10 @@ gst_rmdemux_loop (GstPad * pad)
     case RMDEMUX_LOOP_STATE_HEADER:
       if (rmdemux->offset >= rmdemux->data_offset) {
         /* It's the end of the header */
+        if (gst_rmdemux_post_probe (rmdemux)) {
+          gst_pad_pause_task (rmdemux->sinkpad);
+          return;
+        }
         rmdemux->loop_state = RMDEMUX_LOOP_STATE_INDEX;
         rmdemux->offset = rmdemux->index_offset;
       }
@@ -945,6 +1061,10 @@ need_pause:
     rmdemux->segment_running = FALSE;
     gst_pad_pause_task (rmdemux->sinkpad);
 
+    /* nothing was exposed after probing */
+    if (rmdemux->probed)
+      return;
+
     if (ret == GST_FLOW_EOS) {
       /* perform EOS logic */
       if (rmdemux->segment.flags & GST_SEEK_FLAG_SEGMENT) {
@@ -997,6 +1117,11 @@ gst_rmdemux_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
   GstRMDemux *rmdemux = GST_RMDEMUX (parent);
 
+  if (G_UNLIKELY (rmdemux->probed)) {
+    gst_buffer_unref (buffer);
+    return GST_FLOW_EOS;
+  }
+
   if (rmdemux->base_ts == -1) {
     if (GST_BUFFER_DTS_IS_VALID (buffer))
       rmdemux->base_ts = GST_BUFFER_DTS (buffer);
@@ -1145,6 +1270,13 @@ gst_rmdemux_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       }
       case RMDEMUX_STATE_HEADER_DATA:
       {
+        if (gst_rmdemux_post_probe (rmdemux)) {
+          gst_adapter_clear (rmdemux->adapter);
+          rmdemux->state = RMDEMUX_STATE_EOS;
+          ret = GST_FLOW_EOS;
+          goto unlock;
+        }
+
         /* If we haven't already done so then signal there are no more pads */
         if (!rmdemux->have_pads) {
           GST_LOG_OBJECT (rmdemux, "no more pads");
@@ -1314,6 +1446,87 @@ gst_rmdemux_send_event (GstRMDemux * rmdemux, GstEvent * event)
   gst_event_unref (event);
 }
 
+static gboolean
+gst_rmdemux_get_probe (GstRMDemux * rmdemux)
+{
+  gboolean probe;
+
+  GST_OBJECT_LOCK (rmdemux);
+  probe = rmdemux->probe;
+  GST_OBJECT_UNLOCK (rmdemux);
+
+  return probe;
+}
+
+/* in probe mode a stream only goes into the collection, its pad is never
+ * activated nor added */
+static void
+gst_rmdemux_probe_stream (GstRMDemux * rmdemux, GstRMDemuxStream * stream,
+    GstCaps * caps)
+{
+  GstStream *gst_stream;
+  gchar *stream_id;
+
+  stream_id = gst_pad_create_stream_id_printf (stream->pad,
+      GST_ELEMENT_CAST (rmdemux), "%03u", stream->id);
+  gst_stream = gst_stream_new (stream_id, caps,
+      stream->subtype == GST_RMDEMUX_STREAM_VIDEO ? GST_STREAM_TYPE_VIDEO :
+      GST_STREAM_TYPE_AUDIO, GST_STREAM_FLAG_NONE);
+  g_free (stream_id);
+
+  if (stream->pending_tags)
+    gst_stream_set_tags (gst_stream, stream->pending_tags);
+
+  if (rmdemux->probe_collection == NULL)
+    rmdemux->probe_collection = gst_stream_collection_new (NULL);
+  gst_stream_collection_add_stream (rmdemux->probe_collection, gst_stream);
+}
+
+/* posts what the headers told us and returns TRUE if probing, in which case
+ * the caller stops before the data section */
+static gboolean
+gst_rmdemux_post_probe (GstRMDemux * rmdemux)
+{
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  GstTagList *tags;
+
+  if (!gst_rmdemux_get_probe (rmdemux))
+    return FALSE;
+
+  if (rmdemux->duration > 0)
+    duration = rmdemux->duration;
+
+  tags = rmdemux->pending_tags ? gst_tag_list_copy (rmdemux->pending_tags) :
+      gst_tag_list_new_empty ();
+  gst_tag_list_set_scope (tags, GST_TAG_SCOPE_GLOBAL);
+  gst_tag_list_add (tags, GST_TAG_MERGE_KEEP, GST_TAG_CONTAINER_FORMAT,
+      "RealMedia", NULL);
+  if (GST_CLOCK_TIME_IS_VALID (duration))
+    gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE, GST_TAG_DURATION, duration,
+        NULL);
+
+  GST_DEBUG_OBJECT (rmdemux, "probe done, %u streams, duration %"
+      GST_TIME_FORMAT, g_slist_length (rmdemux->streams),
+      GST_TIME_ARGS (duration));
+
+  if (rmdemux->probe_collection)
+    gst_element_post_message (GST_ELEMENT_CAST (rmdemux),
+        gst_message_new_stream_collection (GST_OBJECT_CAST (rmdemux),
+            rmdemux->probe_collection));
+  gst_element_post_message (GST_ELEMENT_CAST (rmdemux),
+      gst_message_new_tag (GST_OBJECT_CAST (rmdemux), tags));
+  gst_element_post_message (GST_ELEMENT_CAST (rmdemux),
+      gst_message_new_element (GST_OBJECT_CAST (rmdemux),
+          gst_structure_new ("probe-done",
+              "duration", G_TYPE_UINT64, duration,
+              "seekable", G_TYPE_BOOLEAN, rmdemux->seekable,
+              "num-streams", G_TYPE_UINT, g_slist_length (rmdemux->streams),
+              NULL)));
+
+  rmdemux->probed = TRUE;
+  return TRUE;
+}
+
 static void
 gst_rmdemux_add_stream (GstRMDemux * rmdemux, GstRMDemuxStream * stream)
 {
@@ -1519,6 +1732,22 @@ gst_rmdemux_add_stream (GstRMDemux * rmdemux, GstRMDemuxStream * stream)
       gst_buffer_unref (buffer);
     }
 
+    codec_name = gst_pb_utils_get_codec_description (stream_caps);
+
+    /* save for later, we must send the tags after the newsegment event */
+    if (codec_tag != NULL && codec_name != NULL) {
+      if (stream->pending_tags == NULL)
+        stream->pending_tags = gst_tag_list_new_empty ();
+      gst_tag_list_add (stream->pending_tags, GST_TAG_MERGE_KEEP,
+          codec_tag, codec_name, NULL);
+      g_free (codec_name);
+    }
+
+    if (gst_rmdemux_get_probe (rmdemux)) {
+      gst_rmdemux_probe_stream (rmdemux, stream, stream_caps);
+      goto beach;
+    }
+
     gst_pad_use_fixed_caps (stream->pad);
 
     gst_pad_set_event_function (stream->pad,
@@ -1556,16 +1785,6 @@ gst_rmdemux_add_stream (GstRMDemux * rmdemux, GstRMDemuxStream * stream)
 
     gst_pad_set_caps (stream->pad, stream_caps);
 
-    codec_name = gst_pb_utils_get_codec_description (stream_caps);
-
-    /* save for later, we must send the tags after the newsegment event */
-    if (codec_tag != NULL && codec_name != NULL) {
-      if (stream->pending_tags == NULL)
-        stream->pending_tags = gst_tag_list_new_empty ();
-      gst_tag_list_add (stream->pending_tags, GST_TAG_MERGE_KEEP,
-          codec_tag, codec_name, NULL);
-      g_free (codec_name);
-    }
     gst_element_add_pad (GST_ELEMENT_CAST (rmdemux), stream->pad);
     gst_flow_combiner_add_pad (rmdemux->flowcombiner, stream->pad);
   }
@@ -26,6 +26,8 @@
 #include <gst/base/gstflowcombiner.h>
 #include <gst/pbutils/descriptions.h>
 
+#include "rmutils.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_RMDEMUX \
@@ -104,6 +106,10 @@ struct _GstRMDemux {
   guint offset;
   gboolean seekable;
 
+  /* pull mode readahead */
+  guint readahead_bytes;
+  GstRmUtilsReadahead readahead;
+
   GstRMDemuxState state;
   GstRMDemuxLoopState loop_state;
   GstRMDemuxStream *index_stream;
@@ -132,6 +138,11 @@ struct _GstRMDemux {
 
   /* container tags for all streams */
   GstTagList *pending_tags;
+
+  /* header-only probing: describe the streams, expose nothing */
+  gboolean probe;               /* under object lock */
+  gboolean probed;
+  GstStreamCollection *probe_collection;
 };
 
 struct _GstRMDemuxClass {
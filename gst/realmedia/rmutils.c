@@ -254,6 +254,85 @@ gst_rm_utils_descramble_sipr_buffer (GstBuffer * buf)
   return buf;
 }
 
+/* upstream blocks start on this boundary */
+#define READAHEAD_ALIGN 4096
+
+/* Works like gst_pad_pull_range(), but serves requests out of a cached
+ * block of @block_size bytes where possible. A @block_size of 0 disables
+ * the cache and pulls every request directly. */
+GstFlowReturn
+gst_rm_utils_readahead_pull (GstRmUtilsReadahead * ra, GstPad * pad,
+    guint block_size, guint64 offset, guint size, GstBuffer ** buffer)
+{
+  GstFlowReturn ret;
+  GstBuffer *block;
+  guint64 block_offset;
+  gsize block_len, skip;
+  guint pull_size;
+
+  ra->n_reads++;
+
+  /* too large to be worth caching */
+  if (block_size == 0 || size >= block_size) {
+    ra->n_pulls++;
+    return gst_pad_pull_range (pad, offset, size, buffer);
+  }
+
+  if (ra->block != NULL && offset >= ra->offset) {
+    block_len = gst_buffer_get_size (ra->block);
+
+    if (offset + size <= ra->offset + block_len)
+      goto serve;
+
+    /* nothing more to get than what is in the cache */
+    if (ra->short_block) {
+      if (offset < ra->offset + block_len)
+        goto serve;
+      return GST_FLOW_EOS;
+    }
+  }
+
+  /* refill, keeping the start aligned and the request inside the block */
+  gst_rm_utils_readahead_clear (ra);
+
+  block_offset = offset - (offset % READAHEAD_ALIGN);
+  pull_size = MAX (block_size, (guint) (offset - block_offset) + size);
+
+  block = NULL;
+  ra->n_pulls++;
+  ret = gst_pad_pull_range (pad, block_offset, pull_size, &block);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  block_len = gst_buffer_get_size (block);
+  ra->block = block;
+  ra->offset = block_offset;
+  ra->short_block = (block_len < pull_size);
+
+  if (offset >= block_offset + block_len)
+    return GST_FLOW_EOS;
+
+serve:
+  block_len = gst_buffer_get_size (ra->block);
+  skip = offset - ra->offset;
+  size = MIN (size, block_len - skip);
+
+  *buffer = gst_buffer_copy_region (ra->block, GST_BUFFER_COPY_ALL, skip, size);
+  GST_BUFFER_OFFSET (*buffer) = offset;
+  GST_BUFFER_OFFSET_END (*buffer) = offset + size;
+
+  return GST_FLOW_OK;
+}
+
+/* Drops the cached block, e.g. after a seek. Statistics are kept. */
+void
+gst_rm_utils_readahead_clear (GstRmUtilsReadahead * ra)
+{
+  gst_buffer_replace (&ra->block, NULL);
+  ra->offset = 0;
+  ra->short_block = FALSE;
+}
+
 void
 gst_rm_utils_run_tests (void)
 {
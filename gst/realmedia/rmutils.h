@@ -26,6 +26,18 @@ G_BEGIN_DECLS
 
 typedef gchar * (*GstRmUtilsStringReadFunc) (const guint8 * data, guint datalen, guint * p_strlen);
 
+/* Block cache used to serve small pull-mode reads out of one large
+ * upstream pull_range */
+typedef struct
+{
+  GstBuffer *block;             /* cached upstream data, or NULL */
+  guint64    offset;            /* upstream byte offset of block */
+  gboolean   short_block;       /* block was truncated by end of stream */
+
+  guint64    n_reads;           /* reads requested by the demuxer */
+  guint64    n_pulls;           /* pull_range calls made upstream */
+} GstRmUtilsReadahead;
+
 gchar         *gst_rm_utils_read_string8  (const guint8 * data,
                                            guint          datalen,
                                            guint        * p_totallen);
@@ -41,6 +53,15 @@ GstTagList    *gst_rm_utils_read_tags     (const guint8            * data,
 GstBuffer     *gst_rm_utils_descramble_dnet_buffer (GstBuffer * buf);
 GstBuffer     *gst_rm_utils_descramble_sipr_buffer (GstBuffer * buf);
 
+GstFlowReturn  gst_rm_utils_readahead_pull  (GstRmUtilsReadahead * ra,
+                                             GstPad              * pad,
+                                             guint                 block_size,
+                                             guint64               offset,
+                                             guint                 size,
+                                             GstBuffer          ** buffer);
+
+void           gst_rm_utils_readahead_clear (GstRmUtilsReadahead * ra);
+
 void gst_rm_utils_run_tests (void);
 
 
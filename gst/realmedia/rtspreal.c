@@ -47,6 +47,12 @@ GST_DEBUG_CATEGORY_STATIC (rtspreal_debug);
 #define SERVER_PREFIX "RealServer"
 #define DEFAULT_BANDWIDTH	"10485800"
 
+/* maps the id we put in the stream caps to the GstRTSPReal, so that
+ * rdtmanager can report receive rates to us */
+static GMutex registry_lock;
+static GHashTable *registry;
+static guint registry_seqnum;
+
 static GstRTSPResult
 rtsp_ext_real_get_transports (GstRTSPExtension * ext,
     GstRTSPLowerTrans protocols, gchar ** transport)
@@ -266,6 +272,29 @@ G_STMT_START {			                      \
   datap += str_len + 2;                               \
 } G_STMT_END
 
+/* sum of the AverageBandwidth of the given rules */
+static guint
+gst_rtsp_real_stream_get_rules_rate (GstRTSPRealStream * stream,
+    const gint * rules, gint n_rules)
+{
+  guint rate = 0;
+  gint i;
+
+  for (i = 0; i < n_rules; i++) {
+    GstASMRule *rule;
+    const gchar *val;
+
+    rule = g_list_nth_data (stream->rulebook->rules, rules[i]);
+    if (rule == NULL)
+      continue;
+
+    val = g_hash_table_lookup (rule->props, "AverageBandwidth");
+    if (val)
+      rate += atoi (val);
+  }
+  return rate;
+}
+
 static GstRTSPResult
 rtsp_ext_real_parse_sdp (GstRTSPExtension * ext, GstSDPMessage * sdp,
     GstStructure * props)
@@ -381,6 +410,7 @@ rtsp_ext_real_parse_sdp (GstRTSPExtension * ext, GstSDPMessage * sdp,
       continue;
 
     stream = g_new0 (GstRTSPRealStream, 1);
+    stream->index = i;
     ctx->streams = g_list_append (ctx->streams, stream);
 
     READ_INT_M (media, "MaxBitRate", stream->max_bit_rate);
@@ -395,35 +425,24 @@ rtsp_ext_real_parse_sdp (GstRTSPExtension * ext, GstSDPMessage * sdp,
     READ_STRING (media, "mimetype", str, stream->mime_type_len);
     stream->mime_type = g_strndup (str, stream->mime_type_len);
 
-    /* FIXME: Depending on the current bandwidth, we need to select one
-     * bandwith out of a list offered by the server. Someone needs to write
-     * a parser for strings like
-     *
-     * #($Bandwidth < 67959),TimestampDelivery=T,DropByN=T,priority=9;
-     * #($Bandwidth >= 67959) && ($Bandwidth < 167959),AverageBandwidth=67959,
-     * Priority=9;#($Bandwidth >= 67959) && ($Bandwidth < 167959),
-     * AverageBandwidth=0,Priority=5,OnDepend=\"1\";
-     * #($Bandwidth >= 167959) && ($Bandwidth < 267959),
-     * AverageBandwidth=167959,Priority=9;
-     * #($Bandwidth >= 167959) && ($Bandwidth < 267959),AverageBandwidth=0,
-     * Priority=5,OnDepend=\"3\";#($Bandwidth >= 267959),
-     * AverageBandwidth=267959,Priority=9;#($Bandwidth >= 267959),
-     * AverageBandwidth=0,Priority=5,OnDepend=\"5\";
-     *
-     * As I don't know how to do that, I just use the first entry (sel = 0).
-     * But to give you a starting point, I offer you above string
-     * in the variable 'asm_rule_book'.
-     */
+    /* Select the rules for the initial bandwidth. Once data flows,
+     * gst_rtsp_real_report_bitrate() re-evaluates the rulebook against the
+     * measured receive rate and switches between the rules that use the
+     * same codec as the one selected here. */
     READ_STRING (media, "ASMRuleBook", str, asm_rule_book_len);
     stream->rulebook = gst_asm_rule_book_new (str);
 
     n = gst_asm_rule_book_match (stream->rulebook, vars, rulematches);
     for (j = 0; j < n; j++) {
       g_string_append_printf (rules, "stream=%u;rule=%u,", i, rulematches[j]);
+      stream->subscribed[j] = rulematches[j];
     }
+    stream->n_subscribed = n;
+    stream->subscribed_rate =
+        gst_rtsp_real_stream_get_rules_rate (stream, rulematches, n);
 
     /* get the MLTI for the first matched rules */
-    sel = rulematches[0];
+    sel = n > 0 ? rulematches[0] : 0;
 
     READ_BUFFER_M (media, "OpaqueData", opaque_data, opaque_data_len);
 
@@ -455,30 +474,22 @@ rtsp_ext_real_parse_sdp (GstRTSPExtension * ext, GstSDPMessage * sdp,
       goto strange_opaque_data;
     }
 
-    if (opaque_data_len < 2 * sel) {
+    if (opaque_data_len < 2 * stream->num_rules) {
       GST_DEBUG_OBJECT (ctx, "opaque_data_len %" G_GSIZE_FORMAT
-          " < 2 * sel (%d)", opaque_data_len, 2 * sel);
+          " < 2 * num_rules (%d)", opaque_data_len, 2 * stream->num_rules);
       goto strange_opaque_data;
     }
-    opaque_data += 2 * sel;
-    opaque_data_len -= 2 * sel;
 
-    if (opaque_data_len < 2) {
-      GST_DEBUG_OBJECT (ctx, "opaque_data_len %" G_GSIZE_FORMAT " < 2",
-          opaque_data_len);
-      goto strange_opaque_data;
-    }
-    stream->codec = GST_READ_UINT16_BE (opaque_data);
-    opaque_data += 2;
-    opaque_data_len -= 2;
+    /* keep the codec of every rule, we can only switch to rules that use
+     * the codec we configure now */
+    stream->n_rule_codecs = stream->num_rules;
+    stream->rule_codecs = g_new (guint16, stream->n_rule_codecs);
+    for (j = 0; j < stream->num_rules; j++)
+      stream->rule_codecs[j] = GST_READ_UINT16_BE (opaque_data + 2 * j);
+    opaque_data += 2 * stream->num_rules;
+    opaque_data_len -= 2 * stream->num_rules;
 
-    if (opaque_data_len < 2 * (stream->num_rules - sel - 1)) {
-      GST_DEBUG_OBJECT (ctx, "opaque_data_len %" G_GSIZE_FORMAT
-          " < %d", opaque_data_len, 2 * (stream->num_rules - sel - 1));
-      goto strange_opaque_data;
-    }
-    opaque_data += 2 * (stream->num_rules - sel - 1);
-    opaque_data_len -= 2 * (stream->num_rules - sel - 1);
+    stream->codec = stream->rule_codecs[sel];
 
     if (opaque_data_len < 2) {
       GST_DEBUG_OBJECT (ctx, "opaque_data_len %" G_GSIZE_FORMAT " < 2",
@@ -593,6 +604,9 @@ rtsp_ext_real_parse_sdp (GstRTSPExtension * ext, GstSDPMessage * sdp,
   gst_structure_set (props, "encoding-name", G_TYPE_STRING, "X-REAL-RDT", NULL);
   gst_structure_set (props, "media", G_TYPE_STRING, "application", NULL);
 
+  /* lets rdtmanager find us to report receive rates */
+  gst_structure_set (props, "rtspreal-id", G_TYPE_STRING, ctx->id, NULL);
+
   return TRUE;
 
   /* ERRORS */
@@ -629,7 +643,11 @@ rtsp_ext_real_stream_select (GstRTSPExtension * ext, GstRTSPUrl * url)
               req_url)) < 0)
     goto create_request_failed;
 
-  g_free (req_url);
+  /* keep the url around for changing the subscription later */
+  GST_OBJECT_LOCK (ctx);
+  g_free (ctx->req_url);
+  ctx->req_url = req_url;
+  GST_OBJECT_UNLOCK (ctx);
 
   gst_rtsp_message_add_header (&request, GST_RTSP_HDR_SUBSCRIBE, ctx->rules);
 
@@ -664,6 +682,273 @@ reset:
   }
 }
 
+/* evaluate the rulebook of @stream for @bandwidth and update the
+ * subscription, the changes are appended to @subscribe and @unsubscribe */
+static void
+gst_rtsp_real_stream_resubscribe (GstRTSPReal * ctx,
+    GstRTSPRealStream * stream, guint bandwidth, GString * subscribe,
+    GString * unsubscribe)
+{
+  GstASMRuleBook *book = stream->rulebook;
+  gint rulematches[MAX_RULEMATCHES];
+  gint rules[MAX_RULEMATCHES];
+  gfloat *values;
+  gint i, j, n, n_rules, idx;
+
+  values = g_new0 (gfloat, MAX (book->n_vars, 1));
+  idx = gst_asm_rule_book_get_var_index (book, "Bandwidth");
+  if (idx >= 0)
+    values[idx] = bandwidth;
+
+  n = gst_asm_rule_book_match_values (book, values, rulematches);
+  g_free (values);
+
+  /* only rules decoded by the codec we configured */
+  n_rules = 0;
+  for (i = 0; i < n; i++) {
+    gint r = rulematches[i];
+
+    if (stream->rule_codecs && ((guint) r >= stream->n_rule_codecs ||
+            stream->rule_codecs[r] != stream->codec))
+      continue;
+    rules[n_rules++] = r;
+  }
+
+  if (n_rules == 0) {
+    GST_DEBUG_OBJECT (ctx, "stream %u: no usable rules for bandwidth %u",
+        stream->index, bandwidth);
+    return;
+  }
+
+  for (i = 0; i < n_rules; i++) {
+    for (j = 0; j < stream->n_subscribed; j++)
+      if (stream->subscribed[j] == rules[i])
+        break;
+    if (j == stream->n_subscribed)
+      g_string_append_printf (subscribe, "stream=%u;rule=%u,", stream->index,
+          rules[i]);
+  }
+  for (j = 0; j < stream->n_subscribed; j++) {
+    for (i = 0; i < n_rules; i++)
+      if (stream->subscribed[j] == rules[i])
+        break;
+    if (i == n_rules)
+      g_string_append_printf (unsubscribe, "stream=%u;rule=%u,",
+          stream->index, stream->subscribed[j]);
+  }
+
+  memcpy (stream->subscribed, rules, n_rules * sizeof (gint));
+  stream->n_subscribed = n_rules;
+  stream->subscribed_rate =
+      gst_rtsp_real_stream_get_rules_rate (stream, rules, n_rules);
+}
+
+/* a subscription change waiting to be sent */
+typedef struct
+{
+  gchar *req_url;
+  gchar *subscribe;
+  gchar *unsubscribe;
+  guint bandwidth;
+} GstRTSPRealRequest;
+
+static void
+gst_rtsp_real_request_free (GstRTSPRealRequest * req)
+{
+  g_free (req->req_url);
+  g_free (req->subscribe);
+  g_free (req->unsubscribe);
+  g_free (req);
+}
+
+static void
+gst_rtsp_real_send_subscription (GstRTSPReal * ctx, const gchar * req_url,
+    const gchar * subscribe, const gchar * unsubscribe, guint bandwidth)
+{
+  GstRTSPResult res;
+  GstRTSPMessage request = { 0 };
+  GstRTSPMessage response = { 0 };
+  gchar *value;
+
+  if ((res = gst_rtsp_message_init_request (&request, GST_RTSP_SET_PARAMETER,
+              req_url)) < 0)
+    goto create_request_failed;
+
+  if (subscribe[0] != '\0')
+    gst_rtsp_message_add_header (&request, GST_RTSP_HDR_SUBSCRIBE, subscribe);
+  if (unsubscribe[0] != '\0')
+    gst_rtsp_message_add_header_by_name (&request, "Unsubscribe",
+        unsubscribe);
+
+  value = g_strdup_printf ("Bandwidth=%u;BackOff=0", bandwidth);
+  gst_rtsp_message_add_header_by_name (&request, "SetDeliveryBandwidth",
+      value);
+  g_free (value);
+
+  if ((res = gst_rtsp_extension_send (GST_RTSP_EXTENSION (ctx), &request,
+              &response)) < 0)
+    goto send_error;
+
+  gst_rtsp_message_unset (&request);
+  gst_rtsp_message_unset (&response);
+
+  return;
+
+  /* ERRORS */
+create_request_failed:
+  {
+    GST_WARNING_OBJECT (ctx, "could not create request: %d", res);
+    return;
+  }
+send_error:
+  {
+    GST_WARNING_OBJECT (ctx, "could not change subscription: %d", res);
+    gst_rtsp_message_unset (&request);
+    gst_rtsp_message_unset (&response);
+    return;
+  }
+}
+
+/* sends the queued subscription changes in order, so that the RTSP round
+ * trip never blocks the thread that reported the rate */
+static void
+gst_rtsp_real_task_func (GstRTSPReal * ctx)
+{
+  GstRTSPRealRequest *req;
+
+  GST_OBJECT_LOCK (ctx);
+  while (!ctx->stopping && g_queue_is_empty (&ctx->requests))
+    g_cond_wait (&ctx->task_cond, GST_OBJECT_GET_LOCK (ctx));
+  if (ctx->stopping) {
+    GST_OBJECT_UNLOCK (ctx);
+    return;
+  }
+  req = g_queue_pop_head (&ctx->requests);
+  GST_OBJECT_UNLOCK (ctx);
+
+  gst_rtsp_real_send_subscription (ctx, req->req_url, req->subscribe,
+      req->unsubscribe, req->bandwidth);
+  gst_rtsp_real_request_free (req);
+}
+
+/* call with the object lock */
+static void
+gst_rtsp_real_queue_subscription (GstRTSPReal * ctx, GstRTSPRealRequest * req)
+{
+  g_queue_push_tail (&ctx->requests, req);
+  g_cond_signal (&ctx->task_cond);
+
+  if (ctx->task == NULL) {
+    ctx->task = gst_task_new ((GstTaskFunction) gst_rtsp_real_task_func, ctx,
+        NULL);
+    gst_object_set_name (GST_OBJECT_CAST (ctx->task), "rtspreal:subscribe");
+    gst_task_set_lock (ctx->task, &ctx->task_lock);
+    gst_task_start (ctx->task);
+  }
+}
+
+static void
+gst_rtsp_real_adapt (GstRTSPReal * ctx, guint index, guint bitrate)
+{
+  GList *walk;
+  guint64 rate = 0, expected = 0;
+  guint bandwidth;
+  GString *subscribe, *unsubscribe;
+
+  GST_OBJECT_LOCK (ctx);
+  for (walk = ctx->streams; walk; walk = g_list_next (walk)) {
+    GstRTSPRealStream *stream = (GstRTSPRealStream *) walk->data;
+
+    if (stream->index == index)
+      stream->rate = bitrate;
+    rate += stream->rate;
+    expected += stream->subscribed_rate;
+  }
+
+  if (ctx->req_url == NULL ||
+      !gst_rtsp_real_adapt_update (&ctx->adapt, rate, expected, &bandwidth))
+    goto done;
+
+  GST_DEBUG_OBJECT (ctx, "receiving %" G_GUINT64_FORMAT " bps, expected %"
+      G_GUINT64_FORMAT ", evaluating rules for bandwidth %u", rate, expected,
+      bandwidth);
+
+  subscribe = g_string_new ("");
+  unsubscribe = g_string_new ("");
+  for (walk = ctx->streams; walk; walk = g_list_next (walk)) {
+    GstRTSPRealStream *stream = (GstRTSPRealStream *) walk->data;
+
+    gst_rtsp_real_stream_resubscribe (ctx, stream, bandwidth, subscribe,
+        unsubscribe);
+  }
+  if (subscribe->len > 0 || unsubscribe->len > 0) {
+    GstRTSPRealRequest *req;
+
+    /* strip final , */
+    if (subscribe->len > 0)
+      g_string_truncate (subscribe, subscribe->len - 1);
+    if (unsubscribe->len > 0)
+      g_string_truncate (unsubscribe, unsubscribe->len - 1);
+
+    GST_INFO_OBJECT (ctx, "subscribe \"%s\", unsubscribe \"%s\"",
+        subscribe->str, unsubscribe->str);
+
+    req = g_new0 (GstRTSPRealRequest, 1);
+    req->req_url = g_strdup (ctx->req_url);
+    req->subscribe = g_string_free (subscribe, FALSE);
+    req->unsubscribe = g_string_free (unsubscribe, FALSE);
+    req->bandwidth = bandwidth;
+    gst_rtsp_real_queue_subscription (ctx, req);
+  } else {
+    g_string_free (subscribe, TRUE);
+    g_string_free (unsubscribe, TRUE);
+  }
+
+done:
+  GST_OBJECT_UNLOCK (ctx);
+}
+
+/**
+ * gst_rtsp_real_report_bitrate:
+ * @id: the rtspreal-id from the stream caps
+ * @stream: the stream (SDP media index)
+ * @bitrate: receive rate of @stream in bits per second
+ *
+ * Called periodically by rdtmanager. When the receive rate stays below
+ * what the subscribed rules need, the rulebooks are evaluated for the
+ * measured rate and lower rules are subscribed with a SET_PARAMETER
+ * request; when it keeps up, a higher bandwidth is probed.
+ *
+ * The request is sent asynchronously from a task of the extension, so
+ * the calling streaming thread never waits for the server.
+ */
+void
+gst_rtsp_real_report_bitrate (const gchar * id, guint stream, guint bitrate)
+{
+  GstRTSPReal *ctx = NULL;
+  GWeakRef *ref;
+
+  g_mutex_lock (&registry_lock);
+  if (registry && (ref = g_hash_table_lookup (registry, id)))
+    ctx = g_weak_ref_get (ref);
+  g_mutex_unlock (&registry_lock);
+
+  if (ctx == NULL)
+    return;
+
+  if (ctx->isreal)
+    gst_rtsp_real_adapt (ctx, stream, bitrate);
+
+  gst_object_unref (ctx);
+}
+
+static void
+gst_rtsp_real_weak_ref_free (GWeakRef * ref)
+{
+  g_weak_ref_clear (ref);
+  g_free (ref);
+}
+
 static void gst_rtsp_real_extension_init (gpointer g_iface,
     gpointer iface_data);
 static void gst_rtsp_real_finalize (GObject * obj);
@@ -693,7 +978,24 @@ gst_rtsp_real_class_init (GstRTSPRealClass * g_class)
 static void
 gst_rtsp_real_init (GstRTSPReal * rtspreal)
 {
+  GWeakRef *ref;
+
   rtspreal->isreal = FALSE;
+  gst_rtsp_real_adapt_init (&rtspreal->adapt, atoi (DEFAULT_BANDWIDTH));
+  g_rec_mutex_init (&rtspreal->task_lock);
+  g_cond_init (&rtspreal->task_cond);
+  g_queue_init (&rtspreal->requests);
+
+  ref = g_new0 (GWeakRef, 1);
+  g_weak_ref_init (ref, rtspreal);
+
+  g_mutex_lock (&registry_lock);
+  if (registry == NULL)
+    registry = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) gst_rtsp_real_weak_ref_free);
+  rtspreal->id = g_strdup_printf ("rtspreal-%u", registry_seqnum++);
+  g_hash_table_insert (registry, g_strdup (rtspreal->id), ref);
+  g_mutex_unlock (&registry_lock);
 }
 
 static void
@@ -703,6 +1005,7 @@ gst_rtsp_stream_free (GstRTSPRealStream * stream)
   g_free (stream->mime_type);
   gst_asm_rule_book_free (stream->rulebook);
   g_free (stream->type_specific_data);
+  g_free (stream->rule_codecs);
 
   g_free (stream);
 }
@@ -712,9 +1015,29 @@ gst_rtsp_real_finalize (GObject * obj)
 {
   GstRTSPReal *r = (GstRTSPReal *) obj;
 
+  if (r->task) {
+    gst_task_stop (r->task);
+    GST_OBJECT_LOCK (r);
+    r->stopping = TRUE;
+    g_cond_signal (&r->task_cond);
+    GST_OBJECT_UNLOCK (r);
+    gst_task_join (r->task);
+    gst_object_unref (r->task);
+  }
+  g_queue_foreach (&r->requests, (GFunc) gst_rtsp_real_request_free, NULL);
+  g_queue_clear (&r->requests);
+  g_cond_clear (&r->task_cond);
+  g_rec_mutex_clear (&r->task_lock);
+
+  g_mutex_lock (&registry_lock);
+  g_hash_table_remove (registry, r->id);
+  g_mutex_unlock (&registry_lock);
+  g_free (r->id);
+
   g_list_foreach (r->streams, (GFunc) gst_rtsp_stream_free, NULL);
   g_list_free (r->streams);
   g_free (r->rules);
+  g_free (r->req_url);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
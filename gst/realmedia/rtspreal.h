@@ -23,6 +23,7 @@
 #include <gst/gst.h>
 
 #include "asmrules.h"
+#include "rtsprealadapt.h"
 
 G_BEGIN_DECLS
 
@@ -57,6 +58,19 @@ struct _GstRTSPRealStream {
   guint  type_specific_data_len;
 
   guint16 num_rules, j, sel, codec;
+
+  /* media index in the SDP */
+  guint    index;
+  /* MLTI codec of each rule, NULL if the stream has only one codec */
+  guint16 *rule_codecs;
+  guint    n_rule_codecs;
+
+  /* currently subscribed rules and the receive rate they need */
+  gint     subscribed[MAX_RULEMATCHES];
+  gint     n_subscribed;
+  guint    subscribed_rate;
+  /* last receive rate reported by rdtmanager */
+  guint    rate;
 };
 
 struct _GstRTSPReal {
@@ -77,6 +91,19 @@ struct _GstRTSPReal {
   guint  duration;
 
   gchar *rules;
+
+  /* for bandwidth adaptation, protected by the object lock */
+  gchar *id;
+  gchar *req_url;
+  GstRTSPRealAdapt adapt;
+
+  /* subscription changes are sent from this task, never from the thread
+   * reporting the rate; the queue is protected by the object lock */
+  GstTask   *task;
+  GRecMutex  task_lock;
+  GCond      task_cond;
+  GQueue     requests;
+  gboolean   stopping;
 };
 
 struct _GstRTSPRealClass {
@@ -87,6 +114,9 @@ GType gst_rtsp_real_get_type(void);
 
 gboolean gst_rtsp_real_plugin_init (GstPlugin * plugin);
 
+void gst_rtsp_real_report_bitrate (const gchar * id, guint stream,
+    guint bitrate);
+
 G_END_DECLS
 
 #endif /* __GST_RTSP_REAL_H__ */
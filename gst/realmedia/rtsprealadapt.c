@@ -0,0 +1,74 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rtsprealadapt.h"
+
+void
+gst_rtsp_real_adapt_init (GstRTSPRealAdapt * adapt, guint max_bandwidth)
+{
+  adapt->max_bandwidth = max_bandwidth;
+  adapt->bandwidth = max_bandwidth;
+  adapt->n_low_reports = 0;
+  adapt->n_high_reports = 0;
+}
+
+/* takes the total receive @rate and the @expected rate of the subscribed
+ * rules, both in bits per second; returns TRUE and the bandwidth to select
+ * rules for in @bandwidth when the subscription should change */
+gboolean
+gst_rtsp_real_adapt_update (GstRTSPRealAdapt * adapt, guint64 rate,
+    guint64 expected, guint * bandwidth)
+{
+  guint64 result;
+
+  /* no AverageBandwidth in the rules, nothing to compare with */
+  if (expected == 0)
+    return FALSE;
+
+  if (rate * 100 < expected * 85) {
+    adapt->n_low_reports++;
+    adapt->n_high_reports = 0;
+  } else if (rate * 100 >= expected * 95) {
+    adapt->n_high_reports++;
+    adapt->n_low_reports = 0;
+  } else {
+    adapt->n_low_reports = 0;
+    adapt->n_high_reports = 0;
+  }
+
+  if (adapt->n_low_reports >= GST_RTSP_REAL_ADAPT_DOWN_REPORTS) {
+    result = rate;
+  } else if (adapt->n_high_reports >= GST_RTSP_REAL_ADAPT_UP_REPORTS &&
+      adapt->bandwidth < adapt->max_bandwidth) {
+    result = MIN ((guint64) adapt->max_bandwidth,
+        MAX ((guint64) adapt->bandwidth, rate) * 2);
+  } else {
+    return FALSE;
+  }
+
+  adapt->n_low_reports = 0;
+  adapt->n_high_reports = 0;
+  adapt->bandwidth = MIN (result, G_MAXUINT);
+  *bandwidth = adapt->bandwidth;
+
+  return TRUE;
+}
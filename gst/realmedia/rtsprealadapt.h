@@ -0,0 +1,51 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTSP_REAL_ADAPT_H__
+#define __GST_RTSP_REAL_ADAPT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* switch down after this many reports below 85% of the subscribed rate,
+ * probe a higher bandwidth after this many reports above 95% of it */
+#define GST_RTSP_REAL_ADAPT_DOWN_REPORTS      3
+#define GST_RTSP_REAL_ADAPT_UP_REPORTS        10
+
+typedef struct _GstRTSPRealAdapt GstRTSPRealAdapt;
+
+/* decides from the reported receive rates which bandwidth to evaluate the
+ * rulebooks for */
+struct _GstRTSPRealAdapt {
+  guint  bandwidth;
+  guint  max_bandwidth;
+  guint  n_low_reports;
+  guint  n_high_reports;
+};
+
+void     gst_rtsp_real_adapt_init   (GstRTSPRealAdapt * adapt,
+                                     guint max_bandwidth);
+
+gboolean gst_rtsp_real_adapt_update (GstRTSPRealAdapt * adapt,
+                                     guint64 rate, guint64 expected,
+                                     guint * bandwidth);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_REAL_ADAPT_H__ */
@@ -22,7 +22,9 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
 #include <gst/audio/audio.h>
+#include <math.h>
 
 #define SRC_CAPS "audio/x-raw, format = (string)" GST_AUDIO_NE (S16) ", " \
     "layout = (string) interleaved, channels = (int) 1, rate = (int) 8000"
@@ -52,7 +54,7 @@ buffer_unref (void *buffer, void *user_data)
 }
 
 static GstElement *
-setup_amrnbenc (void)
+setup_amrnbenc (guint frames_per_buffer)
 {
   GstElement *amrnbenc;
   GstCaps *caps;
@@ -61,6 +63,7 @@ setup_amrnbenc (void)
   GST_DEBUG ("setup_amrnbenc");
 
   amrnbenc = gst_check_setup_element ("amrnbenc");
+  g_object_set (amrnbenc, "frames-per-buffer", frames_per_buffer, NULL);
   srcpad = gst_check_setup_src_pad (amrnbenc, &srctemplate);
   sinkpad = gst_check_setup_sink_pad (amrnbenc, &sinktemplate);
   gst_pad_set_active (srcpad, TRUE);
@@ -125,7 +128,7 @@ GST_START_TEST (test_enc)
 {
   GstElement *amrnbenc;
 
-  amrnbenc = setup_amrnbenc ();
+  amrnbenc = setup_amrnbenc (1);
   push_data (1000, GST_FLOW_OK);
 
   cleanup_amrnbenc (amrnbenc);
@@ -133,6 +136,181 @@ GST_START_TEST (test_enc)
 
 GST_END_TEST;
 
+GST_START_TEST (test_enc_frames_per_buffer)
+{
+  GstElement *amrnbenc;
+  GstBuffer *buffer;
+  GList *l;
+  gint i;
+
+  amrnbenc = setup_amrnbenc (5);
+
+  /* 10 frames of 20 ms */
+  buffer = gst_buffer_new_and_alloc (10 * 320);
+  gst_buffer_memset (buffer, 0, 0, 10 * 320);
+  GST_BUFFER_PTS (buffer) = 0;
+  GST_BUFFER_DURATION (buffer) = 200 * GST_MSECOND;
+  fail_unless_equals_int (gst_pad_push (srcpad, buffer), GST_FLOW_OK);
+
+  fail_unless_equals_int (g_list_length (buffers), 2);
+  for (l = buffers, i = 0; l; l = l->next, i++) {
+    buffer = GST_BUFFER (l->data);
+    /* 5 frames of 32 bytes in MR122 */
+    fail_unless_equals_int (gst_buffer_get_size (buffer), 5 * 32);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), i * 100 * GST_MSECOND);
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer),
+        100 * GST_MSECOND);
+  }
+
+  cleanup_amrnbenc (amrnbenc);
+}
+
+GST_END_TEST;
+
+#define BENCH_SECONDS 60
+
+static gint64
+encode_seconds (guint frames_per_buffer)
+{
+  GstElement *amrnbenc;
+  gint64 start;
+  gint i;
+
+  amrnbenc = setup_amrnbenc (frames_per_buffer);
+
+  start = g_get_monotonic_time ();
+  /* one second of audio per buffer */
+  for (i = 0; i < BENCH_SECONDS; i++)
+    push_data (8000 * 2, GST_FLOW_OK);
+  start = g_get_monotonic_time () - start;
+
+  fail_unless_equals_int (g_list_length (buffers),
+      BENCH_SECONDS * 50 / frames_per_buffer);
+
+  cleanup_amrnbenc (amrnbenc);
+
+  return start;
+}
+
+GST_START_TEST (test_enc_throughput)
+{
+  guint frames_per_buffer[] = { 1, 5, 10, 25 };
+  gint64 elapsed;
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS (frames_per_buffer); i++) {
+    elapsed = encode_seconds (frames_per_buffer[i]);
+    GST_INFO ("%2u frames per buffer: %d s of audio in %" G_GINT64_FORMAT
+        " us", frames_per_buffer[i], BENCH_SECONDS, elapsed);
+  }
+}
+
+GST_END_TEST;
+
+/* a talk spurt of one second followed by one second of silence, repeated */
+static GstBuffer *
+create_conversation_buffer (gint index)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  gint16 *samples;
+  gint i;
+
+  buffer = gst_buffer_new_and_alloc (8000 * 2);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  samples = (gint16 *) map.data;
+  for (i = 0; i < 8000; i++) {
+    if (index % 2 == 0)
+      samples[i] = 8000 * sin (2 * G_PI * 440 * i / 8000) *
+          sin (G_PI * i / 8000);
+    else
+      samples[i] = 0;
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  GST_BUFFER_PTS (buffer) = index * GST_SECOND;
+  GST_BUFFER_DURATION (buffer) = GST_SECOND;
+
+  return buffer;
+}
+
+typedef struct
+{
+  gsize bytes;
+  guint gaps;
+} EncodedStats;
+
+static GstPadProbeReturn
+count_encoded (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  EncodedStats *stats = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  stats->bytes += gst_buffer_get_size (buffer);
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_GAP))
+    stats->gaps++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* encode the conversation and decode it again */
+static void
+transcode_conversation (gboolean dtx, EncodedStats * stats)
+{
+  GstHarness *h;
+  GstElement *enc;
+  GstPad *pad;
+  GstBuffer *buffer;
+  guint64 decoded = 0;
+  gchar *launch;
+  gint i;
+
+  launch = g_strdup_printf ("amrnbenc name=enc dtx=%d ! amrnbdec", dtx);
+  h = gst_harness_new_parse (launch);
+  g_free (launch);
+
+  stats->bytes = 0;
+  stats->gaps = 0;
+  enc = gst_bin_get_by_name (GST_BIN (h->element), "enc");
+  pad = gst_element_get_static_pad (enc, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, count_encoded, stats,
+      NULL);
+  gst_object_unref (pad);
+  gst_object_unref (enc);
+
+  gst_harness_set_src_caps_str (h, SRC_CAPS);
+  for (i = 0; i < 10; i++) {
+    fail_unless_equals_int (gst_harness_push (h,
+            create_conversation_buffer (i)), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buffer = gst_harness_try_pull (h))) {
+    decoded += gst_buffer_get_size (buffer) / 2;
+    gst_buffer_unref (buffer);
+  }
+  /* every frame, also the NO_DATA ones, still decodes to audio */
+  fail_unless_equals_uint64 (decoded, 10 * 8000);
+
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_enc_dtx)
+{
+  EncodedStats plain, dtx;
+
+  transcode_conversation (FALSE, &plain);
+  fail_unless_equals_int (plain.gaps, 0);
+  transcode_conversation (TRUE, &dtx);
+  fail_unless (dtx.gaps > 0);
+
+  GST_INFO ("encoded %" G_GSIZE_FORMAT " bytes with dtx, %" G_GSIZE_FORMAT
+      " without", dtx.bytes, plain.bytes);
+  fail_unless (dtx.bytes < plain.bytes);
+}
+
+GST_END_TEST;
+
 static Suite *
 amrnbenc_suite ()
 {
@@ -141,6 +319,9 @@ amrnbenc_suite ()
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_enc);
+  tcase_add_test (tc_chain, test_enc_frames_per_buffer);
+  tcase_add_test (tc_chain, test_enc_throughput);
+  tcase_add_test (tc_chain, test_enc_dtx);
   return s;
 }
 
@@ -0,0 +1,191 @@
+/*
+ * GStreamer
+ *
+ * unit test for amrnbtranscoder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/audio/audio.h>
+
+#define RAW_CAPS "audio/x-raw, format = (string)" GST_AUDIO_NE (S16) ", " \
+    "layout = (string) interleaved, channels = (int) 1, rate = (int) 8000"
+#define AMR_CAPS "audio/AMR, channels = (int) 1, rate = (int) 8000"
+
+static GstBuffer *
+create_raw_buffer (guint frames, GstClockTime pts)
+{
+  GstBuffer *buffer;
+
+  buffer = gst_buffer_new_and_alloc (frames * 320);
+  gst_buffer_memset (buffer, 0, 0, frames * 320);
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DURATION (buffer) = frames * 20 * GST_MSECOND;
+
+  return buffer;
+}
+
+GST_START_TEST (test_transcode)
+{
+  GstHarness *enc, *dec;
+  GstBuffer *buffer;
+
+  enc = gst_harness_new_with_padnames ("amrnbtranscoder", "sink_0", "src_0");
+  dec = gst_harness_new_with_element (enc->element, "sink_1", "src_1");
+  gst_harness_set_src_caps_str (enc, RAW_CAPS);
+  gst_harness_set_src_caps_str (dec, AMR_CAPS);
+
+  /* 10 frames are encoded into one buffer of 10 MR122 frames */
+  fail_unless_equals_int (gst_harness_push (enc, create_raw_buffer (10, 0)),
+      GST_FLOW_OK);
+  buffer = gst_harness_pull (enc);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 10 * 32);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 0);
+  fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer),
+      200 * GST_MSECOND);
+
+  /* and decoded again on the other channel */
+  fail_unless_equals_int (gst_harness_push (dec, buffer), GST_FLOW_OK);
+  buffer = gst_harness_pull (dec);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 10 * 320);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 0);
+  fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer),
+      200 * GST_MSECOND);
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (dec);
+  gst_harness_teardown (enc);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_finalize_with_channels)
+{
+  GstElement *transcoder;
+  GstPad *sinkpad, *srcpad;
+
+  /* a channel with an open codec, its pads are only released when the
+   * element is disposed */
+  transcoder = gst_element_factory_make ("amrnbtranscoder", NULL);
+  sinkpad = gst_element_get_request_pad (transcoder, "sink_0");
+  srcpad = gst_element_get_static_pad (transcoder, "src_0");
+  fail_unless (sinkpad != NULL && srcpad != NULL);
+  fail_unless_equals_int (gst_element_set_state (transcoder,
+          GST_STATE_PAUSED), GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_pad_send_event (sinkpad,
+          gst_event_new_stream_start ("test")));
+  fail_unless (gst_pad_send_event (sinkpad,
+          gst_event_new_caps (gst_caps_from_string (RAW_CAPS))));
+  fail_unless_equals_int (gst_element_set_state (transcoder,
+          GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+  gst_object_unref (transcoder);
+}
+
+GST_END_TEST;
+
+#define BENCH_CALLS 100
+#define BENCH_SECONDS 10
+
+/* push one second per call and round until all calls got all audio */
+static void
+run_calls (GstHarness ** h)
+{
+  GstBuffer *buffer;
+  gsize sizes[BENCH_CALLS] = { 0, };
+  gint i, s;
+
+  for (s = 0; s < BENCH_SECONDS; s++) {
+    for (i = 0; i < BENCH_CALLS; i++) {
+      fail_unless_equals_int (gst_harness_push (h[i],
+              create_raw_buffer (50, s * GST_SECOND)), GST_FLOW_OK);
+    }
+  }
+  for (i = 0; i < BENCH_CALLS; i++) {
+    while (sizes[i] < BENCH_SECONDS * 50 * 32) {
+      buffer = gst_harness_pull (h[i]);
+      sizes[i] += gst_buffer_get_size (buffer);
+      gst_buffer_unref (buffer);
+    }
+  }
+}
+
+GST_START_TEST (test_calls_per_core)
+{
+  GstHarness *h[BENCH_CALLS];
+  GstElement *transcoder;
+  gint64 separate, shared;
+  gchar *sinkname, *srcname;
+  gint i;
+
+  /* one encoder element per call */
+  for (i = 0; i < BENCH_CALLS; i++) {
+    h[i] = gst_harness_new ("amrnbenc");
+    gst_harness_set_src_caps_str (h[i], RAW_CAPS);
+  }
+  separate = g_get_monotonic_time ();
+  run_calls (h);
+  separate = g_get_monotonic_time () - separate;
+  for (i = 0; i < BENCH_CALLS; i++)
+    gst_harness_teardown (h[i]);
+
+  /* all calls on one transcoder with a single worker */
+  transcoder = gst_element_factory_make ("amrnbtranscoder", NULL);
+  g_object_set (transcoder, "max-threads", 1, NULL);
+  for (i = 0; i < BENCH_CALLS; i++) {
+    sinkname = g_strdup_printf ("sink_%d", i);
+    srcname = g_strdup_printf ("src_%d", i);
+    h[i] = gst_harness_new_with_element (transcoder, sinkname, srcname);
+    gst_harness_set_src_caps_str (h[i], RAW_CAPS);
+    g_free (sinkname);
+    g_free (srcname);
+  }
+  shared = g_get_monotonic_time ();
+  run_calls (h);
+  shared = g_get_monotonic_time () - shared;
+  for (i = 0; i < BENCH_CALLS; i++)
+    gst_harness_teardown (h[i]);
+  gst_object_unref (transcoder);
+
+  GST_INFO ("%d calls of %d s: %" G_GINT64_FORMAT " us with one encoder per "
+      "call, %" G_GINT64_FORMAT " us on one transcoder worker", BENCH_CALLS,
+      BENCH_SECONDS, separate, shared);
+  GST_INFO ("calls per core: %.1f separate, %.1f shared",
+      BENCH_CALLS * BENCH_SECONDS * 1e6 / MAX (separate, 1),
+      BENCH_CALLS * BENCH_SECONDS * 1e6 / MAX (shared, 1));
+}
+
+GST_END_TEST;
+
+static Suite *
+amrnbtranscoder_suite (void)
+{
+  Suite *s = suite_create ("amrnbtranscoder");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_transcode);
+  tcase_add_test (tc_chain, test_finalize_with_channels);
+  tcase_add_test (tc_chain, test_calls_per_core);
+
+  return s;
+}
+
+GST_CHECK_MAIN (amrnbtranscoder);
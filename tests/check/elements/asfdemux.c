@@ -0,0 +1,1359 @@
+/*
+ * GStreamer
+ *
+ * unit test for asfdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <glib/gstdio.h>
+
+/* 48kHz mono S16LE streams, 10ms of audio per packet; video streams have
+ * 10ms frames with a keyframe every KEYFRAME_DISTANCE frames */
+#define PAYLOAD_SIZE    960
+#define PACKET_HEADER   (1 + 2 + 2 + 2 + 4 + 2)
+#define PAYLOAD_HEADER  (1 + 1 + 4 + 1 + 8)
+#define PACKET_SIZE     (PACKET_HEADER + PAYLOAD_HEADER + PAYLOAD_SIZE)
+#define NUM_PACKETS     500
+#define MAX_STREAMS     2
+#define KEYFRAME_DISTANCE 25
+
+#define DATA_HEADER     50
+
+#define BITRATE_PROPS_SIZE(n) (24 + 2 + 6 * (n))
+#define MUTEX_SIZE(n)         (24 + 16 + 2 + 2 * (n))
+#define HEADER_EXT_SIZE(n)    (24 + 16 + 2 + 4 + MUTEX_SIZE (n))
+#define AUDIO_STREAM_SIZE     (24 + 54 + 18)
+#define VIDEO_STREAM_SIZE     (24 + 54 + 11 + 40)
+
+/* a WM/Picture descriptor with a 1x1 PNG header as the image */
+#define PNG_SIZE              33
+#define PICTURE_NAME_SIZE     (11 * 2)
+#define PICTURE_VALUE_SIZE    (1 + 4 + 2 + 2 + PNG_SIZE)
+#define EXT_CONTENT_SIZE      (24 + 2 + 2 + PICTURE_NAME_SIZE + 2 + 2 + \
+    PICTURE_VALUE_SIZE)
+
+/* one simple index entry per 100ms */
+#define INDEX_INTERVAL        (100 * GST_MSECOND)
+#define INDEX_ENTRIES(n)      (NUM_PACKETS / (n) * 10 * GST_MSECOND / \
+    INDEX_INTERVAL)
+#define INDEX_SIZE(n)         (24 + 16 + 8 + 4 + 4 + 6 * INDEX_ENTRIES (n))
+
+typedef enum
+{
+  ASF_RENDITIONS = (1 << 0),    /* streams are renditions of 100, 200... kbps */
+  ASF_VIDEO = (1 << 1),         /* first stream is video, with a simple index */
+  ASF_EMPTY_STREAM = (1 << 2),  /* one more audio stream, without any data */
+  ASF_PICTURE = (1 << 3)        /* an embedded picture in the header */
+} AsfFlags;
+
+static const guint32 guid_header[4] =
+    { 0x75B22630, 0x11CF668E, 0xAA00D9A6, 0x6CCE6200 };
+static const guint32 guid_file[4] =
+    { 0x8CABDCA1, 0x11CFA947, 0xC000E48E, 0x6553200C };
+static const guint32 guid_stream[4] =
+    { 0xB7DC0791, 0x11CFA9B7, 0xC000E68E, 0x6553200C };
+static const guint32 guid_audio[4] =
+    { 0xF8699E40, 0x11CF5B4D, 0x8000FDA8, 0x2B445C5F };
+static const guint32 guid_video[4] =
+    { 0xBC19EFC0, 0x11CF5B4D, 0x8000FDA8, 0x2B445C5F };
+static const guint32 guid_no_correction[4] =
+    { 0x20FB5700, 0x11CF5B55, 0x8000FDA8, 0x2B445C5F };
+static const guint32 guid_data[4] =
+    { 0x75B22636, 0x11CF668E, 0xAA00D9A6, 0x6CCE6200 };
+static const guint32 guid_bitrate_props[4] =
+    { 0x7BF875CE, 0x11D1468D, 0x6000828D, 0xB2A2C997 };
+static const guint32 guid_header_ext[4] =
+    { 0x5FBF03B5, 0x11CFA92E, 0xC000E38E, 0x6553200C };
+static const guint32 guid_mutex[4] =
+    { 0xA08649CF, 0x46704775, 0x356E168A, 0xCD667535 };
+static const guint32 guid_mutex_bitrate[4] =
+    { 0xD6E22A01, 0x11D135DA, 0xA0003490, 0xBE4903C9 };
+static const guint32 guid_simple_index[4] =
+    { 0x33000890, 0x11CFE5B1, 0xA000F489, 0xCB4903C9 };
+static const guint32 guid_ext_content_desc[4] =
+    { 0xD2D0A440, 0x11D2E307, 0xA000F097, 0x50A85EC9 };
+
+static const guint8 png_header[PNG_SIZE] = {
+  0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A,
+  0x00, 0x00, 0x00, 0x0D, 'I', 'H', 'D', 'R',
+  0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+  0x08, 0x02, 0x00, 0x00, 0x00, 0x90, 0x77, 0x53, 0xDE
+};
+
+static guint8
+payload_byte (guint stream, guint offset)
+{
+  return (offset * 7 + offset / 251 + stream * 101) & 0xff;
+}
+
+static guint
+header_size (guint num_streams, AsfFlags flags)
+{
+  guint size = 30 + 104 + AUDIO_STREAM_SIZE * num_streams;
+
+  if (flags & ASF_VIDEO)
+    size += VIDEO_STREAM_SIZE - AUDIO_STREAM_SIZE;
+  if (flags & ASF_EMPTY_STREAM)
+    size += AUDIO_STREAM_SIZE;
+  if (flags & ASF_PICTURE)
+    size += EXT_CONTENT_SIZE;
+  if (flags & ASF_RENDITIONS)
+    size += BITRATE_PROPS_SIZE (num_streams) + HEADER_EXT_SIZE (num_streams);
+
+  return size;
+}
+
+static guint8 *
+write_guid (guint8 * p, const guint32 * guid)
+{
+  gint i;
+
+  for (i = 0; i < 4; i++)
+    GST_WRITE_UINT32_LE (p + i * 4, guid[i]);
+  return p + 16;
+}
+
+static guint8 *
+write_object (guint8 * p, const guint32 * guid, guint64 size)
+{
+  p = write_guid (p, guid);
+  GST_WRITE_UINT64_LE (p, size);
+  return p + 8;
+}
+
+/* header, file and stream properties, then NUM_PACKETS single payload
+ * packets without padding, taking turns between the streams */
+static GstBuffer *
+create_asf (guint num_streams, AsfFlags flags)
+{
+  guint num_declared = num_streams + ((flags & ASF_EMPTY_STREAM) ? 1 : 0);
+  GstMapInfo map;
+  GstBuffer *buf;
+  guint8 *p;
+  guint i, j;
+
+  buf = gst_buffer_new_allocate (NULL,
+      header_size (num_streams, flags) + DATA_HEADER +
+      NUM_PACKETS * PACKET_SIZE +
+      ((flags & ASF_VIDEO) ? INDEX_SIZE (num_streams) : 0), NULL);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+
+  p = write_object (map.data, guid_header, header_size (num_streams, flags));
+  GST_WRITE_UINT32_LE (p, 1 + num_declared +
+      ((flags & ASF_RENDITIONS) ? 2 : 0) + ((flags & ASF_PICTURE) ? 1 : 0));
+  p[4] = 0x01;
+  p[5] = 0x02;
+  p += 6;
+
+  p = write_object (p, guid_file, 104);
+  GST_WRITE_UINT64_LE (p + 16, map.size);
+  GST_WRITE_UINT64_LE (p + 32, NUM_PACKETS);
+  GST_WRITE_UINT64_LE (p + 40, (guint64) NUM_PACKETS * 10 * 10000);
+  GST_WRITE_UINT64_LE (p + 48, (guint64) NUM_PACKETS * 10 * 10000);
+  GST_WRITE_UINT32_LE (p + 64, 0x02);
+  GST_WRITE_UINT32_LE (p + 68, PACKET_SIZE);
+  GST_WRITE_UINT32_LE (p + 72, PACKET_SIZE);
+  GST_WRITE_UINT32_LE (p + 76, 48000 * 16);
+  p += 80;
+
+  for (i = 0; i < num_declared; i++) {
+    if (i == 0 && (flags & ASF_VIDEO)) {
+      p = write_object (p, guid_stream, VIDEO_STREAM_SIZE);
+      for (j = 0; j < 4; j++) {
+        GST_WRITE_UINT32_LE (p + j * 4, guid_video[j]);
+        GST_WRITE_UINT32_LE (p + 16 + j * 4, guid_no_correction[j]);
+      }
+      GST_WRITE_UINT32_LE (p + 40, 11 + 40);
+      GST_WRITE_UINT16_LE (p + 48, i + 1);
+      p += 54;
+      /* 320x240 WMV3 */
+      GST_WRITE_UINT32_LE (p, 320);
+      GST_WRITE_UINT32_LE (p + 4, 240);
+      p[8] = 0x02;
+      GST_WRITE_UINT16_LE (p + 9, 40);
+      p += 11;
+      GST_WRITE_UINT32_LE (p, 40);
+      GST_WRITE_UINT32_LE (p + 4, 320);
+      GST_WRITE_UINT32_LE (p + 8, 240);
+      GST_WRITE_UINT16_LE (p + 12, 1);
+      GST_WRITE_UINT16_LE (p + 14, 24);
+      GST_WRITE_UINT32_LE (p + 16, GST_MAKE_FOURCC ('W', 'M', 'V', '3'));
+      p += 40;
+      continue;
+    }
+
+    p = write_object (p, guid_stream, AUDIO_STREAM_SIZE);
+    for (j = 0; j < 4; j++) {
+      GST_WRITE_UINT32_LE (p + j * 4, guid_audio[j]);
+      GST_WRITE_UINT32_LE (p + 16 + j * 4, guid_no_correction[j]);
+    }
+    GST_WRITE_UINT32_LE (p + 40, 18);
+    GST_WRITE_UINT16_LE (p + 48, i + 1);
+    p += 54;
+    GST_WRITE_UINT16_LE (p, 0x0001);
+    GST_WRITE_UINT16_LE (p + 2, 1);
+    GST_WRITE_UINT32_LE (p + 4, 48000);
+    GST_WRITE_UINT32_LE (p + 8, 48000 * 2);
+    GST_WRITE_UINT16_LE (p + 12, 2);
+    GST_WRITE_UINT16_LE (p + 14, 16);
+    p += 18;
+  }
+
+  if (flags & ASF_PICTURE) {
+    const gchar *name = "WM/Picture";
+
+    p = write_object (p, guid_ext_content_desc, EXT_CONTENT_SIZE);
+    GST_WRITE_UINT16_LE (p, 1);
+    GST_WRITE_UINT16_LE (p + 2, PICTURE_NAME_SIZE);
+    p += 4;
+    for (j = 0; name[j] != '\0'; j++)
+      GST_WRITE_UINT16_LE (p + j * 2, name[j]);
+    p += PICTURE_NAME_SIZE;
+    /* byte array; front cover, empty mime type and description */
+    GST_WRITE_UINT16_LE (p, 1);
+    GST_WRITE_UINT16_LE (p + 2, PICTURE_VALUE_SIZE);
+    p += 4;
+    p[0] = 3;
+    GST_WRITE_UINT32_LE (p + 1, PNG_SIZE);
+    p += 1 + 4 + 2 + 2;
+    memcpy (p, png_header, PNG_SIZE);
+    p += PNG_SIZE;
+  }
+
+  if (flags & ASF_RENDITIONS) {
+    p = write_object (p, guid_bitrate_props, BITRATE_PROPS_SIZE (num_streams));
+    GST_WRITE_UINT16_LE (p, num_streams);
+    p += 2;
+    for (i = 0; i < num_streams; i++) {
+      GST_WRITE_UINT16_LE (p, i + 1);
+      GST_WRITE_UINT32_LE (p + 2, (i + 1) * 100000);
+      p += 6;
+    }
+
+    p = write_object (p, guid_header_ext, HEADER_EXT_SIZE (num_streams));
+    p += 16 + 2;
+    GST_WRITE_UINT32_LE (p, MUTEX_SIZE (num_streams));
+    p += 4;
+    p = write_object (p, guid_mutex, MUTEX_SIZE (num_streams));
+    p = write_guid (p, guid_mutex_bitrate);
+    GST_WRITE_UINT16_LE (p, num_streams);
+    p += 2;
+    for (i = 0; i < num_streams; i++) {
+      GST_WRITE_UINT16_LE (p, i + 1);
+      p += 2;
+    }
+  }
+
+  p = write_object (p, guid_data, DATA_HEADER + NUM_PACKETS * PACKET_SIZE);
+  GST_WRITE_UINT64_LE (p + 16, NUM_PACKETS);
+  p[24] = 0x01;
+  p[25] = 0x01;
+  p += 26;
+
+  for (i = 0; i < NUM_PACKETS; i++) {
+    guint stream = i % num_streams;
+    guint num = i / num_streams;
+    gboolean keyframe = TRUE;
+
+    if (stream == 0 && (flags & ASF_VIDEO))
+      keyframe = (num % KEYFRAME_DISTANCE) == 0;
+
+    /* error correction, WORD padding length, BYTE replicated data length,
+     * DWORD offset into media object, BYTE media object number */
+    p[0] = 0x82;
+    p[3] = 0x10;
+    p[4] = 0x5D;
+    GST_WRITE_UINT32_LE (p + 7, num * 10);
+    GST_WRITE_UINT16_LE (p + 11, 10);
+    p += PACKET_HEADER;
+
+    p[0] = (keyframe ? 0x80 : 0x00) | (stream + 1);
+    p[1] = num & 0xff;
+    p[6] = 8;
+    GST_WRITE_UINT32_LE (p + 7, PAYLOAD_SIZE);
+    GST_WRITE_UINT32_LE (p + 11, num * 10);
+    p += PAYLOAD_HEADER;
+
+    for (j = 0; j < PAYLOAD_SIZE; j++)
+      p[j] = payload_byte (stream, num * PAYLOAD_SIZE + j);
+    p += PAYLOAD_SIZE;
+  }
+
+  /* each entry points to the packet of the last video keyframe */
+  if (flags & ASF_VIDEO) {
+    p = write_object (p, guid_simple_index, INDEX_SIZE (num_streams));
+    p += 16;
+    GST_WRITE_UINT64_LE (p, INDEX_INTERVAL / 100);
+    GST_WRITE_UINT32_LE (p + 8, 1);
+    GST_WRITE_UINT32_LE (p + 12, INDEX_ENTRIES (num_streams));
+    p += 16;
+    for (i = 0; i < INDEX_ENTRIES (num_streams); i++) {
+      guint frame = i * INDEX_INTERVAL / (10 * GST_MSECOND);
+
+      frame -= frame % KEYFRAME_DISTANCE;
+      GST_WRITE_UINT32_LE (p, frame * num_streams);
+      GST_WRITE_UINT16_LE (p + 4, 1);
+      p += 6;
+    }
+  }
+  g_assert (p == map.data + map.size);
+
+  gst_buffer_unmap (buf, &map);
+  return buf;
+}
+
+static GstPadProbeReturn
+collect_buffer (GstPad * pad, GstPadProbeInfo * info, GByteArray * output)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  guint size = gst_buffer_get_size (buf);
+
+  g_byte_array_set_size (output, output->len + size);
+  gst_buffer_extract (buf, 0, output->data + output->len - size, size);
+
+  return GST_PAD_PROBE_DROP;
+}
+
+static void
+pad_added (GstElement * demux, GstPad * pad, GByteArray ** outputs)
+{
+  guint n;
+
+  fail_unless (g_str_has_prefix (GST_PAD_NAME (pad), "audio_"));
+  n = atoi (GST_PAD_NAME (pad) + strlen ("audio_"));
+  fail_unless (n < MAX_STREAMS);
+  fail_unless (outputs[n] == NULL);
+
+  outputs[n] = g_byte_array_new ();
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) collect_buffer, outputs[n], NULL);
+}
+
+static GstHarness *
+create_demux (GByteArray ** outputs)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("asfdemux", "sink", NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (pad_added), outputs);
+  gst_harness_set_src_caps_str (h, "video/x-ms-asf");
+
+  return h;
+}
+
+static void
+check_output (GByteArray * output, guint stream, guint num_streams)
+{
+  guint i;
+
+  fail_unless (output != NULL);
+  fail_unless_equals_int (output->len,
+      NUM_PACKETS / num_streams * PAYLOAD_SIZE);
+  for (i = 0; i < output->len; i++)
+    fail_unless_equals_int (output->data[i], payload_byte (stream, i));
+}
+
+static void
+free_outputs (GByteArray ** outputs)
+{
+  guint i;
+
+  for (i = 0; i < MAX_STREAMS; i++) {
+    if (outputs[i])
+      g_byte_array_unref (outputs[i]);
+  }
+}
+
+/* pushes the file in chunks of random size between 1 and @max_chunk bytes
+ * and checks that all audio comes out intact */
+static void
+run_push (guint max_chunk)
+{
+  GByteArray *outputs[MAX_STREAMS] = { NULL, };
+  GstHarness *h;
+  GstBuffer *asf;
+  GRand *rand;
+  GTimer *timer;
+  gsize offset, size;
+
+  asf = create_asf (1, 0);
+  size = gst_buffer_get_size (asf);
+  rand = g_rand_new_with_seed (max_chunk);
+
+  h = create_demux (outputs);
+
+  timer = g_timer_new ();
+  for (offset = 0; offset < size;) {
+    gsize len = MIN (g_rand_int_range (rand, 1, max_chunk + 1), size - offset);
+
+    fail_unless_equals_int (gst_harness_push (h,
+            gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, offset, len)),
+        GST_FLOW_OK);
+    offset += len;
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  g_timer_stop (timer);
+
+  GST_INFO ("demuxed %" G_GSIZE_FORMAT " bytes in chunks of up to %u bytes "
+      "in %.3f ms", size, max_chunk, g_timer_elapsed (timer, NULL) * 1000);
+
+  check_output (outputs[0], 0, 1);
+
+  g_timer_destroy (timer);
+  gst_harness_teardown (h);
+  g_rand_free (rand);
+  free_outputs (outputs);
+  gst_buffer_unref (asf);
+}
+
+GST_START_TEST (test_push_whole_packets)
+{
+  run_push (PACKET_SIZE * 4);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push_tiny_chunks)
+{
+  run_push (16);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push_random_chunks)
+{
+  run_push (64 * 1024);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_select_streams)
+{
+  GByteArray *outputs[MAX_STREAMS] = { NULL, };
+  GstStreamCollection *collection;
+  GstMessage *msg;
+  GstHarness *h;
+  GstBuffer *asf;
+  GstBus *bus;
+  GList *selection;
+  gsize size;
+
+  asf = create_asf (2, 0);
+  size = header_size (2, 0) + DATA_HEADER;
+
+  h = create_demux (outputs);
+  bus = gst_bus_new ();
+  gst_element_set_bus (h->element, bus);
+
+  /* headers only, the collection is posted before any data is parsed */
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, 0, size)),
+      GST_FLOW_OK);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_STREAM_COLLECTION);
+  fail_unless (msg != NULL);
+  gst_message_parse_stream_collection (msg, &collection);
+  gst_message_unref (msg);
+  fail_unless_equals_int (gst_stream_collection_get_size (collection), 2);
+
+  selection = g_list_append (NULL, (gchar *)
+      gst_stream_get_stream_id (gst_stream_collection_get_stream (collection,
+              1)));
+  fail_unless (gst_element_send_event (h->element,
+          gst_event_new_select_streams (selection)));
+  g_list_free (selection);
+
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, size, -1)),
+      GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_STREAMS_SELECTED);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (gst_message_streams_selected_get_size (msg), 1);
+  gst_message_unref (msg);
+
+  /* only the second stream got a pad, and nothing of the first went out */
+  fail_unless (outputs[0] == NULL);
+  check_output (outputs[1], 1, 2);
+
+  gst_object_unref (collection);
+  gst_element_set_bus (h->element, NULL);
+  gst_object_unref (bus);
+  gst_harness_teardown (h);
+  free_outputs (outputs);
+  gst_buffer_unref (asf);
+}
+
+GST_END_TEST;
+
+/* returns the stream whose data is in the @n-th payload of @output */
+static gint
+payload_stream (GByteArray * output, guint n)
+{
+  guint s, i;
+
+  for (s = 0; s < MAX_STREAMS; s++) {
+    for (i = 0; i < PAYLOAD_SIZE; i++) {
+      if (output->data[n * PAYLOAD_SIZE + i] !=
+          payload_byte (s, n * PAYLOAD_SIZE + i))
+        break;
+    }
+    if (i == PAYLOAD_SIZE)
+      return s;
+  }
+
+  return -1;
+}
+
+static void
+run_renditions (guint max_bitrate, guint switch_bitrate)
+{
+  GByteArray *outputs[MAX_STREAMS] = { NULL, };
+  GByteArray *output;
+  GstHarness *h;
+  GstBuffer *asf;
+  gsize size;
+  guint i, first, switches = 0;
+
+  asf = create_asf (2, ASF_RENDITIONS);
+  size = gst_buffer_get_size (asf);
+
+  h = create_demux (outputs);
+  g_object_set (h->element, "max-bitrate", max_bitrate, NULL);
+
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, 0, size / 2)),
+      GST_FLOW_OK);
+  if (switch_bitrate != max_bitrate)
+    g_object_set (h->element, "max-bitrate", switch_bitrate, NULL);
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, size / 2, -1)),
+      GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* one pad, the one of the rendition picked first */
+  fail_unless ((outputs[0] == NULL) != (outputs[1] == NULL));
+  output = outputs[0] ? outputs[0] : outputs[1];
+  fail_unless_equals_int (output->len, NUM_PACKETS / 2 * PAYLOAD_SIZE);
+
+  first = (max_bitrate == 0 || max_bitrate >= 200000) ? 1 : 0;
+  fail_unless_equals_int (payload_stream (output, 0), first);
+  for (i = 1; i < output->len / PAYLOAD_SIZE; i++) {
+    gint s = payload_stream (output, i);
+
+    fail_unless (s >= 0);
+    if (s != payload_stream (output, i - 1))
+      switches++;
+  }
+  fail_unless_equals_int (switches, switch_bitrate != max_bitrate ? 1 : 0);
+
+  gst_harness_teardown (h);
+  free_outputs (outputs);
+  gst_buffer_unref (asf);
+}
+
+GST_START_TEST (test_renditions_highest)
+{
+  run_renditions (0, 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_renditions_max_bitrate)
+{
+  run_renditions (150000, 150000);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_renditions_switch)
+{
+  /* down and back up at the next keyframe, on the same pad */
+  run_renditions (0, 150000);
+  run_renditions (150000, 0);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstElement *pipeline;
+  guint video_buffers;
+  guint video_deltas;
+  guint video_disconts;
+  guint audio_buffers;
+  guint audio_gaps;
+  GstSegment video_segment;
+
+  /* video buffers out of order, for forward playback or for GOPs in reverse
+   * playback, which start with a DISCONT buffer */
+  guint order_errors;
+  GstClockTime gop_start;
+  GstClockTime last_pts;
+} TrickData;
+
+static void
+trick_video_buffer (TrickData * data, GstBuffer * buf)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buf);
+
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT))
+    data->video_deltas++;
+  else
+    data->video_buffers++;
+
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT)) {
+    data->video_disconts++;
+    if (data->video_segment.rate < 0
+        && GST_CLOCK_TIME_IS_VALID (data->gop_start)
+        && pts >= data->gop_start)
+      data->order_errors++;
+    data->gop_start = pts;
+  } else if (GST_CLOCK_TIME_IS_VALID (data->last_pts)
+      && pts <= data->last_pts) {
+    data->order_errors++;
+  }
+  data->last_pts = pts;
+}
+
+static GstPadProbeReturn
+trick_probe (GstPad * pad, GstPadProbeInfo * info, TrickData * data)
+{
+  gboolean video = g_str_has_prefix (GST_PAD_NAME (pad), "video_");
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    if (video)
+      trick_video_buffer (data, GST_PAD_PROBE_INFO_BUFFER (info));
+    else
+      data->audio_buffers++;
+  } else {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_FLUSH_STOP:
+        /* only count what comes after the seek */
+        data->video_buffers = data->video_deltas = data->video_disconts = 0;
+        data->audio_buffers = data->audio_gaps = 0;
+        data->order_errors = 0;
+        data->gop_start = data->last_pts = GST_CLOCK_TIME_NONE;
+        break;
+      case GST_EVENT_SEGMENT:
+        if (video)
+          gst_event_copy_segment (event, &data->video_segment);
+        break;
+      case GST_EVENT_GAP:
+        if (!video)
+          data->audio_gaps++;
+        break;
+      default:
+        break;
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+trick_pad_added (GstElement * demux, GstPad * pad, TrickData * data)
+{
+  GstElement *sink;
+  GstPad *sinkpad;
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", FALSE, NULL);
+  gst_bin_add (GST_BIN (data->pipeline), sink);
+  gst_element_sync_state_with_parent (sink);
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      (GstPadProbeCallback) trick_probe, data, NULL);
+}
+
+/* plays a video and an audio stream from a file in pull mode, after a
+ * flushing seek over the whole file with @rate and @flags */
+static void
+run_trick (gdouble rate, GstSeekFlags flags, TrickData * data)
+{
+  GstElement *src, *demux;
+  GstMessage *msg;
+  GstBuffer *asf;
+  GstMapInfo map;
+  GstBus *bus;
+  gchar *filename;
+  gint fd;
+
+  asf = create_asf (2, ASF_VIDEO);
+  fd = g_file_open_tmp ("asfdemux-XXXXXX.asf", &filename, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+  gst_buffer_map (asf, &map, GST_MAP_READ);
+  fail_unless (g_file_set_contents (filename, (gchar *) map.data, map.size,
+          NULL));
+  gst_buffer_unmap (asf, &map);
+
+  data->pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  demux = gst_element_factory_make ("asfdemux", NULL);
+  g_object_set (src, "location", filename, NULL);
+  gst_bin_add_many (GST_BIN (data->pipeline), src, demux, NULL);
+  fail_unless (gst_element_link (src, demux));
+  g_signal_connect (demux, "pad-added", G_CALLBACK (trick_pad_added), data);
+
+  gst_element_set_state (data->pipeline, GST_STATE_PAUSED);
+  fail_unless_equals_int (gst_element_get_state (data->pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  fail_unless (gst_element_seek (demux, rate, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | flags, GST_SEEK_TYPE_SET, 0,
+          GST_SEEK_TYPE_NONE, -1));
+  fail_unless_equals_int (gst_element_get_state (data->pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  gst_element_set_state (data->pipeline, GST_STATE_PLAYING);
+  bus = gst_element_get_bus (data->pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (data->pipeline, GST_STATE_NULL);
+  gst_object_unref (data->pipeline);
+  g_unlink (filename);
+  g_free (filename);
+  gst_buffer_unref (asf);
+}
+
+GST_START_TEST (test_trickmode_key_units)
+{
+  TrickData data = { NULL, };
+
+  run_trick (8.0, GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS,
+      &data);
+
+  /* every video keyframe, nothing else, and audio only gets gaps */
+  fail_unless_equals_int (data.video_buffers,
+      NUM_PACKETS / 2 / KEYFRAME_DISTANCE);
+  fail_unless_equals_int (data.video_deltas, 0);
+  fail_unless_equals_int (data.order_errors, 0);
+  fail_unless_equals_int (data.audio_buffers, 0);
+  fail_unless_equals_int (data.audio_gaps, data.video_buffers);
+  fail_unless_equals_float (data.video_segment.rate, 8.0);
+  fail_unless (data.video_segment.flags &
+      GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS);
+  fail_unless (data.video_segment.flags & GST_SEGMENT_FLAG_TRICKMODE_NO_AUDIO);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_reverse_playback)
+{
+  TrickData data = { NULL, };
+
+  run_trick (-1.0, 0, &data);
+
+  /* all of it, GOP by GOP from the last one, each starting with DISCONT */
+  fail_unless_equals_int (data.video_buffers,
+      NUM_PACKETS / 2 / KEYFRAME_DISTANCE);
+  fail_unless_equals_int (data.video_deltas,
+      NUM_PACKETS / 2 - data.video_buffers);
+  fail_unless_equals_int (data.video_disconts, data.video_buffers);
+  fail_unless_equals_int (data.order_errors, 0);
+  fail_unless_equals_uint64 (data.gop_start, 0);
+  fail_unless_equals_int (data.audio_buffers, NUM_PACKETS / 2);
+  fail_unless_equals_float (data.video_segment.rate, -1.0);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GByteArray *outputs[MAX_STREAMS];
+  GThread *threads[MAX_STREAMS];
+  gboolean eos[MAX_STREAMS];
+  gboolean overtaken;           /* stream 1 went on while 0 was held up */
+  guint run_ahead;              /* buffers of stream 1 while 0 was held up */
+  GMutex lock;
+  GCond cond;
+} QueueData;
+
+/* call with the lock */
+static guint
+other_len (QueueData * data)
+{
+  return data->outputs[1] ? data->outputs[1]->len : 0;
+}
+
+static GstPadProbeReturn
+queue_probe (GstPad * pad, GstPadProbeInfo * info, QueueData * data)
+{
+  guint n = atoi (GST_PAD_NAME (pad) + strlen ("audio_"));
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    g_mutex_lock (&data->lock);
+    collect_buffer (pad, info, data->outputs[n]);
+    if (data->threads[n] == NULL)
+      data->threads[n] = g_thread_self ();
+    fail_unless (data->threads[n] == g_thread_self ());
+    g_cond_broadcast (&data->cond);
+
+    /* a slow branch: hold up the first buffer of stream 0 until the other
+     * stream got some buffers, which only happens if it does not have to
+     * wait, then until the other stream stops getting any because the queue
+     * of stream 0 is full */
+    if (n == 0 && data->outputs[0]->len == PAYLOAD_SIZE) {
+      gint64 end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+      guint len;
+
+      while (other_len (data) < 4 * PAYLOAD_SIZE)
+        if (!g_cond_wait_until (&data->cond, &data->lock, end_time))
+          break;
+      data->overtaken = other_len (data) >= 4 * PAYLOAD_SIZE;
+
+      do {
+        len = other_len (data);
+        end_time = g_get_monotonic_time () + 200 * G_TIME_SPAN_MILLISECOND;
+        while (other_len (data) == len && !data->eos[1])
+          if (!g_cond_wait_until (&data->cond, &data->lock, end_time))
+            break;
+      } while (other_len (data) != len && !data->eos[1]);
+      data->run_ahead = other_len (data) / PAYLOAD_SIZE;
+    }
+    g_mutex_unlock (&data->lock);
+
+    return GST_PAD_PROBE_DROP;
+  }
+
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) == GST_EVENT_EOS) {
+    g_mutex_lock (&data->lock);
+    data->eos[n] = TRUE;
+    g_cond_broadcast (&data->cond);
+    g_mutex_unlock (&data->lock);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+queue_pad_added (GstElement * demux, GstPad * pad, QueueData * data)
+{
+  guint n = atoi (GST_PAD_NAME (pad) + strlen ("audio_"));
+
+  fail_unless (n < MAX_STREAMS);
+  data->outputs[n] = g_byte_array_new ();
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) queue_probe, data, NULL);
+}
+
+GST_START_TEST (test_output_queues)
+{
+  QueueData data = { {NULL,}, };
+  gint64 end_time;
+  GstHarness *h;
+  guint i;
+
+  g_mutex_init (&data.lock);
+  g_cond_init (&data.cond);
+
+  h = gst_harness_new_with_padnames ("asfdemux", "sink", NULL);
+  g_object_set (h->element, "output-queues", TRUE,
+      "max-queue-bytes", PAYLOAD_SIZE * 8, NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (queue_pad_added),
+      &data);
+  gst_harness_set_src_caps_str (h, "video/x-ms-asf");
+
+  fail_unless_equals_int (gst_harness_push (h, create_asf (2, 0)),
+      GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the output is pushed from other threads, wait for it */
+  end_time = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+  g_mutex_lock (&data.lock);
+  while (!data.eos[0] || !data.eos[1])
+    if (!g_cond_wait_until (&data.cond, &data.lock, end_time))
+      break;
+  g_mutex_unlock (&data.lock);
+
+  fail_unless (data.eos[0] && data.eos[1]);
+  fail_unless (data.overtaken);
+  /* the byte limit of stream 0 held, parsing did not run all through the
+   * file; 8 queued payloads of stream 0 give about as many of stream 1 */
+  fail_unless (data.run_ahead < 16, "stream 1 ran %u buffers ahead",
+      data.run_ahead);
+  fail_unless (data.threads[0] != data.threads[1]);
+  for (i = 0; i < MAX_STREAMS; i++) {
+    fail_unless (data.threads[i] != g_thread_self ());
+    check_output (data.outputs[i], i, 2);
+  }
+
+  gst_harness_teardown (h);
+  free_outputs (data.outputs);
+  g_mutex_clear (&data.lock);
+  g_cond_clear (&data.cond);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GByteArray *output;
+  guint packets_pushed;
+  guint activated_at;           /* packets pushed when the pad appeared */
+  gboolean have_audio;
+  guint num_gaps;
+  GstClockTime gap_ts;
+} PrerollData;
+
+static GstPadProbeReturn
+fail_buffer (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  fail ("buffer on %s, which has no data", GST_PAD_NAME (pad));
+  return GST_PAD_PROBE_DROP;
+}
+
+static GstPadProbeReturn
+count_gaps (GstPad * pad, GstPadProbeInfo * info, PrerollData * data)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_GAP) {
+    gst_event_parse_gap (event, &data->gap_ts, NULL);
+    data->num_gaps++;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+preroll_pad_added (GstElement * demux, GstPad * pad, PrerollData * data)
+{
+  /* the audio stream has no data, it gets a pad with a gap instead */
+  if (g_str_equal (GST_PAD_NAME (pad), "audio_0")) {
+    fail_if (data->have_audio);
+    data->have_audio = TRUE;
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) fail_buffer, NULL, NULL);
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) count_gaps, data, NULL);
+    return;
+  }
+
+  fail_unless_equals_string (GST_PAD_NAME (pad), "video_0");
+  fail_unless (data->output == NULL);
+
+  data->output = g_byte_array_new ();
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) collect_buffer, data->output, NULL);
+  data->activated_at = data->packets_pushed;
+}
+
+/* pushes a file with a video stream and an audio stream without any data
+ * one packet at a time, and returns the number of packets it took for the
+ * video stream to get activated; if that was because of the limits, the
+ * audio stream must have been activated too, with a single gap */
+static guint
+run_preroll (GstClockTime max_time, guint max_bytes)
+{
+  PrerollData data = { NULL, };
+  GstHarness *h;
+  GstBuffer *asf;
+  gsize offset;
+
+  asf = create_asf (1, ASF_VIDEO | ASF_EMPTY_STREAM);
+  offset = header_size (1, ASF_VIDEO | ASF_EMPTY_STREAM) + DATA_HEADER;
+
+  h = gst_harness_new_with_padnames ("asfdemux", "sink", NULL);
+  g_object_set (h->element, "max-preroll-time", max_time,
+      "max-preroll-bytes", max_bytes, NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (preroll_pad_added),
+      &data);
+  gst_harness_set_src_caps_str (h, "video/x-ms-asf");
+
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, 0, offset)),
+      GST_FLOW_OK);
+  while (data.packets_pushed < NUM_PACKETS) {
+    data.packets_pushed++;
+    fail_unless_equals_int (gst_harness_push (h,
+            gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, offset,
+                PACKET_SIZE)), GST_FLOW_OK);
+    offset += PACKET_SIZE;
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* nothing gets lost by activating early */
+  check_output (data.output, 0, 1);
+
+  if (max_time > 0 || max_bytes > 0) {
+    fail_unless (data.have_audio);
+    fail_unless_equals_int (data.num_gaps, 1);
+    /* from the first video frame on */
+    fail_unless_equals_uint64 (data.gap_ts, 0);
+  } else {
+    /* at EOS there is nothing left to wait for */
+    fail_if (data.have_audio);
+  }
+
+  gst_harness_teardown (h);
+  g_byte_array_unref (data.output);
+  gst_buffer_unref (asf);
+
+  return data.activated_at;
+}
+
+GST_START_TEST (test_preroll_unbounded)
+{
+  GstElement *demux;
+  GstClockTime max_time;
+  guint max_bytes;
+
+  demux = gst_element_factory_make ("asfdemux", NULL);
+  g_object_get (demux, "max-preroll-time", &max_time, "max-preroll-bytes",
+      &max_bytes, NULL);
+  fail_unless_equals_uint64 (max_time, 5 * GST_SECOND);
+  fail_unless_equals_int (max_bytes, 16 * 1024 * 1024);
+  gst_object_unref (demux);
+
+  /* waits for the audio stream all through the file */
+  fail_unless_equals_int (run_preroll (0, 0), NUM_PACKETS);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_preroll_max_time)
+{
+  guint packets = run_preroll (GST_SECOND, 0);
+
+  /* 10ms per packet */
+  fail_unless (packets >= 100 && packets <= 102, "activated after %u packets",
+      packets);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_preroll_max_bytes)
+{
+  guint packets = run_preroll (0, 50 * PAYLOAD_SIZE);
+
+  fail_unless (packets >= 50 && packets <= 51, "activated after %u packets",
+      packets);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_probe)
+{
+  GByteArray *outputs[MAX_STREAMS] = { NULL, };
+  GstStreamCollection *collection;
+  const GstStructure *s;
+  GstClockTime duration;
+  GstTagList *tags;
+  GstMessage *msg;
+  GstHarness *h;
+  GstBus *bus;
+  guint num_streams, i;
+
+  h = create_demux (outputs);
+  g_object_set (h->element, "probe", TRUE, NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (h->element, bus);
+
+  /* the data section is not even looked at */
+  fail_unless_equals_int (gst_harness_push (h, create_asf (2, 0)),
+      GST_FLOW_EOS);
+  fail_unless_equals_int (gst_harness_push (h, create_asf (2, 0)),
+      GST_FLOW_EOS);
+  gst_harness_push_event (h, gst_event_new_eos ());
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_STREAM_COLLECTION);
+  fail_unless (msg != NULL);
+  gst_message_parse_stream_collection (msg, &collection);
+  gst_message_unref (msg);
+  fail_unless_equals_int (gst_stream_collection_get_size (collection), 2);
+  gst_object_unref (collection);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_TAG);
+  fail_unless (msg != NULL);
+  gst_message_parse_tag (msg, &tags);
+  gst_message_unref (msg);
+  fail_unless (gst_tag_list_get_uint64 (tags, GST_TAG_DURATION, &duration));
+  fail_unless_equals_uint64 (duration, NUM_PACKETS * 10 * GST_MSECOND);
+  gst_tag_list_unref (tags);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  fail_unless (msg != NULL);
+  s = gst_message_get_structure (msg);
+  fail_unless (gst_structure_has_name (s, "probe-done"));
+  fail_unless (gst_structure_get_uint (s, "num-streams", &num_streams));
+  fail_unless_equals_int (num_streams, 2);
+  gst_message_unref (msg);
+
+  for (i = 0; i < MAX_STREAMS; i++)
+    fail_unless (outputs[i] == NULL);
+  fail_unless_equals_int (h->element->numsrcpads, 0);
+
+  gst_element_set_bus (h->element, NULL);
+  gst_object_unref (bus);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstElement *pipeline;
+  guint packets_pushed;
+  guint num_tags;               /* global tag events */
+  guint num_images;             /* global tag events with a picture */
+  GstBuffer *image;             /* the last picture */
+} PictureData;
+
+static GstPadProbeReturn
+picture_probe (GstPad * pad, GstPadProbeInfo * info, PictureData * data)
+{
+  GstTagList *tags;
+  GstEvent *event;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+    return GST_PAD_PROBE_DROP;
+
+  event = GST_PAD_PROBE_INFO_EVENT (info);
+  if (GST_EVENT_TYPE (event) != GST_EVENT_TAG)
+    return GST_PAD_PROBE_OK;
+
+  gst_event_parse_tag (event, &tags);
+  if (gst_tag_list_get_scope (tags) != GST_TAG_SCOPE_GLOBAL)
+    return GST_PAD_PROBE_OK;
+
+  data->num_tags++;
+  if (gst_tag_list_get_tag_size (tags, GST_TAG_IMAGE) > 0) {
+    GstSample *sample;
+
+    /* a late picture must not replace the other global tags */
+    fail_unless (gst_tag_list_get_tag_size (tags,
+            GST_TAG_CONTAINER_FORMAT) > 0);
+    data->num_images++;
+
+    fail_unless (gst_tag_list_get_sample (tags, GST_TAG_IMAGE, &sample));
+    gst_buffer_replace (&data->image, gst_sample_get_buffer (sample));
+    gst_sample_unref (sample);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+picture_pad_added (GstElement * demux, GstPad * pad, PictureData * data)
+{
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) picture_probe, data, NULL);
+}
+
+static void
+check_image (GstBuffer * image)
+{
+  GstMapInfo map;
+
+  fail_unless (image != NULL);
+  gst_buffer_map (image, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, PNG_SIZE);
+  fail_unless (memcmp (map.data, png_header, PNG_SIZE) == 0);
+  gst_buffer_unmap (image, &map);
+}
+
+/* pushes a file with a picture, turning parse-images on halfway through if
+ * it was off, and returns the number of global tag events that went out */
+static guint
+run_pictures (gboolean parse_images)
+{
+  PictureData data = { 0, };
+  GstHarness *h;
+  GstBuffer *asf;
+  gsize offset;
+
+  asf = create_asf (1, ASF_PICTURE);
+  offset = header_size (1, ASF_PICTURE) + DATA_HEADER;
+
+  h = gst_harness_new_with_padnames ("asfdemux", "sink", NULL);
+  g_object_set (h->element, "parse-images", parse_images, NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (picture_pad_added),
+      &data);
+  gst_harness_set_src_caps_str (h, "video/x-ms-asf");
+
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, 0, offset)),
+      GST_FLOW_OK);
+  while (data.packets_pushed < NUM_PACKETS) {
+    if (data.packets_pushed == NUM_PACKETS / 2 && !parse_images) {
+      fail_unless_equals_int (data.num_tags, 1);
+      fail_unless_equals_int (data.num_images, 0);
+      g_object_set (h->element, "parse-images", TRUE, NULL);
+    }
+    data.packets_pushed++;
+    fail_unless_equals_int (gst_harness_push (h,
+            gst_buffer_copy_region (asf, GST_BUFFER_COPY_ALL, offset,
+                PACKET_SIZE)), GST_FLOW_OK);
+    offset += PACKET_SIZE;
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (data.num_images, 1);
+  check_image (data.image);
+
+  gst_harness_teardown (h);
+  gst_buffer_unref (data.image);
+  gst_buffer_unref (asf);
+
+  return data.num_tags;
+}
+
+GST_START_TEST (test_pictures_parsed)
+{
+  fail_unless_equals_int (run_pictures (TRUE), 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pictures_deferred)
+{
+  /* the global tags go out again, with the picture added */
+  fail_unless_equals_int (run_pictures (FALSE), 2);
+}
+
+GST_END_TEST;
+
+static void
+picture_sink_pad_added (GstElement * demux, GstPad * pad, PictureData * data)
+{
+  GstElement *sink;
+  GstPad *sinkpad;
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", FALSE, NULL);
+  gst_bin_add (GST_BIN (data->pipeline), sink);
+  gst_element_sync_state_with_parent (sink);
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  picture_pad_added (demux, pad, data);
+}
+
+/* in pull mode only the offset of the picture is recorded, it is read
+ * again from the file when asked for */
+GST_START_TEST (test_pictures_deferred_pull)
+{
+  PictureData data = { NULL, };
+  GstElement *src, *demux;
+  GstMessage *msg;
+  GstBuffer *asf;
+  GstMapInfo map;
+  GstBus *bus;
+  gchar *filename;
+  gint fd;
+
+  asf = create_asf (1, ASF_PICTURE);
+  fd = g_file_open_tmp ("asfdemux-XXXXXX.asf", &filename, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+  gst_buffer_map (asf, &map, GST_MAP_READ);
+  fail_unless (g_file_set_contents (filename, (gchar *) map.data, map.size,
+          NULL));
+  gst_buffer_unmap (asf, &map);
+
+  data.pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  demux = gst_element_factory_make ("asfdemux", NULL);
+  g_object_set (src, "location", filename, NULL);
+  g_object_set (demux, "parse-images", FALSE, NULL);
+  gst_bin_add_many (GST_BIN (data.pipeline), src, demux, NULL);
+  fail_unless (gst_element_link (src, demux));
+  g_signal_connect (demux, "pad-added", G_CALLBACK (picture_sink_pad_added),
+      &data);
+
+  /* prerolling blocks the streaming thread after the header went out */
+  gst_element_set_state (data.pipeline, GST_STATE_PAUSED);
+  fail_unless_equals_int (gst_element_get_state (data.pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+  fail_unless_equals_int (data.num_tags, 1);
+  fail_unless_equals_int (data.num_images, 0);
+
+  g_object_set (demux, "parse-images", TRUE, NULL);
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+  bus = gst_element_get_bus (data.pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (data.num_tags, 2);
+  fail_unless_equals_int (data.num_images, 1);
+  check_image (data.image);
+
+  gst_element_set_state (data.pipeline, GST_STATE_NULL);
+  gst_object_unref (data.pipeline);
+  gst_buffer_unref (data.image);
+  g_unlink (filename);
+  g_free (filename);
+  gst_buffer_unref (asf);
+}
+
+GST_END_TEST;
+
+static Suite *
+asfdemux_suite (void)
+{
+  Suite *s = suite_create ("asfdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_push_whole_packets);
+  tcase_add_test (tc_chain, test_push_tiny_chunks);
+  tcase_add_test (tc_chain, test_push_random_chunks);
+  tcase_add_test (tc_chain, test_select_streams);
+  tcase_add_test (tc_chain, test_renditions_highest);
+  tcase_add_test (tc_chain, test_renditions_max_bitrate);
+  tcase_add_test (tc_chain, test_renditions_switch);
+  tcase_add_test (tc_chain, test_trickmode_key_units);
+  tcase_add_test (tc_chain, test_reverse_playback);
+  tcase_add_test (tc_chain, test_output_queues);
+  tcase_add_test (tc_chain, test_preroll_unbounded);
+  tcase_add_test (tc_chain, test_preroll_max_time);
+  tcase_add_test (tc_chain, test_preroll_max_bytes);
+  tcase_add_test (tc_chain, test_probe);
+  tcase_add_test (tc_chain, test_pictures_parsed);
+  tcase_add_test (tc_chain, test_pictures_deferred);
+  tcase_add_test (tc_chain, test_pictures_deferred_pull);
+
+  return s;
+}
+
+GST_CHECK_MAIN (asfdemux);
@@ -0,0 +1,222 @@
+/*
+ * GStreamer
+ *
+ * unit test for cdiocddasrc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <glib/gstdio.h>
+
+#define SECTOR_SIZE 2352
+#define FRAMES_PER_SECTOR (SECTOR_SIZE / 4)
+
+/* two audio tracks of 2 and 1 1/3 seconds */
+#define TRACK1_SECTORS 150
+#define TRACK2_SECTORS 100
+
+static gchar *tmpdir;
+static gchar *bin_file;
+static gchar *cue_file;
+
+/* a smooth triangle wave so the drive endianness is detected as ours */
+static gint16
+sample_at (gint frame)
+{
+  gint pos = frame % 200;
+
+  return (pos < 100 ? pos : 200 - pos) * 100 - 5000;
+}
+
+/* the right channel is a bit behind, so swapped channels show */
+#define RIGHT_DELAY 50
+
+/* BIN/CUE image, which libcdio opens like a drive. With @swapped, the
+ * samples are in the other endianness, like some drives produce them. */
+static void
+create_image (gboolean swapped)
+{
+  GError *err = NULL;
+  guint16 *data;
+  guint16 left, right;
+  gsize size, i;
+  gchar *cue;
+
+  tmpdir = g_dir_make_tmp ("cdiocddasrc-XXXXXX", &err);
+  fail_unless (tmpdir != NULL, "%s", err ? err->message : "");
+  bin_file = g_build_filename (tmpdir, "image.bin", NULL);
+  cue_file = g_build_filename (tmpdir, "image.cue", NULL);
+
+  size = (TRACK1_SECTORS + TRACK2_SECTORS) * SECTOR_SIZE;
+  data = g_malloc (size);
+  for (i = 0; i < size / 4; i++) {
+    left = sample_at (i);
+    right = sample_at (i + RIGHT_DELAY);
+    data[i * 2] = swapped ? GUINT16_SWAP_LE_BE (left) : left;
+    data[i * 2 + 1] = swapped ? GUINT16_SWAP_LE_BE (right) : right;
+  }
+  fail_unless (g_file_set_contents (bin_file, (gchar *) data, size, NULL));
+  g_free (data);
+
+  cue = g_strdup_printf ("FILE \"image.bin\" BINARY\n"
+      "  TRACK 01 AUDIO\n"
+      "    INDEX 01 00:00:00\n"
+      "  TRACK 02 AUDIO\n"
+      "    INDEX 01 00:%02d:%02d\n",
+      TRACK1_SECTORS / 75, TRACK1_SECTORS % 75);
+  fail_unless (g_file_set_contents (cue_file, cue, -1, NULL));
+  g_free (cue);
+}
+
+static void
+remove_image (void)
+{
+  g_unlink (bin_file);
+  g_unlink (cue_file);
+  g_rmdir (tmpdir);
+  g_free (bin_file);
+  g_free (cue_file);
+  g_free (tmpdir);
+}
+
+/* pulls @num_sectors sectors starting at @first_sector and then EOS, the
+ * samples must be in host endianness whatever the image has */
+static void
+check_sectors (GstHarness * h, gint first_sector, gint num_sectors)
+{
+  GstBuffer *buffer;
+  GstEvent *event;
+  GstMapInfo map;
+  gint i, j;
+
+  for (i = 0; i < num_sectors; i++) {
+    const gint16 *samples;
+    gint frame;
+
+    buffer = gst_harness_pull (h);
+    fail_unless (buffer != NULL);
+    fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+    fail_unless_equals_int (map.size, SECTOR_SIZE);
+
+    samples = (const gint16 *) map.data;
+    frame = (first_sector + i) * FRAMES_PER_SECTOR;
+    for (j = 0; j < FRAMES_PER_SECTOR; j++) {
+      fail_unless_equals_int (samples[j * 2], sample_at (frame + j));
+      fail_unless_equals_int (samples[j * 2 + 1],
+          sample_at (frame + j + RIGHT_DELAY));
+    }
+
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+  }
+
+  while ((event = gst_harness_pull_event (h))) {
+    gboolean eos = GST_EVENT_TYPE (event) == GST_EVENT_EOS;
+
+    gst_event_unref (event);
+    if (eos)
+      break;
+  }
+  fail_unless (gst_harness_try_pull (h) == NULL);
+}
+
+static void
+run_disc (guint sectors_per_read, guint readahead, gboolean swapped)
+{
+  GstHarness *h;
+
+  create_image (swapped);
+
+  h = gst_harness_new_with_padnames ("cdiocddasrc", NULL, "src");
+  g_object_set (h->element, "device", cue_file, "sectors-per-read",
+      sectors_per_read, "readahead", readahead, NULL);
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode", "continuous");
+  gst_harness_play (h);
+
+  check_sectors (h, 0, TRACK1_SECTORS + TRACK2_SECTORS);
+
+  gst_harness_teardown (h);
+  remove_image ();
+}
+
+GST_START_TEST (test_read_single)
+{
+  run_disc (1, 0, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_read_batched)
+{
+  run_disc (16, 0, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_readahead)
+{
+  run_disc (16, 4, FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_read_swapped)
+{
+  /* detected from the samples, and swapped back while copying */
+  run_disc (16, 4, TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_readahead_second_track)
+{
+  GstHarness *h;
+
+  create_image (FALSE);
+
+  /* reading ahead starts in the middle of the disc and stops at the end */
+  h = gst_harness_new_with_padnames ("cdiocddasrc", NULL, "src");
+  g_object_set (h->element, "device", cue_file, "track", 2,
+      "sectors-per-read", 7, "readahead", 2, NULL);
+  gst_harness_play (h);
+
+  check_sectors (h, TRACK1_SECTORS, TRACK2_SECTORS);
+
+  gst_harness_teardown (h);
+  remove_image ();
+}
+
+GST_END_TEST;
+
+static Suite *
+cdiocddasrc_suite (void)
+{
+  Suite *s = suite_create ("cdiocddasrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_read_single);
+  tcase_add_test (tc_chain, test_read_batched);
+  tcase_add_test (tc_chain, test_readahead);
+  tcase_add_test (tc_chain, test_read_swapped);
+  tcase_add_test (tc_chain, test_readahead_second_track);
+
+  return s;
+}
+
+GST_CHECK_MAIN (cdiocddasrc);
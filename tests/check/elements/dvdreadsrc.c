@@ -0,0 +1,230 @@
+/*
+ * GStreamer
+ *
+ * unit test for the dvdreadsrc sector/time index
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#include "../../../ext/dvdread/dvdreadindex.c"
+
+/* a time map with an entry every second, VOBUs are 100 sectors apart */
+static vts_tmap_t *
+create_tmap (gint entries)
+{
+  vts_tmap_t *tmap;
+  gint j;
+
+  tmap = g_new0 (vts_tmap_t, 1);
+  tmap->tmu = 1;
+  tmap->nr_of_entries = entries;
+  tmap->map_ent = g_new0 (map_ent_t, entries);
+  for (j = 0; j < entries; j++)
+    tmap->map_ent[j] = 50 + 100 * j;
+
+  return tmap;
+}
+
+static void
+free_tmap (vts_tmap_t * tmap)
+{
+  g_free (tmap->map_ent);
+  g_free (tmap);
+}
+
+/* the lookup dvdreadsrc did before it had an index */
+static GstClockTime
+linear_get_time (vts_tmap_t * tmap, guint sector)
+{
+  gint j;
+
+  for (j = 0; j < tmap->nr_of_entries; ++j) {
+    if ((tmap->map_ent[j] & 0x7fffffff) == sector)
+      return (guint64) tmap->tmu * (j + 1) * GST_SECOND;
+  }
+  return GST_CLOCK_TIME_NONE;
+}
+
+GST_START_TEST (test_index_tmap)
+{
+  GstDvdReadIndex *index;
+  vts_tmap_t *tmap;
+
+  tmap = create_tmap (3600);
+  index = gst_dvd_read_index_new_from_tmap (tmap);
+
+  fail_unless_equals_uint64 (gst_dvd_read_index_get_time (index, 50),
+      GST_SECOND);
+  fail_unless_equals_uint64 (gst_dvd_read_index_get_time (index, 250),
+      3 * GST_SECOND);
+  fail_unless_equals_uint64 (gst_dvd_read_index_get_time (index, 0), 0);
+  fail_unless (gst_dvd_read_index_get_time (index, 51) == GST_CLOCK_TIME_NONE);
+
+  /* the entry at or before the time */
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index,
+          2500 * GST_MSECOND), 150);
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index,
+          2 * GST_SECOND), 150);
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index,
+          500 * GST_MSECOND), 50);
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index,
+          3601 * GST_SECOND), -1);
+
+  gst_dvd_read_index_free (index);
+  free_tmap (tmap);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_index_cells)
+{
+  GstDvdReadIndex *index;
+  cell_playback_t cells[2];
+  pgc_t *pgc;
+
+  memset (cells, 0, sizeof (cells));
+  cells[0].first_sector = 0;
+  cells[0].last_sector = 999;
+  cells[0].playback_time.second = 0x10;
+  cells[1].first_sector = 1000;
+  cells[1].last_sector = 1999;
+  cells[1].playback_time.second = 0x10;
+
+  pgc = g_new0 (pgc_t, 1);
+  pgc->nr_of_cells = 2;
+  pgc->cell_playback = cells;
+
+  index = gst_dvd_read_index_new_from_pgc (pgc);
+
+  /* positions within cells are interpolated */
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index, 0), 0);
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index,
+          5 * GST_SECOND), 500);
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index,
+          15 * GST_SECOND), 1500);
+  fail_unless_equals_int (gst_dvd_read_index_get_sector (index,
+          25 * GST_SECOND), -1);
+
+  fail_unless_equals_uint64 (gst_dvd_read_index_get_time (index, 1000),
+      10 * GST_SECOND);
+  fail_unless (gst_dvd_read_index_get_time (index, 1500) ==
+      GST_CLOCK_TIME_NONE);
+
+  gst_dvd_read_index_free (index);
+  g_free (pgc);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_index_other_tmaps)
+{
+  GstDvdReadIndex *index;
+  vts_tmapt_t tmapt;
+  vts_tmap_t tmaps[3];
+  vts_tmap_t *first, *second;
+
+  /* the title's own map, another title's map further on, and an empty one */
+  first = create_tmap (10);
+  second = create_tmap (10);
+  second->tmu = 2;
+  second->map_ent[4] = 5000;
+
+  memset (&tmapt, 0, sizeof (tmapt));
+  memset (tmaps, 0, sizeof (tmaps));
+  tmaps[0] = *first;
+  tmaps[1] = *second;
+  tmapt.nr_of_tmaps = 3;
+  tmapt.tmap = tmaps;
+
+  index = gst_dvd_read_index_new_from_tmap (&tmaps[0]);
+  fail_unless (gst_dvd_read_index_get_time (index, 5000) ==
+      GST_CLOCK_TIME_NONE);
+
+  /* both maps have sector 250, the first one wins */
+  fail_unless_equals_uint64 (gst_dvd_read_index_scan_tmapt (&tmapt, 250),
+      3 * GST_SECOND);
+  fail_unless_equals_uint64 (gst_dvd_read_index_scan_tmapt (&tmapt, 5000),
+      10 * GST_SECOND);
+  fail_unless (gst_dvd_read_index_scan_tmapt (&tmapt, 5001) ==
+      GST_CLOCK_TIME_NONE);
+  fail_unless (gst_dvd_read_index_scan_tmapt (NULL, 250) ==
+      GST_CLOCK_TIME_NONE);
+
+  gst_dvd_read_index_free (index);
+  free_tmap (first);
+  free_tmap (second);
+}
+
+GST_END_TEST;
+
+#define BENCH_ENTRIES (3 * 3600)
+#define BENCH_LOOKUPS 10000
+
+GST_START_TEST (test_index_benchmark)
+{
+  GstDvdReadIndex *index;
+  vts_tmap_t *tmap;
+  gint64 linear, indexed;
+  guint sector;
+  gint i;
+
+  /* a 3 hour title with a one second time map */
+  tmap = create_tmap (BENCH_ENTRIES);
+  index = gst_dvd_read_index_new_from_tmap (tmap);
+
+  linear = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_LOOKUPS; i++) {
+    sector = 50 + 100 * g_random_int_range (0, BENCH_ENTRIES);
+    fail_unless (GST_CLOCK_TIME_IS_VALID (linear_get_time (tmap, sector)));
+  }
+  linear = g_get_monotonic_time () - linear;
+
+  indexed = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_LOOKUPS; i++) {
+    sector = 50 + 100 * g_random_int_range (0, BENCH_ENTRIES);
+    fail_unless (GST_CLOCK_TIME_IS_VALID (gst_dvd_read_index_get_time (index,
+                sector)));
+  }
+  indexed = g_get_monotonic_time () - indexed;
+
+  GST_INFO ("%d sector lookups in %d entries: %" G_GINT64_FORMAT " us "
+      "linear, %" G_GINT64_FORMAT " us indexed", BENCH_LOOKUPS, BENCH_ENTRIES,
+      linear, indexed);
+
+  gst_dvd_read_index_free (index);
+  free_tmap (tmap);
+}
+
+GST_END_TEST;
+
+static Suite *
+dvdreadsrc_suite (void)
+{
+  Suite *s = suite_create ("dvdreadsrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_index_tmap);
+  tcase_add_test (tc_chain, test_index_cells);
+  tcase_add_test (tc_chain, test_index_other_tmaps);
+  tcase_add_test (tc_chain, test_index_benchmark);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dvdreadsrc);
@@ -0,0 +1,173 @@
+/*
+ * GStreamer
+ *
+ * unit test for rdtmanager
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/check/gsttestclock.h>
+
+#define RDT_CAPS "application/x-rdt, clock-rate = (int) 1000"
+#define LATENCY_MS 100
+
+static GstCaps *
+request_pt_map (GstElement * element, guint session, guint pt,
+    gpointer user_data)
+{
+  return gst_caps_from_string (RDT_CAPS);
+}
+
+static GstHarness *
+setup_rdtmanager (void)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("rdtmanager", "recv_rtp_sink_0",
+      "recv_rtp_src_0_0_0");
+  g_signal_connect (h->element, "request-pt-map",
+      G_CALLBACK (request_pt_map), NULL);
+  g_object_set (h->element, "latency", LATENCY_MS, NULL);
+  gst_harness_use_testclock (h);
+  gst_harness_set_src_caps_str (h, RDT_CAPS);
+
+  return h;
+}
+
+/* a data packet without length and reliable seqnum on stream 0, the RDT
+ * timestamp is in ms, like the arrival time */
+static void
+push_packet (GstHarness * h, guint16 seqnum, guint32 time_ms)
+{
+  GstBuffer *buffer;
+  guint8 *data;
+
+  data = g_malloc0 (12);
+  GST_WRITE_UINT16_BE (data + 1, seqnum);
+  GST_WRITE_UINT32_BE (data + 4, time_ms);
+
+  buffer = gst_buffer_new_wrapped (data, 12);
+  GST_BUFFER_PTS (buffer) = time_ms * GST_MSECOND;
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+}
+
+static void
+pull_packet (GstHarness * h, guint16 seqnum, guint release_ms)
+{
+  GstTestClock *testclock;
+  GstBuffer *buffer;
+  GstMapInfo map;
+
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+
+  testclock = gst_harness_get_testclock (h);
+  fail_unless_equals_uint64 (gst_clock_get_time (GST_CLOCK (testclock)),
+      release_ms * GST_MSECOND);
+  gst_object_unref (testclock);
+
+  buffer = gst_harness_pull (h);
+  fail_unless (buffer != NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  fail_unless_equals_int (GST_READ_UINT16_BE (map.data + 1), seqnum);
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+}
+
+GST_START_TEST (test_reorder)
+{
+  GstHarness *h = setup_rdtmanager ();
+
+  push_packet (h, 0, 0);
+  push_packet (h, 2, 40);
+  push_packet (h, 1, 20);
+
+  /* nothing is released before the latency expired */
+  gst_harness_wait_for_clock_id_waits (h, 1, 60);
+  fail_unless_equals_int (gst_harness_buffers_received (h), 0);
+
+  /* packets come out in seqnum order at running time plus latency */
+  pull_packet (h, 0, LATENCY_MS);
+  pull_packet (h, 1, 20 + LATENCY_MS);
+  pull_packet (h, 2, 40 + LATENCY_MS);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_lost)
+{
+  GstHarness *h = setup_rdtmanager ();
+  GstStructure *stats;
+  const GValue *sessions;
+  const GstStructure *session;
+  const GstStructure *s;
+  GstEvent *event;
+  gboolean found = FALSE;
+  guint seqnum, count;
+  gint64 lost;
+
+  push_packet (h, 0, 0);
+  push_packet (h, 2, 40);
+
+  pull_packet (h, 0, LATENCY_MS);
+  /* #1 never arrives, it is declared lost when #2 is released */
+  pull_packet (h, 2, 40 + LATENCY_MS);
+
+  while ((event = gst_harness_try_pull_event (h))) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_DOWNSTREAM) {
+      s = gst_event_get_structure (event);
+      fail_unless (gst_structure_has_name (s, "GstRDTPacketLost"));
+      fail_unless (gst_structure_get_uint (s, "seqnum", &seqnum));
+      fail_unless (gst_structure_get_uint (s, "count", &count));
+      fail_unless_equals_int (seqnum, 1);
+      fail_unless_equals_int (count, 1);
+      found = TRUE;
+    }
+    gst_event_unref (event);
+  }
+  fail_unless (found);
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  sessions = gst_structure_get_value (stats, "session-stats");
+  fail_unless_equals_int (gst_value_array_get_size (sessions), 1);
+  session = gst_value_get_structure (gst_value_array_get_value (sessions, 0));
+  fail_unless (gst_structure_get_int64 (session, "packets-lost", &lost));
+  fail_unless_equals_int (lost, 1);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+rdtmanager_suite (void)
+{
+  Suite *s = suite_create ("rdtmanager");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_reorder);
+  tcase_add_test (tc_chain, test_lost);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rdtmanager);
@@ -0,0 +1,184 @@
+/*
+ * GStreamer
+ *
+ * unit test for rmdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define CHUNK_HEADER    10
+#define RMF_SIZE        (CHUNK_HEADER + 8)
+#define PROP_SIZE       (CHUNK_HEADER + 40)
+#define DATA_SIZE       (CHUNK_HEADER + 8)
+#define DURATION_MS     12340
+
+#define STREAM_NAME     "Audio Stream"
+#define STREAM_MIME     "audio/x-pn-realaudio"
+/* ".ra\xfd" and the version, 3 is 14.4 audio which needs nothing else */
+#define TYPE_SPECIFIC   6
+#define MDPR_SIZE       (CHUNK_HEADER + 30 + 1 + sizeof (STREAM_NAME) - 1 + \
+                         1 + sizeof (STREAM_MIME) - 1 + 4 + TYPE_SPECIFIC)
+
+#define HEADER_SIZE     (RMF_SIZE + PROP_SIZE + MDPR_SIZE + DATA_SIZE)
+
+static guint8 *
+write_chunk (guint8 * p, guint32 fourcc, guint32 size)
+{
+  GST_WRITE_UINT32_LE (p, fourcc);
+  GST_WRITE_UINT32_BE (p + 4, size);
+  GST_WRITE_UINT16_BE (p + 8, 0);
+  return p + CHUNK_HEADER;
+}
+
+static guint8 *
+write_string8 (guint8 * p, const gchar * str)
+{
+  guint len = strlen (str);
+
+  GST_WRITE_UINT8 (p, len);
+  memcpy (p + 1, str, len);
+  return p + 1 + len;
+}
+
+/* .RMF, PROP, one audio MDPR and the DATA header, followed by @data_size
+ * bytes of garbage that is never looked at when probing */
+static GstBuffer *
+create_rm (gsize data_size)
+{
+  guint8 *data, *p;
+
+  data = g_malloc0 (HEADER_SIZE + data_size);
+
+  p = write_chunk (data, GST_MAKE_FOURCC ('.', 'R', 'M', 'F'), RMF_SIZE);
+  GST_WRITE_UINT32_BE (p + 4, 4);       /* num headers */
+  p += RMF_SIZE - CHUNK_HEADER;
+
+  p = write_chunk (p, GST_MAKE_FOURCC ('P', 'R', 'O', 'P'), PROP_SIZE);
+  GST_WRITE_UINT32_BE (p + 20, DURATION_MS);
+  GST_WRITE_UINT32_BE (p + 32, HEADER_SIZE - DATA_SIZE);
+  GST_WRITE_UINT16_BE (p + 36, 1);      /* num streams */
+  p += PROP_SIZE - CHUNK_HEADER;
+
+  p = write_chunk (p, GST_MAKE_FOURCC ('M', 'D', 'P', 'R'), MDPR_SIZE);
+  GST_WRITE_UINT16_BE (p, 0);   /* stream number */
+  GST_WRITE_UINT32_BE (p + 2, 8000);    /* max bitrate */
+  GST_WRITE_UINT32_BE (p + 6, 8000);    /* avg bitrate */
+  GST_WRITE_UINT32_BE (p + 26, DURATION_MS);
+  p = write_string8 (p + 30, STREAM_NAME);
+  p = write_string8 (p, STREAM_MIME);
+  GST_WRITE_UINT32_BE (p, TYPE_SPECIFIC);
+  memcpy (p + 4, ".ra\xfd", 4);
+  GST_WRITE_UINT16_BE (p + 8, 3);
+  p += 4 + TYPE_SPECIFIC;
+
+  p = write_chunk (p, GST_MAKE_FOURCC ('D', 'A', 'T', 'A'),
+      DATA_SIZE + data_size);
+  fail_unless_equals_int (p + DATA_SIZE - CHUNK_HEADER - data,
+      HEADER_SIZE);
+
+  return gst_buffer_new_wrapped (data, HEADER_SIZE + data_size);
+}
+
+static void
+pad_added (GstElement * demux, GstPad * pad, gpointer user_data)
+{
+  fail ("pad %s added while probing", GST_PAD_NAME (pad));
+}
+
+GST_START_TEST (test_probe)
+{
+  GstStreamCollection *collection;
+  const GstStructure *s;
+  GstClockTime duration;
+  GstTagList *tags;
+  GstMessage *msg;
+  GstHarness *h;
+  GstBus *bus;
+  gchar *format;
+  guint num_streams;
+
+  h = gst_harness_new_with_padnames ("rmdemux", "sink", NULL);
+  g_object_set (h->element, "probe", TRUE, NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (pad_added), NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (h->element, bus);
+  gst_harness_set_src_caps_str (h, "application/vnd.rn-realmedia");
+
+  /* the data section is not even looked at */
+  fail_unless_equals_int (gst_harness_push (h, create_rm (1024)),
+      GST_FLOW_EOS);
+  fail_unless_equals_int (gst_harness_push (h, create_rm (1024)),
+      GST_FLOW_EOS);
+  gst_harness_push_event (h, gst_event_new_eos ());
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_STREAM_COLLECTION);
+  fail_unless (msg != NULL);
+  gst_message_parse_stream_collection (msg, &collection);
+  gst_message_unref (msg);
+  fail_unless_equals_int (gst_stream_collection_get_size (collection), 1);
+  fail_unless_equals_int (gst_stream_get_stream_type
+      (gst_stream_collection_get_stream (collection, 0)),
+      GST_STREAM_TYPE_AUDIO);
+  gst_object_unref (collection);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_TAG);
+  fail_unless (msg != NULL);
+  gst_message_parse_tag (msg, &tags);
+  gst_message_unref (msg);
+  fail_unless (gst_tag_list_get_uint64 (tags, GST_TAG_DURATION, &duration));
+  fail_unless_equals_uint64 (duration, DURATION_MS * GST_MSECOND);
+  fail_unless (gst_tag_list_get_string (tags, GST_TAG_CONTAINER_FORMAT,
+          &format));
+  fail_unless_equals_string (format, "RealMedia");
+  g_free (format);
+  gst_tag_list_unref (tags);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  fail_unless (msg != NULL);
+  s = gst_message_get_structure (msg);
+  fail_unless (gst_structure_has_name (s, "probe-done"));
+  fail_unless (gst_structure_get_uint (s, "num-streams", &num_streams));
+  fail_unless_equals_int (num_streams, 1);
+  fail_unless (gst_structure_get_uint64 (s, "duration", &duration));
+  fail_unless_equals_uint64 (duration, DURATION_MS * GST_MSECOND);
+  gst_message_unref (msg);
+
+  fail_unless (gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT) == NULL);
+  fail_unless_equals_int (h->element->numsrcpads, 0);
+
+  gst_element_set_bus (h->element, NULL);
+  gst_object_unref (bus);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+rmdemux_suite (void)
+{
+  Suite *s = suite_create ("rmdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_probe);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rmdemux);
@@ -0,0 +1,244 @@
+/*
+ * GStreamer
+ *
+ * unit test for rtpasfdepay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#define PACKET_SIZE     100
+#define HEADERS_SIZE    32
+
+/* the ASF header object GUID, followed by garbage nobody looks at */
+static const guint8 asf_marker[16] = { 0x30, 0x26, 0xb2, 0x75, 0x8e, 0x66,
+  0xcf, 0x11, 0xa6, 0xd9, 0x00, 0xaa, 0x00, 0x62, 0xce, 0x6c
+};
+
+static GstCaps *
+create_caps (guint maxps, gboolean valid)
+{
+  guint8 headers[HEADERS_SIZE] = { 0, };
+  GstCaps *caps;
+  gchar *config, *ps;
+
+  if (valid)
+    memcpy (headers, asf_marker, sizeof (asf_marker));
+  config = g_base64_encode (headers, sizeof (headers));
+  ps = g_strdup_printf ("%u", maxps);
+
+  caps = gst_caps_new_simple ("application/x-rtp",
+      "media", G_TYPE_STRING, "application",
+      "payload", G_TYPE_INT, 96,
+      "clock-rate", G_TYPE_INT, 1000,
+      "encoding-name", G_TYPE_STRING, "X-ASF-PF",
+      "config", G_TYPE_STRING, config, "maxps", G_TYPE_STRING, ps, NULL);
+
+  g_free (config);
+  g_free (ps);
+
+  return caps;
+}
+
+static GstHarness *
+setup_rtpasfdepay (void)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+
+  h = gst_harness_new ("rtpasfdepay");
+  gst_harness_set_src_caps (h, create_caps (PACKET_SIZE, TRUE));
+
+  /* the headers go out first */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), HEADERS_SIZE);
+  fail_unless_equals_int (gst_buffer_memcmp (buf, 0, asf_marker,
+          sizeof (asf_marker)), 0);
+  gst_buffer_unref (buf);
+
+  return h;
+}
+
+/* an ASF packet of @len bytes without error correction and with a WORD
+ * padding length field at offset 2, set to 0 as the spec says */
+static void
+fill_packet (guint8 * data, guint len)
+{
+  guint i;
+
+  data[0] = 0x10;
+  data[1] = 0x5d;
+  for (i = 2; i < len; i++)
+    data[i] = i < 4 ? 0 : i & 0xff;
+}
+
+/* pushes @len bytes of @packet from @offset in one RTP packet, as the
+ * complete packet if @offset is -1 or as a fragment otherwise */
+static void
+push_rtp (GstHarness * h, const guint8 * packet, gint offset, guint len,
+    gboolean marker, guint16 seqnum)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buf;
+  guint8 *payload;
+  guint value;
+
+  buf = gst_rtp_buffer_new_allocate (4 + len, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_seq (&rtp, seqnum);
+  gst_rtp_buffer_set_marker (&rtp, marker);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+
+  /* S, and L with the length for a complete packet */
+  payload[0] = offset < 0 ? 0xc0 : 0x80;
+  value = offset < 0 ? len : offset;
+  payload[1] = (value >> 16) & 0xff;
+  payload[2] = (value >> 8) & 0xff;
+  payload[3] = value & 0xff;
+  memcpy (payload + 4, packet + MAX (offset, 0), len);
+  gst_rtp_buffer_unmap (&rtp);
+
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+}
+
+/* pulls a packet and checks that it is @len bytes of @packet with the
+ * padding length filled in, followed by zeros up to the packet size */
+static void
+check_packet (GstHarness * h, const guint8 * packet, guint len)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint i;
+
+  buf = gst_harness_pull (h);
+  fail_unless (buf != NULL);
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.size, PACKET_SIZE);
+
+  fail_unless_equals_int (map.data[0], packet[0]);
+  fail_unless_equals_int (map.data[1], packet[1]);
+  fail_unless_equals_int (GST_READ_UINT16_LE (map.data + 2),
+      PACKET_SIZE - len);
+  fail_unless_equals_int (memcmp (map.data + 4, packet + 4, len - 4), 0);
+  for (i = len; i < PACKET_SIZE; i++)
+    fail_unless_equals_int (map.data[i], 0);
+
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+}
+
+GST_START_TEST (test_padded)
+{
+  guint8 packet[PACKET_SIZE];
+  GstHarness *h = setup_rtpasfdepay ();
+
+  fill_packet (packet, PACKET_SIZE);
+
+  push_rtp (h, packet, -1, 40, TRUE, 0);
+  check_packet (h, packet, 40);
+
+  /* the padding is shared between packets, it must not pick up data */
+  push_rtp (h, packet, -1, 60, TRUE, 1);
+  check_packet (h, packet, 60);
+  push_rtp (h, packet, -1, 40, TRUE, 2);
+  check_packet (h, packet, 40);
+
+  /* complete packets come out as they are */
+  push_rtp (h, packet, -1, PACKET_SIZE, TRUE, 3);
+  check_packet (h, packet, PACKET_SIZE);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_fragmented)
+{
+  guint8 packet[PACKET_SIZE];
+  GstHarness *h = setup_rtpasfdepay ();
+
+  fill_packet (packet, PACKET_SIZE);
+
+  push_rtp (h, packet, 0, 35, FALSE, 0);
+  push_rtp (h, packet, 35, 35, FALSE, 1);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 0);
+  push_rtp (h, packet, 70, 10, TRUE, 2);
+  check_packet (h, packet, 80);
+
+  /* a fragment that doesn't line up drops the packet */
+  push_rtp (h, packet, 0, 35, FALSE, 3);
+  push_rtp (h, packet, 40, 35, TRUE, 4);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 0);
+
+  /* and we pick up again from the next one */
+  push_rtp (h, packet, 0, 50, FALSE, 5);
+  push_rtp (h, packet, 50, 50, TRUE, 6);
+  check_packet (h, packet, PACKET_SIZE);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_invalid_headers)
+{
+  guint8 packet[PACKET_SIZE];
+  GstHarness *h;
+
+  fill_packet (packet, PACKET_SIZE);
+
+  h = gst_harness_new ("rtpasfdepay");
+  fail_unless (gst_pad_push_event (h->srcpad,
+          gst_event_new_stream_start ("rtpasfdepay")));
+
+  /* neither of these may leave the packet size behind */
+  fail_if (gst_pad_push_event (h->srcpad,
+          gst_event_new_caps (create_caps (PACKET_SIZE, FALSE))));
+  fail_if (gst_pad_push_event (h->srcpad,
+          gst_event_new_caps (create_caps (16, TRUE))));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 0);
+
+  /* so the same size with valid headers is not taken for a repeat */
+  gst_harness_set_src_caps (h, create_caps (PACKET_SIZE, TRUE));
+  gst_buffer_unref (gst_harness_pull (h));
+
+  push_rtp (h, packet, -1, 40, TRUE, 0);
+  check_packet (h, packet, 40);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+rtpasfdepay_suite (void)
+{
+  Suite *s = suite_create ("rtpasfdepay");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_padded);
+  tcase_add_test (tc_chain, test_fragmented);
+  tcase_add_test (tc_chain, test_invalid_headers);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtpasfdepay);
@@ -0,0 +1,137 @@
+/*
+ * GStreamer
+ *
+ * unit test for the rtspreal bandwidth adaptation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#include "../../../gst/realmedia/rtsprealadapt.c"
+
+#define MAX_BANDWIDTH   1000000
+#define EXPECTED        200000
+
+/* reports @rate @n times, returns TRUE if the last one changed the
+ * subscription, none of the others may */
+static gboolean
+report (GstRTSPRealAdapt * adapt, guint64 rate, guint64 expected, guint n,
+    guint * bandwidth)
+{
+  guint i;
+
+  for (i = 1; i < n; i++)
+    fail_if (gst_rtsp_real_adapt_update (adapt, rate, expected, bandwidth),
+        "switched after %u reports", i);
+  return gst_rtsp_real_adapt_update (adapt, rate, expected, bandwidth);
+}
+
+GST_START_TEST (test_adapt_down)
+{
+  GstRTSPRealAdapt adapt;
+  guint bandwidth = 0;
+
+  gst_rtsp_real_adapt_init (&adapt, MAX_BANDWIDTH);
+
+  /* below 85% of what the rules need */
+  fail_unless (report (&adapt, EXPECTED * 80 / 100, EXPECTED,
+          GST_RTSP_REAL_ADAPT_DOWN_REPORTS, &bandwidth));
+  fail_unless_equals_int (bandwidth, EXPECTED * 80 / 100);
+  fail_unless_equals_int (adapt.bandwidth, bandwidth);
+
+  /* the count starts over */
+  fail_unless (report (&adapt, EXPECTED / 2, EXPECTED,
+          GST_RTSP_REAL_ADAPT_DOWN_REPORTS, &bandwidth));
+  fail_unless_equals_int (bandwidth, EXPECTED / 2);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_adapt_hysteresis)
+{
+  GstRTSPRealAdapt adapt;
+  guint bandwidth = 0;
+  guint i;
+
+  gst_rtsp_real_adapt_init (&adapt, MAX_BANDWIDTH);
+
+  /* between 85% and 95% nothing changes, however long it lasts */
+  for (i = 0; i < 2 * GST_RTSP_REAL_ADAPT_UP_REPORTS; i++)
+    fail_if (gst_rtsp_real_adapt_update (&adapt, EXPECTED * 90 / 100,
+            EXPECTED, &bandwidth));
+
+  /* a report in between resets the low count */
+  for (i = 1; i < GST_RTSP_REAL_ADAPT_DOWN_REPORTS; i++)
+    fail_if (gst_rtsp_real_adapt_update (&adapt, EXPECTED / 2, EXPECTED,
+            &bandwidth));
+  fail_if (gst_rtsp_real_adapt_update (&adapt, EXPECTED * 90 / 100,
+          EXPECTED, &bandwidth));
+  fail_if (gst_rtsp_real_adapt_update (&adapt, EXPECTED / 2, EXPECTED,
+          &bandwidth));
+
+  /* without AverageBandwidth in the rules there is nothing to compare */
+  for (i = 0; i < 2 * GST_RTSP_REAL_ADAPT_UP_REPORTS; i++)
+    fail_if (gst_rtsp_real_adapt_update (&adapt, 0, 0, &bandwidth));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_adapt_up)
+{
+  GstRTSPRealAdapt adapt;
+  guint bandwidth = 0;
+
+  gst_rtsp_real_adapt_init (&adapt, MAX_BANDWIDTH);
+
+  /* already at the maximum, nothing to probe */
+  fail_if (report (&adapt, EXPECTED, EXPECTED,
+          GST_RTSP_REAL_ADAPT_UP_REPORTS, &bandwidth));
+
+  fail_unless (report (&adapt, EXPECTED / 2, EXPECTED,
+          GST_RTSP_REAL_ADAPT_DOWN_REPORTS, &bandwidth));
+  fail_unless_equals_int (bandwidth, EXPECTED / 2);
+
+  /* keeping up with the lower rules probes twice the bandwidth */
+  fail_unless (report (&adapt, EXPECTED / 2, EXPECTED / 2,
+          GST_RTSP_REAL_ADAPT_UP_REPORTS, &bandwidth));
+  fail_unless_equals_int (bandwidth, EXPECTED);
+
+  /* but never more than the maximum */
+  fail_unless (report (&adapt, MAX_BANDWIDTH, EXPECTED,
+          GST_RTSP_REAL_ADAPT_UP_REPORTS, &bandwidth));
+  fail_unless_equals_int (bandwidth, MAX_BANDWIDTH);
+  fail_if (report (&adapt, MAX_BANDWIDTH, EXPECTED,
+          GST_RTSP_REAL_ADAPT_UP_REPORTS, &bandwidth));
+}
+
+GST_END_TEST;
+
+static Suite *
+rtspreal_suite (void)
+{
+  Suite *s = suite_create ("rtspreal");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_adapt_down);
+  tcase_add_test (tc_chain, test_adapt_hysteresis);
+  tcase_add_test (tc_chain, test_adapt_up);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtspreal);
@@ -0,0 +1,217 @@
+/*
+ * GStreamer
+ *
+ * unit test for siddec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/audio/audio.h>
+
+#define RAW_CAPS "audio/x-raw, format = (string)" GST_AUDIO_NE (S16) ", " \
+    "layout = (string) interleaved, channels = (int) 1, rate = (int) 44100"
+
+/* a PSID v1 tune with one song, loaded at $1000: an init routine that sets
+ * the volume and starts a voice and a play routine that returns */
+static const guint8 tune_data[] = {
+  /* load address */
+  0x00, 0x10,
+  /* $1000 init: lda #$0f, sta $d418, lda #$11, sta $d404, rts */
+  0xa9, 0x0f, 0x8d, 0x18, 0xd4, 0xa9, 0x11, 0x8d, 0x04, 0xd4, 0x60,
+  /* $100b play: rts */
+  0x60
+};
+
+static GstBuffer *
+create_tune (void)
+{
+  GstBuffer *buffer;
+  guint8 *data;
+
+  data = (guint8 *) g_malloc0 (0x76 + sizeof (tune_data));
+  memcpy (data, "PSID", 4);
+  GST_WRITE_UINT16_BE (data + 4, 1);    /* version */
+  GST_WRITE_UINT16_BE (data + 6, 0x76); /* data offset */
+  GST_WRITE_UINT16_BE (data + 8, 0);    /* load address is in the data */
+  GST_WRITE_UINT16_BE (data + 10, 0x1000);      /* init address */
+  GST_WRITE_UINT16_BE (data + 12, 0x100b);      /* play address */
+  GST_WRITE_UINT16_BE (data + 14, 1);   /* songs */
+  GST_WRITE_UINT16_BE (data + 16, 1);   /* start song */
+  memcpy (data + 22, "test", 4);
+  memcpy (data + 0x76, tune_data, sizeof (tune_data));
+
+  buffer = gst_buffer_new_wrapped (data, 0x76 + sizeof (tune_data));
+
+  return buffer;
+}
+
+static GstBuffer *
+pull_discont (GstHarness * h)
+{
+  GstBuffer *buffer;
+
+  while ((buffer = gst_harness_pull (h))) {
+    if (GST_BUFFER_IS_DISCONT (buffer))
+      break;
+    gst_buffer_unref (buffer);
+  }
+
+  return buffer;
+}
+
+GST_START_TEST (test_seek)
+{
+  GstHarness *h;
+  GstBuffer *buffer;
+  GstEvent *seek;
+  gint64 elapsed;
+  gint i;
+
+  h = gst_harness_new ("siddec");
+  gst_harness_set_src_caps_str (h, "audio/x-sid");
+  gst_harness_set_sink_caps_str (h, RAW_CAPS);
+
+  /* the tune starts playing when it was loaded completely */
+  fail_unless_equals_int (gst_harness_push (h, create_tune ()), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  buffer = pull_discont (h);
+  fail_unless (buffer != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 0);
+  gst_buffer_unref (buffer);
+
+  /* seek forward, and back to the same place again */
+  for (i = 0; i < 2; i++) {
+    seek = gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+        GST_SEEK_TYPE_SET, 180 * GST_SECOND, GST_SEEK_TYPE_NONE, -1);
+
+    elapsed = g_get_monotonic_time ();
+    fail_unless (gst_harness_push_upstream_event (h, seek));
+    elapsed = g_get_monotonic_time () - elapsed;
+
+    GST_INFO ("seek to 3:00 took %" G_GINT64_FORMAT " us", elapsed);
+
+    buffer = pull_discont (h);
+    fail_unless (buffer != NULL);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 180 * GST_SECOND);
+    gst_buffer_unref (buffer);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_song_length)
+{
+  GstHarness *h;
+  GstBuffer *buffer;
+  GstEvent *event;
+  GstCaps *metadata;
+  gint64 duration;
+  gsize size = 0;
+  gint songs;
+
+  h = gst_harness_new ("siddec");
+  g_object_set (h->element, "song-length", GST_SECOND, NULL);
+  gst_harness_set_src_caps_str (h, "audio/x-sid");
+  gst_harness_set_sink_caps_str (h, RAW_CAPS);
+
+  fail_unless_equals_int (gst_harness_push (h, create_tune ()), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  g_object_get (h->element, "metadata", &metadata, NULL);
+  fail_unless (metadata != NULL);
+  fail_unless (gst_structure_get_int (gst_caps_get_structure (metadata, 0),
+          "songs", &songs));
+  fail_unless_equals_int (songs, 1);
+  gst_caps_unref (metadata);
+
+  fail_unless (gst_element_query_duration (h->element, GST_FORMAT_TIME,
+          &duration));
+  fail_unless_equals_uint64 (duration, GST_SECOND);
+
+  /* the tune ends after one second */
+  while ((event = gst_harness_pull_event (h))) {
+    gboolean eos = GST_EVENT_TYPE (event) == GST_EVENT_EOS;
+
+    gst_event_unref (event);
+    if (eos)
+      break;
+  }
+  while ((buffer = gst_harness_try_pull (h))) {
+    size += gst_buffer_get_size (buffer);
+    gst_buffer_unref (buffer);
+  }
+  fail_unless (size >= 44100 * 2);
+  fail_unless (size < 44100 * 2 + 4096);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_default_song_length)
+{
+  GstHarness *h;
+  gint64 duration;
+
+  /* without a song length the estimate is reported */
+  h = gst_harness_new ("siddec");
+  gst_harness_set_src_caps_str (h, "audio/x-sid");
+  gst_harness_set_sink_caps_str (h, RAW_CAPS);
+
+  fail_unless_equals_int (gst_harness_push (h, create_tune ()), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless (gst_element_query_duration (h->element, GST_FORMAT_TIME,
+          &duration));
+  fail_unless_equals_uint64 (duration, 5 * 60 * GST_SECOND);
+  gst_harness_teardown (h);
+
+  /* unless the tune is to play forever */
+  h = gst_harness_new ("siddec");
+  g_object_set (h->element, "default-song-length", GST_CLOCK_TIME_NONE, NULL);
+  gst_harness_set_src_caps_str (h, "audio/x-sid");
+  gst_harness_set_sink_caps_str (h, RAW_CAPS);
+
+  fail_unless_equals_int (gst_harness_push (h, create_tune ()), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_if (gst_element_query_duration (h->element, GST_FORMAT_TIME,
+          &duration));
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+siddec_suite (void)
+{
+  Suite *s = suite_create ("siddec");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_seek);
+  tcase_add_test (tc_chain, test_song_length);
+  tcase_add_test (tc_chain, test_default_song_length);
+
+  return s;
+}
+
+GST_CHECK_MAIN (siddec);